@@ -50,6 +50,7 @@
 #include "gromacs/analysisdata/dataframe.h"
 #include "gromacs/analysisdata/datamodulemanager.h"
 #include "gromacs/analysisdata/paralleloptions.h"
+#include "gromacs/legacyheaders/thread_mpi/mutex.h"
 #include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/gmxassert.h"
 #include "gromacs/utility/uniqueptr.h"
@@ -251,7 +252,7 @@ class AnalysisDataStorageImpl
          * There is always one unused frame in the buffer, which is initialized
          * such that when \a firstFrameLocation_ is incremented, it becomes
          * valid.  This makes it easier to rotate the buffer in concurrent
-         * access scenarions (which are not yet otherwise implemented).
+         * access scenarions.
          */
         FrameList               frames_;
         //! Location of oldest frame in \a frames_.
@@ -276,6 +277,14 @@ class AnalysisDataStorageImpl
          * frame (see \a frames_).
          */
         int                     nextIndex_;
+        /*! \brief
+         * Protects the frame buffer and the builders when frames are
+         * started and finished concurrently from multiple data handles.
+         *
+         * The frames are notified to the serial modules with the lock held,
+         * which keeps the notifications in order.
+         */
+        tMPI::mutex             mutex_;
 };
 
 /********************************************************************
@@ -545,6 +554,7 @@ AnalysisDataStorageImpl::notifyNextFrames(size_t firstLocation)
 void
 AnalysisDataStorageImpl::finishFrame(int index)
 {
+    tMPI::lock_guard<tMPI::mutex> lock(mutex_);
     const int storageIndex = computeStorageLocation(index);
     GMX_RELEASE_ASSERT(storageIndex >= 0, "Out of bounds frame index");
 
@@ -885,6 +895,7 @@ AnalysisDataStorageFrame &
 AnalysisDataStorage::startFrame(const AnalysisDataFrameHeader &header)
 {
     GMX_ASSERT(header.isValid(), "Invalid header");
+    tMPI::lock_guard<tMPI::mutex>           lock(impl_->mutex_);
     internal::AnalysisDataStorageFrameData *storedFrame;
     if (impl_->storeAll())
     {
@@ -928,6 +939,7 @@ AnalysisDataStorage::startFrame(int index, real x, real dx)
 AnalysisDataStorageFrame &
 AnalysisDataStorage::currentFrame(int index)
 {
+    tMPI::lock_guard<tMPI::mutex> lock(impl_->mutex_);
     const int storageIndex = impl_->computeStorageLocation(index);
     GMX_RELEASE_ASSERT(storageIndex >= 0, "Out of bounds frame index");
 
@@ -258,8 +258,10 @@ class AnalysisDataStorageFrame
  * take the responsibility of calling all the notification methods in
  * AnalysisDataModuleManager,
  *
- * \todo
- * Proper multi-threaded implementation.
+ * startFrame(), currentFrame() and finishFrame() can be called concurrently
+ * from multiple threads for different frames after
+ * startParallelDataStorage().  The frames are notified to the serial modules
+ * in order from the thread that finishes the oldest pending frame.
  *
  * \inlibraryapi
  * \ingroup module_analysisdata
@@ -77,6 +77,8 @@ FILE* debug = 0;
 #endif
 
 #include "gmx_fatal.h"
+#include "network.h"
+#include "gromacs/utility/common.h"
 
 
 #ifdef GMX_FFT_FFTW3
@@ -839,6 +841,162 @@ static void joinAxesTrans12(t_complex* lout, const t_complex* lin, int maxN, int
 }
 
 
+#if defined GMX_MPI && defined GMX_DOUBLE
+/* Convert n doubles in buf to floats, in place.
+ * Float i overlaps double i/2, which has already been read.
+ */
+static void pack_double_to_float(real* buf, int n)
+{
+    float* fbuf = (float*)buf;
+    int    i;
+
+    for (i = 0; i < n; i++)
+    {
+        fbuf[i] = (float)buf[i];
+    }
+}
+
+/* Convert n floats in buf to doubles, in place.
+ * We loop backwards, so double i only overlaps floats that have been read.
+ */
+static void unpack_float_to_double(real* buf, int n)
+{
+    const float* fbuf = (const float*)buf;
+    int          i;
+
+    for (i = n-1; i >= 0; i--)
+    {
+        buf[i] = fbuf[i];
+    }
+}
+#endif
+
+#ifdef GMX_MPI
+/* Transposes nrow x ncol blocks of blocksize bytes from src into dst */
+static void transpose_blocks(char* dst, const char* src,
+                             int nrow, int ncol, size_t blocksize)
+{
+    int r, c;
+
+    for (r = 0; r < nrow; r++)
+    {
+        for (c = 0; c < ncol; c++)
+        {
+            memcpy(dst + (c*nrow + r)*blocksize,
+                   src + (r*ncol + c)*blocksize,
+                   blocksize);
+        }
+    }
+}
+
+/* Node-aggregated all-to-all over cart[s], with the same result as
+ * MPI_Alltoall. The data for all ranks of a node is first sent in one
+ * message to the rank with the same group index on each other node,
+ * then distributed within the node. This reduces the number of
+ * inter-node messages by a factor nrank_hier[s]. Returns the result
+ * in recvbuf, sendbuf is used as a work buffer.
+ */
+static void alltoall_hier(fft5d_plan plan, int s,
+                          void* sendbuf, void* recvbuf,
+                          int count, MPI_Datatype type, size_t typesize)
+{
+    int    nl, ng;
+    size_t blocksize;
+
+    nl        = plan->nrank_hier[s];
+    ng        = plan->P[s]/nl;
+    blocksize = count*typesize;
+
+    /* Blocks for destination group g are contiguous: send them together */
+    MPI_Alltoall(sendbuf, count*nl, type, recvbuf, count*nl, type,
+                 plan->cart_inter[s]);
+    /* Reorder from [source group][destination rank in group]
+     * to [destination rank in group][source group].
+     */
+    transpose_blocks((char*)sendbuf, (const char*)recvbuf, ng, nl, blocksize);
+    MPI_Alltoall(sendbuf, count*ng, type, recvbuf, count*ng, type,
+                 plan->cart_intra[s]);
+    /* We now have [source rank in group][source group], reorder to
+     * the source rank order in cart[s].
+     */
+    transpose_blocks((char*)sendbuf, (const char*)recvbuf, nl, ng, blocksize);
+    memcpy(recvbuf, sendbuf, plan->P[s]*blocksize);
+}
+#endif
+
+/* Sets up node-aggregated transposes for the parallel dimensions.
+ * With nrank_node>0 the ranks are grouped in consecutive blocks
+ * of nrank_node, with nrank_node=0 they are grouped by physical node.
+ * Grouping is only used when it results in more than one group
+ * with multiple ranks each. Must be called by all ranks of the plan.
+ */
+void fft5d_setup_hier_comm(fft5d_plan plan, int nrank_node)
+{
+#ifdef GMX_MPI
+    int  s, r, rank, nl;
+    int *hash_loc, *hash;
+
+    for (s = 0; s < 2; s++)
+    {
+        plan->nrank_hier[s] = 0;
+        if (!GMX_PARALLEL_ENV_INITIALIZED || plan->cart[s] == MPI_COMM_NULL ||
+            plan->P[s] <= 2)
+        {
+            continue;
+        }
+        MPI_Comm_rank(plan->cart[s], &rank);
+
+        if (nrank_node > 0)
+        {
+            nl = nrank_node;
+        }
+        else
+        {
+            /* Determine the size of the first group of ranks sharing
+             * a physical node and check that all groups are equal in size
+             * and consist of consecutive ranks.
+             */
+            snew(hash_loc, plan->P[s]);
+            snew(hash, plan->P[s]);
+            hash_loc[rank] = gmx_physicalnode_id_hash();
+            MPI_Allreduce(hash_loc, hash, plan->P[s], MPI_INT, MPI_SUM,
+                          plan->cart[s]);
+            nl = 1;
+            while (nl < plan->P[s] && hash[nl] == hash[0])
+            {
+                nl++;
+            }
+            for (r = 0; r < plan->P[s] && nl > 0; r++)
+            {
+                if (hash[r] != hash[r - r % nl] ||
+                    (r % nl == 0 && r > 0 && hash[r] == hash[r - 1]))
+                {
+                    nl = 0;
+                }
+            }
+            sfree(hash_loc);
+            sfree(hash);
+        }
+        if (nl <= 1 || nl >= plan->P[s] || plan->P[s] % nl != 0)
+        {
+            continue;
+        }
+
+        MPI_Comm_split(plan->cart[s], rank/nl, rank, &plan->cart_intra[s]);
+        MPI_Comm_split(plan->cart[s], rank%nl, rank, &plan->cart_inter[s]);
+        plan->nrank_hier[s] = nl;
+        if (debug)
+        {
+            fprintf(debug, "FFT5D: transpose %d uses %d groups of %d ranks\n",
+                    s, plan->P[s]/nl, nl);
+        }
+    }
+#else
+    GMX_UNUSED_VALUE(plan);
+    GMX_UNUSED_VALUE(nrank_node);
+#endif
+}
+
 static void rotate_offsets(int x[])
 {
     int t = x[0];
@@ -1115,13 +1273,42 @@ void fft5d_execute(fft5d_plan plan, int thread, fft5d_time times)
                 FFTW(execute)(mpip[s]);
 #else
 #ifdef GMX_MPI
+                int ncomm;
+
                 if ((s == 0 && !(plan->flags&FFT5D_ORDER_YZ)) || (s == 1 && (plan->flags&FFT5D_ORDER_YZ)))
                 {
-                    MPI_Alltoall((real *)lout2, N[s]*pM[s]*K[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, (real *)lout3, N[s]*pM[s]*K[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, cart[s]);
+                    ncomm = N[s]*pM[s]*K[s]*sizeof(t_complex)/sizeof(real);
+                }
+                else
+                {
+                    ncomm = N[s]*M[s]*pK[s]*sizeof(t_complex)/sizeof(real);
+                }
+#ifdef GMX_DOUBLE
+                if (plan->flags&FFT5D_SINGLE_COMM)
+                {
+                    /* Halve the communication volume by sending floats.
+                     * The P[s] blocks stay contiguous after packing.
+                     */
+                    pack_double_to_float((real *)lout2, ncomm*P[s]);
+                    if (plan->nrank_hier[s] > 0)
+                    {
+                        alltoall_hier(plan, s, lout2, lout3, ncomm, MPI_FLOAT, sizeof(float));
+                    }
+                    else
+                    {
+                        MPI_Alltoall((real *)lout2, ncomm, MPI_FLOAT, (real *)lout3, ncomm, MPI_FLOAT, cart[s]);
+                    }
+                    unpack_float_to_double((real *)lout3, ncomm*P[s]);
                 }
                 else
+#endif
+                if (plan->nrank_hier[s] > 0)
                 {
-                    MPI_Alltoall((real *)lout2, N[s]*M[s]*pK[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, (real *)lout3, N[s]*M[s]*pK[s]*sizeof(t_complex)/sizeof(real), GMX_MPI_REAL, cart[s]);
+                    alltoall_hier(plan, s, lout2, lout3, ncomm, GMX_MPI_REAL, sizeof(real));
+                }
+                else
+                {
+                    MPI_Alltoall((real *)lout2, ncomm, GMX_MPI_REAL, (real *)lout3, ncomm, GMX_MPI_REAL, cart[s]);
                 }
 #else
                 gmx_incons("fft5d MPI call without MPI configuration");
@@ -1287,6 +1474,17 @@ void fft5d_destroy(fft5d_plan plan)
     FFTW_UNLOCK;
 #endif /* GMX_FFT_FFTW3 */
 
+#ifdef GMX_MPI
+    for (s = 0; s < 2; s++)
+    {
+        if (plan->nrank_hier[s] > 0)
+        {
+            MPI_Comm_free(&plan->cart_intra[s]);
+            MPI_Comm_free(&plan->cart_inter[s]);
+        }
+    }
+#endif
+
     if (!(plan->flags&FFT5D_NOMALLOC))
     {
         sfree_aligned(plan->lin);
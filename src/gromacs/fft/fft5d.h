@@ -86,7 +86,8 @@ typedef enum fft5d_flags_t {
     FFT5D_DEBUG       = 8,
     FFT5D_NOMEASURE   = 16,
     FFT5D_INPLACE     = 32,
-    FFT5D_NOMALLOC    = 64
+    FFT5D_NOMALLOC    = 64,
+    FFT5D_SINGLE_COMM = 128 /* Transpose in single precision with GMX_DOUBLE */
 } fft5d_flags;
 
 struct fft5d_plan_t {
@@ -99,6 +100,13 @@ struct fft5d_plan_t {
     FFTW(plan) mpip[2];
 #endif
     MPI_Comm cart[2];
+    /* For node-aggregated transposes: the ranks of cart[s] are split into
+     * groups of nrank_hier[s] consecutive ranks (one group per node),
+     * cart_intra[s] connects the ranks within a group, cart_inter[s]
+     * the ranks with the same index in each group. nrank_hier[s]=0: unused.
+     */
+    MPI_Comm cart_intra[2], cart_inter[2];
+    int      nrank_hier[2];
 
     int      N[3], M[3], K[3];                        /*local length in transposed coordinate system (if not divisisable max)*/
     int      pN[3], pM[3], pK[3];                     /*local length - not max but length for this processor*/
@@ -125,6 +133,7 @@ void fft5d_execute(fft5d_plan plan, int thread, fft5d_time times);
 fft5d_plan fft5d_plan_3d(int N, int M, int K, MPI_Comm comm[2], int flags, t_complex**lin, t_complex**lin2, t_complex**lout2, t_complex**lout3, int nthreads);
 void fft5d_local_size(fft5d_plan plan, int* N1, int* M0, int* K0, int* K1, int** coor);
 void fft5d_destroy(fft5d_plan plan);
+void fft5d_setup_hier_comm(fft5d_plan plan, int nrank_node);
 fft5d_plan fft5d_plan_3d_cart(int N, int M, int K, MPI_Comm comm, int P0, int flags, t_complex** lin, t_complex** lin2, t_complex** lout2, t_complex** lout3, int nthreads);
 void fft5d_compare_data(const t_complex* lin, const t_complex* in, fft5d_plan plan, int bothLocal, int normarlize);
 
@@ -62,6 +62,8 @@ gmx_parallel_3dfft_init   (gmx_parallel_3dfft_t     *    pfft_setup,
                            t_complex     **              complex_data,
                            MPI_Comm                      comm[2],
                            gmx_bool                      bReproducible,
+                           gmx_bool                      bSingleComm,
+                           int                           nrank_node,
                            int                           nthreads)
 {
     int        rN      = ndata[2], M = ndata[1], K = ndata[0];
@@ -75,6 +77,10 @@ gmx_parallel_3dfft_init   (gmx_parallel_3dfft_t     *    pfft_setup,
     {
         flags |= FFT5D_NOMEASURE;
     }
+    if (bSingleComm)
+    {
+        flags |= FFT5D_SINGLE_COMM;
+    }
 
     if (!(flags&FFT5D_ORDER_YZ))
     {
@@ -90,6 +96,12 @@ gmx_parallel_3dfft_init   (gmx_parallel_3dfft_t     *    pfft_setup,
     (*pfft_setup)->p2 = fft5d_plan_3d(Nb, Mb, Kb, rcomm,
                                       (flags|FFT5D_BACKWARD|FFT5D_NOMALLOC)^FFT5D_ORDER_YZ, complex_data, (t_complex**)real_data, &buf1, &buf2, nthreads);
 
+    if (nrank_node >= 0)
+    {
+        fft5d_setup_hier_comm((*pfft_setup)->p1, nrank_node);
+        fft5d_setup_hier_comm((*pfft_setup)->p2, nrank_node);
+    }
+
     return (*pfft_setup)->p1 != 0 && (*pfft_setup)->p2 != 0;
 }
 
@@ -72,6 +72,11 @@ typedef struct gmx_parallel_3dfft *
  *  \param bReproducible  Try to avoid FFT timing optimizations and other stuff
  *                        that could make results differ for two runs with
  *                        identical input (reproducibility for debugging).
+ *  \param bSingleComm    With double precision, communicate the grid data
+ *                        in the transposes in single precision.
+ *  \param nrank_node     Use node-aggregated transposes when >= 0: with 0
+ *                        ranks are grouped by physical node, with >0 in
+ *                        groups of nrank_node consecutive ranks.
  *  \param nthreads       Run in parallel using n threads
  *
  *  \return 0 or a standard error code.
@@ -83,6 +88,8 @@ int
                                t_complex **complex_data,
                                MPI_Comm                  comm[2],
                                gmx_bool                  bReproducible,
+                               gmx_bool                  bSingleComm,
+                               int                       nrank_node,
                                int                       nthreads);
 
 
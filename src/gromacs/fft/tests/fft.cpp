@@ -256,7 +256,7 @@ TEST_F(FFFTest3D, Real5_6_9)
     ivec       local_ndata, offset, rsize, csize, complex_order;
 
     gmx_parallel_3dfft_init(&fft_, ndata, &rdata, &cdata,
-                            comm, TRUE, 1);
+                            comm, TRUE, FALSE, -1, 1);
 
     gmx_parallel_3dfft_real_limits(fft_, local_ndata, offset, rsize);
     gmx_parallel_3dfft_complex_limits(fft_, complex_order,
@@ -49,6 +49,8 @@
 #include "string2.h"
 #include "futil.h"
 #include "gmx_fatal.h"
+#include "smalloc.h"
+#include "gromacs/utility/gmxomp.h"
 
 
 /* This is just for clarity - it can never be anything but 4! */
@@ -1013,6 +1015,160 @@ int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
 
 
 
+/* Upper bound for the number of bytes xdr3dfcoord writes for n atoms:
+ * the compressed data uses at most 1.2*3*n ints and at least 3*20 ints,
+ * plus 10 ints of header.
+ */
+static int xdr3dfcoord_bytes_bound(int n)
+{
+    return XDR_INT_SIZE*(10 + MAX(3*20, (int)(3*n*1.2) + 1)) + 12*n;
+}
+
+int xdr3dfcoord_blocks(XDR *xdrs, float *fp, int *size, float *precision,
+                       int block_natoms)
+{
+    int       nblock, b, start, n, nthreads;
+    int      *nbytes, *offset, lsize, totbytes, rc;
+    char     *buf;
+    gmx_bool  bRead;
+
+    bRead = (xdrs->x_op == XDR_DECODE);
+
+    if (!bRead)
+    {
+        lsize = *size;
+        if (block_natoms <= 0)
+        {
+            gmx_incons("xdr3dfcoord_blocks called with block_natoms <= 0");
+        }
+    }
+    if (xdr_int(xdrs, &lsize) == 0 ||
+        xdr_float(xdrs, precision) == 0 ||
+        xdr_int(xdrs, &block_natoms) == 0)
+    {
+        return 0;
+    }
+    if (bRead)
+    {
+        if (*size != 0 && lsize != *size)
+        {
+            fprintf(stderr, "wrong number of coordinates in xdr3dfcoord_blocks; "
+                    "%d arg vs %d in file", *size, lsize);
+        }
+        *size = lsize;
+        if (block_natoms <= 0)
+        {
+            return 0;
+        }
+    }
+    nblock = (lsize + block_natoms - 1)/block_natoms;
+
+    snew(nbytes, nblock);
+    snew(offset, nblock + 1);
+
+    nthreads = MIN(gmx_omp_get_max_threads(), nblock);
+    rc       = 1;
+
+    if (!bRead)
+    {
+        /* Each block is compressed independently into its own region
+         * of buf, so the blocks can be encoded concurrently.
+         */
+        offset[0] = 0;
+        for (b = 0; b < nblock; b++)
+        {
+            n           = MIN(block_natoms, lsize - b*block_natoms);
+            offset[b+1] = offset[b] + xdr3dfcoord_bytes_bound(n);
+        }
+        snew(buf, offset[nblock]);
+
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic) private(start, n)
+        for (b = 0; b < nblock; b++)
+        {
+            XDR xdrmem;
+
+            start = b*block_natoms;
+            n     = MIN(block_natoms, lsize - start);
+            xdrmem_create(&xdrmem, buf + offset[b],
+                          offset[b+1] - offset[b], XDR_ENCODE);
+            if (xdr3dfcoord(&xdrmem, fp + start*3, &n, precision) == 0)
+            {
+                nbytes[b] = -1;
+            }
+            else
+            {
+                nbytes[b] = xdr_getpos(&xdrmem);
+            }
+            xdr_destroy(&xdrmem);
+        }
+
+        for (b = 0; b < nblock && rc; b++)
+        {
+            rc = (nbytes[b] >= 0 && xdr_int(xdrs, &nbytes[b]));
+        }
+        for (b = 0; b < nblock && rc; b++)
+        {
+            rc = xdr_opaque(xdrs, buf + offset[b], (unsigned int)nbytes[b]);
+        }
+    }
+    else
+    {
+        totbytes = 0;
+        for (b = 0; b < nblock && rc; b++)
+        {
+            rc = xdr_int(xdrs, &nbytes[b]);
+            if (rc && (nbytes[b] < 0 || nbytes[b] % XDR_INT_SIZE != 0))
+            {
+                rc = 0;
+            }
+            offset[b]  = totbytes;
+            totbytes  += nbytes[b];
+        }
+        if (!rc)
+        {
+            sfree(offset);
+            sfree(nbytes);
+            return 0;
+        }
+        snew(buf, totbytes);
+        rc = xdr_opaque(xdrs, buf, (unsigned int)totbytes);
+
+        if (rc)
+        {
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic) private(start, n)
+            for (b = 0; b < nblock; b++)
+            {
+                XDR   xdrmem;
+                float prec;
+
+                start = b*block_natoms;
+                n     = MIN(block_natoms, lsize - start);
+                xdrmem_create(&xdrmem, buf + offset[b], nbytes[b], XDR_DECODE);
+                if (xdr3dfcoord(&xdrmem, fp + start*3, &n, &prec) == 0)
+                {
+                    /* Signal the error through the block size */
+                    nbytes[b] = -1;
+                }
+                xdr_destroy(&xdrmem);
+            }
+            for (b = 0; b < nblock; b++)
+            {
+                if (nbytes[b] < 0)
+                {
+                    rc = 0;
+                }
+            }
+        }
+    }
+
+    sfree(buf);
+    sfree(offset);
+    sfree(nbytes);
+
+    return rc;
+}
+
+
 /******************************************************************
 
    XTC files have a relatively simple structure.
@@ -1028,10 +1184,13 @@ int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
 
  ********************************************************************/
 
-/* Must match definition in xtcio.c */
+/* Must match definitions in xtcio.c */
 #ifndef XTC_MAGIC
 #define XTC_MAGIC 1995
 #endif
+#ifndef XTC_BLOCK_MAGIC
+#define XTC_BLOCK_MAGIC 1996
+#endif
 
 static const int header_size = 16;
 
@@ -1060,7 +1219,7 @@ static int xtc_at_header_start(FILE *fp, XDR *xdrs,
         }
     }
     /* quick return */
-    if (i_inp[0] != XTC_MAGIC)
+    if (i_inp[0] != XTC_MAGIC && i_inp[0] != XTC_BLOCK_MAGIC)
     {
         if (gmx_fseek(fp, off+XDR_INT_SIZE, SEEK_SET))
         {
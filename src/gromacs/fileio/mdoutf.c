@@ -33,6 +33,7 @@
  * the research papers on the package. Check out http://www.gromacs.org.
  */
 #include "mdoutf.h"
+#include "mdoutf_async.h"
 
 #include "gromacs/legacyheaders/xvgr.h"
 #include "trnio.h"
@@ -55,6 +56,7 @@ gmx_mdoutf_t *init_mdoutf(int nfile, const t_filenm fnm[], int mdrun_flags,
     of->fp_xtc   = NULL;
     of->fp_dhdl  = NULL;
     of->fp_field = NULL;
+    of->async    = NULL;
 
     of->eIntegrator     = ir->eI;
     of->bExpanded       = ir->bExpanded;
@@ -122,6 +124,11 @@ gmx_mdoutf_t *init_mdoutf(int nfile, const t_filenm fnm[], int mdrun_flags,
                                         "E (V/nm)", oenv);
             }
         }
+
+        if ((mdrun_flags & MD_ASYNCIO) && (of->fp_trn || of->fp_xtc))
+        {
+            of->async = init_mdoutf_async(of->fp_trn, of->fp_xtc, of->xtc_prec);
+        }
     }
 
     return of;
@@ -129,6 +136,10 @@ gmx_mdoutf_t *init_mdoutf(int nfile, const t_filenm fnm[], int mdrun_flags,
 
 void done_mdoutf(gmx_mdoutf_t *of)
 {
+    if (of->async != NULL)
+    {
+        done_mdoutf_async(of->async);
+    }
     if (of->fp_ene != NULL)
     {
         close_enx(of->fp_ene);
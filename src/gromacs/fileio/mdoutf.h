@@ -55,6 +55,8 @@ typedef struct {
     int         simulation_part;
     FILE       *fp_dhdl;
     FILE       *fp_field;
+    /* Asynchronous trn/xtc writer, NULL when writing synchronously */
+    struct gmx_mdoutf_async *async;
 } gmx_mdoutf_t;
 
 gmx_mdoutf_t *init_mdoutf(int nfile, const t_filenm fnm[],
@@ -63,10 +65,14 @@ gmx_mdoutf_t *init_mdoutf(int nfile, const t_filenm fnm[],
                           const output_env_t oenv);
 /* Returns a pointer to a data structure with all output file pointers
  * and names required by mdrun.
+ * With MD_ASYNCIO in mdrun_flags, trn and xtc frames are written
+ * by a separate I/O thread on the master node.
  */
 
 void done_mdoutf(gmx_mdoutf_t *of);
-/* Close all open output files and free the of pointer */
+/* Writes all pending frames, closes all open output files
+ * and frees the of pointer.
+ */
 
 #define MDOF_X   (1<<0)
 #define MDOF_V   (1<<1)
@@ -0,0 +1,289 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "mdoutf_async.h"
+#include "mdoutf.h"
+#include "trnio.h"
+#include "xtcio.h"
+#include "gromacs/legacyheaders/gmx_fatal.h"
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/legacyheaders/vec.h"
+#include "gromacs/legacyheaders/smalloc.h"
+#include "gromacs/legacyheaders/thread_mpi/threads.h"
+
+/* A snapshot of the output data of one MD step */
+typedef struct {
+    int             flags;     /* MDOF_ flags of the data in this frame      */
+    gmx_large_int_t step;
+    double          t;
+    real            lambda;
+    matrix          box;
+    int             natoms;
+    rvec           *x;
+    int             x_nalloc;
+    rvec           *v;
+    int             v_nalloc;
+    rvec           *f;
+    int             f_nalloc;
+    int             n_xtc;
+    rvec           *x_xtc;     /* NULL when the xtc frame is stored in x     */
+    int             x_xtc_nalloc;
+} t_mdoutf_frame;
+
+struct gmx_mdoutf_async {
+    t_fileio           *fp_trn;
+    t_fileio           *fp_xtc;
+    int                 xtc_prec;
+
+    t_mdoutf_frame      frame[MDOUTF_ASYNC_NFRAME];
+    int                 head;     /* The first queued frame                  */
+    int                 nqueued;  /* The number of frames queued for writing */
+    gmx_bool            bFinish;  /* Tells the I/O thread to stop            */
+
+    tMPI_Thread_t       thread;
+    tMPI_Thread_mutex_t mutex;
+    tMPI_Thread_cond_t  cond_queued;
+    tMPI_Thread_cond_t  cond_written;
+};
+
+static void copy_rvecs_realloc(int n, rvec *src, int *nalloc, rvec **dest)
+{
+    if (n > *nalloc)
+    {
+        *nalloc = over_alloc_large(n);
+        srenew(*dest, *nalloc);
+    }
+    memcpy(*dest, src, n*sizeof(**dest));
+}
+
+static void write_frame(gmx_mdoutf_async_t aw, t_mdoutf_frame *fr)
+{
+    rvec *xxtc;
+
+    if (fr->flags & (MDOF_X | MDOF_V | MDOF_F))
+    {
+        fwrite_trn(aw->fp_trn, fr->step, fr->t, fr->lambda,
+                   fr->box, fr->natoms,
+                   (fr->flags & MDOF_X) ? fr->x : NULL,
+                   (fr->flags & MDOF_V) ? fr->v : NULL,
+                   (fr->flags & MDOF_F) ? fr->f : NULL);
+        if (gmx_fio_flush(aw->fp_trn) != 0)
+        {
+            gmx_file("Cannot write trajectory; maybe you are out of disk space?");
+        }
+        gmx_fio_check_file_position(aw->fp_trn);
+    }
+    if (fr->flags & MDOF_XTC)
+    {
+        xxtc = (fr->x_xtc != NULL) ? fr->x_xtc : fr->x;
+        if (write_xtc(aw->fp_xtc, fr->n_xtc, fr->step, fr->t,
+                      fr->box, xxtc, aw->xtc_prec) == 0)
+        {
+            gmx_fatal(FARGS, "XTC error - maybe you are out of disk space?");
+        }
+        gmx_fio_check_file_position(aw->fp_xtc);
+    }
+}
+
+static void *mdoutf_async_thread(void *arg)
+{
+    gmx_mdoutf_async_t aw = (gmx_mdoutf_async_t)arg;
+    t_mdoutf_frame    *fr;
+
+    tMPI_Thread_mutex_lock(&aw->mutex);
+    for (;; )
+    {
+        while (aw->nqueued == 0 && !aw->bFinish)
+        {
+            tMPI_Thread_cond_wait(&aw->cond_queued, &aw->mutex);
+        }
+        if (aw->nqueued == 0)
+        {
+            /* bFinish is set and all frames have been written */
+            break;
+        }
+        fr = &aw->frame[aw->head];
+        /* The producer does not touch queued frames, so we can write
+         * without holding the lock.
+         */
+        tMPI_Thread_mutex_unlock(&aw->mutex);
+
+        write_frame(aw, fr);
+
+        tMPI_Thread_mutex_lock(&aw->mutex);
+        aw->head = (aw->head + 1) % MDOUTF_ASYNC_NFRAME;
+        aw->nqueued--;
+        tMPI_Thread_cond_broadcast(&aw->cond_written);
+    }
+    tMPI_Thread_mutex_unlock(&aw->mutex);
+
+    return NULL;
+}
+
+gmx_mdoutf_async_t init_mdoutf_async(t_fileio *fp_trn, t_fileio *fp_xtc,
+                                     int xtc_prec)
+{
+    gmx_mdoutf_async_t aw;
+
+    if (tMPI_Thread_support() == TMPI_THREAD_SUPPORT_NO)
+    {
+        return NULL;
+    }
+
+    snew(aw, 1);
+    aw->fp_trn   = fp_trn;
+    aw->fp_xtc   = fp_xtc;
+    aw->xtc_prec = xtc_prec;
+    aw->head     = 0;
+    aw->nqueued  = 0;
+    aw->bFinish  = FALSE;
+
+    tMPI_Thread_mutex_init(&aw->mutex);
+    tMPI_Thread_cond_init(&aw->cond_queued);
+    tMPI_Thread_cond_init(&aw->cond_written);
+
+    if (tMPI_Thread_create(&aw->thread, mdoutf_async_thread, aw) != 0)
+    {
+        tMPI_Thread_cond_destroy(&aw->cond_written);
+        tMPI_Thread_cond_destroy(&aw->cond_queued);
+        tMPI_Thread_mutex_destroy(&aw->mutex);
+        sfree(aw);
+
+        return NULL;
+    }
+
+    return aw;
+}
+
+void mdoutf_async_write_frame(gmx_mdoutf_async_t aw, int mdof_flags,
+                              gmx_large_int_t step, double t, real lambda,
+                              matrix box, int natoms,
+                              rvec *x, rvec *v, rvec *f,
+                              int n_xtc, rvec *x_xtc)
+{
+    t_mdoutf_frame *fr;
+
+    mdof_flags &= (MDOF_X | MDOF_V | MDOF_F | MDOF_XTC);
+    if (mdof_flags == 0)
+    {
+        return;
+    }
+
+    tMPI_Thread_mutex_lock(&aw->mutex);
+    while (aw->nqueued == MDOUTF_ASYNC_NFRAME)
+    {
+        tMPI_Thread_cond_wait(&aw->cond_written, &aw->mutex);
+    }
+    fr = &aw->frame[(aw->head + aw->nqueued) % MDOUTF_ASYNC_NFRAME];
+    tMPI_Thread_mutex_unlock(&aw->mutex);
+
+    /* This frame is not queued, so the I/O thread will not access it */
+    fr->flags  = mdof_flags;
+    fr->step   = step;
+    fr->t      = t;
+    fr->lambda = lambda;
+    copy_mat(box, fr->box);
+    fr->natoms = natoms;
+    if (mdof_flags & MDOF_X)
+    {
+        copy_rvecs_realloc(natoms, x, &fr->x_nalloc, &fr->x);
+    }
+    if (mdof_flags & MDOF_V)
+    {
+        copy_rvecs_realloc(natoms, v, &fr->v_nalloc, &fr->v);
+    }
+    if (mdof_flags & MDOF_F)
+    {
+        copy_rvecs_realloc(natoms, f, &fr->f_nalloc, &fr->f);
+    }
+    if (mdof_flags & MDOF_XTC)
+    {
+        fr->n_xtc = n_xtc;
+        if ((mdof_flags & MDOF_X) && n_xtc == natoms)
+        {
+            fr->x_xtc = NULL;
+        }
+        else
+        {
+            copy_rvecs_realloc(n_xtc, x_xtc, &fr->x_xtc_nalloc, &fr->x_xtc);
+        }
+    }
+
+    tMPI_Thread_mutex_lock(&aw->mutex);
+    aw->nqueued++;
+    tMPI_Thread_cond_signal(&aw->cond_queued);
+    tMPI_Thread_mutex_unlock(&aw->mutex);
+}
+
+void mdoutf_async_flush(gmx_mdoutf_async_t aw)
+{
+    tMPI_Thread_mutex_lock(&aw->mutex);
+    while (aw->nqueued > 0)
+    {
+        tMPI_Thread_cond_wait(&aw->cond_written, &aw->mutex);
+    }
+    tMPI_Thread_mutex_unlock(&aw->mutex);
+}
+
+void done_mdoutf_async(gmx_mdoutf_async_t aw)
+{
+    int i;
+
+    tMPI_Thread_mutex_lock(&aw->mutex);
+    aw->bFinish = TRUE;
+    tMPI_Thread_cond_signal(&aw->cond_queued);
+    tMPI_Thread_mutex_unlock(&aw->mutex);
+
+    /* The thread writes all remaining frames before it returns */
+    tMPI_Thread_join(aw->thread, NULL);
+
+    tMPI_Thread_cond_destroy(&aw->cond_written);
+    tMPI_Thread_cond_destroy(&aw->cond_queued);
+    tMPI_Thread_mutex_destroy(&aw->mutex);
+
+    for (i = 0; i < MDOUTF_ASYNC_NFRAME; i++)
+    {
+        sfree(aw->frame[i].x);
+        sfree(aw->frame[i].v);
+        sfree(aw->frame[i].f);
+        sfree(aw->frame[i].x_xtc);
+    }
+    sfree(aw);
+}
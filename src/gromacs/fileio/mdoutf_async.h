@@ -0,0 +1,86 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+#ifndef GMX_FILEIO_MDOUTF_ASYNC_H
+#define GMX_FILEIO_MDOUTF_ASYNC_H
+
+#include "gmxfio.h"
+#include "../legacyheaders/types/simple.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Number of frame buffers used by the asynchronous writer.
+ * With two buffers the MD loop can fill one frame while the I/O thread
+ * writes the other; when both are in use, the MD loop waits.
+ */
+#define MDOUTF_ASYNC_NFRAME  2
+
+typedef struct gmx_mdoutf_async *gmx_mdoutf_async_t;
+
+gmx_mdoutf_async_t init_mdoutf_async(t_fileio *fp_trn, t_fileio *fp_xtc,
+                                     int xtc_prec);
+/* Starts a thread that writes trn and xtc frames to fp_trn and fp_xtc,
+ * either of which can be NULL. Returns NULL when threads are not
+ * supported, in which case the caller should write synchronously.
+ */
+
+void mdoutf_async_write_frame(gmx_mdoutf_async_t aw, int mdof_flags,
+                              gmx_large_int_t step, double t, real lambda,
+                              matrix box, int natoms,
+                              rvec *x, rvec *v, rvec *f,
+                              int n_xtc, rvec *x_xtc);
+/* Copies the trn (MDOF_X, MDOF_V, MDOF_F) and xtc (MDOF_XTC) output data
+ * selected by mdof_flags into a free frame buffer and queues it for
+ * writing. Blocks only when all frame buffers are still queued.
+ * When natoms coordinates x are written with MDOF_X and n_xtc == natoms,
+ * the xtc frame is taken from x and x_xtc is ignored.
+ */
+
+void mdoutf_async_flush(gmx_mdoutf_async_t aw);
+/* Waits until all queued frames have been written and flushed to disk.
+ * Must be called before anything else that accesses the output files,
+ * such as writing a checkpoint.
+ */
+
+void done_mdoutf_async(gmx_mdoutf_async_t aw);
+/* Flushes all queued frames, stops the I/O thread and frees aw */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GMX_FILEIO_MDOUTF_ASYNC_H */
@@ -0,0 +1,223 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2013, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for reading and writing xtc files.
+ *
+ * \ingroup module_fileio
+ */
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/fileio/xtcio.h"
+#include "gromacs/legacyheaders/smalloc.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace
+{
+
+//! Magic number of standard xtc frames.
+const int xtcMagic      = 1995;
+//! Magic number of block-compressed xtc frames.
+const int xtcBlockMagic = 1996;
+
+/*! \brief
+ * Test fixture for xtc round trips.
+ *
+ * Sets GMX_XTC_BLOCKS for the duration of a test and restores it after.
+ */
+class XtcIOTest : public ::testing::Test
+{
+    public:
+        XtcIOTest()
+        {
+            const char *env = std::getenv("GMX_XTC_BLOCKS");
+            bEnvSet_ = (env != NULL);
+            if (bEnvSet_)
+            {
+                envValue_ = env;
+            }
+        }
+        ~XtcIOTest()
+        {
+            if (bEnvSet_)
+            {
+                setenv("GMX_XTC_BLOCKS", envValue_.c_str(), 1);
+            }
+            else
+            {
+                unsetenv("GMX_XTC_BLOCKS");
+            }
+        }
+
+        /*! \brief
+         * Writes nframes frames of natoms atoms and reads them back.
+         *
+         * Returns the magic number of the first frame in the file.
+         */
+        int runRoundTrip(int natoms, int nframes);
+
+        //! Manages the temporary xtc file.
+        gmx::test::TestFileManager  fileManager_;
+
+    private:
+        bool                        bEnvSet_;
+        std::string                 envValue_;
+};
+
+int XtcIOTest::runRoundTrip(int natoms, int nframes)
+{
+    const real         prec = 1000;
+    std::string        filename(fileManager_.getTemporaryFilePath(
+                                        gmx::formatString("%d.xtc", natoms).c_str()));
+    rvec              *x;
+    matrix             box = {{5, 0, 0}, {0, 6, 0}, {0, 0, 7}};
+
+    snew(x, natoms);
+    t_fileio          *fio = open_xtc(filename.c_str(), "w");
+    for (int f = 0; f < nframes; f++)
+    {
+        /* Smooth, but not too regular, coordinates inside the box */
+        for (int i = 0; i < natoms; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                x[i][d] = box[d][d]*(0.5 + 0.45*std::sin(0.37*i + 1.3*d + 0.1*f));
+            }
+        }
+        EXPECT_EQ(1, write_xtc(fio, natoms, f, 0.5*f, box, x, prec));
+    }
+    close_xtc(fio);
+
+    /* Check the magic number of the first frame */
+    int   magic = 0;
+    FILE *fp    = std::fopen(filename.c_str(), "rb");
+    unsigned char buf[4];
+    EXPECT_EQ(4U, std::fread(buf, 1, 4, fp));
+    std::fclose(fp);
+    magic = (buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
+
+    int      natomsRead, step;
+    real     time, precRead;
+    matrix   boxRead;
+    rvec    *xRead = NULL;
+    gmx_bool bOK;
+
+    fio = open_xtc(filename.c_str(), "r");
+    EXPECT_EQ(1, read_first_xtc(fio, &natomsRead, &step, &time, boxRead,
+                                &xRead, &precRead, &bOK));
+    EXPECT_EQ(natoms, natomsRead);
+    for (int f = 0; f < nframes; f++)
+    {
+        if (f > 0)
+        {
+            EXPECT_EQ(1, read_next_xtc(fio, natomsRead, &step, &time, boxRead,
+                                       xRead, &precRead, &bOK));
+        }
+        EXPECT_TRUE(bOK);
+        EXPECT_EQ(f, step);
+        EXPECT_FLOAT_EQ(0.5*f, time);
+        for (int i = 0; i < natoms; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                x[i][d] = box[d][d]*(0.5 + 0.45*std::sin(0.37*i + 1.3*d + 0.1*f));
+                /* Compression rounds to the nearest 1/prec */
+                EXPECT_NEAR(x[i][d], xRead[i][d], 0.5/prec + 1e-5)
+                << "frame " << f << " atom " << i << " dim " << d;
+            }
+        }
+    }
+    /* There should be no more frames */
+    EXPECT_EQ(0, read_next_xtc(fio, natomsRead, &step, &time, boxRead,
+                               xRead, &precRead, &bOK));
+    close_xtc(fio);
+    sfree(xRead);
+    sfree(x);
+
+    return magic;
+}
+
+TEST_F(XtcIOTest, RoundTripStandard)
+{
+    unsetenv("GMX_XTC_BLOCKS");
+    EXPECT_EQ(xtcMagic, runRoundTrip(2500, 3));
+}
+
+TEST_F(XtcIOTest, RoundTripBlocksFewerAtomsThanBlockSize)
+{
+    setenv("GMX_XTC_BLOCKS", "1000", 1);
+    EXPECT_EQ(xtcMagic, runRoundTrip(999, 3));
+}
+
+TEST_F(XtcIOTest, RoundTripBlocksAtomsEqualToBlockSize)
+{
+    setenv("GMX_XTC_BLOCKS", "1000", 1);
+    EXPECT_EQ(xtcMagic, runRoundTrip(1000, 3));
+}
+
+TEST_F(XtcIOTest, RoundTripBlocksMoreAtomsThanBlockSize)
+{
+    setenv("GMX_XTC_BLOCKS", "1000", 1);
+    EXPECT_EQ(xtcBlockMagic, runRoundTrip(1001, 3));
+    EXPECT_EQ(xtcBlockMagic, runRoundTrip(3500, 3));
+}
+
+TEST_F(XtcIOTest, SmallValueUsesDefaultBlockSize)
+{
+    /* Values below the minimum of 1000 select the default of 12288,
+     * so 1 works as a plain switch to enable blocks.
+     */
+    setenv("GMX_XTC_BLOCKS", "1", 1);
+    EXPECT_EQ(xtcMagic, runRoundTrip(2500, 2));
+    EXPECT_EQ(xtcBlockMagic, runRoundTrip(12289, 2));
+}
+
+TEST_F(XtcIOTest, NonPositiveValueUsesDefaultBlockSize)
+{
+    setenv("GMX_XTC_BLOCKS", "0", 1);
+    EXPECT_EQ(xtcMagic, runRoundTrip(2500, 2));
+    EXPECT_EQ(xtcBlockMagic, runRoundTrip(12289, 2));
+}
+
+} // namespace
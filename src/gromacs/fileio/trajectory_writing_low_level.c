@@ -37,6 +37,7 @@
 #include "gromacs/legacyheaders/mvdata.h"
 #include "gromacs/legacyheaders/domdec.h"
 #include "checkpoint.h"
+#include "mdoutf_async.h"
 #include "trnio.h"
 #include "xtcio.h"
 #include "gromacs/legacyheaders/smalloc.h"
@@ -62,7 +63,7 @@ void write_traj(FILE *fplog, t_commrec *cr,
 {
     int           i, j;
     gmx_groups_t *groups;
-    rvec         *xxtc;
+    rvec         *xxtc = NULL;
     rvec         *local_v;
     rvec         *global_v;
 
@@ -177,24 +178,16 @@ void write_traj(FILE *fplog, t_commrec *cr,
     {
         if (mdof_flags & MDOF_CPT)
         {
+            if (of->async != NULL)
+            {
+                /* The checkpoint stores the output file positions */
+                mdoutf_async_flush(of->async);
+            }
             write_checkpoint(of->fn_cpt, of->bKeepAndNumCPT,
                              fplog, cr, of->eIntegrator, of->simulation_part,
                              of->bExpanded, of->elamstats, step, t, state_global);
         }
 
-        if (mdof_flags & (MDOF_X | MDOF_V | MDOF_F))
-        {
-            fwrite_trn(of->fp_trn, step, t, state_local->lambda[efptFEP],
-                       state_local->box, top_global->natoms,
-                       (mdof_flags & MDOF_X) ? state_global->x : NULL,
-                       (mdof_flags & MDOF_V) ? global_v : NULL,
-                       (mdof_flags & MDOF_F) ? f_global : NULL);
-            if (gmx_fio_flush(of->fp_trn) != 0)
-            {
-                gmx_file("Cannot write trajectory; maybe you are out of disk space?");
-            }
-            gmx_fio_check_file_position(of->fp_trn);
-        }
         if (mdof_flags & MDOF_XTC)
         {
             groups = &top_global->groups;
@@ -229,6 +222,36 @@ void write_traj(FILE *fplog, t_commrec *cr,
                     }
                 }
             }
+        }
+
+        if (of->async != NULL)
+        {
+            /* Only the copy to the frame buffer happens here,
+             * the I/O thread does the compression and writing.
+             */
+            mdoutf_async_write_frame(of->async, mdof_flags,
+                                     step, t, state_local->lambda[efptFEP],
+                                     state_local->box, top_global->natoms,
+                                     state_global->x, global_v, f_global,
+                                     *n_xtc, xxtc);
+            return;
+        }
+
+        if (mdof_flags & (MDOF_X | MDOF_V | MDOF_F))
+        {
+            fwrite_trn(of->fp_trn, step, t, state_local->lambda[efptFEP],
+                       state_local->box, top_global->natoms,
+                       (mdof_flags & MDOF_X) ? state_global->x : NULL,
+                       (mdof_flags & MDOF_V) ? global_v : NULL,
+                       (mdof_flags & MDOF_F) ? f_global : NULL);
+            if (gmx_fio_flush(of->fp_trn) != 0)
+            {
+                gmx_file("Cannot write trajectory; maybe you are out of disk space?");
+            }
+            gmx_fio_check_file_position(of->fp_trn);
+        }
+        if (mdof_flags & MDOF_XTC)
+        {
             if (write_xtc(of->fp_xtc, *n_xtc, step, t,
                           state_local->box, xxtc, of->xtc_prec) == 0)
             {
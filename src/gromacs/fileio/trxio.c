@@ -58,6 +58,7 @@
 #include "vec.h"
 #include "futil.h"
 #include "xtcio.h"
+#include "xtcindex.h"
 #include "pdbio.h"
 #include "confio.h"
 #include "checkpoint.h"
@@ -85,6 +86,9 @@ struct t_trxstatus
     double          DT, BOX[3];
     gmx_bool        bReadBox;
     char           *persistent_line; /* Persistent line for reading g96 trajectories */
+    gmx_xtc_index_t xtcindex;        /* Frame index for xtc files, can be NULL */
+    int             xtc_frame;       /* The xtc frame that will be read next,
+                                      * -1 when unknown after seeking by time */
 };
 
 /* utility functions */
@@ -161,6 +165,45 @@ static void status_init(t_trxstatus *status)
     status->fio             = NULL;
     status->__frame         = -1;
     status->persistent_line = NULL;
+    status->xtcindex        = NULL;
+    status->xtc_frame       = 0;
+}
+
+/* Returns whether reading xtc files should use a frame index.
+ * This only pays off when frames are skipped with -b or -dt.
+ */
+static gmx_bool use_xtc_index(void)
+{
+    return ((bTimeSet(TBEGIN) || bTimeSet(TDELTA)) &&
+            getenv("GMX_NO_XTC_INDEX") == NULL);
+}
+
+/* Uses the xtc index to move to the first frame, at or after the frame
+ * that would be read next, that is not skipped by -b and -dt.
+ * Frames that are not read are counted as skipped.
+ */
+static void xtc_index_skip_frames(t_trxstatus *status, t_trxframe *fr)
+{
+    int frame, nframes;
+
+    nframes = xtc_index_nframes(status->xtcindex);
+    frame   = status->xtc_frame;
+    while (frame < nframes &&
+           check_times2(xtc_index_frame_time(status->xtcindex, frame),
+                        fr->t0, fr->bDouble) < 0)
+    {
+        frame++;
+    }
+    if (frame != status->xtc_frame)
+    {
+        if (!xtc_index_seek(status->fio, status->xtcindex, frame))
+        {
+            gmx_fatal(FARGS, "Could not seek to frame %d in %s",
+                      frame, gmx_fio_getname(status->fio));
+        }
+        status->__frame  += frame - status->xtc_frame;
+        status->xtc_frame = frame;
+    }
 }
 
 
@@ -507,6 +550,7 @@ int write_trx(t_trxstatus *status, int nind, const atom_id *ind, t_atoms *atoms,
 void close_trx(t_trxstatus *status)
 {
     gmx_fio_close(status->fio);
+    xtc_index_done(status->xtcindex);
     sfree(status);
 }
 
@@ -908,7 +952,11 @@ gmx_bool read_next_frame(const output_env_t oenv, t_trxstatus *status, t_trxfram
                 /* DvdS 2005-05-31: this has been fixed along with the increased
                  * accuracy of the control over -b and -e options.
                  */
-                if (bTimeSet(TBEGIN) && (fr->time < rTimeValue(TBEGIN)))
+                if (status->xtcindex != NULL && !(fr->flags & TRX_DONT_SKIP))
+                {
+                    xtc_index_skip_frames(status, fr);
+                }
+                else if (bTimeSet(TBEGIN) && (fr->time < rTimeValue(TBEGIN)))
                 {
                     if (xtc_seek_time(status->fio, rTimeValue(TBEGIN), fr->natoms, TRUE))
                     {
@@ -916,9 +964,15 @@ gmx_bool read_next_frame(const output_env_t oenv, t_trxstatus *status, t_trxfram
                                   rTimeValue(TBEGIN));
                     }
                     initcount(status);
+                    /* Without index we do not know which frame we are at */
+                    status->xtc_frame = -1;
                 }
                 bRet = read_next_xtc(status->fio, fr->natoms, &fr->step, &fr->time, fr->box,
                                      fr->x, &fr->prec, &bOK);
+                if (status->xtc_frame >= 0)
+                {
+                    status->xtc_frame++;
+                }
                 fr->bPrec = (bRet && fr->prec > 0);
                 fr->bStep = bRet;
                 fr->bTime = bRet;
@@ -1073,6 +1127,11 @@ int read_first_frame(const output_env_t oenv, t_trxstatus **status,
                 fr->bX    = TRUE;
                 fr->bBox  = TRUE;
                 printcount(*status, oenv, fr->time, FALSE);
+                (*status)->xtc_frame = 1;
+                if (use_xtc_index())
+                {
+                    (*status)->xtcindex = xtc_index_init(fio, fn);
+                }
             }
             bFirst = FALSE;
             break;
@@ -1167,6 +1226,7 @@ gmx_bool read_next_x(const output_env_t oenv, t_trxstatus *status, real *t,
 void close_trj(t_trxstatus *status)
 {
     gmx_fio_close(status->fio);
+    xtc_index_done(status->xtcindex);
     /* The memory in status->xframe is lost here,
      * but the read_first_x/read_next_x functions are deprecated anyhow.
      * read_first_frame/read_next_frame and close_trx should be used.
@@ -1177,10 +1237,47 @@ void close_trj(t_trxstatus *status)
 void rewind_trj(t_trxstatus *status)
 {
     initcount(status);
+    status->xtc_frame = 0;
 
     gmx_fio_rewind(status->fio);
 }
 
+gmx_bool trx_seek_frame(t_trxstatus *status, int frame)
+{
+    if (gmx_fio_getftp(status->fio) != efXTC)
+    {
+        return FALSE;
+    }
+    if (status->xtcindex == NULL)
+    {
+        status->xtcindex = xtc_index_init(status->fio,
+                                          gmx_fio_getname(status->fio));
+        if (status->xtcindex == NULL)
+        {
+            return FALSE;
+        }
+    }
+    if (status->xtc_frame < 0)
+    {
+        /* Look up the frame we are at after seeking by time */
+        status->xtc_frame = xtc_index_find_frame(status->fio,
+                                                 status->xtcindex);
+        if (status->xtc_frame < 0)
+        {
+            return FALSE;
+        }
+    }
+    if (frame >= xtc_index_nframes(status->xtcindex) ||
+        !xtc_index_seek(status->fio, status->xtcindex, frame))
+    {
+        return FALSE;
+    }
+    status->__frame  += frame - status->xtc_frame;
+    status->xtc_frame = frame;
+
+    return TRUE;
+}
+
 /***** T O P O L O G Y   S T U F F ******/
 
 t_topology *read_top(const char *fn, int *ePBC)
@@ -200,6 +200,13 @@ void close_trj(t_trxstatus *status);
 void rewind_trj(t_trxstatus *status);
 /* Rewind trj file as opened with read_first_x */
 
+gmx_bool trx_seek_frame(t_trxstatus *status, int frame);
+/* Positions status such that the next call to read_next_frame reads
+ * frame number frame, counting from 0. Only xtc files are supported,
+ * seeking uses a frame index that is cached next to the file.
+ * Returns FALSE when seeking is not supported or the frame does not exist.
+ */
+
 t_topology *read_top(const char *fn, int *ePBC);
 /* Extract a topology data structure from a topology file.
  * If ePBC!=NULL *ePBC gives the pbc type.
@@ -63,6 +63,15 @@ struct t_fileio;
 int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision);
 
 
+/* Read or write reduced precision *float* coordinates split into
+ * independently compressed blocks of block_natoms atoms, so that the
+ * blocks can be encoded and decoded by multiple OpenMP threads.
+ * When reading, block_natoms is taken from the stream.
+ */
+int xdr3dfcoord_blocks(XDR *xdrs, float *fp, int *size, float *precision,
+                       int block_natoms);
+
+
 /* Read or write a *real* value (stored as float) */
 int xdr_real(XDR *xdrs, real *r);
 
@@ -0,0 +1,387 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "xtcindex.h"
+#include "xdrf.h"
+#include "gromacs/legacyheaders/gmx_fatal.h"
+#include "gromacs/legacyheaders/smalloc.h"
+
+/* Must match definitions in xtcio.c */
+#define XTC_MAGIC       1995
+#define XTC_BLOCK_MAGIC 1996
+
+/* Identifies an index cache file, followed by the format version */
+#define XTC_INDEX_MAGIC   0x47584958
+#define XTC_INDEX_VERSION 1
+
+#define XTC_INDEX_SUFFIX  ".gmxidx"
+
+struct gmx_xtc_index {
+    int              nframes;
+    gmx_large_int_t *offset; /* File offsets, size nframes+1        */
+    int             *step;
+    real            *time;
+    gmx_large_int_t  fsize;  /* Size of the indexed file            */
+    gmx_large_int_t  mtime;  /* Modification time of the file       */
+};
+
+static void xtc_index_add_frame(gmx_xtc_index_t xi, int *nalloc,
+                                gmx_off_t offset, int step, real time)
+{
+    if (xi->nframes + 1 >= *nalloc)
+    {
+        *nalloc = over_alloc_large(xi->nframes + 2);
+        srenew(xi->offset, *nalloc);
+        srenew(xi->step, *nalloc);
+        srenew(xi->time, *nalloc);
+    }
+    xi->offset[xi->nframes] = offset;
+    xi->step[xi->nframes]   = step;
+    xi->time[xi->nframes]   = time;
+    xi->nframes++;
+}
+
+/* Reads the header of the frame at the current position of fp and
+ * returns the offset of the next frame, or -1 when no complete frame
+ * could be read. No coordinates are decompressed.
+ */
+static gmx_off_t xtc_scan_frame(FILE *fp, XDR *xd, gmx_off_t fsize,
+                                int *step, float *time)
+{
+    int       magic, natoms, size, block_natoms, nblock, nbytes, b, i;
+    float     fdum;
+    gmx_off_t skip;
+
+    if (!xdr_int(xd, &magic) ||
+        (magic != XTC_MAGIC && magic != XTC_BLOCK_MAGIC) ||
+        !xdr_int(xd, &natoms) ||
+        !xdr_int(xd, step) ||
+        !xdr_float(xd, time))
+    {
+        return -1;
+    }
+    /* Skip the box */
+    if (gmx_fseek(fp, DIM*DIM*sizeof(float), SEEK_CUR) != 0 ||
+        !xdr_int(xd, &size))
+    {
+        return -1;
+    }
+    skip = 0;
+    if (magic == XTC_MAGIC)
+    {
+        if (size <= 9)
+        {
+            skip = size*DIM*sizeof(float);
+        }
+        else
+        {
+            /* Skip precision, minint, maxint and smallidx */
+            for (i = 0; i < 8; i++)
+            {
+                if (!xdr_float(xd, &fdum))
+                {
+                    return -1;
+                }
+            }
+            if (!xdr_int(xd, &nbytes) || nbytes < 0)
+            {
+                return -1;
+            }
+            /* xdr_opaque pads to multiples of 4 bytes */
+            skip = (nbytes + 3) & ~3;
+        }
+    }
+    else
+    {
+        if (!xdr_float(xd, &fdum) ||
+            !xdr_int(xd, &block_natoms) || block_natoms <= 0)
+        {
+            return -1;
+        }
+        nblock = (size + block_natoms - 1)/block_natoms;
+        for (b = 0; b < nblock; b++)
+        {
+            if (!xdr_int(xd, &nbytes) || nbytes < 0)
+            {
+                return -1;
+            }
+            skip += nbytes;
+        }
+    }
+    skip += gmx_ftell(fp);
+    if (skip > fsize || gmx_fseek(fp, skip, SEEK_SET) != 0)
+    {
+        /* Incomplete last frame */
+        return -1;
+    }
+
+    return skip;
+}
+
+static gmx_bool xtc_index_scan(t_fileio *fio, gmx_xtc_index_t xi)
+{
+    FILE     *fp;
+    XDR      *xd;
+    gmx_off_t offset, next;
+    int       step, nalloc;
+    float     time;
+
+    fp = gmx_fio_getfp(fio);
+    xd = gmx_fio_getxdr(fio);
+
+    if (fp == NULL || xd == NULL || gmx_fseek(fp, 0, SEEK_SET) != 0)
+    {
+        return FALSE;
+    }
+    nalloc      = 0;
+    xi->nframes = 0;
+    offset      = 0;
+    while (offset < xi->fsize &&
+           (next = xtc_scan_frame(fp, xd, xi->fsize, &step, &time)) >= 0)
+    {
+        xtc_index_add_frame(xi, &nalloc, offset, step, time);
+        offset = next;
+    }
+    /* Store the end of the last complete frame */
+    xtc_index_add_frame(xi, &nalloc, offset, 0, 0);
+    xi->nframes--;
+
+    return TRUE;
+}
+
+static char *xtc_index_filename(const char *fn)
+{
+    char *fn_index;
+
+    snew(fn_index, strlen(fn) + strlen(XTC_INDEX_SUFFIX) + 1);
+    sprintf(fn_index, "%s%s", fn, XTC_INDEX_SUFFIX);
+
+    return fn_index;
+}
+
+/* Reads or writes the index cache file, returns FALSE on error
+ * or when the cache does not match the size and time in xi.
+ */
+static gmx_bool do_xtc_index_cache(XDR *xd, gmx_xtc_index_t xi, gmx_bool bRead)
+{
+    int             magic, version, i;
+    gmx_large_int_t fsize, mtime;
+    float           ftime;
+
+    magic   = XTC_INDEX_MAGIC;
+    version = XTC_INDEX_VERSION;
+    fsize   = xi->fsize;
+    mtime   = xi->mtime;
+    if (!xdr_int(xd, &magic) || magic != XTC_INDEX_MAGIC ||
+        !xdr_int(xd, &version) || version != XTC_INDEX_VERSION ||
+        !xdr_gmx_large_int(xd, &fsize) || fsize != xi->fsize ||
+        !xdr_gmx_large_int(xd, &mtime) || mtime != xi->mtime ||
+        !xdr_int(xd, &xi->nframes) || xi->nframes < 0)
+    {
+        return FALSE;
+    }
+    if (bRead)
+    {
+        snew(xi->offset, xi->nframes + 1);
+        snew(xi->step, xi->nframes + 1);
+        snew(xi->time, xi->nframes + 1);
+    }
+    for (i = 0; i <= xi->nframes; i++)
+    {
+        ftime = xi->time[i];
+        if (!xdr_gmx_large_int(xd, &xi->offset[i]) ||
+            !xdr_int(xd, &xi->step[i]) ||
+            !xdr_float(xd, &ftime))
+        {
+            return FALSE;
+        }
+        xi->time[i] = ftime;
+    }
+
+    return TRUE;
+}
+
+static gmx_bool xtc_index_cache(const char *fn_index, gmx_xtc_index_t xi,
+                                gmx_bool bRead)
+{
+    FILE    *fp;
+    XDR      xd;
+    gmx_bool bOK;
+
+    fp = fopen(fn_index, bRead ? "rb" : "wb");
+    if (fp == NULL)
+    {
+        return FALSE;
+    }
+    xdrstdio_create(&xd, fp, bRead ? XDR_DECODE : XDR_ENCODE);
+    bOK = do_xtc_index_cache(&xd, xi, bRead);
+    xdr_destroy(&xd);
+    if (fclose(fp) != 0)
+    {
+        bOK = FALSE;
+    }
+    if (!bOK && !bRead)
+    {
+        /* Do not leave a broken cache behind */
+        remove(fn_index);
+    }
+
+    return bOK;
+}
+
+gmx_xtc_index_t xtc_index_init(t_fileio *fio, const char *fn)
+{
+    gmx_xtc_index_t xi;
+    struct stat     st;
+    char           *fn_index;
+    FILE           *fp;
+    gmx_off_t       pos;
+
+    if (stat(fn, &st) != 0)
+    {
+        return NULL;
+    }
+    fp = gmx_fio_getfp(fio);
+    if (fp == NULL || (pos = gmx_ftell(fp)) < 0)
+    {
+        return NULL;
+    }
+
+    snew(xi, 1);
+    xi->fsize = st.st_size;
+    xi->mtime = st.st_mtime;
+
+    fn_index = xtc_index_filename(fn);
+    if (!xtc_index_cache(fn_index, xi, TRUE))
+    {
+        sfree(xi->offset);
+        sfree(xi->step);
+        sfree(xi->time);
+        if (!xtc_index_scan(fio, xi))
+        {
+            sfree(fn_index);
+            xtc_index_done(xi);
+            gmx_fseek(fp, pos, SEEK_SET);
+
+            return NULL;
+        }
+        if (!xtc_index_cache(fn_index, xi, FALSE) && debug)
+        {
+            fprintf(debug, "Could not write the xtc index file %s\n", fn_index);
+        }
+    }
+    sfree(fn_index);
+
+    if (gmx_fseek(fp, pos, SEEK_SET) != 0)
+    {
+        gmx_file(fn);
+    }
+
+    return xi;
+}
+
+int xtc_index_nframes(gmx_xtc_index_t xi)
+{
+    return xi->nframes;
+}
+
+real xtc_index_frame_time(gmx_xtc_index_t xi, int frame)
+{
+    return xi->time[frame];
+}
+
+gmx_bool xtc_index_seek(t_fileio *fio, gmx_xtc_index_t xi, int frame)
+{
+    FILE *fp;
+
+    fp = gmx_fio_getfp(fio);
+    if (fp == NULL || frame < 0 || frame > xi->nframes)
+    {
+        return FALSE;
+    }
+
+    return (gmx_fseek(fp, xi->offset[frame], SEEK_SET) == 0);
+}
+
+int xtc_index_find_frame(t_fileio *fio, gmx_xtc_index_t xi)
+{
+    FILE     *fp;
+    gmx_off_t pos;
+    int       f0, f1, f;
+
+    fp = gmx_fio_getfp(fio);
+    if (fp == NULL || (pos = gmx_ftell(fp)) < 0)
+    {
+        return -1;
+    }
+
+    /* Binary search in the increasing offsets */
+    f0 = 0;
+    f1 = xi->nframes;
+    while (f0 < f1)
+    {
+        f = (f0 + f1)/2;
+        if (xi->offset[f] < pos)
+        {
+            f0 = f + 1;
+        }
+        else
+        {
+            f1 = f;
+        }
+    }
+
+    return (xi->offset[f0] == pos ? f0 : -1);
+}
+
+void xtc_index_done(gmx_xtc_index_t xi)
+{
+    if (xi != NULL)
+    {
+        sfree(xi->offset);
+        sfree(xi->step);
+        sfree(xi->time);
+        sfree(xi);
+    }
+}
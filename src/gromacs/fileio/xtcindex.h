@@ -0,0 +1,87 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+#ifndef GMX_FILEIO_XTCINDEX_H
+#define GMX_FILEIO_XTCINDEX_H
+
+#include "../legacyheaders/types/simple.h"
+#include "futil.h"
+#include "gmxfio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* An index with the file offset, step and time of all frames in an xtc file.
+ * The index is built by reading only the frame headers and the sizes
+ * of the compressed coordinate data, no coordinates are decompressed.
+ * It is cached in a file fn.gmxidx next to the trajectory fn, which is only
+ * used when the size and modification time of fn have not changed.
+ */
+typedef struct gmx_xtc_index *gmx_xtc_index_t;
+
+gmx_xtc_index_t xtc_index_init(t_fileio *fio, const char *fn);
+/* Returns the index for the xtc file fn opened for reading as fio.
+ * Reads the cached index when valid, otherwise scans the file and tries
+ * to write the cache. The file position of fio is not changed.
+ * Returns NULL when the file can not be indexed.
+ */
+
+int xtc_index_nframes(gmx_xtc_index_t xi);
+/* Returns the number of frames in the index */
+
+real xtc_index_frame_time(gmx_xtc_index_t xi, int frame);
+/* Returns the time of frame as stored in the xtc file */
+
+gmx_bool xtc_index_seek(t_fileio *fio, gmx_xtc_index_t xi, int frame);
+/* Positions fio at the start of frame, with frame equal to the number
+ * of frames positions at the end of the last complete frame.
+ * Returns FALSE when frame is out of range or seeking failed.
+ */
+
+int xtc_index_find_frame(t_fileio *fio, gmx_xtc_index_t xi);
+/* Returns the frame that starts at the current position of fio,
+ * nframes at the end of the last complete frame,
+ * -1 when the position is not at the start of a frame.
+ */
+
+void xtc_index_done(gmx_xtc_index_t xi);
+/* Frees the index */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GMX_FILEIO_XTCINDEX_H */
@@ -38,6 +38,7 @@
 #include <config.h>
 #endif
 
+#include <stdlib.h>
 #include <string.h>
 #include "typedefs.h"
 #include "xdrf.h"
@@ -49,6 +50,16 @@
 #include "gmx_fatal.h"
 
 #define XTC_MAGIC 1995
+/* Magic number for frames with coordinates compressed in independent
+ * blocks of atoms, see xdr3dfcoord_blocks().
+ */
+#define XTC_BLOCK_MAGIC 1996
+/* Default number of atoms per block, the compression overhead per block
+ * is about 40 bytes, which is negligible at this size.
+ */
+#define XTC_BLOCK_NATOMS 12288
+/* Smaller blocks compress badly, so smaller settings use the default */
+#define XTC_BLOCK_NATOMS_MIN 1000
 
 
 static int xdr_r2f(XDR *xdrs, real *r, gmx_bool gmx_unused bRead)
@@ -86,11 +97,40 @@ void close_xtc(t_fileio *fio)
 
 static void check_xtc_magic(int magic)
 {
-    if (magic != XTC_MAGIC)
+    if (magic != XTC_MAGIC && magic != XTC_BLOCK_MAGIC)
+    {
+        gmx_fatal(FARGS, "Magic Number Error in XTC file (read %d, should be %d or %d)",
+                  magic, XTC_MAGIC, XTC_BLOCK_MAGIC);
+    }
+}
+
+/* Returns the number of atoms per block for writing block-compressed
+ * frames, or 0 for writing standard xtc frames.
+ * Setting GMX_XTC_BLOCKS enables blocks, a value of at least
+ * XTC_BLOCK_NATOMS_MIN sets the size.
+ */
+static int xtc_write_block_natoms(int natoms)
+{
+    const char *env;
+    int         block_natoms;
+
+    env = getenv("GMX_XTC_BLOCKS");
+    if (env == NULL)
+    {
+        return 0;
+    }
+    block_natoms = strtol(env, NULL, 10);
+    if (block_natoms < XTC_BLOCK_NATOMS_MIN)
+    {
+        block_natoms = XTC_BLOCK_NATOMS;
+    }
+    /* Blocks only pay off when there are at least two of them */
+    if (natoms <= block_natoms)
     {
-        gmx_fatal(FARGS, "Magic Number Error in XTC file (read %d, should be %d)",
-                  magic, XTC_MAGIC);
+        return 0;
     }
+
+    return block_natoms;
 }
 
 int xtc_check(const char *str, gmx_bool bResult, const char *file, int line)
@@ -139,7 +179,11 @@ static int xtc_header(XDR *xd, int *magic, int *natoms, int *step, real *time,
     return result;
 }
 
-static int xtc_coord(XDR *xd, int *natoms, matrix box, rvec *x, real *prec, gmx_bool bRead)
+/* Reads or writes the box and coordinates, in block-compressed format
+ * when block_natoms > 0.
+ */
+static int xtc_coord(XDR *xd, int *natoms, matrix box, rvec *x, real *prec,
+                     int block_natoms, gmx_bool bRead)
 {
     int    i, j, result;
 #ifdef GMX_DOUBLE
@@ -177,7 +221,15 @@ static int xtc_coord(XDR *xd, int *natoms, matrix box, rvec *x, real *prec, gmx_
         }
         fprec = *prec;
     }
-    result = XTC_CHECK("x", xdr3dfcoord(xd, ftmp, natoms, &fprec));
+    if (block_natoms > 0)
+    {
+        result = XTC_CHECK("x", xdr3dfcoord_blocks(xd, ftmp, natoms, &fprec,
+                                                   block_natoms));
+    }
+    else
+    {
+        result = XTC_CHECK("x", xdr3dfcoord(xd, ftmp, natoms, &fprec));
+    }
 
     /* Copy from temp. array if reading */
     if (bRead)
@@ -192,7 +244,15 @@ static int xtc_coord(XDR *xd, int *natoms, matrix box, rvec *x, real *prec, gmx_
     }
     sfree(ftmp);
 #else
-    result = XTC_CHECK("x", xdr3dfcoord(xd, x[0], natoms, prec));
+    if (block_natoms > 0)
+    {
+        result = XTC_CHECK("x", xdr3dfcoord_blocks(xd, x[0], natoms, prec,
+                                                   block_natoms));
+    }
+    else
+    {
+        result = XTC_CHECK("x", xdr3dfcoord(xd, x[0], natoms, prec));
+    }
 #endif
 
     return result;
@@ -204,11 +264,15 @@ int write_xtc(t_fileio *fio,
               int natoms, int step, real time,
               matrix box, rvec *x, real prec)
 {
-    int      magic_number = XTC_MAGIC;
+    int      magic_number;
+    int      block_natoms;
     XDR     *xd;
     gmx_bool bDum;
     int      bOK;
 
+    block_natoms = xtc_write_block_natoms(natoms);
+    magic_number = (block_natoms > 0) ? XTC_BLOCK_MAGIC : XTC_MAGIC;
+
     xd = gmx_fio_getxdr(fio);
     /* write magic number and xtc identidier */
     if (xtc_header(xd, &magic_number, &natoms, &step, &time, FALSE, &bDum) == 0)
@@ -217,7 +281,7 @@ int write_xtc(t_fileio *fio,
     }
 
     /* write data */
-    bOK = xtc_coord(xd, &natoms, box, x, &prec, FALSE); /* bOK will be 1 if writing went well */
+    bOK = xtc_coord(xd, &natoms, box, x, &prec, block_natoms, FALSE); /* bOK will be 1 if writing went well */
 
     if (bOK)
     {
@@ -249,7 +313,9 @@ int read_first_xtc(t_fileio *fio, int *natoms, int *step, real *time,
 
     snew(*x, *natoms);
 
-    *bOK = xtc_coord(xd, natoms, box, *x, prec, TRUE);
+    /* For block frames the block size is read from the frame */
+    *bOK = xtc_coord(xd, natoms, box, *x, prec,
+                     (magic == XTC_BLOCK_MAGIC) ? 1 : 0, TRUE);
 
     return *bOK;
 }
@@ -280,7 +346,8 @@ int read_next_xtc(t_fileio* fio,
                   n, natoms);
     }
 
-    *bOK = xtc_coord(xd, &natoms, box, x, prec, TRUE);
+    *bOK = xtc_coord(xd, &natoms, box, x, prec,
+                     (magic == XTC_BLOCK_MAGIC) ? 1 : 0, TRUE);
 
     return *bOK;
 }
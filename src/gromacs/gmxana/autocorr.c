@@ -49,7 +49,8 @@
 #include "gmx_fatal.h"
 #include "vec.h"
 #include "string2.h"
-#include "correl.h"
+#include "gromacs/fft/fft.h"
+#include "gromacs/utility/gmxomp.h"
 
 #define MODE(x) ((mode & (x)) == (x))
 
@@ -67,6 +68,133 @@ enum {
     enNorm, enCos, enSin
 };
 
+/* Buffers and FFT setups for computing correlation functions of single
+ * items. Each thread uses its own, so items can be processed in parallel.
+ */
+struct gmx_acf_work {
+    int        nframes; /* Maximum number of frames per item */
+    int        nfour;   /* FFT length for ACFs, 0 when not using FFTs */
+    gmx_fft_t  fft;     /* FFT setup of length nfour */
+    int        ncross;  /* FFT length for cross correlations, 0 when unset */
+    gmx_fft_t  fft_cross;
+    int        nalloc;  /* Allocation size of the buffers below */
+    real      *csum;    /* Sum of the correlation components */
+    real      *ctmp;    /* Copy of the input for multi-component ACFs */
+    real      *cfour;   /* Correlation of a single component */
+    real      *fbuf;    /* In-place FFT buffers */
+    real      *gbuf;
+};
+
+/* Returns whether the ACF for mode should be computed with FFTs */
+static gmx_bool acf_use_fft(unsigned long mode)
+{
+    return (acf.bFour && !(MODE(eacP3) || MODE(eacRcross)));
+}
+
+static void acf_work_realloc(gmx_acf_work_t work, int n)
+{
+    if (n > work->nalloc)
+    {
+        work->nalloc = n;
+        srenew(work->csum, work->nalloc);
+        srenew(work->ctmp, work->nalloc);
+        srenew(work->cfour, work->nalloc);
+        srenew(work->fbuf, work->nalloc + 2);
+        srenew(work->gbuf, work->nalloc + 2);
+    }
+}
+
+gmx_acf_work_t init_acf_work(int nframes, unsigned long mode)
+{
+    gmx_acf_work_t work;
+    int            status;
+
+    snew(work, 1);
+    work->nframes = nframes;
+    if (nframes > 0 && acf_use_fft(mode))
+    {
+        /* Zero padding to at least twice the length avoids wrap-around */
+        work->nfour = 1;
+        while (work->nfour < nframes)
+        {
+            work->nfour *= 2;
+        }
+        work->nfour *= 2;
+        if ((status = gmx_fft_init_1d_real(&work->fft, work->nfour,
+                                           GMX_FFT_FLAG_CONSERVATIVE)) != 0)
+        {
+            gmx_fatal(FARGS, "Invalid fft return status %d", status);
+        }
+    }
+    acf_work_realloc(work, max(nframes, work->nfour));
+
+    return work;
+}
+
+void done_acf_work(gmx_acf_work_t work)
+{
+    if (work->nfour > 0)
+    {
+        gmx_fft_destroy(work->fft);
+    }
+    if (work->ncross > 0)
+    {
+        gmx_fft_destroy(work->fft_cross);
+    }
+    sfree(work->csum);
+    sfree(work->ctmp);
+    sfree(work->cfour);
+    sfree(work->fbuf);
+    sfree(work->gbuf);
+    sfree(work);
+}
+
+/* Computes the circular correlation corr[j] = sum_i f[i+j] g[i]
+ * of length n with FFT setup fft, using the buffers in work.
+ */
+static void fft_correl(gmx_acf_work_t work, gmx_fft_t fft, int n,
+                       real f[], real g[], real corr[])
+{
+    real *ff, *fg, re, im;
+    int   i;
+
+    ff = work->fbuf;
+    fg = work->gbuf;
+    for (i = 0; i < n; i++)
+    {
+        ff[i] = f[i];
+    }
+    gmx_fft_1d_real(fft, GMX_FFT_REAL_TO_COMPLEX, ff, ff);
+    if (g == f)
+    {
+        for (i = 0; i <= n/2; i++)
+        {
+            ff[2*i]   = sqr(ff[2*i]) + sqr(ff[2*i+1]);
+            ff[2*i+1] = 0;
+        }
+    }
+    else
+    {
+        for (i = 0; i < n; i++)
+        {
+            fg[i] = g[i];
+        }
+        gmx_fft_1d_real(fft, GMX_FFT_REAL_TO_COMPLEX, fg, fg);
+        for (i = 0; i <= n/2; i++)
+        {
+            re        = ff[2*i]*fg[2*i]   + ff[2*i+1]*fg[2*i+1];
+            im        = ff[2*i+1]*fg[2*i] - ff[2*i]*fg[2*i+1];
+            ff[2*i]   = re;
+            ff[2*i+1] = im;
+        }
+    }
+    gmx_fft_1d_real(fft, GMX_FFT_COMPLEX_TO_REAL, ff, ff);
+    for (i = 0; i < n; i++)
+    {
+        corr[i] = ff[i]/n;
+    }
+}
+
 int sffn2effn(const char **sffn)
 {
     int eFitFn, i;
@@ -83,11 +211,14 @@ int sffn2effn(const char **sffn)
     return eFitFn;
 }
 
-static void low_do_four_core(int nfour, int nframes, real c1[], real cfour[],
+static void low_do_four_core(gmx_acf_work_t work, int nframes,
+                             real c1[], real cfour[],
                              int nCos, gmx_bool bPadding)
 {
-    int  i = 0;
-    real aver, *ans;
+    int  nfour, i = 0;
+    real aver;
+
+    nfour = work->nfour;
 
     aver = 0.0;
     switch (nCos)
@@ -129,25 +260,15 @@ static void low_do_four_core(int nfour, int nframes, real c1[], real cfour[],
         }
     }
 
-    snew(ans, 2*nfour);
-    correl(cfour-1, cfour-1, nfour, ans-1);
+    fft_correl(work, work->fft, nfour, cfour, cfour, cfour);
 
     if (bPadding)
     {
         for (i = 0; (i < nfour); i++)
         {
-            cfour[i] = ans[i]+sqr(aver);
+            cfour[i] += sqr(aver);
         }
     }
-    else
-    {
-        for (i = 0; (i < nfour); i++)
-        {
-            cfour[i] = ans[i];
-        }
-    }
-
-    sfree(ans);
 }
 
 static void do_ac_core(int nframes, int nout,
@@ -439,22 +560,24 @@ real evaluate_integral(int n, real x[], real y[], real dy[], real aver_start,
     return sum;
 }
 
-void do_four_core(unsigned long mode, int nfour, int nf2, int nframes,
-                  real c1[], real csum[], real ctmp[])
+static void do_four_core(gmx_acf_work_t work, unsigned long mode,
+                         int nf2, int nframes, real c1[])
 {
-    real   *cfour;
+    real   *csum, *ctmp, *cfour;
     char    buf[32];
     real    fac;
     int     j, m, m1;
 
-    snew(cfour, nfour);
+    csum  = work->csum;
+    ctmp  = work->ctmp;
+    cfour = work->cfour;
 
     if (MODE(eacNormal))
     {
         /********************************************
          *  N O R M A L
          ********************************************/
-        low_do_four_core(nfour, nf2, c1, csum, enNorm, FALSE);
+        low_do_four_core(work, nf2, c1, csum, enNorm, FALSE);
     }
     else if (MODE(eacCos))
     {
@@ -470,14 +593,14 @@ void do_four_core(unsigned long mode, int nfour, int nf2, int nframes,
         }
 
         /* Cosine term of AC function */
-        low_do_four_core(nfour, nf2, ctmp, cfour, enCos, FALSE);
+        low_do_four_core(work, nf2, ctmp, cfour, enCos, FALSE);
         for (j = 0; (j < nf2); j++)
         {
             c1[j]  = cfour[j];
         }
 
         /* Sine term of AC function */
-        low_do_four_core(nfour, nf2, ctmp, cfour, enSin, FALSE);
+        low_do_four_core(work, nf2, ctmp, cfour, enSin, FALSE);
         for (j = 0; (j < nf2); j++)
         {
             c1[j]  += cfour[j];
@@ -544,7 +667,7 @@ void do_four_core(unsigned long mode, int nfour, int nf2, int nframes,
                 dump_tmp(buf, nf2, ctmp);
             }
 
-            low_do_four_core(nfour, nf2, ctmp, cfour, enNorm, FALSE);
+            low_do_four_core(work, nf2, ctmp, cfour, enNorm, FALSE);
 
             if (debug)
             {
@@ -572,7 +695,7 @@ void do_four_core(unsigned long mode, int nfour, int nf2, int nframes,
                 sprintf(buf, "c1off%d.xvg", m);
                 dump_tmp(buf, nf2, ctmp);
             }
-            low_do_four_core(nfour, nf2, ctmp, cfour, enNorm, FALSE);
+            low_do_four_core(work, nf2, ctmp, cfour, enNorm, FALSE);
             if (debug)
             {
                 sprintf(buf, "c1ofout%d.xvg", m);
@@ -611,7 +734,7 @@ void do_four_core(unsigned long mode, int nfour, int nf2, int nframes,
             {
                 ctmp[j] = c1[DIM*j+m];
             }
-            low_do_four_core(nfour, nf2, ctmp, cfour, enNorm, FALSE);
+            low_do_four_core(work, nf2, ctmp, cfour, enNorm, FALSE);
             for (j = 0; (j < nf2); j++)
             {
                 csum[j] += cfour[j];
@@ -623,13 +746,30 @@ void do_four_core(unsigned long mode, int nfour, int nf2, int nframes,
         gmx_fatal(FARGS, "\nUnknown mode in do_autocorr (%d)", mode);
     }
 
-    sfree(cfour);
     for (j = 0; (j < nf2); j++)
     {
         c1[j] = csum[j]/(real)(nframes-j);
     }
 }
 
+void calc_acf_item(gmx_acf_work_t work, unsigned long mode,
+                   int nframes, int nout, int nrestart, real c1[])
+{
+    if (nframes > work->nframes)
+    {
+        gmx_incons("calc_acf_item called with more frames than the work data was set up for");
+    }
+
+    if (work->nfour > 0)
+    {
+        do_four_core(work, mode, nframes, nframes, c1);
+    }
+    else
+    {
+        do_ac_core(nframes, nout, work->ctmp, c1, nrestart, mode);
+    }
+}
+
 real fit_acf(int ncorr, int fitfn, const output_env_t oenv, gmx_bool bVerbose,
              real tbeginfit, real tendfit, real dt, real c1[], real *fit)
 {
@@ -778,11 +918,10 @@ void low_do_autocorr(const char *fn, const output_env_t oenv, const char *title,
                      int eFitFn)
 {
     FILE       *fp, *gp = NULL;
-    int         i, k, nfour;
-    real       *csum;
-    real       *ctmp, *fit;
-    real        c0, sum, Ct2av, Ctav;
-    gmx_bool    bFour = acf.bFour;
+    int         i, k, nthreads;
+    real       *fit;
+    real        sum, Ct2av, Ctav;
+    gmx_bool    bFour;
 
     /* Check flags and parameters */
     nout = get_acfnout();
@@ -800,10 +939,10 @@ void low_do_autocorr(const char *fn, const output_env_t oenv, const char *title,
         gmx_fatal(FARGS, "Incompatible options bCos && bVector (%s, %d)",
                   __FILE__, __LINE__);
     }
-    if ((MODE(eacP3) || MODE(eacRcross)) && bFour)
+    bFour = acf_use_fft(mode);
+    if (acf.bFour && !bFour)
     {
         fprintf(stderr, "Can't combine mode %lu with FFT, turning off FFT\n", mode);
-        bFour = FALSE;
     }
     if (MODE(eacNormal) && MODE(eacVector))
     {
@@ -819,60 +958,43 @@ void low_do_autocorr(const char *fn, const output_env_t oenv, const char *title,
                bool_names[bAver], bool_names[bFour], bool_names[bNormalize]);
         printf("mode = %lu, dt = %g, nrestart = %d\n", mode, dt, nrestart);
     }
-    if (bFour)
-    {
-        c0 = log((double)nframes)/log(2.0);
-        k  = c0;
-        if (k < c0)
-        {
-            k++;
-        }
-        k++;
-        nfour = 1<<k;
-        if (debug)
-        {
-            fprintf(debug, "Using FFT to calculate %s, #points for FFT = %d\n",
-                    title, nfour);
-        }
-
-        /* Allocate temp arrays */
-        snew(csum, nfour);
-        snew(ctmp, nfour);
-    }
-    else
-    {
-        nfour = 0; /* To keep the compiler happy */
-        snew(csum, nframes);
-        snew(ctmp, nframes);
-    }
-
     /* Loop over items (e.g. molecules or dihedrals)
      * In this loop the actual correlation functions are computed, but without
-     * normalizing them.
+     * normalizing them. The items are independent, so we divide them over
+     * the threads, each with its own buffers and FFT setup.
      */
-    k = max(1, pow(10, (int)(log(nitem)/log(100))));
-    for (i = 0; i < nitem; i++)
+    nthreads = max(1, min(nitem, gmx_omp_get_max_threads()));
+    k        = max(1, pow(10, (int)(log(nitem)/log(100))));
+#pragma omp parallel num_threads(nthreads)
     {
-        if (bVerbose && ((i%k == 0 || i == nitem-1)))
-        {
-            fprintf(stderr, "\rThingie %d", i+1);
-        }
+        gmx_acf_work_t work;
+        int            it;
 
-        if (bFour)
+        work = init_acf_work(nframes, mode);
+        if (debug && bFour && gmx_omp_get_thread_num() == 0)
         {
-            do_four_core(mode, nfour, nframes, nframes, c1[i], csum, ctmp);
+            fprintf(debug, "Using FFT to calculate %s, #points for FFT = %d\n",
+                    title, work->nfour);
         }
-        else
+
+#pragma omp for schedule(static)
+        for (it = 0; it < nitem; it++)
         {
-            do_ac_core(nframes, nout, ctmp, c1[i], nrestart, mode);
+            if (bVerbose && gmx_omp_get_thread_num() == 0 &&
+                ((it%k == 0 || it == nitem-1)))
+            {
+                fprintf(stderr, "\rThingie %d", it+1);
+            }
+
+            calc_acf_item(work, mode, nframes, nout, nrestart, c1[it]);
         }
+
+        done_acf_work(work);
     }
     if (bVerbose)
     {
         fprintf(stderr, "\n");
     }
-    sfree(ctmp);
-    sfree(csum);
 
     if (fn)
     {
@@ -1072,13 +1194,27 @@ int get_acffitfn(void)
     return sffn2effn(s_ffn);
 }
 
-void cross_corr(int n, real f[], real g[], real corr[])
+void calc_cross_corr(gmx_acf_work_t work, int n, real f[], real g[], real corr[])
 {
-    int i, j;
+    int i, j, status;
 
     if (acf.bFour)
     {
-        correl(f-1, g-1, n, corr-1);
+        if (n != work->ncross)
+        {
+            if (work->ncross > 0)
+            {
+                gmx_fft_destroy(work->fft_cross);
+            }
+            if ((status = gmx_fft_init_1d_real(&work->fft_cross, n,
+                                               GMX_FFT_FLAG_CONSERVATIVE)) != 0)
+            {
+                gmx_fatal(FARGS, "Invalid fft return status %d", status);
+            }
+            work->ncross = n;
+            acf_work_realloc(work, n);
+        }
+        fft_correl(work, work->fft_cross, n, f, g, corr);
     }
     else
     {
@@ -1092,3 +1228,12 @@ void cross_corr(int n, real f[], real g[], real corr[])
         }
     }
 }
+
+void cross_corr(int n, real f[], real g[], real corr[])
+{
+    gmx_acf_work_t work;
+
+    work = init_acf_work(0, eacNormal);
+    calc_cross_corr(work, n, f, g, corr);
+    done_acf_work(work);
+}
@@ -1408,7 +1408,7 @@ int gmx_cluster(int argc, char *argv[])
     gmx_large_int_t    nrms = 0;
 
     matrix             box;
-    rvec              *xtps, *usextps, *x1, **xx = NULL;
+    rvec              *xtps, *usextps, **xx = NULL;
     const char        *fn, *trx_out_fn;
     t_clusters         clust;
     t_mat             *rms, *orig = NULL;
@@ -1744,27 +1744,57 @@ int gmx_cluster(int argc, char *argv[])
         if (!bRMSdist)
         {
             fprintf(stderr, "Computing %dx%d RMS deviation matrix\n", nf, nf);
-            /* Initialize work array */
-            snew(x1, isize);
-            for (i1 = 0; i1 < nf; i1++)
+            if (bFit)
             {
-                for (i2 = i1+1; i2 < nf; i2++)
+                /* Rows of the matrix per call, to be able to report progress */
+                const int nrow = 64;
+                int       n1;
+                real    **rmsd_rows;
+
+                /* All frames are centered, so we can use the fast
+                 * all-vs-all superposition RMSD.
+                 */
+                snew(rmsd_rows, nrow);
+                for (i = 0; i < nrow; i++)
+                {
+                    snew(rmsd_rows[i], nf);
+                }
+                for (i1 = 0; i1 < nf - 1; i1 += nrow)
                 {
-                    for (i = 0; i < isize; i++)
+                    /* Rows i1 up to i1+n1 against all later frames */
+                    n1 = min(nrow, nf - 1 - i1);
+                    calc_rmsd_matrix_qcp(isize, mass, n1, xx + i1,
+                                         nf - i1 - 1, xx + i1 + 1, rmsd_rows);
+                    for (i = 0; i < n1; i++)
                     {
-                        copy_rvec(xx[i1][i], x1[i]);
+                        for (i2 = i1 + i + 1; i2 < nf; i2++)
+                        {
+                            set_mat_entry(rms, i1 + i, i2,
+                                          rmsd_rows[i][i2 - i1 - 1]);
+                        }
+                        nrms -= (gmx_large_int_t) (nf - (i1 + i) - 1);
                     }
-                    if (bFit)
+                    fprintf(stderr, "\r# RMSD calculations left: " gmx_large_int_pfmt "   ", nrms);
+                }
+                for (i = 0; i < nrow; i++)
+                {
+                    sfree(rmsd_rows[i]);
+                }
+                sfree(rmsd_rows);
+            }
+            else
+            {
+                for (i1 = 0; i1 < nf; i1++)
+                {
+                    for (i2 = i1+1; i2 < nf; i2++)
                     {
-                        do_fit(isize, mass, xx[i2], x1);
+                        rmsd = rmsdev(isize, mass, xx[i2], xx[i1]);
+                        set_mat_entry(rms, i1, i2, rmsd);
                     }
-                    rmsd = rmsdev(isize, mass, xx[i2], x1);
-                    set_mat_entry(rms, i1, i2, rmsd);
+                    nrms -= (gmx_large_int_t) (nf-i1-1);
+                    fprintf(stderr, "\r# RMSD calculations left: " gmx_large_int_pfmt "   ", nrms);
                 }
-                nrms -= (gmx_large_int_t) (nf-i1-1);
-                fprintf(stderr, "\r# RMSD calculations left: " gmx_large_int_pfmt "   ", nrms);
             }
-            sfree(x1);
         }
         else /* bRMSdist */
         {
@@ -126,6 +126,16 @@ typedef struct {
 typedef int     t_icell[grNR];
 typedef atom_id h_id[MAXHYDRO];
 
+/* Run-length encoded existence function of a hydrogen bond:
+ * run i covers the frames b[2*i] <= frame < b[2*i+1].
+ * Hydrogen bonds typically exist for long stretches of frames,
+ * so this uses far less memory than one bit per frame.
+ */
+typedef struct {
+    int  nrun, nalloc;
+    int *b;
+} t_hbexist;
+
 typedef struct {
     int      history[MAXHYDRO];
     /* Has this hbond existed ever? If so as hbDist or hbHB or both.
@@ -135,9 +145,9 @@ typedef struct {
      * at a given time. Either of these may be NULL
      */
     int            n0;                 /* First frame a HB was found     */
-    int            nframes, maxframes; /* Amount of frames in this hbond */
-    unsigned int **h;
-    unsigned int **g;
+    int            nframes;            /* Amount of frames in this hbond */
+    t_hbexist    **h;
+    t_hbexist    **g;
     /* See Xu and Berne, JPCB 105 (2001), p. 11929. We define the
      * function g(t) = [1-h(t)] H(t) where H(t) is one when the donor-
      * acceptor distance is less than the user-specified distance (typically
@@ -193,9 +203,17 @@ typedef struct {
     t_E ****E;    /* Energy estimate for [d][a][h][frame-n0] */
 } t_hbEmap;
 
+/* One row of the sparse donor-acceptor matrix, only the donor-acceptor
+ * pairs that have been within hydrogen bonding distance are stored.
+ */
+typedef struct {
+    int       n, nalloc;
+    int      *acc;    /* Acceptor indices, sorted */
+    t_hbond **hb;     /* The hbond data for each acceptor */
+} t_hbrow;
+
 typedef struct {
     gmx_bool        bHBmap, bDAnr, bGem;
-    int             wordlen;
     /* The following arrays are nframes long */
     int             nframes, max_frames, maxhydro;
     int            *nhb, *ndist;
@@ -206,9 +224,9 @@ typedef struct {
     /* These structures are initialized from the topology at start up */
     t_donors        d;
     t_acceptors     a;
-    /* This holds a matrix with all possible hydrogen bonds */
+    /* This holds a sparse matrix with all found hydrogen bonds */
     int             nrhb, nrdist;
-    t_hbond      ***hbmap;
+    t_hbrow        *hbmap;
 #ifdef HAVE_NN_LOOPS
     t_hbEmap        hbE;
 #endif
@@ -335,7 +353,6 @@ static t_hbdata *mk_hbdata(gmx_bool bHBmap, gmx_bool bDAnr, gmx_bool oneHB, gmx_
     t_hbdata *hb;
 
     snew(hb, 1);
-    hb->wordlen = 8*sizeof(unsigned int);
     hb->bHBmap  = bHBmap;
     hb->bDAnr   = bDAnr;
     hb->bGem    = bGem;
@@ -355,21 +372,65 @@ static t_hbdata *mk_hbdata(gmx_bool bHBmap, gmx_bool bDAnr, gmx_bool oneHB, gmx_
 
 static void mk_hbmap(t_hbdata *hb)
 {
-    int  i, j;
-
+    /* The rows are filled when hydrogen bonds are found */
     snew(hb->hbmap, hb->d.nrd);
-    for (i = 0; (i < hb->d.nrd); i++)
+}
+
+/* Returns the hbond data for donor id and acceptor ia, NULL when absent */
+static t_hbond *get_hbond(const t_hbdata *hb, int id, int ia)
+{
+    const t_hbrow *row = &hb->hbmap[id];
+    int            lo, hi, mid;
+
+    lo = 0;
+    hi = row->n;
+    while (lo < hi)
     {
-        snew(hb->hbmap[i], hb->a.nra);
-        if (hb->hbmap[i] == NULL)
+        mid = (lo + hi)/2;
+        if (row->acc[mid] < ia)
         {
-            gmx_fatal(FARGS, "Could not allocate enough memory for hbmap");
+            lo = mid + 1;
         }
-        for (j = 0; (j > hb->a.nra); j++)
+        else
         {
-            hb->hbmap[i][j] = NULL;
+            hi = mid;
         }
     }
+
+    return (lo < row->n && row->acc[lo] == ia) ? row->hb[lo] : NULL;
+}
+
+/* Returns the hbond data for donor id and acceptor ia, adds it when absent */
+static t_hbond *get_add_hbond(t_hbdata *hb, int id, int ia)
+{
+    t_hbrow *row = &hb->hbmap[id];
+    t_hbond *hbond;
+    int      i;
+
+    hbond = get_hbond(hb, id, ia);
+    if (hbond == NULL)
+    {
+        if (row->n == row->nalloc)
+        {
+            row->nalloc = 2*row->nalloc + 4;
+            srenew(row->acc, row->nalloc);
+            srenew(row->hb, row->nalloc);
+        }
+        /* Insert while keeping the row sorted */
+        for (i = row->n; i > 0 && row->acc[i-1] > ia; i--)
+        {
+            row->acc[i] = row->acc[i-1];
+            row->hb[i]  = row->hb[i-1];
+        }
+        snew(hbond, 1);
+        snew(hbond->h, hb->maxhydro);
+        snew(hbond->g, hb->maxhydro);
+        row->acc[i] = ia;
+        row->hb[i]  = hbond;
+        row->n++;
+    }
+
+    return hbond;
 }
 
 /* Consider redoing pHist so that is only stores transitions between
@@ -681,44 +742,86 @@ static void add_frames(t_hbdata *hb, int nframes)
     hb->nframes = nframes;
 }
 
-#define OFFSET(frame) (frame / 32)
-#define MASK(frame)   (1 << (frame % 32))
-
-static void _set_hb(unsigned int hbexist[], unsigned int frame, gmx_bool bValue)
+/* Sets the existence at frame, frames should be set in increasing order */
+static void _set_hb(t_hbexist *hbexist, int frame)
 {
-    if (bValue)
+    int n;
+
+    n = 2*hbexist->nrun;
+    if (n > 0 && frame <= hbexist->b[n-1])
     {
-        hbexist[OFFSET(frame)] |= MASK(frame);
+        if (frame == hbexist->b[n-1])
+        {
+            /* Extend the last run */
+            hbexist->b[n-1]++;
+        }
+        else if (frame < hbexist->b[n-2])
+        {
+            gmx_incons("Hydrogen bond existence set out of frame order");
+        }
+        return;
     }
-    else
+    if (n + 2 > hbexist->nalloc)
+    {
+        hbexist->nalloc = 2*hbexist->nalloc + 2;
+        srenew(hbexist->b, hbexist->nalloc);
+    }
+    hbexist->b[n]   = frame;
+    hbexist->b[n+1] = frame + 1;
+    hbexist->nrun++;
+}
+
+static gmx_bool is_hb(const t_hbexist *hbexist, int frame)
+{
+    int lo, hi, mid;
+
+    /* Find the first run that ends after frame */
+    lo = 0;
+    hi = hbexist->nrun;
+    while (lo < hi)
     {
-        hbexist[OFFSET(frame)] &= ~MASK(frame);
+        mid = (lo + hi)/2;
+        if (hbexist->b[2*mid+1] <= frame)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
     }
+
+    return (lo < hbexist->nrun && hbexist->b[2*lo] <= frame);
 }
 
-static gmx_bool is_hb(unsigned int hbexist[], int frame)
+static void done_hbexist(t_hbexist **hbexist)
 {
-    return ((hbexist[OFFSET(frame)] & MASK(frame)) != 0) ? 1 : 0;
+    if (*hbexist != NULL)
+    {
+        sfree((*hbexist)->b);
+        sfree(*hbexist);
+        *hbexist = NULL;
+    }
 }
 
-static void set_hb(t_hbdata *hb, int id, int ih, int ia, int frame, int ihb)
+static void set_hb(t_hbond *hbond, int ih, int frame, int ihb)
 {
-    unsigned int *ghptr = NULL;
+    t_hbexist *ghptr = NULL;
 
     if (ihb == hbHB)
     {
-        ghptr = hb->hbmap[id][ia]->h[ih];
+        ghptr = hbond->h[ih];
     }
     else if (ihb == hbDist)
     {
-        ghptr = hb->hbmap[id][ia]->g[ih];
+        ghptr = hbond->g[ih];
     }
     else
     {
         gmx_fatal(FARGS, "Incomprehensible iValue %d in set_hb", ihb);
     }
 
-    _set_hb(ghptr, frame-hb->hbmap[id][ia]->n0, TRUE);
+    _set_hb(ghptr, frame-hbond->n0);
 }
 
 static void addPshift(t_pShift *pHist, PSTYPE p, int frame)
@@ -771,51 +874,29 @@ static PSTYPE getPshift(t_pShift pHist, int frame)
     return pHist.p[pHist.len-1];
 }
 
-static void add_ff(t_hbdata *hbd, int id, int h, int ia, int frame, int ihb, PSTYPE p)
+static void add_ff(t_hbdata *hbd, t_hbond *hb, int id, int h, int ia,
+                   int frame, int ihb, PSTYPE p)
 {
-    int         i, j, n;
-    t_hbond    *hb       = hbd->hbmap[id][ia];
+    int         i;
     int         maxhydro = min(hbd->maxhydro, hbd->d.nhydro[id]);
-    int         wlen     = hbd->wordlen;
-    int         delta    = 32*wlen;
     gmx_bool    bGem     = hbd->bGem;
 
     if (!hb->h[0])
     {
-        hb->n0        = frame;
-        hb->maxframes = delta;
+        hb->n0 = frame;
         for (i = 0; (i < maxhydro); i++)
         {
-            snew(hb->h[i], hb->maxframes/wlen);
-            snew(hb->g[i], hb->maxframes/wlen);
+            snew(hb->h[i], 1);
+            snew(hb->g[i], 1);
         }
     }
     else
     {
         hb->nframes = frame-hb->n0;
-        /* We need a while loop here because hbonds may be returning
-         * after a long time.
-         */
-        while (hb->nframes >= hb->maxframes)
-        {
-            n = hb->maxframes + delta;
-            for (i = 0; (i < maxhydro); i++)
-            {
-                srenew(hb->h[i], n/wlen);
-                srenew(hb->g[i], n/wlen);
-                for (j = hb->maxframes/wlen; (j < n/wlen); j++)
-                {
-                    hb->h[i][j] = 0;
-                    hb->g[i][j] = 0;
-                }
-            }
-
-            hb->maxframes = n;
-        }
     }
     if (frame >= 0)
     {
-        set_hb(hbd, id, h, ia, frame, ihb);
+        set_hb(hb, h, frame, ihb);
         if (bGem)
         {
             if (p >= hbd->per->nper)
@@ -915,6 +996,7 @@ static void add_hbond(t_hbdata *hb, int d, int a, int h, int grpd, int grpa,
 {
     int      k, id, ia, hh;
     gmx_bool daSwap = FALSE;
+    t_hbond *hbond  = NULL;
 
     if ((id = hb->d.dptr[d]) == NOTSET)
     {
@@ -997,15 +1079,13 @@ static void add_hbond(t_hbdata *hb, int d, int a, int h, int grpd, int grpa,
         if (hb->bHBmap)
         {
 
+            /* Rows can be reallocated by other threads, but the hbond
+             * pointers remain valid, so only the insertion is critical.
+             */
 #pragma omp critical
             {
-                if (hb->hbmap[id][ia] == NULL)
-                {
-                    snew(hb->hbmap[id][ia], 1);
-                    snew(hb->hbmap[id][ia]->h, hb->maxhydro);
-                    snew(hb->hbmap[id][ia]->g, hb->maxhydro);
-                }
-                add_ff(hb, id, k, ia, frame, ihb, p);
+                hbond = get_add_hbond(hb, id, ia);
+                add_ff(hb, hbond, id, k, ia, frame, ihb, p);
             }
         }
 
@@ -1015,13 +1095,13 @@ static void add_hbond(t_hbdata *hb, int d, int a, int h, int grpd, int grpa,
          */
         if (frame >= 0)
         {
-            hh = hb->hbmap[id][ia]->history[k];
+            hh = hbond->history[k];
             if (ihb == hbHB)
             {
                 hb->nhb[frame]++;
                 if (!(ISHB(hh)))
                 {
-                    hb->hbmap[id][ia]->history[k] = hh | 2;
+                    hbond->history[k] = hh | 2;
                     hb->nrhb++;
                 }
             }
@@ -1032,7 +1112,7 @@ static void add_hbond(t_hbdata *hb, int d, int a, int h, int grpd, int grpa,
                     hb->ndist[frame]++;
                     if (!(ISDIST(hh)))
                     {
-                        hb->hbmap[id][ia]->history[k] = hh | 1;
+                        hbond->history[k] = hh | 1;
                         hb->nrdist++;
                     }
                 }
@@ -1976,12 +2056,9 @@ static void do_merge(t_hbdata *hb, int ntmp,
             ptmp[mm] = pm;
         }
     }
-    /* Reallocate target array */
-    if (nnframes > hb0->maxframes)
-    {
-        srenew(hb0->h[0], 4+nnframes/hb->wordlen);
-        srenew(hb0->g[0], 4+nnframes/hb->wordlen);
-    }
+    /* Clear the target existence functions */
+    hb0->h[0]->nrun = 0;
+    hb0->g[0]->nrun = 0;
     if (NULL != hb->per->pHist)
     {
         clearPshift(&(hb->per->pHist[a1][a2]));
@@ -1990,8 +2067,14 @@ static void do_merge(t_hbdata *hb, int ntmp,
     /* Copy temp array to target array */
     for (m = 0; (m <= nnframes); m++)
     {
-        _set_hb(hb0->h[0], m, htmp[m]);
-        _set_hb(hb0->g[0], m, gtmp[m]);
+        if (htmp[m])
+        {
+            _set_hb(hb0->h[0], m);
+        }
+        if (gtmp[m])
+        {
+            _set_hb(hb0->g[0], m);
+        }
         if (hb->bGem)
         {
             addPshift(&(hb->per->pHist[a1][a2]), ptmp[m], m+nn0);
@@ -1999,8 +2082,7 @@ static void do_merge(t_hbdata *hb, int ntmp,
     }
 
     /* Set scalar variables */
-    hb0->n0        = nn0;
-    hb0->maxframes = nnframes;
+    hb0->n0 = nn0;
 }
 
 /* Added argument bContact for nicer output.
@@ -2008,7 +2090,7 @@ static void do_merge(t_hbdata *hb, int ntmp,
  */
 static void merge_hb(t_hbdata *hb, gmx_bool bTwo, gmx_bool bContact)
 {
-    int           i, inrnew, indnew, j, ii, jj, m, id, ia, grp, ogrp, ntmp;
+    int           i, inrnew, indnew, j, n, ii, jj, m, id, ia, grp, ogrp, ntmp;
     unsigned int *htmp, *gtmp;
     PSTYPE       *ptmp;
     t_hbond      *hb0, *hb1;
@@ -2028,15 +2110,16 @@ static void merge_hb(t_hbdata *hb, gmx_bool bTwo, gmx_bool bContact)
         fprintf(stderr, "\r%d/%d", i+1, hb->d.nrd);
         id = hb->d.don[i];
         ii = hb->a.aptr[id];
-        for (j = 0; (j < hb->a.nra); j++)
+        for (n = 0; (n < hb->hbmap[i].n); n++)
         {
+            j  = hb->hbmap[i].acc[n];
             ia = hb->a.acc[j];
             jj = hb->d.dptr[ia];
             if ((id != ia) && (ii != NOTSET) && (jj != NOTSET) &&
                 (!bTwo || (bTwo && (hb->d.grp[i] != hb->a.grp[j]))))
             {
-                hb0 = hb->hbmap[i][j];
-                hb1 = hb->hbmap[jj][ii];
+                hb0 = hb->hbmap[i].hb[n];
+                hb1 = get_hbond(hb, jj, ii);
                 if (hb0 && hb1 && ISHB(hb0->history[0]) && ISHB(hb1->history[0]))
                 {
                     do_merge(hb, ntmp, htmp, gtmp, ptmp, hb0, hb1, i, j);
@@ -2057,14 +2140,12 @@ static void merge_hb(t_hbdata *hb, gmx_bool bTwo, gmx_bool bContact)
                     {
                         gmx_incons("Neither hydrogen bond nor distance");
                     }
-                    sfree(hb1->h[0]);
-                    sfree(hb1->g[0]);
+                    done_hbexist(&hb1->h[0]);
+                    done_hbexist(&hb1->g[0]);
                     if (hb->bGem)
                     {
                         clearPshift(&(hb->per->pHist[jj][ii]));
                     }
-                    hb1->h[0]       = NULL;
-                    hb1->g[0]       = NULL;
                     hb1->history[0] = hbNo;
                 }
             }
@@ -2121,9 +2202,9 @@ static void do_hblife(const char *fn, t_hbdata *hb, gmx_bool bMerge, gmx_bool bC
     FILE          *fp;
     const char    *leg[] = { "p(t)", "t p(t)" };
     int           *histo;
-    int            i, j, j0, k, m, nh, ihb, ohb, nhydro, ndump = 0;
+    int            i, j, j0, n, m, nh, ihb, ohb, nhydro, ndump = 0;
     int            nframes = hb->nframes;
-    unsigned int **h;
+    t_hbexist    **h;
     real           t, x1, dt;
     double         sum, integral;
     t_hbond       *hbh;
@@ -2133,65 +2214,62 @@ static void do_hblife(const char *fn, t_hbdata *hb, gmx_bool bMerge, gmx_bool bC
     /* Total number of hbonds analyzed here */
     for (i = 0; (i < hb->d.nrd); i++)
     {
-        for (k = 0; (k < hb->a.nra); k++)
+        for (n = 0; (n < hb->hbmap[i].n); n++)
         {
-            hbh = hb->hbmap[i][k];
-            if (hbh)
+            hbh = hb->hbmap[i].hb[n];
+            if (bMerge)
             {
-                if (bMerge)
+                if (hbh->h[0])
                 {
-                    if (hbh->h[0])
-                    {
-                        h[0]   = hbh->h[0];
-                        nhydro = 1;
-                    }
-                    else
-                    {
-                        nhydro = 0;
-                    }
+                    h[0]   = hbh->h[0];
+                    nhydro = 1;
                 }
                 else
                 {
                     nhydro = 0;
-                    for (m = 0; (m < hb->maxhydro); m++)
+                }
+            }
+            else
+            {
+                nhydro = 0;
+                for (m = 0; (m < hb->maxhydro); m++)
+                {
+                    if (hbh->h[m])
                     {
-                        if (hbh->h[m])
-                        {
-                            h[nhydro++] = bContact ? hbh->g[m] : hbh->h[m];
-                        }
+                        h[nhydro++] = bContact ? hbh->g[m] : hbh->h[m];
                     }
                 }
-                for (nh = 0; (nh < nhydro); nh++)
+            }
+            for (nh = 0; (nh < nhydro); nh++)
+            {
+                ohb = 0;
+                j0  = 0;
+
+                /* Changed '<' into '<=' below, just like I
+                   did in the hbm-output-loop in the main code.
+                   - Erik Marklund, May 31, 2006
+                 */
+                for (j = 0; (j <= hbh->nframes); j++)
                 {
-                    ohb = 0;
-                    j0  = 0;
-
-                    /* Changed '<' into '<=' below, just like I
-                       did in the hbm-output-loop in the main code.
-                       - Erik Marklund, May 31, 2006
-                     */
-                    for (j = 0; (j <= hbh->nframes); j++)
+                    ihb      = is_hb(h[nh], j);
+                    if (debug && (ndump < 10))
                     {
-                        ihb      = is_hb(h[nh], j);
-                        if (debug && (ndump < 10))
+                        fprintf(debug, "%5d  %5d\n", j, ihb);
+                    }
+                    if (ihb != ohb)
+                    {
+                        if (ihb)
                         {
-                            fprintf(debug, "%5d  %5d\n", j, ihb);
+                            j0 = j;
                         }
-                        if (ihb != ohb)
+                        else
                         {
-                            if (ihb)
-                            {
-                                j0 = j;
-                            }
-                            else
-                            {
-                                histo[j-j0]++;
-                            }
-                            ohb = ihb;
+                            histo[j-j0]++;
                         }
+                        ohb = ihb;
                     }
-                    ndump++;
                 }
+                ndump++;
             }
         }
     }
@@ -2258,11 +2336,11 @@ static void dump_ac(t_hbdata *hb, gmx_bool oneHB, int nDump)
         fprintf(fp, "%10.3f", hb->time[j]);
         for (i = nd = 0; (i < hb->d.nrd) && (nd < nDump); i++)
         {
-            for (k = 0; (k < hb->a.nra) && (nd < nDump); k++)
+            for (k = 0; (k < hb->hbmap[i].n) && (nd < nDump); k++)
             {
                 bPrint = FALSE;
                 ihb    = idist = 0;
-                hbh    = hb->hbmap[i][k];
+                hbh    = hb->hbmap[i].hb[k];
                 if (oneHB)
                 {
                     if (hbh->h[0])
@@ -2741,11 +2819,11 @@ static void do_hbac(const char *fn, t_hbdata *hb,
     gmx_bool       bNorm = FALSE, bOMP = FALSE;
     double         nhb   = 0;
     int            nhbi  = 0;
-    real          *rhbex = NULL, *ht, *gt, *ght, *dght, *kt;
+    real          *rhbex = NULL, *ght, *kt;
     real          *ct, *p_ct, tail, tail2, dtail, ct_fac, ght_fac, *cct;
     const real     tol     = 1e-3;
     int            nframes = hb->nframes, nf;
-    unsigned int **h       = NULL, **g = NULL;
+    t_hbexist    **h       = NULL, **g = NULL;
     int            nh, nhbonds, nhydro, ngh;
     t_hbond       *hbh;
     PSTYPE         p, *pfound = NULL, np;
@@ -2755,7 +2833,7 @@ static void do_hbac(const char *fn, t_hbdata *hb,
     gmx_bool       c;
     int            acType;
     t_E           *E;
-    double        *ctdouble, *timedouble, *fittedct;
+    double        *ctdouble, *ghtdouble, *timedouble, *fittedct;
     double         fittolerance = 0.1;
     int           *dondata      = NULL, thisThread;
 
@@ -2988,7 +3066,7 @@ static void do_hbac(const char *fn, t_hbdata *hb,
 #endif
 
 #pragma omp parallel \
-            private(i, k, nh, hbh, pHist, h, g, n0, nf, np, j, m, \
+            private(i, k, n, nh, hbh, pHist, h, g, n0, nf, np, j, m, \
             pfound, poff, rHbExGem, p, ihb, mMax, \
             thisThread, p_ct) \
             default(shared)
@@ -3025,138 +3103,136 @@ static void do_hbac(const char *fn, t_hbdata *hb,
                     {
                         fprintf(stderr, "\r %i", i);
                     }
-                    for (k = 0; k < hb->a.nra; k++)
+                    for (n = 0; n < hb->hbmap[i].n; n++)
                     {
+                        k = hb->hbmap[i].acc[n];
                         for (nh = 0; nh < ((bMerge || bContact) ? 1 : hb->d.nhydro[i]); nh++)
                         {
-                            hbh = hb->hbmap[i][k];
-                            if (hbh)
+                            hbh = hb->hbmap[i].hb[n];
+                            /* Note that if hb->per->gemtype==gemDD, then distances will be stored in
+                             * the h array of the hbond anyway, because the contact flag will be set.
+                             * hence, it's only with the gemAD mode that the g array will be used. */
+                            pHist = &(hb->per->pHist[i][k]);
+                            if (ISHB(hbh->history[nh]) && pHist->len != 0)
                             {
-                                /* Note that if hb->per->gemtype==gemDD, then distances will be stored in
-                                 * hb->hbmap[d][a].h array anyway, because the contact flag will be set.
-                                 * hence, it's only with the gemAD mode that hb->hbmap[d][a].g will be used. */
-                                pHist = &(hb->per->pHist[i][k]);
-                                if (ISHB(hbh->history[nh]) && pHist->len != 0)
-                                {
 
+                                {
+                                    h[nh] = hbh->h[nh];
+                                    g[nh] = hb->per->gemtype == gemAD ? hbh->g[nh] : NULL;
+                                }
+                                n0 = hbh->n0;
+                                nf = hbh->nframes;
+                                /* count the number of periodic shifts encountered and store
+                                 * them in separate arrays. */
+                                np = 0;
+                                for (j = 0; j < pHist->len; j++)
+                                {
+                                    p = pHist->p[j];
+                                    for (m = 0; m <= np; m++)
                                     {
-                                        h[nh] = hbh->h[nh];
-                                        g[nh] = hb->per->gemtype == gemAD ? hbh->g[nh] : NULL;
-                                    }
-                                    n0 = hbh->n0;
-                                    nf = hbh->nframes;
-                                    /* count the number of periodic shifts encountered and store
-                                     * them in separate arrays. */
-                                    np = 0;
-                                    for (j = 0; j < pHist->len; j++)
-                                    {
-                                        p = pHist->p[j];
-                                        for (m = 0; m <= np; m++)
+                                        if (m == np) /* p not recognized in list. Add it and set up new array. */
                                         {
-                                            if (m == np) /* p not recognized in list. Add it and set up new array. */
+                                            np++;
+                                            if (np > hb->per->nper)
+                                            {
+                                                gmx_fatal(FARGS, "Too many pshifts. Something's utterly wrong here.");
+                                            }
+                                            if (m >= mMax) /* Extend the arrays.
+                                                            * Doing it like this, using mMax to keep track of the sizes,
+                                                            * eleviates the need for freeing and re-allocating the arrays
+                                                            * when taking on the next donor-acceptor pair */
+                                            {
+                                                mMax = m;
+                                                srenew(pfound, np);   /* The list of found periodic shifts. */
+                                                srenew(rHbExGem, np); /* The hb existence functions (-aver_hb). */
+                                                snew(rHbExGem[m], 2*n2);
+                                                srenew(poff, np);
+                                            }
+
                                             {
-                                                np++;
-                                                if (np > hb->per->nper)
+                                                if (rHbExGem != NULL && rHbExGem[m] != NULL)
                                                 {
-                                                    gmx_fatal(FARGS, "Too many pshifts. Something's utterly wrong here.");
+                                                    /* This must be done, as this array was most likey
+                                                     * used to store stuff in some previous iteration. */
+                                                    memset(rHbExGem[m], 0, (sizeof(real)) * (2*n2));
                                                 }
-                                                if (m >= mMax) /* Extend the arrays.
-                                                                * Doing it like this, using mMax to keep track of the sizes,
-                                                                * eleviates the need for freeing and re-allocating the arrays
-                                                                * when taking on the next donor-acceptor pair */
+                                                else
                                                 {
-                                                    mMax = m;
-                                                    srenew(pfound, np);   /* The list of found periodic shifts. */
-                                                    srenew(rHbExGem, np); /* The hb existence functions (-aver_hb). */
-                                                    snew(rHbExGem[m], 2*n2);
-                                                    srenew(poff, np);
+                                                    fprintf(stderr, "rHbExGem not initialized! m = %i\n", m);
                                                 }
+                                            }
+                                            pfound[m] = p;
+                                            poff[m]   = -1;
 
-                                                {
-                                                    if (rHbExGem != NULL && rHbExGem[m] != NULL)
-                                                    {
-                                                        /* This must be done, as this array was most likey
-                                                         * used to store stuff in some previous iteration. */
-                                                        memset(rHbExGem[m], 0, (sizeof(real)) * (2*n2));
-                                                    }
-                                                    else
-                                                    {
-                                                        fprintf(stderr, "rHbExGem not initialized! m = %i\n", m);
-                                                    }
-                                                }
-                                                pfound[m] = p;
-                                                poff[m]   = -1;
+                                            break;
+                                        } /* m==np */
+                                        if (p == pfound[m])
+                                        {
+                                            break;
+                                        }
+                                    } /* m: Loop over found shifts */
+                                }     /* j: Loop over shifts */
 
-                                                break;
-                                            } /* m==np */
-                                            if (p == pfound[m])
+                                /* Now unpack and disentangle the existence funtions. */
+                                for (j = 0; j < nf; j++)
+                                {
+                                    /* i:       donor,
+                                     * k:       acceptor
+                                     * nh:      hydrogen
+                                     * j:       time
+                                     * p:       periodic shift
+                                     * pfound:  list of periodic shifts found for this pair.
+                                     * poff:    list of frame offsets; that is, the first
+                                     *          frame a hbond has a particular periodic shift. */
+                                    p = getPshift(*pHist, j+n0);
+                                    if (p != -1)
+                                    {
+                                        for (m = 0; m < np; m++)
+                                        {
+                                            if (pfound[m] == p)
                                             {
                                                 break;
                                             }
-                                        } /* m: Loop over found shifts */
-                                    }     /* j: Loop over shifts */
+                                            if (m == (np-1))
+                                            {
+                                                gmx_fatal(FARGS, "Shift not found, but must be there.");
+                                            }
+                                        }
 
-                                    /* Now unpack and disentangle the existence funtions. */
-                                    for (j = 0; j < nf; j++)
-                                    {
-                                        /* i:       donor,
-                                         * k:       acceptor
-                                         * nh:      hydrogen
-                                         * j:       time
-                                         * p:       periodic shift
-                                         * pfound:  list of periodic shifts found for this pair.
-                                         * poff:    list of frame offsets; that is, the first
-                                         *          frame a hbond has a particular periodic shift. */
-                                        p = getPshift(*pHist, j+n0);
-                                        if (p != -1)
+                                        ihb = is_hb(h[nh], j) || ((hb->per->gemtype != gemAD || j == 0) ? FALSE : is_hb(g[nh], j));
+                                        if (ihb)
                                         {
-                                            for (m = 0; m < np; m++)
+                                            if (poff[m] == -1)
                                             {
-                                                if (pfound[m] == p)
-                                                {
-                                                    break;
-                                                }
-                                                if (m == (np-1))
-                                                {
-                                                    gmx_fatal(FARGS, "Shift not found, but must be there.");
-                                                }
+                                                poff[m] = j; /* Here's where the first hbond with shift p is,
+                                                              * relative to the start of h[0].*/
                                             }
-
-                                            ihb = is_hb(h[nh], j) || ((hb->per->gemtype != gemAD || j == 0) ? FALSE : is_hb(g[nh], j));
-                                            if (ihb)
+                                            if (j < poff[m])
                                             {
-                                                if (poff[m] == -1)
-                                                {
-                                                    poff[m] = j; /* Here's where the first hbond with shift p is,
-                                                                  * relative to the start of h[0].*/
-                                                }
-                                                if (j < poff[m])
-                                                {
-                                                    gmx_fatal(FARGS, "j<poff[m]");
-                                                }
-                                                rHbExGem[m][j-poff[m]] += 1;
+                                                gmx_fatal(FARGS, "j<poff[m]");
                                             }
+                                            rHbExGem[m][j-poff[m]] += 1;
                                         }
                                     }
+                                }
 
-                                    /* Now, build ac. */
-                                    for (m = 0; m < np; m++)
+                                /* Now, build ac. */
+                                for (m = 0; m < np; m++)
+                                {
+                                    if (rHbExGem[m][0] > 0  && n0+poff[m] < nn /*  && m==0 */)
                                     {
-                                        if (rHbExGem[m][0] > 0  && n0+poff[m] < nn /*  && m==0 */)
+                                        low_do_autocorr(NULL, oenv, NULL, nframes, 1, -1, &(rHbExGem[m]), hb->time[1]-hb->time[0],
+                                                        eacNormal, 1, FALSE, bNorm, FALSE, 0, -1, 0);
+                                        for (j = 0; (j < nn); j++)
                                         {
-                                            low_do_autocorr(NULL, oenv, NULL, nframes, 1, -1, &(rHbExGem[m]), hb->time[1]-hb->time[0],
-                                                            eacNormal, 1, FALSE, bNorm, FALSE, 0, -1, 0);
-                                            for (j = 0; (j < nn); j++)
-                                            {
-                                                __ACDATA[j] += rHbExGem[m][j];
-                                            }
+                                            __ACDATA[j] += rHbExGem[m][j];
                                         }
-                                    } /* Building of ac. */
-                                }     /* if (ISHB(...*/
-                            }         /* if (hbh) */
-                        }             /* hydrogen loop */
-                    }                 /* acceptor loop */
-                }                     /* donor loop */
+                                    }
+                                } /* Building of ac. */
+                            }     /* if (ISHB(...*/
+                        }         /* hydrogen loop */
+                    }             /* acceptor loop */
+                }                 /* donor loop */
 
                 for (m = 0; m <= mMax; m++)
                 {
@@ -3258,31 +3334,57 @@ static void do_hbac(const char *fn, t_hbdata *hb,
             break; /* case AC_GEM */
 
         case AC_LUZAR:
-            snew(rhbex, 2*n2);
             snew(ct, 2*n2);
-            snew(gt, 2*n2);
-            snew(ht, 2*n2);
             snew(ght, 2*n2);
-            snew(dght, 2*n2);
 
             snew(kt, nn);
             snew(cct, nn);
+            /* The sums run over many hbonds, so we accumulate in double */
+            snew(ctdouble, nn);
+            snew(ghtdouble, nn);
 
-            for (i = 0; (i < hb->d.nrd); i++)
+            /* The hbonds are independent, so we divide the donors over
+             * the threads. The time series of each hbond are generated
+             * from the existence maps when needed, so the memory usage
+             * does not grow with the number of hbonds.
+             */
+            nThreads = min((nThreads <= 0) ? INT_MAX : nThreads, gmx_omp_get_max_threads());
+#pragma omp parallel num_threads(nThreads) private(j, n, m, nh, nhydro, hbh, nf, ihb, idist)
             {
-                for (k = 0; (k < hb->a.nra); k++)
-                {
-                    nhydro = 0;
-                    hbh    = hb->hbmap[i][k];
+                gmx_acf_work_t  work;
+                t_hbexist     **h_t, **g_t;
+                real           *rhbex_t, *ht_t, *gt_t, *dght_t;
+                double         *ct_t, *ght_t, nhb_t;
+                int             d;
+
+                work = init_acf_work(nframes, eacNormal);
+                snew(h_t, hb->maxhydro);
+                snew(g_t, hb->maxhydro);
+                snew(rhbex_t, 2*n2);
+                snew(ht_t, 2*n2);
+                snew(gt_t, 2*n2);
+                snew(dght_t, 2*n2);
+                snew(ct_t, nn);
+                snew(ght_t, nn);
+                nhb_t = 0;
 
-                    if (hbh)
+#pragma omp for schedule(dynamic)
+                for (d = 0; d < hb->d.nrd; d++)
+                {
+                    if (gmx_omp_get_thread_num() == 0 && ((d+1) % 10 == 0 || d+1 == hb->d.nrd))
                     {
+                        fprintf(stderr, "\rACF donor %d/%d", d+1, hb->d.nrd);
+                    }
+                    for (n = 0; (n < hb->hbmap[d].n); n++)
+                    {
+                        nhydro = 0;
+                        hbh    = hb->hbmap[d].hb[n];
                         if (bMerge || bContact)
                         {
                             if (ISHB(hbh->history[0]))
                             {
-                                h[0]   = hbh->h[0];
-                                g[0]   = hbh->g[0];
+                                h_t[0] = hbh->h[0];
+                                g_t[0] = hbh->g[0];
                                 nhydro = 1;
                             }
                         }
@@ -3292,8 +3394,8 @@ static void do_hbac(const char *fn, t_hbdata *hb,
                             {
                                 if (bContact ? ISDIST(hbh->history[m]) : ISHB(hbh->history[m]))
                                 {
-                                    g[nhydro] = hbh->g[m];
-                                    h[nhydro] = hbh->h[m];
+                                    g_t[nhydro] = hbh->g[m];
+                                    h_t[nhydro] = hbh->h[m];
                                     nhydro++;
                                 }
                             }
@@ -3302,12 +3404,6 @@ static void do_hbac(const char *fn, t_hbdata *hb,
                         nf = hbh->nframes;
                         for (nh = 0; (nh < nhydro); nh++)
                         {
-                            int nrint = bContact ? hb->nrdist : hb->nrhb;
-                            if ((((nhbonds+1) % 10) == 0) || (nhbonds+1 == nrint))
-                            {
-                                fprintf(stderr, "\rACF %d/%d", nhbonds+1, nrint);
-                            }
-                            nhbonds++;
                             for (j = 0; (j < nframes); j++)
                             {
                                 /* Changed '<' into '<=' below, just like I did in
@@ -3315,54 +3411,79 @@ static void do_hbac(const char *fn, t_hbdata *hb,
                                    - Erik Marklund, May 31, 2006 */
                                 if (j <= nf)
                                 {
-                                    ihb   = is_hb(h[nh], j);
-                                    idist = is_hb(g[nh], j);
+                                    ihb   = is_hb(h_t[nh], j);
+                                    idist = is_hb(g_t[nh], j);
                                 }
                                 else
                                 {
                                     ihb = idist = 0;
                                 }
-                                rhbex[j] = ihb;
+                                rhbex_t[j] = ihb;
                                 /* For contacts: if a second cut-off is provided, use it,
                                  * otherwise use g(t) = 1-h(t) */
                                 if (!R2 && bContact)
                                 {
-                                    gt[j]  = 1-ihb;
+                                    gt_t[j]  = 1-ihb;
                                 }
                                 else
                                 {
-                                    gt[j]  = idist*(1-ihb);
+                                    gt_t[j]  = idist*(1-ihb);
                                 }
-                                ht[j]    = rhbex[j];
-                                nhb     += ihb;
+                                ht_t[j]  = rhbex_t[j];
+                                nhb_t   += ihb;
                             }
 
-
                             /* The autocorrelation function is normalized after summation only */
-                            low_do_autocorr(NULL, oenv, NULL, nframes, 1, -1, &rhbex, hb->time[1]-hb->time[0],
-                                            eacNormal, 1, FALSE, bNorm, FALSE, 0, -1, 0);
+                            calc_acf_item(work, eacNormal, nframes, nn, 1, rhbex_t);
 
                             /* Cross correlation analysis for thermodynamics */
                             for (j = nframes; (j < n2); j++)
                             {
-                                ht[j] = 0;
-                                gt[j] = 0;
+                                ht_t[j] = 0;
+                                gt_t[j] = 0;
                             }
 
-                            cross_corr(n2, ht, gt, dght);
+                            calc_cross_corr(work, n2, ht_t, gt_t, dght_t);
 
                             for (j = 0; (j < nn); j++)
                             {
-                                ct[j]  += rhbex[j];
-                                ght[j] += dght[j];
+                                ct_t[j]  += rhbex_t[j];
+                                ght_t[j] += dght_t[j];
                             }
                         }
                     }
                 }
+
+#pragma omp critical
+                {
+                    for (j = 0; (j < nn); j++)
+                    {
+                        ctdouble[j]  += ct_t[j];
+                        ghtdouble[j] += ght_t[j];
+                    }
+                    nhb += nhb_t;
+                }
+
+                sfree(ght_t);
+                sfree(ct_t);
+                sfree(dght_t);
+                sfree(gt_t);
+                sfree(ht_t);
+                sfree(rhbex_t);
+                sfree(g_t);
+                sfree(h_t);
+                done_acf_work(work);
             }
             fprintf(stderr, "\n");
             sfree(h);
             sfree(g);
+            for (j = 0; (j < nn); j++)
+            {
+                ct[j]  = ctdouble[j];
+                ght[j] = ghtdouble[j];
+            }
+            sfree(ghtdouble);
+            sfree(ctdouble);
             normalizeACF(ct, ght, nhb, nn);
 
             /* Determine tail value for statistics */
@@ -3420,12 +3541,8 @@ static void do_hbac(const char *fn, t_hbdata *hb,
                          fit_start, temp, smooth_tail_start, oenv);
 
             do_view(oenv, fn, NULL);
-            sfree(rhbex);
             sfree(ct);
-            sfree(gt);
-            sfree(ht);
             sfree(ght);
-            sfree(dght);
             sfree(cct);
             sfree(kt);
             /* sfree(h); */
@@ -3440,7 +3557,7 @@ static void do_hbac(const char *fn, t_hbdata *hb,
 
 static void init_hbframe(t_hbdata *hb, int nframes, real t)
 {
-    int i, j, m;
+    int i;
 
     hb->time[nframes]   = t;
     hb->nhb[nframes]    = 0;
@@ -3449,24 +3566,6 @@ static void init_hbframe(t_hbdata *hb, int nframes, real t)
     {
         hb->nhx[nframes][i] = 0;
     }
-    /* Loop invalidated */
-    if (hb->bHBmap && 0)
-    {
-        for (i = 0; (i < hb->d.nrd); i++)
-        {
-            for (j = 0; (j < hb->a.nra); j++)
-            {
-                for (m = 0; (m < hb->maxhydro); m++)
-                {
-                    if (hb->hbmap[i][j] && hb->hbmap[i][j]->h[m])
-                    {
-                        set_hb(hb, i, m, j, nframes, HB_NO);
-                    }
-                }
-            }
-        }
-    }
-    /*set_hb(hb->hbmap[i][j]->h[m],nframes-hb->hbmap[i][j]->n0,HB_NO);*/
 }
 
 static void analyse_donor_props(const char *fn, t_hbdata *hb, int nframes, real t,
@@ -3474,7 +3573,8 @@ static void analyse_donor_props(const char *fn, t_hbdata *hb, int nframes, real
 {
     static FILE *fp    = NULL;
     const char  *leg[] = { "Nbound", "Nfree" };
-    int          i, j, k, nbound, nb, nhtot;
+    int          i, n, k, nbound, nb, nhtot;
+    t_hbond     *hbh;
 
     if (!fn)
     {
@@ -3493,10 +3593,10 @@ static void analyse_donor_props(const char *fn, t_hbdata *hb, int nframes, real
         {
             nb = 0;
             nhtot++;
-            for (j = 0; (j < hb->a.nra) && (nb == 0); j++)
+            for (n = 0; (n < hb->hbmap[i].n) && (nb == 0); n++)
             {
-                if (hb->hbmap[i][j] && hb->hbmap[i][j]->h[k] &&
-                    is_hb(hb->hbmap[i][j]->h[k], nframes))
+                hbh = hb->hbmap[i].hb[n];
+                if (hbh->h[k] && is_hb(hbh->h[k], nframes - hbh->n0))
                 {
                     nb = 1;
                 }
@@ -3513,7 +3613,7 @@ static void dump_hbmap(t_hbdata *hb,
                        t_atoms *atoms)
 {
     FILE    *fp, *fplog;
-    int      ddd, hhh, aaa, i, j, k, m, grp;
+    int      ddd, hhh, aaa, i, j, k, n, m, grp;
     char     ds[32], hs[32], as[32];
     gmx_bool first;
 
@@ -3582,12 +3682,12 @@ static void dump_hbmap(t_hbdata *hb,
     for (i = 0; (i < hb->d.nrd); i++)
     {
         ddd = hb->d.don[i];
-        for (k = 0; (k < hb->a.nra); k++)
+        for (n = 0; (n < hb->hbmap[i].n); n++)
         {
-            aaa = hb->a.acc[k];
+            aaa = hb->a.acc[hb->hbmap[i].acc[n]];
             for (m = 0; (m < hb->d.nhydro[i]); m++)
             {
-                if (hb->hbmap[i][k] && ISHB(hb->hbmap[i][k]->history[m]))
+                if (ISHB(hb->hbmap[i].hb[n]->history[m]))
                 {
                     sprintf(ds, "%s", mkatomname(atoms, ddd));
                     sprintf(as, "%s", mkatomname(atoms, aaa));
@@ -4233,7 +4333,6 @@ int gmx_hbond(int argc, char *argv[])
             p_hb[i]->bHBmap     = hb->bHBmap;
             p_hb[i]->bDAnr      = hb->bDAnr;
             p_hb[i]->bGem       = hb->bGem;
-            p_hb[i]->wordlen    = hb->wordlen;
             p_hb[i]->nframes    = hb->nframes;
             p_hb[i]->maxhydro   = hb->maxhydro;
             p_hb[i]->danr       = hb->danr;
@@ -4769,7 +4868,8 @@ int gmx_hbond(int argc, char *argv[])
         if (opt2bSet("-hbm", NFILE, fnm))
         {
             t_matrix mat;
-            int      id, ia, hh, x, y;
+            t_hbond *hbh;
+            int      id, n, hh, x, y;
 
             if ((nframes > 0) && (hb->nrhb > 0))
             {
@@ -4784,29 +4884,27 @@ int gmx_hbond(int argc, char *argv[])
                 y = 0;
                 for (id = 0; (id < hb->d.nrd); id++)
                 {
-                    for (ia = 0; (ia < hb->a.nra); ia++)
+                    for (n = 0; (n < hb->hbmap[id].n); n++)
                     {
+                        hbh = hb->hbmap[id].hb[n];
                         for (hh = 0; (hh < hb->maxhydro); hh++)
                         {
-                            if (hb->hbmap[id][ia])
+                            if (ISHB(hbh->history[hh]))
                             {
-                                if (ISHB(hb->hbmap[id][ia]->history[hh]))
+                                /* Changed '<' into '<=' in the for-statement below.
+                                 * It fixed the previously undiscovered bug that caused
+                                 * the last occurance of an hbond/contact to not be
+                                 * set in mat.matrix. Have a look at any old -hbm-output
+                                 * and you will notice that the last column is allways empty.
+                                 * - Erik Marklund May 30, 2006
+                                 */
+                                for (x = 0; (x <= hbh->nframes); x++)
                                 {
-                                    /* Changed '<' into '<=' in the for-statement below.
-                                     * It fixed the previously undiscovered bug that caused
-                                     * the last occurance of an hbond/contact to not be
-                                     * set in mat.matrix. Have a look at any old -hbm-output
-                                     * and you will notice that the last column is allways empty.
-                                     * - Erik Marklund May 30, 2006
-                                     */
-                                    for (x = 0; (x <= hb->hbmap[id][ia]->nframes); x++)
-                                    {
-                                        int nn0 = hb->hbmap[id][ia]->n0;
-                                        range_check(y, 0, mat.ny);
-                                        mat.matrix[x+nn0][y] = is_hb(hb->hbmap[id][ia]->h[hh], x);
-                                    }
-                                    y++;
+                                    int nn0 = hbh->n0;
+                                    range_check(y, 0, mat.ny);
+                                    mat.matrix[x+nn0][y] = is_hb(hbh->h[hh], x);
                                 }
+                                y++;
                             }
                         }
                     }
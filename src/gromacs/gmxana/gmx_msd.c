@@ -56,6 +56,8 @@
 #include "pbc.h"
 #include "vec.h"
 #include "gromacs/fileio/confio.h"
+#include "gromacs/fft/fft.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gmx_ana.h"
 
 
@@ -94,6 +96,14 @@ typedef struct {
     int          *n_offs;
     int         **ndata;      /* the number of msds (particles/mols) per data
                                  point. */
+    gmx_bool      bFFT;       /* use all frames as time origins, using FFTs */
+    rvec       ***xfr;        /* with bFFT: the coordinates of a block of
+                                 atoms of each group for each frame */
+    int           fft_a0;     /* with bFFT: the first atom of the block */
+    int           fft_nat;    /* with bFFT: the number of atoms per block */
+    real          fft_maxmem; /* with bFFT: the memory limit for xfr in bytes */
+    double      **fft_spec;   /* with bFFT: the summed spectra per group */
+    double      **fft_sq;     /* with bFFT: the summed squared coordinates */
 } t_corr;
 
 typedef real t_calc_func (t_corr *curr, int nx, atom_id index[], int nx0, rvec xc[],
@@ -110,7 +120,8 @@ static gmx_bool in_data(t_corr *curr, int nx00)
 }
 
 t_corr *init_corr(int nrgrp, int type, int axis, real dim_factor,
-                  int nmol, gmx_bool bTen, gmx_bool bMass, real dt, t_topology *top,
+                  int nmol, gmx_bool bTen, gmx_bool bMass, gmx_bool bFFT,
+                  real fft_maxmem, real dt, t_topology *top,
                   real beginfit, real endfit)
 {
     t_corr  *curr;
@@ -130,8 +141,18 @@ t_corr *init_corr(int nrgrp, int type, int axis, real dim_factor,
     curr->nframes    = 0;
     curr->nlast      = 0;
     curr->dim_factor = dim_factor;
+    curr->bFFT       = bFFT;
 
     snew(curr->ndata, nrgrp);
+    if (bFFT)
+    {
+        snew(curr->xfr, nrgrp);
+        snew(curr->fft_spec, nrgrp);
+        snew(curr->fft_sq, nrgrp);
+        curr->fft_a0     = 0;
+        curr->fft_nat    = 0;
+        curr->fft_maxmem = fft_maxmem;
+    }
     snew(curr->data, nrgrp);
     if (bTen)
     {
@@ -185,8 +206,16 @@ static void corr_print(t_corr *curr, gmx_bool bTen, const char *fn, const char *
     out = xvgropen(fn, title, output_env_get_xvgr_tlabel(oenv), yaxis, oenv);
     if (DD)
     {
-        fprintf(out, "# MSD gathered over %g %s with %d restarts\n",
-                msdtime, output_env_get_time_unit(oenv), curr->nrestart);
+        if (curr->bFFT)
+        {
+            fprintf(out, "# MSD gathered over %g %s with all %d frames as time origins\n",
+                    msdtime, output_env_get_time_unit(oenv), curr->nframes);
+        }
+        else
+        {
+            fprintf(out, "# MSD gathered over %g %s with %d restarts\n",
+                    msdtime, output_env_get_time_unit(oenv), curr->nrestart);
+        }
         fprintf(out, "# Diffusion constants fitted from time %g to %g %s\n",
                 beginfit, endfit, output_env_get_time_unit(oenv));
         for (i = 0; i < curr->ngrp; i++)
@@ -546,6 +575,429 @@ static real calc1_mol(t_corr *curr, int nx, atom_id gmx_unused index[], int nx0,
     return gtot/nx;
 }
 
+/* The maximum number of reals in the FFT buffer of each thread,
+ * this limits the number of atoms that are transformed as one block.
+ */
+#define MSD_FFT_BUFSIZE (1<<22)
+
+/* with bFFT, called from corr_loop to store the coordinates of the current
+ * block of atoms of a group for frame f
+ */
+static void store_frame_fft(t_corr *curr, int nr, int f, int nx, atom_id index[],
+                            gmx_bool bMol, rvec xc[], gmx_bool bRmCOMM, rvec com)
+{
+    rvec *xs;
+    int   i, i0, i1;
+
+    i0 = min(curr->fft_a0, nx);
+    i1 = min(curr->fft_a0 + curr->fft_nat, nx);
+    snew(curr->xfr[nr][f], i1 - i0);
+    xs = curr->xfr[nr][f];
+    for (i = i0; (i < i1); i++)
+    {
+        copy_rvec(xc[bMol ? i : index[i]], xs[i - i0]);
+        if (bRmCOMM)
+        {
+            rvec_dec(xs[i - i0], com);
+        }
+    }
+}
+
+/* with bFFT, reduces the number of atoms per block, and the stored
+ * coordinates, as long as the stored coordinates for the frames read
+ * so far and the next frame would use more memory than allowed
+ */
+static void limit_fft_memory(t_corr *curr, int gnx[])
+{
+    int nat, g, f;
+
+    nat = curr->fft_nat;
+    while (nat > 1 &&
+           (double)curr->ngrp*nat*(curr->nframes + 2)*sizeof(rvec) > curr->fft_maxmem)
+    {
+        nat = (nat + 1)/2;
+    }
+    if (nat < curr->fft_nat)
+    {
+        if (debug)
+        {
+            fprintf(debug, "Reducing the MSD FFT block to %d atoms\n", nat);
+        }
+        curr->fft_nat = nat;
+        for (g = 0; g < curr->ngrp; g++)
+        {
+            for (f = 0; f <= curr->nframes; f++)
+            {
+                srenew(curr->xfr[g][f], min(nat, gnx[g]));
+            }
+        }
+    }
+}
+
+/* Returns the smallest even number >= n with only prime factors 2, 3 and 5 */
+static int msd_fft_size(int n)
+{
+    int m, r;
+
+    for (m = n + (n % 2); ; m += 2)
+    {
+        r = m;
+        while (r % 2 == 0)
+        {
+            r /= 2;
+        }
+        while (r % 3 == 0)
+        {
+            r /= 3;
+        }
+        while (r % 5 == 0)
+        {
+            r /= 5;
+        }
+        if (r == 1)
+        {
+            return m;
+        }
+    }
+}
+
+/* Sets up the coordinate products to correlate, the diagonal ones first,
+ * returns the number of products and sets the number of diagonal products.
+ */
+static int msd_fft_components(t_corr *curr, gmx_bool bTen,
+                              int comp[2*DIM][2], int *ndiag)
+{
+    int ncomp, c, d;
+
+    ncomp = 0;
+    for (d = 0; d < DIM; d++)
+    {
+        if ((curr->type == NORMAL) ||
+            (curr->type == LATERAL && d != curr->axis) ||
+            (curr->type >= X && curr->type <= Z && d == curr->type - X))
+        {
+            comp[ncomp][0] = d;
+            comp[ncomp][1] = d;
+            ncomp++;
+        }
+    }
+    *ndiag = ncomp;
+    if (bTen)
+    {
+        for (d = 1; d < DIM; d++)
+        {
+            for (c = 0; c < d; c++)
+            {
+                comp[ncomp][0] = d;
+                comp[ncomp][1] = c;
+                ncomp++;
+            }
+        }
+    }
+
+    return ncomp;
+}
+
+/* Returns the summed squared displacements over all time origins for
+ * lag m, using the running sum q of the squared coordinates sq.
+ * corr is the correlation function of the coordinates times nfft.
+ */
+static double msd_sum_lag(int m, int nframes, const double *sq, double *q,
+                          const real *corr, int nfft)
+{
+    if (m == 0)
+    {
+        /* Avoid returning rounding errors where we know the result */
+        return 0;
+    }
+    *q -= sq[m-1] + sq[nframes-m];
+
+    return *q - corr[m]/nfft;
+}
+
+/* with bFFT, sums the contributions of the stored block of atoms of
+ * group nr to the MSD averaged over all time origins.
+ * The MSD at lag m is the average of |x(t+m)|^2 + |x(t)|^2 - 2 x(t).x(t+m),
+ * the last term is obtained for all lags at once from the power spectrum
+ * of the coordinates. The atoms are processed in smaller blocks, which
+ * are distributed over the OpenMP threads, and only the summed spectra
+ * are stored. The stored coordinates are freed.
+ */
+static void sum_corr_fft(t_corr *curr, int nr, int nx, atom_id index[],
+                         gmx_bool bMol, gmx_bool bTen)
+{
+    int        nframes, nfft, nh, ncomp, ndiag, a0, a1, nb, nblock, i, c, d, f, k, m;
+    int        comp[2*DIM][2];
+    gmx_bool   bDim[DIM];
+    double     wtot, q, msd, *spec, *sq;
+
+    nframes = curr->nframes;
+    nfft    = msd_fft_size(2*nframes);
+    nh      = nfft/2 + 1;
+
+    ncomp = msd_fft_components(curr, bTen, comp, &ndiag);
+    for (d = 0; d < DIM; d++)
+    {
+        bDim[d] = FALSE;
+    }
+    for (c = 0; c < ndiag; c++)
+    {
+        bDim[comp[c][0]] = TRUE;
+    }
+
+    wtot = 0;
+    for (i = 0; (i < nx); i++)
+    {
+        wtot += curr->mass ? curr->mass[bMol ? i : index[i]] : 1;
+    }
+
+    if (curr->fft_spec[nr] == NULL)
+    {
+        snew(curr->fft_spec[nr], ncomp*nh);
+        snew(curr->fft_sq[nr], ncomp*nframes);
+    }
+    spec = curr->fft_spec[nr];
+    sq   = curr->fft_sq[nr];
+
+    a0     = min(curr->fft_a0, nx);
+    a1     = min(curr->fft_a0 + curr->fft_nat, nx);
+    nb     = max(1, min(a1 - a0, MSD_FFT_BUFSIZE/(DIM*(nfft + 2))));
+    nblock = (a1 - a0 + nb - 1)/nb;
+
+#pragma omp parallel private(i, c, d, f, k, m, q, msd)
+    {
+        gmx_fft_t  fft_t;
+        real      *buf_t, *y[DIM], *work;
+        double    *spec_t, *sq_t, *sqm, w, xav, tt;
+        int        b, i0, i1, status;
+
+        if ((status = gmx_fft_init_1d_real(&fft_t, nfft, GMX_FFT_FLAG_NONE)) != 0)
+        {
+            gmx_fatal(FARGS, "Invalid fft return status %d", status);
+        }
+        snew(buf_t, nb*DIM*(nfft + 2));
+        snew(spec_t, ncomp*nh);
+        snew(sq_t, ncomp*nframes);
+        work = NULL;
+        sqm  = NULL;
+        if (bMol)
+        {
+            snew(work, nfft + 2);
+            snew(sqm, nframes);
+        }
+
+#pragma omp for schedule(dynamic)
+        for (b = 0; b < nblock; b++)
+        {
+            i0 = a0 + b*nb;
+            i1 = min(i0 + nb, a1);
+
+            /* Gather the coordinates of this block of atoms per dimension */
+            for (f = 0; f < nframes; f++)
+            {
+                for (i = i0; i < i1; i++)
+                {
+                    for (d = 0; d < DIM; d++)
+                    {
+                        buf_t[((i - i0)*DIM + d)*(nfft + 2) + f] = curr->xfr[nr][f][i - a0][d];
+                    }
+                }
+            }
+
+            for (i = i0; i < i1; i++)
+            {
+                w = (curr->mass ? curr->mass[bMol ? i : index[i]] : 1)/wtot;
+
+                /* Subtract the average position to reduce rounding errors,
+                 * the displacements do not change, and pad with zeros.
+                 */
+                for (d = 0; d < DIM; d++)
+                {
+                    y[d] = buf_t + ((i - i0)*DIM + d)*(nfft + 2);
+                    xav  = 0;
+                    for (f = 0; f < nframes; f++)
+                    {
+                        xav += y[d][f];
+                    }
+                    xav /= nframes;
+                    for (f = 0; f < nframes; f++)
+                    {
+                        y[d][f] -= xav;
+                    }
+                    for (; f < nfft + 2; f++)
+                    {
+                        y[d][f] = 0;
+                    }
+                }
+
+                for (c = 0; c < ncomp; c++)
+                {
+                    for (f = 0; f < nframes; f++)
+                    {
+                        sq_t[c*nframes + f] += w*y[comp[c][0]][f]*y[comp[c][1]][f];
+                    }
+                }
+                if (bMol)
+                {
+                    for (f = 0; f < nframes; f++)
+                    {
+                        sqm[f] = 0;
+                        for (c = 0; c < ndiag; c++)
+                        {
+                            sqm[f] += y[comp[c][0]][f]*y[comp[c][0]][f];
+                        }
+                    }
+                }
+
+                for (d = 0; d < DIM; d++)
+                {
+                    if (bDim[d])
+                    {
+                        gmx_fft_1d_real(fft_t, GMX_FFT_REAL_TO_COMPLEX, y[d], y[d]);
+                    }
+                }
+
+                /* Sum the spectra of x_a(t).x_b(t+m) + x_b(t).x_a(t+m) */
+                for (c = 0; c < ncomp; c++)
+                {
+                    for (k = 0; k < nh; k++)
+                    {
+                        spec_t[c*nh + k] += 2*w*(y[comp[c][0]][2*k]*y[comp[c][1]][2*k] +
+                                                 y[comp[c][0]][2*k+1]*y[comp[c][1]][2*k+1]);
+                    }
+                }
+
+                if (bMol)
+                {
+                    /* Fit the MSD of this molecule for the diffusion constant */
+                    for (k = 0; k < nh; k++)
+                    {
+                        work[2*k]   = 0;
+                        work[2*k+1] = 0;
+                        for (c = 0; c < ndiag; c++)
+                        {
+                            work[2*k] += 2*(sqr(y[comp[c][0]][2*k]) + sqr(y[comp[c][0]][2*k+1]));
+                        }
+                    }
+                    gmx_fft_1d_real(fft_t, GMX_FFT_COMPLEX_TO_REAL, work, work);
+                    q = 0;
+                    for (f = 0; f < nframes; f++)
+                    {
+                        q += 2*sqm[f];
+                    }
+                    for (m = 0; m < nframes; m++)
+                    {
+                        msd = msd_sum_lag(m, nframes, sqm, &q, work, nfft);
+                        tt  = curr->time[m];
+                        if (tt >= curr->beginfit && (curr->endfit < 0 || tt <= curr->endfit))
+                        {
+                            /* Weight with the number of origins, as a fit
+                             * through the points of all origins would do.
+                             */
+                            gmx_stats_add_point(curr->lsq[0][i], tt, msd/(nframes - m),
+                                                0, 1/sqrt(nframes - m));
+                        }
+                    }
+                }
+            }
+        }
+
+#pragma omp critical
+        {
+            for (k = 0; k < ncomp*nh; k++)
+            {
+                spec[k] += spec_t[k];
+            }
+            for (f = 0; f < ncomp*nframes; f++)
+            {
+                sq[f] += sq_t[f];
+            }
+        }
+
+        sfree(sqm);
+        sfree(work);
+        sfree(sq_t);
+        sfree(spec_t);
+        sfree(buf_t);
+        gmx_fft_destroy(fft_t);
+    }
+
+    for (f = 0; f < nframes; f++)
+    {
+        sfree(curr->xfr[nr][f]);
+        curr->xfr[nr][f] = NULL;
+    }
+}
+
+/* with bFFT, computes the MSD of group nr from the spectra summed
+ * over all blocks of atoms by sum_corr_fft
+ */
+static void finish_corr_fft(t_corr *curr, int nr, gmx_bool bTen)
+{
+    int        nframes, nfft, nh, ncomp, ndiag, c, f, k, m;
+    int        comp[2*DIM][2];
+    double     q, msd, *spec, *sq;
+    real      *buf;
+    gmx_fft_t  fft;
+
+    nframes = curr->nframes;
+    nfft    = msd_fft_size(2*nframes);
+    nh      = nfft/2 + 1;
+    ncomp   = msd_fft_components(curr, bTen, comp, &ndiag);
+    spec    = curr->fft_spec[nr];
+    sq      = curr->fft_sq[nr];
+
+    /* Transform the summed spectra back to the correlation functions */
+    if (gmx_fft_init_1d_real(&fft, nfft, GMX_FFT_FLAG_NONE) != 0)
+    {
+        gmx_fatal(FARGS, "Could not set up an FFT of length %d", nfft);
+    }
+    snew(buf, nfft + 2);
+    for (m = 0; m < nframes; m++)
+    {
+        curr->data[nr][m]  = 0;
+        curr->ndata[nr][m] = nframes - m;
+        if (bTen)
+        {
+            clear_mat(curr->datam[nr][m]);
+        }
+    }
+    for (c = 0; c < ncomp; c++)
+    {
+        for (k = 0; k < nh; k++)
+        {
+            buf[2*k]   = spec[c*nh + k];
+            buf[2*k+1] = 0;
+        }
+        gmx_fft_1d_real(fft, GMX_FFT_COMPLEX_TO_REAL, buf, buf);
+        q = 0;
+        for (f = 0; f < nframes; f++)
+        {
+            q += 2*sq[c*nframes + f];
+        }
+        for (m = 0; m < nframes; m++)
+        {
+            msd = msd_sum_lag(m, nframes, sq + c*nframes, &q, buf, nfft);
+            if (c < ndiag)
+            {
+                curr->data[nr][m] += msd;
+            }
+            if (bTen)
+            {
+                curr->datam[nr][m][comp[c][0]][comp[c][1]] += msd;
+            }
+        }
+    }
+    sfree(buf);
+    gmx_fft_destroy(fft);
+    sfree(curr->fft_sq[nr]);
+    sfree(curr->fft_spec[nr]);
+    curr->fft_sq[nr]   = NULL;
+    curr->fft_spec[nr] = NULL;
+    sfree(curr->xfr[nr]);
+    curr->xfr[nr] = NULL;
+}
+
 void printmol(t_corr *curr, const char *fn,
               const char *fn_pdb, int *molindex, t_topology *top,
               rvec *x, int ePBC, matrix box, const output_env_t oenv)
@@ -553,7 +1005,7 @@ void printmol(t_corr *curr, const char *fn,
 #define NDIST 100
     FILE       *out;
     gmx_stats_t lsq1;
-    int         i, j;
+    int         i, j, nlsq;
     real        a, b, D, Dav, D2av, VarD, sqrtD, sqrtD_max, scale;
     t_pdbinfo  *pdbinfo = NULL;
     int        *mol2a   = NULL;
@@ -570,12 +1022,14 @@ void printmol(t_corr *curr, const char *fn,
         mol2a   = top->mols.index;
     }
 
+    /* With bFFT the points of all time origins are in a single set */
+    nlsq      = curr->bFFT ? 1 : curr->nrestart;
     Dav       = D2av = 0;
     sqrtD_max = 0;
     for (i = 0; (i < curr->nmol); i++)
     {
         lsq1 = gmx_stats_init();
-        for (j = 0; (j < curr->nrestart); j++)
+        for (j = 0; (j < nlsq); j++)
         {
             real xx, yy, dx, dy;
 
@@ -584,7 +1038,8 @@ void printmol(t_corr *curr, const char *fn,
                 gmx_stats_add_point(lsq1, xx, yy, dx, dy);
             }
         }
-        gmx_stats_get_ab(lsq1, elsqWEIGHT_NONE, &a, &b, NULL, NULL, NULL, NULL);
+        /* Only points from bFFT have an error estimate to weight with */
+        gmx_stats_get_ab(lsq1, elsqWEIGHT_Y, &a, &b, NULL, NULL, NULL, NULL);
         gmx_stats_done(lsq1);
         sfree(lsq1);
         D     = a*FACTOR/curr->dim_factor;
@@ -637,6 +1092,118 @@ void printmol(t_corr *curr, const char *fn,
     }
 }
 
+/* prepares the coordinates x of a frame: makes the molecules whole,
+ * puts their centers of mass in xa_cur, removes the periodic boundary
+ * crossings with respect to xa_prev and computes the center of mass com
+ */
+static void prep_frame(t_topology *top, gmx_bool bMol, gmx_rmpbc_t gpbc,
+                       int natoms, matrix box, rvec x[], int ncoords,
+                       rvec xa_cur[], rvec xa_prev[], gmx_bool bFirst,
+                       int ngrp, int gnx[], atom_id *index[],
+                       int *gnx_com, atom_id *index_com[], rvec com)
+{
+    int i;
+
+    /* for the first frame, the previous frame is a copy of the first frame */
+    if (bFirst)
+    {
+        memcpy(xa_prev, xa_cur, ncoords*sizeof(xa_prev[0]));
+    }
+
+    /* make the molecules whole */
+    if (bMol)
+    {
+        gmx_rmpbc(gpbc, natoms, box, x);
+    }
+
+    /* calculate the molecules' centers of masses and put them into xa */
+    if (bMol)
+    {
+        calc_mol_com(gnx[0], index[0], &top->mols, &top->atoms, x, xa_cur);
+    }
+
+    /* first remove the periodic boundary condition crossings */
+    for (i = 0; i < ngrp; i++)
+    {
+        prep_data(bMol, gnx[i], index[i], xa_cur, xa_prev, box);
+    }
+
+    /* calculate the center of mass */
+    if (gnx_com)
+    {
+        prep_data(bMol, gnx_com[0], index_com[0], xa_cur, xa_prev, box);
+        calc_com(bMol, gnx_com[0], index_com[0], xa_cur, xa_prev, box,
+                 &top->atoms, com);
+    }
+}
+
+#define        prev (1-cur)
+
+/* with bFFT, reads the trajectory again to store the coordinates of
+ * the block of atoms starting at curr->fft_a0
+ */
+static void read_block_fft(t_corr *curr, const char *fn, t_topology *top, int ePBC,
+                           gmx_bool bMol, int gnx[], atom_id *index[],
+                           int *gnx_com, atom_id *index_com[],
+                           const output_env_t oenv)
+{
+    rvec            *x[2], *xa[2];
+    rvec             com = {0};
+    real             t;
+    int              natoms, i, f, cur = 0;
+    t_trxstatus     *status;
+    matrix           box;
+    gmx_rmpbc_t      gpbc = NULL;
+
+    natoms = read_first_x(oenv, &status, fn, &t, &(x[cur]), box);
+    snew(x[prev], natoms);
+    if (bMol)
+    {
+        snew(xa[0], curr->ncoords);
+        snew(xa[1], curr->ncoords);
+        gpbc = gmx_rmpbc_init(&top->idef, ePBC, natoms);
+    }
+    else
+    {
+        xa[0] = x[0];
+        xa[1] = x[1];
+    }
+
+    f = 0;
+    do
+    {
+        if (f == curr->nframes)
+        {
+            gmx_fatal(FARGS, "Trajectory %s has more frames than in the first pass", fn);
+        }
+        prep_frame(top, bMol, gpbc, natoms, box, x[cur], curr->ncoords,
+                   xa[cur], xa[prev], f == 0, curr->ngrp, gnx, index,
+                   gnx_com, index_com, com);
+        for (i = 0; (i < curr->ngrp); i++)
+        {
+            store_frame_fft(curr, i, f, gnx[i], index[i], bMol, xa[cur],
+                            (gnx_com != NULL), com);
+        }
+        cur = prev;
+        f++;
+    }
+    while (read_next_x(oenv, status, &t, x[cur], box));
+    if (f != curr->nframes)
+    {
+        gmx_fatal(FARGS, "Trajectory %s has fewer frames than in the first pass", fn);
+    }
+
+    if (bMol)
+    {
+        gmx_rmpbc_done(gpbc);
+        sfree(xa[0]);
+        sfree(xa[1]);
+    }
+    sfree(x[0]);
+    sfree(x[1]);
+    close_trj(status);
+}
+
 /* this is the main loop for the correlation type functions
  * fx and nx are file pointers to things like read_first_x and
  * read_next_x
@@ -651,9 +1218,8 @@ int corr_loop(t_corr *curr, const char *fn, t_topology *top, int ePBC,
     rvec            *xa[2]; /* the coordinates to calculate displacements for */
     rvec             com = {0};
     real             t, t_prev = 0;
-    int              natoms, i, j, cur = 0, maxframes = 0;
+    int              natoms, i, j, cur = 0, maxframes = 0, maxgnx, nblock, b;
     t_trxstatus     *status;
-#define        prev (1-cur)
     matrix           box;
     gmx_bool         bFirst;
     gmx_rmpbc_t      gpbc = NULL;
@@ -694,6 +1260,28 @@ int corr_loop(t_corr *curr, const char *fn, t_topology *top, int ePBC,
         gpbc = gmx_rmpbc_init(&top->idef, ePBC, natoms);
     }
 
+    maxgnx = 0;
+    for (i = 0; i < curr->ngrp; i++)
+    {
+        maxgnx = max(maxgnx, gnx[i]);
+    }
+    if (curr->bFFT)
+    {
+        /* Start with all atoms in one block, limit_fft_memory reduces this */
+        curr->fft_a0  = 0;
+        curr->fft_nat = max(1, maxgnx);
+    }
+
+    if (curr->bFFT && curr->nmol > 0)
+    {
+        snew(curr->lsq, 1);
+        snew(curr->lsq[0], curr->nmol);
+        for (i = 0; i < curr->nmol; i++)
+        {
+            curr->lsq[0][i] = gmx_stats_init();
+        }
+    }
+
     /* the loop over all frames */
     do
     {
@@ -715,7 +1303,7 @@ int corr_loop(t_corr *curr, const char *fn, t_topology *top, int ePBC,
 
 
         /* check whether we've reached a restart point */
-        if (bRmod(t, curr->t0, dt))
+        if (!curr->bFFT && bRmod(t, curr->t0, dt))
         {
             curr->nrestart++;
 
@@ -761,6 +1349,10 @@ int corr_loop(t_corr *curr, const char *fn, t_topology *top, int ePBC,
                 {
                     srenew(curr->datam[i], maxframes);
                 }
+                if (curr->bFFT)
+                {
+                    srenew(curr->xfr[i], maxframes);
+                }
                 for (j = maxframes-10; j < maxframes; j++)
                 {
                     curr->ndata[i][j] = 0;
@@ -777,57 +1369,76 @@ int corr_loop(t_corr *curr, const char *fn, t_topology *top, int ePBC,
         /* set the time */
         curr->time[curr->nframes] = t - curr->t0;
 
-        /* for the first frame, the previous frame is a copy of the first frame */
-        if (bFirst)
-        {
-            memcpy(xa[prev], xa[cur], curr->ncoords*sizeof(xa[prev][0]));
-            bFirst = FALSE;
-        }
+        prep_frame(top, bMol, gpbc, natoms, box, x[cur], curr->ncoords,
+                   xa[cur], xa[prev], bFirst, curr->ngrp, gnx, index,
+                   gnx_com, index_com, com);
+        bFirst = FALSE;
 
-        /* make the molecules whole */
-        if (bMol)
+        /* loop over all groups in index file */
+        for (i = 0; (i < curr->ngrp); i++)
         {
-            gmx_rmpbc(gpbc, natoms, box, x[cur]);
+            if (curr->bFFT)
+            {
+                /* store the coordinates, the MSD is computed at the end */
+                store_frame_fft(curr, i, curr->nframes, gnx[i], index[i], bMol,
+                                xa[cur], (gnx_com != NULL), com);
+            }
+            else
+            {
+                /* calculate something useful, like mean square displacements */
+                calc_corr(curr, i, gnx[i], index[i], xa[cur], (gnx_com != NULL), com,
+                          calc1, bTen);
+            }
         }
-
-        /* calculate the molecules' centers of masses and put them into xa */
-        if (bMol)
+        if (curr->bFFT)
         {
-            calc_mol_com(gnx[0], index[0], &top->mols, &top->atoms, x[cur], xa[cur]);
+            limit_fft_memory(curr, gnx);
         }
+        cur    = prev;
+        t_prev = t;
 
-        /* first remove the periodic boundary condition crossings */
-        for (i = 0; i < curr->ngrp; i++)
+        curr->nframes++;
+    }
+    while (read_next_x(oenv, status, &t, x[cur], box));
+    if (curr->bFFT)
+    {
+        fprintf(stderr, "\nUsing all %d frames as time origins over %g %s\n\n",
+                curr->nframes,
+                output_env_conv_time(oenv, curr->time[curr->nframes-1]),
+                output_env_get_time_unit(oenv));
+        nblock = (maxgnx + curr->fft_nat - 1)/curr->fft_nat;
+        if (nblock > 1)
         {
-            prep_data(bMol, gnx[i], index[i], xa[cur], xa[prev], box);
+            fprintf(stderr, "To stay within %g MB of memory, the trajectory is read %d times,\n"
+                    "each time for a block of %d atoms\n\n",
+                    curr->fft_maxmem/(1024*1024), nblock, curr->fft_nat);
         }
-
-        /* calculate the center of mass */
-        if (gnx_com)
+        for (b = 0; b < nblock; b++)
         {
-            prep_data(bMol, gnx_com[0], index_com[0], xa[cur], xa[prev], box);
-            calc_com(bMol, gnx_com[0], index_com[0], xa[cur], xa[prev], box,
-                     &top->atoms, com);
+            if (b > 0)
+            {
+                curr->fft_a0 = b*curr->fft_nat;
+                read_block_fft(curr, fn, top, ePBC, bMol, gnx, index,
+                               gnx_com, index_com, oenv);
+            }
+            for (i = 0; (i < curr->ngrp); i++)
+            {
+                sum_corr_fft(curr, i, gnx[i], index[i], bMol, bTen);
+            }
         }
-
-        /* loop over all groups in index file */
         for (i = 0; (i < curr->ngrp); i++)
         {
-            /* calculate something useful, like mean square displacements */
-            calc_corr(curr, i, gnx[i], index[i], xa[cur], (gnx_com != NULL), com,
-                      calc1, bTen);
+            finish_corr_fft(curr, i, bTen);
         }
-        cur    = prev;
-        t_prev = t;
-
-        curr->nframes++;
     }
-    while (read_next_x(oenv, status, &t, x[cur], box));
-    fprintf(stderr, "\nUsed %d restart points spaced %g %s over %g %s\n\n",
-            curr->nrestart,
-            output_env_conv_time(oenv, dt), output_env_get_time_unit(oenv),
-            output_env_conv_time(oenv, curr->time[curr->nframes-1]),
-            output_env_get_time_unit(oenv) );
+    else
+    {
+        fprintf(stderr, "\nUsed %d restart points spaced %g %s over %g %s\n\n",
+                curr->nrestart,
+                output_env_conv_time(oenv, dt), output_env_get_time_unit(oenv),
+                output_env_conv_time(oenv, curr->time[curr->nframes-1]),
+                output_env_get_time_unit(oenv) );
+    }
 
     if (bMol)
     {
@@ -876,8 +1487,8 @@ static void index_atom2mol(int *n, int *index, t_block *mols)
 void do_corr(const char *trx_file, const char *ndx_file, const char *msd_file,
              const char *mol_file, const char *pdb_file, real t_pdb,
              int nrgrp, t_topology *top, int ePBC,
-             gmx_bool bTen, gmx_bool bMW, gmx_bool bRmCOMM,
-             int type, real dim_factor, int axis,
+             gmx_bool bTen, gmx_bool bMW, gmx_bool bRmCOMM, gmx_bool bFFT,
+             real fft_maxmem, int type, real dim_factor, int axis,
              real dt, real beginfit, real endfit, const output_env_t oenv)
 {
     t_corr        *msd;
@@ -915,7 +1526,8 @@ void do_corr(const char *trx_file, const char *ndx_file, const char *msd_file,
     }
 
     msd = init_corr(nrgrp, type, axis, dim_factor,
-                    mol_file == NULL ? 0 : gnx[0], bTen, bMW, dt, top,
+                    mol_file == NULL ? 0 : gnx[0], bTen, bMW, bFFT,
+                    fft_maxmem*1024*1024, dt, top,
                     beginfit, endfit);
 
     nat_trx =
@@ -1069,7 +1681,18 @@ int gmx_msd(int argc, char *argv[])
         "Option [TT]-pdb[tt] writes a [TT].pdb[tt] file with the coordinates of the frame",
         "at time [TT]-tpdb[tt] with in the B-factor field the square root of",
         "the diffusion coefficient of the molecule.",
-        "This option implies option [TT]-mol[tt]."
+        "This option implies option [TT]-mol[tt].[PAR]",
+        "With option [TT]-fft[tt] every frame is used as a time origin",
+        "and [TT]-trestart[tt] is ignored. The MSD is then computed",
+        "with FFTs, at a cost that scales as N log N with the number of frames",
+        "instead of with the number of frames times the number of origins.",
+        "The coordinates of the selected atoms for all frames are kept",
+        "in memory, which takes 12 bytes (24 in double precision) per atom,",
+        "or per molecule with [TT]-mol[tt], per frame. When this exceeds",
+        "[TT]-fftmem[tt] MB, the atoms are processed in blocks and",
+        "the trajectory is read once per block.",
+        "With [TT]-mol[tt] the MSD of each molecule, averaged",
+        "over all time origins, is fitted once for each time lag."
     };
     static const char *normtype[] = { NULL, "no", "x", "y", "z", NULL };
     static const char *axtitle[]  = { NULL, "no", "x", "y", "z", NULL };
@@ -1081,6 +1704,8 @@ int gmx_msd(int argc, char *argv[])
     static gmx_bool    bTen       = FALSE;
     static gmx_bool    bMW        = TRUE;
     static gmx_bool    bRmCOMM    = FALSE;
+    static gmx_bool    bFFT       = FALSE;
+    static real        fft_maxmem = 1000;
     t_pargs            pa[]       = {
         { "-type",    FALSE, etENUM, {normtype},
           "Compute diffusion coefficient in one direction" },
@@ -1098,6 +1723,10 @@ int gmx_msd(int argc, char *argv[])
           "The frame to use for option [TT]-pdb[tt] (%t)" },
         { "-trestart", FALSE, etTIME, {&dt},
           "Time between restarting points in trajectory (%t)" },
+        { "-fft",     FALSE, etBOOL, {&bFFT},
+          "Use all frames as restarting points and compute the MSD with FFTs" },
+        { "-fftmem",  FALSE, etREAL, {&fft_maxmem},
+          "Maximum memory in MB for the coordinates stored with [TT]-fft[tt]" },
         { "-beginfit", FALSE, etTIME, {&beginfit},
           "Start time for fitting the MSD (%t), -1 is 10%" },
         { "-endfit", FALSE, etTIME, {&endfit},
@@ -1197,7 +1826,7 @@ int gmx_msd(int argc, char *argv[])
     }
 
     do_corr(trx_file, ndx_file, msd_file, mol_file, pdb_file, t_pdb, ngroup,
-            &top, ePBC, bTen, bMW, bRmCOMM, type, dim_factor, axis, dt, beginfit, endfit,
+            &top, ePBC, bTen, bMW, bRmCOMM, bFFT, fft_maxmem, type, dim_factor, axis, dt, beginfit, endfit,
             oenv);
 
     view_all(oenv, NFILE, fnm);
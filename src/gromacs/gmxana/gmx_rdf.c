@@ -58,9 +58,23 @@
 #include "coulomb.h"
 #include "gstat.h"
 #include "gromacs/fileio/matio.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gmx_ana.h"
 #include "names.h"
 
+/* Cell list of the selected particles, used with a cut-off */
+typedef struct {
+    int     nc[DIM];      /* The number of cells along each box vector     */
+    int     nsearch[DIM]; /* The number of cells to search on each side,
+                           * -1 means all cells                            */
+    matrix  invbox;       /* The inverse box, for fractional coordinates   */
+    int     cell_nalloc;
+    int    *cell_start;   /* Index in a of the first particle in each cell */
+    int     nalloc;
+    int    *ci;           /* The cell of each particle                     */
+    int    *a;            /* The particle indices sorted on cell           */
+} t_rdf_grid;
+
 static void check_box_c(matrix box)
 {
     if (fabs(box[ZZ][XX]) > GMX_REAL_EPS*box[ZZ][ZZ] ||
@@ -173,11 +187,204 @@ static void split_group(int isize, int *index, char *grpname,
     *coi_out = coi;
 }
 
+/* Returns the cell of x in grid, x does not need to be in the unit cell */
+static int rdf_grid_cell(const t_rdf_grid *grid, const rvec x, ivec c)
+{
+    int  d, m;
+    real f;
+
+    for (d = 0; d < DIM; d++)
+    {
+        f = 0;
+        for (m = d; m < DIM; m++)
+        {
+            f += x[m]*grid->invbox[m][d];
+        }
+        f   -= floor(f);
+        c[d] = (int)(f*grid->nc[d]);
+        if (c[d] >= grid->nc[d])
+        {
+            c[d] = grid->nc[d] - 1;
+        }
+    }
+
+    return (c[XX]*grid->nc[YY] + c[YY])*grid->nc[ZZ] + c[ZZ];
+}
+
+/* Puts the n particles x in a cell list for distances up to rmax.
+ * With bXY all cells along z are searched, since only x and y count.
+ */
+static void rdf_grid_set(t_rdf_grid *grid, matrix box, gmx_bool bXY, real rmax,
+                         int n, rvec x[])
+{
+    int  d, ncell, i, c;
+    real vol, csize, h;
+    rvec cp;
+    ivec ci;
+
+    /* Use cells of at least half the cut-off, but not much smaller
+     * than the volume per particle, to avoid many empty cells.
+     */
+    vol   = det(box);
+    csize = 0.5*rmax;
+    if (n > 0)
+    {
+        if (bXY)
+        {
+            csize = max(csize, sqrt(box[XX][XX]*box[YY][YY]/n));
+        }
+        else
+        {
+            csize = max(csize, pow(vol/n, 1.0/3.0));
+        }
+    }
+    ncell = 1;
+    for (d = 0; d < DIM; d++)
+    {
+        if (bXY && d == ZZ)
+        {
+            grid->nc[d]      = 1;
+            grid->nsearch[d] = -1;
+        }
+        else
+        {
+            /* The distance between the box faces along box vector d */
+            cprod(box[(d + 1) % DIM], box[(d + 2) % DIM], cp);
+            h                = vol/norm(cp);
+            grid->nc[d]      = max(1, (int)(h/csize));
+            grid->nsearch[d] = (int)ceil(rmax*grid->nc[d]/h);
+            if (2*grid->nsearch[d] + 1 >= grid->nc[d])
+            {
+                grid->nsearch[d] = -1;
+            }
+        }
+        ncell *= grid->nc[d];
+    }
+    m_inv_ur0(box, grid->invbox);
+
+    if (ncell + 1 > grid->cell_nalloc)
+    {
+        grid->cell_nalloc = over_alloc_large(ncell + 1);
+        srenew(grid->cell_start, grid->cell_nalloc);
+    }
+    if (n > grid->nalloc)
+    {
+        grid->nalloc = over_alloc_large(n);
+        srenew(grid->ci, grid->nalloc);
+        srenew(grid->a, grid->nalloc);
+    }
+
+    /* Sort the particles on cell index with a counting sort */
+    for (c = 0; c <= ncell; c++)
+    {
+        grid->cell_start[c] = 0;
+    }
+    for (i = 0; i < n; i++)
+    {
+        grid->ci[i] = rdf_grid_cell(grid, x[i], ci);
+        grid->cell_start[grid->ci[i] + 1]++;
+    }
+    for (c = 0; c < ncell; c++)
+    {
+        grid->cell_start[c + 1] += grid->cell_start[c];
+    }
+    for (i = 0; i < n; i++)
+    {
+        grid->a[grid->cell_start[grid->ci[i]]++] = i;
+    }
+    /* Shift back the start indices which were used as fill counters */
+    for (c = ncell; c > 0; c--)
+    {
+        grid->cell_start[c] = grid->cell_start[c - 1];
+    }
+    grid->cell_start[0] = 0;
+}
+
+static gmx_bool is_excluded(const t_blocka *excl, atom_id ix, atom_id jx)
+{
+    int j;
+
+    for (j = excl->index[ix]; j < excl->index[ix+1]; j++)
+    {
+        if (excl->a[j] == jx)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/* Histograms the distances between xi and the particles xj in the cells
+ * within range of xi. When excl!=NULL, the exclusions of atom ix with
+ * the atoms jindex of the particles are skipped.
+ */
+static void rdf_grid_count(const t_rdf_grid *grid, const rvec xi, rvec xj[],
+                           const t_pbc *pbc, gmx_bool bXY,
+                           real cut2, real rmax2, real invhbinw,
+                           const t_blocka *excl, atom_id ix, const atom_id *jindex,
+                           int *cnt)
+{
+    ivec ci, c0, c1, c;
+    int  d, cx, cy, cell, k, j;
+    real r2;
+    rvec dx;
+
+    rdf_grid_cell(grid, xi, ci);
+    for (d = 0; d < DIM; d++)
+    {
+        if (grid->nsearch[d] < 0)
+        {
+            c0[d] = 0;
+            c1[d] = grid->nc[d] - 1;
+        }
+        else
+        {
+            c0[d] = ci[d] - grid->nsearch[d];
+            c1[d] = ci[d] + grid->nsearch[d];
+        }
+    }
+    for (c[XX] = c0[XX]; c[XX] <= c1[XX]; c[XX]++)
+    {
+        cx = (c[XX] + grid->nc[XX]) % grid->nc[XX];
+        for (c[YY] = c0[YY]; c[YY] <= c1[YY]; c[YY]++)
+        {
+            cy = (c[YY] + grid->nc[YY]) % grid->nc[YY];
+            for (c[ZZ] = c0[ZZ]; c[ZZ] <= c1[ZZ]; c[ZZ]++)
+            {
+                cell = (cx*grid->nc[YY] + cy)*grid->nc[ZZ] +
+                    (c[ZZ] + grid->nc[ZZ]) % grid->nc[ZZ];
+                for (k = grid->cell_start[cell]; k < grid->cell_start[cell + 1]; k++)
+                {
+                    j = grid->a[k];
+                    if (excl != NULL && is_excluded(excl, ix, jindex[j]))
+                    {
+                        continue;
+                    }
+                    pbc_dx(pbc, xi, xj[j], dx);
+                    if (bXY)
+                    {
+                        r2 = dx[XX]*dx[XX] + dx[YY]*dx[YY];
+                    }
+                    else
+                    {
+                        r2 = iprod(dx, dx);
+                    }
+                    if (r2 > cut2 && r2 <= rmax2)
+                    {
+                        cnt[(int)(sqrt(r2)*invhbinw)]++;
+                    }
+                }
+            }
+        }
+    }
+}
+
 static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
                    const char *fnRDF, const char *fnCNRDF, const char *fnHQ,
                    gmx_bool bCM, const char *close,
                    const char **rdft, gmx_bool bXY, gmx_bool bPBC, gmx_bool bNormalize,
-                   real cutoff, real binwidth, real fade, int ng,
+                   real cutoff, real rmax, real binwidth, real fade, int ng, gmx_bool bPairs,
                    const output_env_t oenv)
 {
     FILE          *fp;
@@ -185,8 +392,9 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
     char           outf1[STRLEN], outf2[STRLEN];
     char           title[STRLEN], gtitle[STRLEN], refgt[30];
     int            g, natoms, i, ii, j, k, nbin, j0, j1, n, nframes;
-    int          **count;
-    char         **grpname;
+    int            ncol, *refg, *selg, *nref, sg, nthreads, th;
+    int          **count, ***count_t;
+    char         **grpname, **colname;
     int           *isize, isize_cm = 0, nrdf = 0, max_i, isize0, isize_g;
     atom_id      **index, *index_cm = NULL;
 #if (defined SIZEOF_LONG_LONG_INT) && (SIZEOF_LONG_LONG_INT >= 8)
@@ -194,9 +402,9 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
 #else
     double        *sum;
 #endif
-    real           t, rmax2, cut2, r, r2, r2ii, invhbinw, normfac;
+    real           t, rmax2, cut2, r, invhbinw, normfac;
     real           segvol, spherevol, prev_spherevol, **rdf;
-    rvec          *x, dx, *x0 = NULL, *x_i1, xi;
+    rvec          *x, *x0 = NULL, *x_i1;
     real          *inv_segvol, invvol, invvol_sum, rho;
     gmx_bool       bClose, *bExcl, bTop, bNonSelfExcl;
     matrix         box, box_pbc;
@@ -210,6 +418,7 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
     t_pbc          pbc;
     gmx_rmpbc_t    gpbc = NULL;
     int           *is   = NULL, **coi = NULL, cur, mol, i1, res, a;
+    t_rdf_grid    *grid = NULL;
 
     excl = NULL;
 
@@ -279,6 +488,40 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
         isize0 = isize[0];
     }
 
+    /* Set up the reference and selection group of each RDF */
+    if (bPairs)
+    {
+        ncol = (ng + 1)*(ng + 2)/2;
+    }
+    else
+    {
+        ncol = ng;
+    }
+    snew(refg, ncol);
+    snew(selg, ncol);
+    snew(nref, ncol);
+    snew(colname, ncol);
+    g = 0;
+    for (i = 0; i < (bPairs ? ng + 1 : 1); i++)
+    {
+        for (j = (bPairs ? i : 1); j < ng + 1; j++)
+        {
+            refg[g] = i;
+            selg[g] = j;
+            nref[g] = bPairs ? isize[i] : isize0;
+            if (bPairs)
+            {
+                snew(colname[g], strlen(grpname[i]) + strlen(grpname[j]) + 2);
+                sprintf(colname[g], "%s-%s", grpname[i], grpname[j]);
+            }
+            else
+            {
+                colname[g] = grpname[j];
+            }
+            g++;
+        }
+    }
+
     natoms = read_first_x(oenv, &status, fnTRX, &t, &x, box);
     if (!natoms)
     {
@@ -341,6 +584,25 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
     {
         rmax2   = sqr(3*max(box[XX][XX], max(box[YY][YY], box[ZZ][ZZ])));
     }
+    if (rmax > 0)
+    {
+        if (bPBC && sqr(rmax) > rmax2)
+        {
+            fprintf(stderr, "\nWARNING: -rmax %g is larger than allowed by the box, using %g nm\n\n",
+                    rmax, sqrt(rmax2));
+        }
+        else
+        {
+            rmax2 = sqr(rmax);
+        }
+        /* With a cut-off shorter than the box we only need to consider
+         * particles in nearby cells.
+         */
+        if (bPBC && !bClose && (ePBCrdf == epbcXYZ || ePBCrdf == epbcXY))
+        {
+            snew(grid, 1);
+        }
+    }
     if (debug)
     {
         fprintf(debug, "rmax2 = %g\n", rmax2);
@@ -353,35 +615,47 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
     invhbinw = 2.0 / binwidth;
     cut2     = sqr(cutoff);
 
-    snew(count, ng);
-    snew(pairs, ng);
-    snew(npairs, ng);
+    snew(count, ncol);
+    snew(pairs, ncol);
+    snew(npairs, ncol);
 
     snew(bExcl, natoms);
     max_i = 0;
-    for (g = 0; g < ng; g++)
+    for (g = 0; g < ncol; g++)
     {
-        if (isize[g+1] > max_i)
+        if (isize[selg[g]] > max_i)
         {
-            max_i = isize[g+1];
+            max_i = isize[selg[g]];
         }
 
         /* this is THE array */
         snew(count[g], nbin+1);
 
         /* make pairlist array for groups and exclusions */
-        snew(pairs[g], isize[0]);
-        snew(npairs[g], isize[0]);
-        for (i = 0; i < isize[0]; i++)
+        snew(pairs[g], isize[refg[g]]);
+        snew(npairs[g], isize[refg[g]]);
+        for (i = 0; i < isize[refg[g]]; i++)
         {
+            npairs[g][i] = -1;
             /* We can only have exclusions with atomic rdfs */
-            if (!(bCM || bClose || rdft[0][0] != 'a'))
+            if (grid && excl && !(bCM || bClose || rdft[0][0] != 'a'))
             {
-                ix = index[0][i];
-                for (j = 0; j < natoms; j++)
+                /* The grid search checks the exclusions per pair, so we
+                 * only need to know if there are non-self exclusions,
+                 * which we signal with npairs=0.
+                 */
+                ix = index[refg[g]][i];
+                for (j = excl->index[ix]; j < excl->index[ix+1]; j++)
                 {
-                    bExcl[j] = FALSE;
+                    if (excl->a[j] != ix)
+                    {
+                        npairs[g][i] = 0;
+                    }
                 }
+            }
+            else if (!(bCM || bClose || rdft[0][0] != 'a'))
+            {
+                ix = index[refg[g]][i];
                 /* exclusions? */
                 if (excl)
                 {
@@ -391,11 +665,11 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
                     }
                 }
                 k = 0;
-                snew(pairs[g][i], isize[g+1]);
+                snew(pairs[g][i], isize[selg[g]]);
                 bNonSelfExcl = FALSE;
-                for (j = 0; j < isize[g+1]; j++)
+                for (j = 0; j < isize[selg[g]]; j++)
                 {
-                    jx = index[g+1][j];
+                    jx = index[selg[g]][j];
                     if (!bExcl[jx])
                     {
                         pairs[g][i][k++] = jx;
@@ -406,6 +680,13 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
                         bNonSelfExcl = TRUE;
                     }
                 }
+                if (excl)
+                {
+                    for (j = excl->index[ix]; j < excl->index[ix+1]; j++)
+                    {
+                        bExcl[excl->a[j]] = FALSE;
+                    }
+                }
                 if (bNonSelfExcl)
                 {
                     npairs[g][i] = k;
@@ -414,18 +695,28 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
                 else
                 {
                     /* Save a LOT of memory and some cpu cycles */
-                    npairs[g][i] = -1;
                     sfree(pairs[g][i]);
                 }
             }
-            else
-            {
-                npairs[g][i] = -1;
-            }
         }
     }
     sfree(bExcl);
 
+    /* Each thread histograms into its own count array,
+     * thread 0 uses count directly.
+     */
+    nthreads = gmx_omp_get_max_threads();
+    snew(count_t, nthreads);
+    count_t[0] = count;
+    for (th = 1; th < nthreads; th++)
+    {
+        snew(count_t[th], ncol);
+        for (g = 0; g < ncol; g++)
+        {
+            snew(count_t[th][g], nbin+1);
+        }
+    }
+
     snew(x_i1, max_i);
     nframes    = 0;
     invvol_sum = 0;
@@ -470,37 +761,43 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
             calc_comg(is[0], coi[0], index[0], rdft[0][6] == 'm', atom, x, x0);
         }
 
-        for (g = 0; g < ng; g++)
+        for (g = 0; g < ncol; g++)
         {
+            sg = selg[g];
             if (rdft[0][0] == 'a')
             {
                 /* Copy the indexed coordinates to a continuous array */
-                for (i = 0; i < isize[g+1]; i++)
+                for (i = 0; i < isize[sg]; i++)
                 {
-                    copy_rvec(x[index[g+1][i]], x_i1[i]);
+                    copy_rvec(x[index[sg][i]], x_i1[i]);
                 }
+                isize_g = isize[sg];
             }
             else
             {
                 /* Calculate the COMs/COGs and store in x_i1 */
-                calc_comg(is[g+1], coi[g+1], index[g+1], rdft[0][6] == 'm', atom, x, x_i1);
+                calc_comg(is[sg], coi[sg], index[sg], rdft[0][6] == 'm', atom, x, x_i1);
+                isize_g = is[sg];
+            }
+            if (grid)
+            {
+                rdf_grid_set(grid, box, bXY, sqrt(rmax2), isize_g, x_i1);
             }
 
-            for (i = 0; i < isize0; i++)
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, 16)
+            for (i = 0; i < nref[g]; i++)
             {
+                int     *cnt, j, ii;
+                atom_id  ix, jx;
+                real     r2, r2ii;
+                rvec     dx, xi;
+
+                cnt = count_t[gmx_omp_get_thread_num()][g];
                 if (bClose)
                 {
                     /* Special loop, since we need to determine the minimum distance
                      * over all selected atoms in the reference molecule/residue.
                      */
-                    if (rdft[0][0] == 'a')
-                    {
-                        isize_g = isize[g+1];
-                    }
-                    else
-                    {
-                        isize_g = is[g+1];
-                    }
                     for (j = 0; j < isize_g; j++)
                     {
                         r2 = 1e30;
@@ -530,7 +827,7 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
                         }
                         if (r2 > cut2 && r2 <= rmax2)
                         {
-                            count[g][(int)(sqrt(r2)*invhbinw)]++;
+                            cnt[(int)(sqrt(r2)*invhbinw)]++;
                         }
                     }
                 }
@@ -539,13 +836,22 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
                     /* Real rdf between points in space */
                     if (bCM || rdft[0][0] != 'a')
                     {
+                        ix = -1;
                         copy_rvec(x0[i], xi);
                     }
                     else
                     {
-                        copy_rvec(x[index[0][i]], xi);
+                        ix = index[refg[g]][i];
+                        copy_rvec(x[ix], xi);
+                    }
+                    if (grid)
+                    {
+                        /* Only search the cells within the cut-off */
+                        rdf_grid_count(grid, xi, x_i1, &pbc, bXY, cut2, rmax2, invhbinw,
+                                       (rdft[0][0] == 'a' && npairs[g][i] >= 0) ? excl : NULL,
+                                       ix, index[sg], cnt);
                     }
-                    if (rdft[0][0] == 'a' && npairs[g][i] >= 0)
+                    else if (rdft[0][0] == 'a' && npairs[g][i] >= 0)
                     {
                         /* Expensive loop, because of indexing */
                         for (j = 0; j < npairs[g][i]; j++)
@@ -570,21 +876,13 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
                             }
                             if (r2 > cut2 && r2 <= rmax2)
                             {
-                                count[g][(int)(sqrt(r2)*invhbinw)]++;
+                                cnt[(int)(sqrt(r2)*invhbinw)]++;
                             }
                         }
                     }
                     else
                     {
                         /* Cheaper loop, no exclusions */
-                        if (rdft[0][0] == 'a')
-                        {
-                            isize_g = isize[g+1];
-                        }
-                        else
-                        {
-                            isize_g = is[g+1];
-                        }
                         for (j = 0; j < isize_g; j++)
                         {
                             if (bPBC)
@@ -605,7 +903,7 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
                             }
                             if (r2 > cut2 && r2 <= rmax2)
                             {
-                                count[g][(int)(sqrt(r2)*invhbinw)]++;
+                                cnt[(int)(sqrt(r2)*invhbinw)]++;
                             }
                         }
                     }
@@ -617,6 +915,28 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
     while (read_next_x(oenv, status, &t, x, box));
     fprintf(stderr, "\n");
 
+    /* Reduce the thread histograms */
+    for (th = 1; th < nthreads; th++)
+    {
+        for (g = 0; g < ncol; g++)
+        {
+            for (i = 0; i < nbin+1; i++)
+            {
+                count[g][i] += count_t[th][g][i];
+            }
+            sfree(count_t[th][g]);
+        }
+        sfree(count_t[th]);
+    }
+    sfree(count_t);
+    if (grid)
+    {
+        sfree(grid->cell_start);
+        sfree(grid->ci);
+        sfree(grid->a);
+        sfree(grid);
+    }
+
     if (bPBC && (NULL != top))
     {
         gmx_rmpbc_done(gpbc);
@@ -648,17 +968,17 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
         prev_spherevol = spherevol;
     }
 
-    snew(rdf, ng);
-    for (g = 0; g < ng; g++)
+    snew(rdf, ncol);
+    for (g = 0; g < ncol; g++)
     {
         /* We have to normalize by dividing by the number of frames */
         if (rdft[0][0] == 'a')
         {
-            normfac = 1.0/(nframes*invvol*isize0*isize[g+1]);
+            normfac = 1.0/(nframes*invvol*nref[g]*isize[selg[g]]);
         }
         else
         {
-            normfac = 1.0/(nframes*invvol*isize0*is[g+1]);
+            normfac = 1.0/(nframes*invvol*nref[g]*is[selg[g]]);
         }
 
         /* Do the normalization */
@@ -687,7 +1007,7 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
                 }
                 else
                 {
-                    rdf[g][i] = j/(binwidth*isize0*nframes);
+                    rdf[g][i] = j/(binwidth*nref[g]*nframes);
                 }
             }
         }
@@ -720,25 +1040,25 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
     {
         sprintf(refgt, "%s", "");
     }
-    if (ng == 1)
+    if (ncol == 1)
     {
         if (output_env_get_print_xvgr_codes(oenv))
         {
-            fprintf(fp, "@ subtitle \"%s%s - %s\"\n", grpname[0], refgt, grpname[1]);
+            fprintf(fp, "@ subtitle \"%s%s - %s\"\n", grpname[refg[0]], refgt, grpname[selg[0]]);
         }
     }
     else
     {
-        if (output_env_get_print_xvgr_codes(oenv))
+        if (!bPairs && output_env_get_print_xvgr_codes(oenv))
         {
             fprintf(fp, "@ subtitle \"reference %s%s\"\n", grpname[0], refgt);
         }
-        xvgr_legend(fp, ng, (const char**)(grpname+1), oenv);
+        xvgr_legend(fp, ncol, (const char**)colname, oenv);
     }
     for (i = 0; (i < nrdf); i++)
     {
         fprintf(fp, "%10g", i*binwidth);
-        for (g = 0; g < ng; g++)
+        for (g = 0; g < ncol; g++)
         {
             fprintf(fp, " %10g", rdf[g][i]);
         }
@@ -755,7 +1075,7 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
         real *hq, *integrand, Q;
 
         /* Get a better number density later! */
-        rho = isize[1]*invvol;
+        rho = isize[selg[0]]*invvol;
         snew(hq, nhq);
         snew(integrand, nrdf);
         for (i = 0; (i < nhq); i++)
@@ -783,29 +1103,29 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
 
     if (fnCNRDF)
     {
-        normfac = 1.0/(isize0*nframes);
         fp      = xvgropen(fnCNRDF, "Cumulative Number RDF", "r", "number", oenv);
-        if (ng == 1)
+        if (ncol == 1)
         {
             if (output_env_get_print_xvgr_codes(oenv))
             {
-                fprintf(fp, "@ subtitle \"%s-%s\"\n", grpname[0], grpname[1]);
+                fprintf(fp, "@ subtitle \"%s-%s\"\n", grpname[refg[0]], grpname[selg[0]]);
             }
         }
         else
         {
-            if (output_env_get_print_xvgr_codes(oenv))
+            if (!bPairs && output_env_get_print_xvgr_codes(oenv))
             {
                 fprintf(fp, "@ subtitle \"reference %s\"\n", grpname[0]);
             }
-            xvgr_legend(fp, ng, (const char**)(grpname+1), oenv);
+            xvgr_legend(fp, ncol, (const char**)colname, oenv);
         }
-        snew(sum, ng);
+        snew(sum, ncol);
         for (i = 0; (i <= nbin/2); i++)
         {
             fprintf(fp, "%10g", i*binwidth);
-            for (g = 0; g < ng; g++)
+            for (g = 0; g < ncol; g++)
             {
+                normfac = 1.0/(nref[g]*nframes);
                 fprintf(fp, " %10g", (real)((double)sum[g]*normfac));
                 if (i*2+1 < nbin)
                 {
@@ -820,11 +1140,19 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
         do_view(oenv, fnCNRDF, NULL);
     }
 
-    for (g = 0; g < ng; g++)
+    for (g = 0; g < ncol; g++)
     {
         sfree(rdf[g]);
+        if (bPairs)
+        {
+            sfree(colname[g]);
+        }
     }
     sfree(rdf);
+    sfree(colname);
+    sfree(nref);
+    sfree(selg);
+    sfree(refg);
 }
 
 
@@ -863,10 +1191,22 @@ int gmx_rdf(int argc, char *argv[])
         "Note that all atoms in the selected groups are used, also the ones",
         "that don't have Lennard-Jones interactions.[PAR]",
         "Option [TT]-cn[tt] produces the cumulative number RDF,",
-        "i.e. the average number of particles within a distance r.[PAR]"
+        "i.e. the average number of particles within a distance r.[PAR]",
+        "With option [TT]-rmax[tt] the RDF is only computed up to the given",
+        "distance. With periodic boundary conditions the particles are",
+        "then put on a grid, so that only pairs in nearby cells are considered.",
+        "For large systems this is much faster than the default, where",
+        "the maximum distance is set by the box size.[PAR]",
+        "With option [TT]-pairs[tt] the RDFs between all pairs",
+        "of the selected groups, including the first group, are computed",
+        "in a single pass over the trajectory, e.g. for all atom types",
+        "in a mixture. This only works with atomic RDFs.[PAR]",
+        "The distance calculation is parallelized with OpenMP",
+        "over the reference particles."
     };
     static gmx_bool    bCM     = FALSE, bXY = FALSE, bPBC = TRUE, bNormalize = TRUE;
-    static real        cutoff  = 0, binwidth = 0.002, fade = 0.0;
+    static gmx_bool    bPairs  = FALSE;
+    static real        cutoff  = 0, rmax = 0, binwidth = 0.002, fade = 0.0;
     static int         ngroups = 1;
 
     static const char *closet[] = { NULL, "no", "mol", "res", NULL };
@@ -889,8 +1229,12 @@ int gmx_rdf(int argc, char *argv[])
           "Use only the x and y components of the distance" },
         { "-cut",      FALSE, etREAL, {&cutoff},
           "Shortest distance (nm) to be considered"},
+        { "-rmax",     FALSE, etREAL, {&rmax},
+          "Largest distance (nm) to be considered, 0 is the maximum allowed by the box" },
         { "-ng",       FALSE, etINT, {&ngroups},
           "Number of secondary groups to compute RDFs around a central group" },
+        { "-pairs",    FALSE, etBOOL, {&bPairs},
+          "Compute the RDFs between all pairs of the selected groups" },
         { "-fade",     FALSE, etREAL, {&fade},
           "From this distance onwards the RDF is tranformed by g'(r) = 1 + [g(r)-1] exp(-(r/fade-1)^2 to make it go to 1 smoothly. If fade is 0.0 nothing is done." }
     };
@@ -929,6 +1273,11 @@ int gmx_rdf(int argc, char *argv[])
                   "Nothing to do!");
     }
 
+    if (bPairs && (bCM || closet[0][0] != 'n' || rdft[0][0] != 'a'))
+    {
+        gmx_fatal(FARGS, "-pairs can only be used for atomic RDFs without -com and -surf");
+    }
+
     if (closet[0][0] != 'n')
     {
         if (bCM)
@@ -945,8 +1294,8 @@ int gmx_rdf(int argc, char *argv[])
     do_rdf(fnNDX, fnTPS, ftp2fn(efTRX, NFILE, fnm),
            opt2fn("-o", NFILE, fnm), opt2fn_null("-cn", NFILE, fnm),
            opt2fn_null("-hq", NFILE, fnm),
-           bCM, closet[0], rdft, bXY, bPBC, bNormalize, cutoff, binwidth, fade, ngroups,
-           oenv);
+           bCM, closet[0], rdft, bXY, bPBC, bNormalize, cutoff, rmax, binwidth, fade, ngroups,
+           bPairs, oenv);
 
     return 0;
 }
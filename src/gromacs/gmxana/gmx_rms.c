@@ -92,6 +92,39 @@ static void norm_princ(t_atoms *atoms, int isize, atom_id *index, int natoms,
     }
 }
 
+/* Returns TRUE when the RMSD group equals the fit group, with the same
+ * weights, so the matrix RMSD is the RMSD after optimal superposition.
+ */
+static gmx_bool rms_group_is_fit_group(int n, const real *w_fit,
+                                       const real *w_rms,
+                                       int nrms, const atom_id *ind_rms)
+{
+    gmx_bool bEqual;
+    int      i, *count;
+
+    bEqual = TRUE;
+    for (i = 0; i < n; i++)
+    {
+        if (w_fit[i] != w_rms[i])
+        {
+            bEqual = FALSE;
+        }
+    }
+    /* Atoms occuring multiple times in the RMSD group count multiple times */
+    snew(count, n);
+    for (i = 0; i < nrms; i++)
+    {
+        count[ind_rms[i]]++;
+        if (count[ind_rms[i]] > 1)
+        {
+            bEqual = FALSE;
+        }
+    }
+    sfree(count);
+
+    return bEqual;
+}
+
 int gmx_rms(int argc, char *argv[])
 {
     const char     *desc[] =
@@ -222,7 +255,7 @@ int gmx_rms(int argc, char *argv[])
     int             maxframe = NFRAME, maxframe2 = NFRAME;
     real            t, *w_rls, *w_rms, *w_rls_m = NULL, *w_rms_m = NULL;
     gmx_bool        bNorm, bAv, bFreq2, bFile2, bMat, bBond, bDelta, bMirror, bMass;
-    gmx_bool        bFit, bReset;
+    gmx_bool        bFit, bReset, bQCP;
     t_topology      top;
     int             ePBC;
     t_iatom        *iatom = NULL;
@@ -856,7 +889,25 @@ int gmx_rms(int argc, char *argv[])
             }
         }
 
-        if (bFitAll)
+        /* When we only need the RMSD after fitting on the same group,
+         * we can use the fast all-vs-all superposition RMSD.
+         */
+        bQCP = (bMat && !bBond && bFitAll && ewhat == ewRMSD &&
+                rms_group_is_fit_group(n_ind_m, w_rls_m, w_rms_m,
+                                       irms[0], ind_rms_m));
+        if (bMat)
+        {
+            for (i = 0; i < tel_mat; i++)
+            {
+                snew(rmsd_mat[i], tel_mat2);
+            }
+        }
+        if (bQCP)
+        {
+            calc_rmsd_matrix_qcp(n_ind_m, w_rls_m, tel_mat, mat_x,
+                                 tel_mat2, mat_x2, rmsd_mat);
+        }
+        else if (bFitAll)
         {
             snew(mat_x2_j, natoms);
         }
@@ -864,17 +915,13 @@ int gmx_rms(int argc, char *argv[])
         {
             axis[i] = time[freq*i];
             fprintf(stderr, "\r element %5d; time %5.2f  ", i, axis[i]);
-            if (bMat)
-            {
-                snew(rmsd_mat[i], tel_mat2);
-            }
             if (bBond)
             {
                 snew(bond_mat[i], tel_mat2);
             }
             for (j = 0; j < tel_mat2; j++)
             {
-                if (bFitAll)
+                if (bFitAll && !bQCP)
                 {
                     for (k = 0; k < n_ind_m; k++)
                     {
@@ -890,9 +937,12 @@ int gmx_rms(int argc, char *argv[])
                 {
                     if (bFile2 || (i < j))
                     {
-                        rmsd_mat[i][j] =
-                            calc_similar_ind(ewhat != ewRMSD, irms[0], ind_rms_m,
-                                             w_rms_m, mat_x[i], mat_x2_j);
+                        if (!bQCP)
+                        {
+                            rmsd_mat[i][j] =
+                                calc_similar_ind(ewhat != ewRMSD, irms[0], ind_rms_m,
+                                                 w_rms_m, mat_x[i], mat_x2_j);
+                        }
                         if (rmsd_mat[i][j] > rmsd_max)
                         {
                             rmsd_max = rmsd_mat[i][j];
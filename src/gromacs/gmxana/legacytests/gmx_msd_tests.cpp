@@ -0,0 +1,194 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2013, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for gmx msd -fft
+ *
+ * The MSD computed with FFTs should match the direct sum over all
+ * time origins, also when the atoms are processed in several blocks.
+ *
+ * \ingroup module_integration_tests
+ */
+#include <cstdio>
+
+#include <string>
+#include <vector>
+
+#include "gromacs/gmxana/gmx_ana.h"
+#include "gromacs/legacyheaders/gmx_random.h"
+#include "gromacs/legacyheaders/smalloc.h"
+#include "gromacs/legacyheaders/xvgr.h"
+#include "testutils/integrationtests.h"
+#include "testutils/cmdlinetest.h"
+
+namespace
+{
+
+//! Number of atoms in the test trajectory.
+const int    natoms  = 50;
+//! Number of frames in the test trajectory.
+const int    nframes = 40;
+//! Time between frames in ps.
+const double dtframe = 2;
+
+//! Test fixture for gmx msd -fft
+class GmxMsdFftTest : public gmx::test::IntegrationTestFixture
+{
+    public:
+        GmxMsdFftTest()
+            : trajFileName_(fileManager_.getTemporaryFilePath("walk.gro")),
+              msdFileName_(fileManager_.getTemporaryFilePath("msd.xvg"))
+        {
+            writeTrajectory();
+        }
+
+        /*! \brief
+         * Writes random walks in a large box and computes the reference MSD.
+         *
+         * The coordinates are multiples of 0.001 nm, so they are stored
+         * exactly in the gro file and the reference is a plain double
+         * precision sum over all time origins.
+         */
+        void writeTrajectory()
+        {
+            std::vector<int> x(nframes*natoms*DIM);
+            gmx_rng_t        rng = gmx_rng_init(1993);
+
+            for (int i = 0; i < natoms*DIM; i++)
+            {
+                x[i] = gmx_rng_uniform_uint32(rng) % 5000;
+            }
+            for (int f = 1; f < nframes; f++)
+            {
+                for (int i = 0; i < natoms*DIM; i++)
+                {
+                    x[f*natoms*DIM + i] = x[(f - 1)*natoms*DIM + i] +
+                        static_cast<int>(gmx_rng_uniform_uint32(rng) % 101) - 50;
+                }
+            }
+            gmx_rng_destroy(rng);
+
+            FILE *fp = std::fopen(trajFileName_.c_str(), "w");
+            ASSERT_TRUE(fp != NULL);
+            for (int f = 0; f < nframes; f++)
+            {
+                std::fprintf(fp, "Random walk t= %g\n%5d\n", f*dtframe, natoms);
+                for (int a = 0; a < natoms; a++)
+                {
+                    const int *xa = &x[(f*natoms + a)*DIM];
+                    std::fprintf(fp, "%5d%-5s%5s%5d%8.3f%8.3f%8.3f\n",
+                                 a + 1, "SOL", "OW", a + 1,
+                                 0.001*xa[XX], 0.001*xa[YY], 0.001*xa[ZZ]);
+                }
+                std::fprintf(fp, "%10.5f%10.5f%10.5f\n", 100.0, 100.0, 100.0);
+            }
+            std::fclose(fp);
+
+            msdRef_.assign(nframes, 0.0);
+            for (int m = 1; m < nframes; m++)
+            {
+                double sum = 0;
+                for (int f = 0; f + m < nframes; f++)
+                {
+                    for (int i = 0; i < natoms*DIM; i++)
+                    {
+                        double dx = 0.001*(x[(f + m)*natoms*DIM + i] - x[f*natoms*DIM + i]);
+                        sum += dx*dx;
+                    }
+                }
+                msdRef_[m] = sum/((nframes - m)*natoms);
+            }
+        }
+
+        //! Runs gmx msd -fft with memory limit fftmem in MB.
+        void runMsdFft(double fftmem)
+        {
+            gmx::test::CommandLine caller;
+            caller.append("msd");
+            caller.addOption("-f", trajFileName_);
+            caller.addOption("-s", trajFileName_);
+            caller.addOption("-o", msdFileName_);
+            caller.append("-fft");
+            caller.addOption("-fftmem", fftmem);
+
+            redirectStringToStdin("0\n");
+
+            ASSERT_EQ(0, gmx_msd(caller.argc(), caller.argv()));
+        }
+
+        //! Checks the MSD output against the direct sums.
+        void checkMsd()
+        {
+            double **y;
+            int      ny;
+            int      n = read_xvg(msdFileName_.c_str(), &y, &ny);
+
+            ASSERT_EQ(nframes, n);
+            ASSERT_EQ(2, ny);
+            for (int m = 0; m < nframes; m++)
+            {
+                EXPECT_DOUBLE_EQ(m*dtframe, y[0][m]);
+                /* The output has 6 significant digits */
+                EXPECT_NEAR(msdRef_[m], y[1][m], 1e-5*msdRef_[m] + 1e-7)
+                << "at lag " << m;
+            }
+            for (int c = 0; c < ny; c++)
+            {
+                sfree(y[c]);
+            }
+            sfree(y);
+        }
+
+        std::string         trajFileName_;
+        std::string         msdFileName_;
+        std::vector<double> msdRef_;
+};
+
+TEST_F(GmxMsdFftTest, MatchesDirectSumOverAllOrigins)
+{
+    runMsdFft(1000);
+    checkMsd();
+}
+
+TEST_F(GmxMsdFftTest, MatchesDirectSumWithMultipleBlocks)
+{
+    /* The coordinates of all frames take 12*(nframes + 2) bytes per atom,
+     * so this limit gives blocks of 13 atoms and four trajectory passes.
+     */
+    runMsdFft(0.01);
+    checkMsd();
+}
+
+} // namespace
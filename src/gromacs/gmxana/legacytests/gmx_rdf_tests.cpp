@@ -0,0 +1,279 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2013, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the cell list search of gmx rdf -rmax
+ *
+ * The RDFs up to the cut-off should be identical to those of the
+ * all-pairs loop that is used without -rmax.
+ *
+ * \ingroup module_integration_tests
+ */
+#include <cstdio>
+
+#include <string>
+
+#include "gromacs/gmxana/gmx_ana.h"
+#include "gromacs/legacyheaders/gmx_random.h"
+#include "gromacs/legacyheaders/smalloc.h"
+#include "gromacs/legacyheaders/vec.h"
+#include "gromacs/legacyheaders/xvgr.h"
+#include "gromacs/utility/file.h"
+#include "gromacs/utility/stringutil.h"
+#include "programs/gmx/legacycmainfunctions.h"
+#include "testutils/integrationtests.h"
+#include "testutils/cmdlinetest.h"
+
+namespace
+{
+
+//! Number of water molecules in the test systems.
+const int  nmol     = 400;
+//! Cut-off used for the cell list search.
+const real rmax     = 0.8;
+//! Bin width of the RDFs.
+const real binwidth = 0.01;
+
+//! Test fixture for the cell list search of gmx rdf
+class GmxRdfTest : public gmx::test::IntegrationTestFixture
+{
+    public:
+        GmxRdfTest()
+            : confFileName_(fileManager_.getTemporaryFilePath("conf.gro")),
+              ndxFileName_(fileManager_.getTemporaryFilePath("index.ndx")),
+              tprFileName_(fileManager_.getTemporaryFilePath("topol.tpr"))
+        {
+        }
+
+        /*! \brief
+         * Writes two frames of randomly placed water molecules in box.
+         *
+         * Also writes an index file with groups OW and System.
+         */
+        void writeConf(const matrix box)
+        {
+            gmx_rng_t rng = gmx_rng_init(1997);
+            FILE     *fp  = std::fopen(confFileName_.c_str(), "w");
+            ASSERT_TRUE(fp != NULL);
+            for (int frame = 0; frame < 2; frame++)
+            {
+                std::fprintf(fp, "Random water\n%5d\n", 3*nmol);
+                for (int m = 0; m < nmol; m++)
+                {
+                    const char *name[3] = { "OW", "HW1", "HW2" };
+                    const rvec  dh[3]   = { {0, 0, 0}, {0.1, 0, 0}, {-0.033, 0.094, 0} };
+                    rvec        xo;
+
+                    clear_rvec(xo);
+                    for (int d = 0; d < DIM; d++)
+                    {
+                        rvec b;
+                        svmul(gmx_rng_uniform_real(rng), box[d], b);
+                        rvec_inc(xo, b);
+                    }
+                    for (int a = 0; a < 3; a++)
+                    {
+                        std::fprintf(fp, "%5d%-5s%5s%5d%8.3f%8.3f%8.3f\n",
+                                     (m + 1) % 100000, "SOL", name[a],
+                                     (3*m + a + 1) % 100000,
+                                     xo[XX] + dh[a][XX],
+                                     xo[YY] + dh[a][YY],
+                                     xo[ZZ] + dh[a][ZZ]);
+                    }
+                }
+                std::fprintf(fp, "%10.5f%10.5f%10.5f%10.5f%10.5f%10.5f%10.5f%10.5f%10.5f\n",
+                             box[XX][XX], box[YY][YY], box[ZZ][ZZ],
+                             box[XX][YY], box[XX][ZZ], box[YY][XX],
+                             box[YY][ZZ], box[ZZ][XX], box[ZZ][YY]);
+            }
+            std::fclose(fp);
+            gmx_rng_destroy(rng);
+
+            std::string ndx("[ OW ]\n");
+            for (int m = 0; m < nmol; m++)
+            {
+                ndx += gmx::formatString("%d\n", 3*m + 1);
+            }
+            ndx += "[ System ]\n";
+            for (int a = 0; a < 3*nmol; a++)
+            {
+                ndx += gmx::formatString("%d\n", a + 1);
+            }
+            gmx::File::writeFileFromString(ndxFileName_, ndx);
+        }
+
+        //! Writes a tpr file for the configuration, to get exclusions.
+        void writeTpr()
+        {
+            std::string topFileName = fileManager_.getTemporaryFilePath("topol.top");
+            std::string mdpFileName = fileManager_.getTemporaryFilePath("grompp.mdp");
+            gmx::File::writeFileFromString(topFileName, gmx::formatString(
+                                                   "#include \"oplsaa.ff/forcefield.itp\"\n"
+                                                   "#include \"oplsaa.ff/spc.itp\"\n"
+                                                   "[ system ]\nRandom water\n"
+                                                   "[ molecules ]\nSOL %d\n", nmol));
+            gmx::File::writeFileFromString(mdpFileName,
+                                           "cutoff-scheme = Group\n"
+                                           "rlist         = 0.5\n"
+                                           "rcoulomb      = 0.5\n"
+                                           "rvdw          = 0.5\n");
+
+            gmx::test::CommandLine caller;
+            caller.append("grompp");
+            caller.addOption("-f", mdpFileName);
+            caller.addOption("-p", topFileName);
+            caller.addOption("-c", confFileName_);
+            caller.addOption("-po", fileManager_.getTemporaryFilePath("mdout.mdp"));
+            caller.addOption("-o", tprFileName_);
+            ASSERT_EQ(0, gmx_grompp(caller.argc(), caller.argv()));
+        }
+
+        /*! \brief
+         * Runs gmx rdf of OW around group refGroup.
+         *
+         * All options are given, as gmx rdf keeps them in static variables.
+         */
+        void runRdf(const std::string &structureFileName, const char *refGroup,
+                    real cutoff, bool bXY, const std::string &name)
+        {
+            gmx::test::CommandLine caller;
+            caller.append("rdf");
+            caller.addOption("-f", confFileName_);
+            caller.addOption("-s", structureFileName);
+            caller.addOption("-n", ndxFileName_);
+            caller.addOption("-o", fileManager_.getTemporaryFilePath((name + ".xvg").c_str()));
+            caller.addOption("-cn", fileManager_.getTemporaryFilePath((name + "_cn.xvg").c_str()));
+            caller.addOption("-bin", binwidth);
+            caller.addOption("-rmax", cutoff);
+            caller.append(bXY ? "-xy" : "-noxy");
+
+            redirectStringToStdin(gmx::formatString("%s\nOW\n", refGroup).c_str());
+
+            ASSERT_EQ(0, gmx_rdf(caller.argc(), caller.argv()));
+        }
+
+        /*! \brief
+         * Checks that the columns of file name with the cell list match
+         * those of file reference up to the cut-off.
+         */
+        void compareXvg(const std::string &reference, const std::string &name)
+        {
+            double **yref, **y;
+            int      nyref, ny;
+            int      nref = read_xvg(fileManager_.getTemporaryFilePath((reference + ".xvg").c_str()).c_str(),
+                                     &yref, &nyref);
+            int      n    = read_xvg(fileManager_.getTemporaryFilePath((name + ".xvg").c_str()).c_str(),
+                                     &y, &ny);
+
+            ASSERT_EQ(nyref, ny);
+            ASSERT_LT(n, nref) << "The cut-off should limit the distance range";
+            /* The last bin can be partially beyond the cut-off */
+            ASSERT_GE(n, static_cast<int>(rmax/binwidth) - 1);
+            for (int i = 0; i < n - 1; i++)
+            {
+                for (int c = 0; c < ny; c++)
+                {
+                    EXPECT_DOUBLE_EQ(yref[c][i], y[c][i])
+                    << "column " << c << " at r = " << yref[0][i];
+                }
+            }
+            for (int c = 0; c < nyref; c++)
+            {
+                sfree(yref[c]);
+            }
+            sfree(yref);
+            for (int c = 0; c < ny; c++)
+            {
+                sfree(y[c]);
+            }
+            sfree(y);
+        }
+
+        /*! \brief
+         * Runs gmx rdf without and with -rmax and compares the output.
+         */
+        void runAndCompare(const std::string &structureFileName, const char *refGroup,
+                           bool bXY)
+        {
+            runRdf(structureFileName, refGroup, 0, bXY, "allpairs");
+            runRdf(structureFileName, refGroup, rmax, bXY, "grid");
+            compareXvg("allpairs", "grid");
+            compareXvg("allpairs_cn", "grid_cn");
+        }
+
+        std::string confFileName_;
+        std::string ndxFileName_;
+        std::string tprFileName_;
+};
+
+TEST_F(GmxRdfTest, CellListMatchesAllPairsForRectangularBox)
+{
+    const matrix box = {{2.5, 0, 0}, {0, 2.4, 0}, {0, 0, 2.6}};
+    writeConf(box);
+    runAndCompare(confFileName_, "OW", false);
+}
+
+TEST_F(GmxRdfTest, CellListMatchesAllPairsForTriclinicBox)
+{
+    const matrix box = {{2.5, 0, 0}, {0.8, 2.3, 0}, {-0.6, 0.7, 2.2}};
+    writeConf(box);
+    runAndCompare(confFileName_, "OW", false);
+}
+
+TEST_F(GmxRdfTest, CellListMatchesAllPairsForXY)
+{
+    const matrix box = {{2.5, 0, 0}, {0, 2.4, 0}, {0, 0, 2.6}};
+    writeConf(box);
+    runAndCompare(confFileName_, "OW", true);
+}
+
+TEST_F(GmxRdfTest, CellListMatchesAllPairsForTriclinicXY)
+{
+    /* With -xy the last box vector has to be along z */
+    const matrix box = {{2.5, 0, 0}, {0.8, 2.3, 0}, {0, 0, 2.2}};
+    writeConf(box);
+    runAndCompare(confFileName_, "OW", true);
+}
+
+TEST_F(GmxRdfTest, CellListMatchesAllPairsWithExclusions)
+{
+    /* With the tpr file, the O-H pairs within a molecule are excluded */
+    const matrix box = {{2.5, 0, 0}, {0.8, 2.3, 0}, {-0.6, 0.7, 2.2}};
+    writeConf(box);
+    writeTpr();
+    runAndCompare(tprFileName_, "System", false);
+}
+
+} // namespace
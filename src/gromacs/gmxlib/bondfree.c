@@ -190,6 +190,47 @@ pbc_dx_simd(gmx_mm_pr *dx, gmx_mm_pr *dy, gmx_mm_pr *dz,
     *dx = gmx_nmsub_pr(sh, pbc->bxx, *dx);
 }
 
+/* Returns the shift index of atom ai with respect to atom aj, for use
+ * with shift forces. With a graph the graph shifts are used, otherwise
+ * the shift is the one pbc_dx_simd applied to get dx_pbc from x[ai]-x[aj].
+ */
+static int
+shift_index_simd(const t_pbc *pbc, const t_graph *g, const rvec x[],
+                 int ai, int aj, const rvec dx_pbc)
+{
+    ivec is;
+    rvec ds;
+    int  d, m;
+
+    if (g != NULL)
+    {
+        ivec_sub(SHIFT_IVEC(g, ai), SHIFT_IVEC(g, aj), is);
+
+        return IVEC2IS(is);
+    }
+    if (pbc == NULL)
+    {
+        return CENTRAL;
+    }
+
+    /* The applied shift is a sum of box vectors, decompose it */
+    for (m = 0; m < DIM; m++)
+    {
+        ds[m] = dx_pbc[m] - (x[ai][m] - x[aj][m]);
+    }
+    clear_ivec(is);
+    for (d = pbc->ndim_ePBC - 1; d >= 0; d--)
+    {
+        is[d] = gmx_nint(ds[d]/pbc->box[d][d]);
+        for (m = 0; m <= d; m++)
+        {
+            ds[m] -= is[d]*pbc->box[d][m];
+        }
+    }
+
+    return IVEC2IS(is);
+}
+
 #endif /* SIMD_BONDEDS */
 
 /*
@@ -499,6 +540,141 @@ real bonds(int nbonds,
     return vtot;
 }
 
+#ifdef SIMD_BONDEDS
+
+/* As bonds, but using SIMD to calculate many bonds at once.
+ * Energies and shift forces are only calculated when fshift!=NULL.
+ */
+static real
+bonds_simd(int nbonds,
+           const t_iatom forceatoms[], const t_iparams forceparams[],
+           const rvec x[], rvec f[], rvec fshift[],
+           const t_pbc *pbc, const t_graph *g)
+{
+#define UNROLL GMX_SIMD_WIDTH_HERE
+    const int      nfa1 = 3;
+    int            i, iu, s, m, ki;
+    int            type, ai[UNROLL], aj[UNROLL];
+    real           coeff_array[2*UNROLL+UNROLL], *coeff;
+    real           dr_array[DIM*UNROLL+UNROLL], *dr;
+    real           f_buf_array[(DIM+1)*UNROLL+UNROLL], *f_buf;
+    real           vtot;
+    rvec           dx, fij;
+    gmx_mm_pr      k_S, b0_S;
+    gmx_mm_pr      dx_S, dy_S, dz_S;
+    gmx_mm_pr      dr2_S, dr2_min_S, invdr_S, ddr_S, fbond_S, v_S;
+    gmx_mm_pr      half_S, zero_S;
+    pbc_simd_t     pbc_simd;
+
+    /* Ensure register memory alignment */
+    coeff = gmx_simd_align_real(coeff_array);
+    dr    = gmx_simd_align_real(dr_array);
+    f_buf = gmx_simd_align_real(f_buf_array);
+
+    set_pbc_simd(pbc, &pbc_simd);
+
+    half_S    = gmx_set1_pr(0.5);
+    zero_S    = gmx_setzero_pr();
+    /* Used to avoid division by zero, the force is zero anyhow then */
+    dr2_min_S = gmx_set1_pr(GMX_REAL_MIN);
+
+    vtot = 0;
+
+    /* nbonds is the number of bonds times nfa1, here we step UNROLL bonds */
+    for (i = 0; (i < nbonds); i += UNROLL*nfa1)
+    {
+        /* Collect atoms for UNROLL bonds.
+         * iu indexes into forceatoms, we should not let iu go beyond nbonds.
+         */
+        iu = i;
+        for (s = 0; s < UNROLL; s++)
+        {
+            type  = forceatoms[iu];
+            ai[s] = forceatoms[iu+1];
+            aj[s] = forceatoms[iu+2];
+
+            coeff[s]        = forceparams[type].harmonic.krA;
+            coeff[UNROLL+s] = forceparams[type].harmonic.rA;
+
+            for (m = 0; m < DIM; m++)
+            {
+                dr[s + m*UNROLL] = x[ai[s]][m] - x[aj[s]][m];
+            }
+
+            /* At the end fill the arrays with identical entries */
+            if (iu + nfa1 < nbonds)
+            {
+                iu += nfa1;
+            }
+        }
+
+        k_S     = gmx_load_pr(coeff);
+        b0_S    = gmx_load_pr(coeff+UNROLL);
+
+        dx_S    = gmx_load_pr(dr + 0*UNROLL);
+        dy_S    = gmx_load_pr(dr + 1*UNROLL);
+        dz_S    = gmx_load_pr(dr + 2*UNROLL);
+
+        pbc_dx_simd(&dx_S, &dy_S, &dz_S, &pbc_simd);
+
+        dr2_S   = gmx_norm2_pr(dx_S, dy_S, dz_S);
+        invdr_S = gmx_invsqrt_pr(gmx_max_pr(dr2_S, dr2_min_S));
+
+        ddr_S   = gmx_sub_pr(gmx_mul_pr(dr2_S, invdr_S), b0_S);
+        fbond_S = gmx_mul_pr(gmx_mul_pr(k_S, ddr_S), invdr_S);
+
+        /* As in the plain-C code, bonds of zero length do not contribute */
+        v_S     = gmx_mul_pr(half_S, gmx_mul_pr(k_S, gmx_mul_pr(ddr_S, ddr_S)));
+        v_S     = gmx_blendzero_pr(v_S, gmx_cmplt_pr(zero_S, dr2_S));
+
+        /* Store -f[i] */
+        gmx_store_pr(f_buf + 0*UNROLL, gmx_mul_pr(fbond_S, dx_S));
+        gmx_store_pr(f_buf + 1*UNROLL, gmx_mul_pr(fbond_S, dy_S));
+        gmx_store_pr(f_buf + 2*UNROLL, gmx_mul_pr(fbond_S, dz_S));
+        gmx_store_pr(f_buf + 3*UNROLL, v_S);
+
+        if (fshift != NULL)
+        {
+            /* Store the pbc corrected distances for the shift forces */
+            gmx_store_pr(dr + 0*UNROLL, dx_S);
+            gmx_store_pr(dr + 1*UNROLL, dy_S);
+            gmx_store_pr(dr + 2*UNROLL, dz_S);
+        }
+
+        iu = i;
+        s  = 0;
+        do
+        {
+            for (m = 0; m < DIM; m++)
+            {
+                f[ai[s]][m] -= f_buf[s + m*UNROLL];
+                f[aj[s]][m] += f_buf[s + m*UNROLL];
+            }
+            if (fshift != NULL)
+            {
+                for (m = 0; m < DIM; m++)
+                {
+                    dx[m]  =  dr[s + m*UNROLL];
+                    fij[m] = -f_buf[s + m*UNROLL];
+                }
+                ki = shift_index_simd(pbc, g, x, ai[s], aj[s], dx);
+                rvec_inc(fshift[ki], fij);
+                rvec_dec(fshift[CENTRAL], fij);
+
+                vtot += f_buf[s + DIM*UNROLL];
+            }
+            s++;
+            iu += nfa1;
+        }
+        while (s < UNROLL && iu < nbonds);
+    }
+#undef UNROLL
+
+    return vtot;
+}
+
+#endif /* SIMD_BONDEDS */
+
 real restraint_bonds(int nbonds,
                      const t_iatom forceatoms[], const t_iparams forceparams[],
                      const rvec x[], rvec f[], rvec fshift[],
@@ -1038,41 +1214,47 @@ real angles(int nbonds,
 
 #ifdef SIMD_BONDEDS
 
-/* As angles, but using SIMD to calculate many dihedrals at once.
- * This routines does not calculate energies and shift forces.
+/* As angles and urey_bradley, but using SIMD to calculate many angles
+ * at once, ftype should be F_ANGLES or F_UREY_BRADLEY.
+ * Energies and shift forces are only calculated when fshift!=NULL.
  */
-static gmx_inline void
-angles_noener_simd(int nbonds,
-                   const t_iatom forceatoms[], const t_iparams forceparams[],
-                   const rvec x[], rvec f[],
-                   const t_pbc *pbc, const t_graph gmx_unused *g,
-                   real gmx_unused lambda,
-                   const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
-                   int gmx_unused *global_atom_index)
+static real
+angles_simd(int ftype, int nbonds,
+            const t_iatom forceatoms[], const t_iparams forceparams[],
+            const rvec x[], rvec f[], rvec fshift[],
+            const t_pbc *pbc, const t_graph *g)
 {
 #define UNROLL GMX_SIMD_WIDTH_HERE
     const int      nfa1 = 4;
-    int            i, iu, s, m;
+    int            i, iu, s, m, t1, t2;
     int            type, ai[UNROLL], aj[UNROLL], ak[UNROLL];
-    real           coeff_array[2*UNROLL+UNROLL], *coeff;
+    gmx_bool       bUB;
+    real           coeff_array[4*UNROLL+UNROLL], *coeff;
     real           dr_array[2*DIM*UNROLL+UNROLL], *dr;
-    real           f_buf_array[6*UNROLL+UNROLL], *f_buf;
-    gmx_mm_pr      k_S, theta0_S;
+    real           f_buf_array[(2*DIM+1)*UNROLL+UNROLL], *f_buf;
+    real           vtot;
+    rvec           r_ij, r_kj, f_i, f_j, f_k;
+    gmx_mm_pr      k_S, theta0_S, kUB_S, r13_S;
     gmx_mm_pr      rijx_S, rijy_S, rijz_S;
     gmx_mm_pr      rkjx_S, rkjy_S, rkjz_S;
-    gmx_mm_pr      one_S;
-    gmx_mm_pr      min_one_plus_eps_S;
+    gmx_mm_pr      rikx_S, riky_S, rikz_S;
+    gmx_mm_pr      one_S, half_S;
+    gmx_mm_pr      min_one_plus_eps_S, dr2_min_S;
     gmx_mm_pr      rij_rkj_S;
     gmx_mm_pr      nrij2_S, nrij_1_S;
     gmx_mm_pr      nrkj2_S, nrkj_1_S;
     gmx_mm_pr      cos_S, invsin_S;
-    gmx_mm_pr      theta_S;
+    gmx_mm_pr      theta_S, dtheta_S;
     gmx_mm_pr      st_S, sth_S;
     gmx_mm_pr      cik_S, cii_S, ckk_S;
+    gmx_mm_pr      dr2_S, invdr_S, ddr_S, fbond_S;
     gmx_mm_pr      f_ix_S, f_iy_S, f_iz_S;
     gmx_mm_pr      f_kx_S, f_ky_S, f_kz_S;
+    gmx_mm_pr      v_S;
     pbc_simd_t     pbc_simd;
 
+    bUB = (ftype == F_UREY_BRADLEY);
+
     /* Ensure register memory alignment */
     coeff = gmx_simd_align_real(coeff_array);
     dr    = gmx_simd_align_real(dr_array);
@@ -1080,11 +1262,17 @@ angles_noener_simd(int nbonds,
 
     set_pbc_simd(pbc, &pbc_simd);
 
-    one_S = gmx_set1_pr(1.0);
+    one_S     = gmx_set1_pr(1.0);
+    half_S    = gmx_set1_pr(0.5);
 
     /* The smallest number > -1 */
     min_one_plus_eps_S = gmx_set1_pr(-1.0 + 2*GMX_REAL_EPS);
 
+    /* Used to avoid division by zero for the Urey-Bradley bond */
+    dr2_min_S = gmx_set1_pr(GMX_REAL_MIN);
+
+    vtot = 0;
+
     /* nbonds is the number of angles times nfa1, here we step UNROLL angles */
     for (i = 0; (i < nbonds); i += UNROLL*nfa1)
     {
@@ -1099,8 +1287,18 @@ angles_noener_simd(int nbonds,
             aj[s] = forceatoms[iu+2];
             ak[s] = forceatoms[iu+3];
 
-            coeff[s]        = forceparams[type].harmonic.krA;
-            coeff[UNROLL+s] = forceparams[type].harmonic.rA*DEG2RAD;
+            if (bUB)
+            {
+                coeff[s]          = forceparams[type].u_b.kthetaA;
+                coeff[UNROLL+s]   = forceparams[type].u_b.thetaA*DEG2RAD;
+                coeff[2*UNROLL+s] = forceparams[type].u_b.kUBA;
+                coeff[3*UNROLL+s] = forceparams[type].u_b.r13A;
+            }
+            else
+            {
+                coeff[s]          = forceparams[type].harmonic.krA;
+                coeff[UNROLL+s]   = forceparams[type].harmonic.rA*DEG2RAD;
+            }
 
             /* If you can't use pbc_dx_simd below for PBC, e.g. because
              * you can't round in SIMD, use pbc_rvec_sub here.
@@ -1156,8 +1354,8 @@ angles_noener_simd(int nbonds,
 
         invsin_S  = gmx_invsqrt_pr(gmx_sub_pr(one_S, gmx_mul_pr(cos_S, cos_S)));
 
-        st_S      = gmx_mul_pr(gmx_mul_pr(k_S, gmx_sub_pr(theta0_S, theta_S)),
-                               invsin_S);
+        dtheta_S  = gmx_sub_pr(theta0_S, theta_S);
+        st_S      = gmx_mul_pr(gmx_mul_pr(k_S, dtheta_S), invsin_S);
         sth_S     = gmx_mul_pr(st_S, cos_S);
 
         cik_S     = gmx_mul_pr(st_S,  gmx_mul_pr(nrij_1_S, nrkj_1_S));
@@ -1177,12 +1375,51 @@ angles_noener_simd(int nbonds,
         f_kz_S    = gmx_mul_pr(ckk_S, rkjz_S);
         f_kz_S    = gmx_nmsub_pr(cik_S, rijz_S, f_kz_S);
 
+        v_S       = gmx_mul_pr(half_S, gmx_mul_pr(k_S, gmx_mul_pr(dtheta_S, dtheta_S)));
+
+        if (bUB)
+        {
+            /* The Urey-Bradley bond between atoms i and k */
+            kUB_S   = gmx_load_pr(coeff+2*UNROLL);
+            r13_S   = gmx_load_pr(coeff+3*UNROLL);
+
+            rikx_S  = gmx_sub_pr(rijx_S, rkjx_S);
+            riky_S  = gmx_sub_pr(rijy_S, rkjy_S);
+            rikz_S  = gmx_sub_pr(rijz_S, rkjz_S);
+
+            dr2_S   = gmx_norm2_pr(rikx_S, riky_S, rikz_S);
+            invdr_S = gmx_invsqrt_pr(gmx_max_pr(dr2_S, dr2_min_S));
+            ddr_S   = gmx_sub_pr(gmx_mul_pr(dr2_S, invdr_S), r13_S);
+            fbond_S = gmx_mul_pr(gmx_mul_pr(kUB_S, ddr_S), invdr_S);
+
+            f_ix_S  = gmx_nmsub_pr(fbond_S, rikx_S, f_ix_S);
+            f_iy_S  = gmx_nmsub_pr(fbond_S, riky_S, f_iy_S);
+            f_iz_S  = gmx_nmsub_pr(fbond_S, rikz_S, f_iz_S);
+            f_kx_S  = gmx_madd_pr(fbond_S, rikx_S, f_kx_S);
+            f_ky_S  = gmx_madd_pr(fbond_S, riky_S, f_ky_S);
+            f_kz_S  = gmx_madd_pr(fbond_S, rikz_S, f_kz_S);
+
+            v_S     = gmx_madd_pr(half_S, gmx_mul_pr(kUB_S, gmx_mul_pr(ddr_S, ddr_S)), v_S);
+        }
+
         gmx_store_pr(f_buf + 0*UNROLL, f_ix_S);
         gmx_store_pr(f_buf + 1*UNROLL, f_iy_S);
         gmx_store_pr(f_buf + 2*UNROLL, f_iz_S);
         gmx_store_pr(f_buf + 3*UNROLL, f_kx_S);
         gmx_store_pr(f_buf + 4*UNROLL, f_ky_S);
         gmx_store_pr(f_buf + 5*UNROLL, f_kz_S);
+        gmx_store_pr(f_buf + 6*UNROLL, v_S);
+
+        if (fshift != NULL)
+        {
+            /* Store the pbc corrected distances for the shift forces */
+            gmx_store_pr(dr + 0*UNROLL, rijx_S);
+            gmx_store_pr(dr + 1*UNROLL, rijy_S);
+            gmx_store_pr(dr + 2*UNROLL, rijz_S);
+            gmx_store_pr(dr + 3*UNROLL, rkjx_S);
+            gmx_store_pr(dr + 4*UNROLL, rkjy_S);
+            gmx_store_pr(dr + 5*UNROLL, rkjz_S);
+        }
 
         iu = i;
         s  = 0;
@@ -1194,12 +1431,32 @@ angles_noener_simd(int nbonds,
                 f[aj[s]][m] -= f_buf[s + m*UNROLL] + f_buf[s + (DIM+m)*UNROLL];
                 f[ak[s]][m] += f_buf[s + (DIM+m)*UNROLL];
             }
+            if (fshift != NULL)
+            {
+                for (m = 0; m < DIM; m++)
+                {
+                    r_ij[m] = dr[s +      m *UNROLL];
+                    r_kj[m] = dr[s + (DIM+m)*UNROLL];
+                    f_i[m]  = f_buf[s +      m *UNROLL];
+                    f_k[m]  = f_buf[s + (DIM+m)*UNROLL];
+                    f_j[m]  = -f_i[m] - f_k[m];
+                }
+                t1 = shift_index_simd(pbc, g, x, ai[s], aj[s], r_ij);
+                t2 = shift_index_simd(pbc, g, x, ak[s], aj[s], r_kj);
+                rvec_inc(fshift[t1], f_i);
+                rvec_inc(fshift[CENTRAL], f_j);
+                rvec_inc(fshift[t2], f_k);
+
+                vtot += f_buf[s + 2*DIM*UNROLL];
+            }
             s++;
             iu += nfa1;
         }
         while (s < UNROLL && iu < nbonds);
     }
 #undef UNROLL
+
+    return vtot;
 }
 
 #endif /* SIMD_BONDEDS */
@@ -1506,6 +1763,7 @@ real dih_angle(const rvec xi, const rvec xj, const rvec xk, const rvec xl,
 
 /* As dih_angle above, but calculates 4 dihedral angles at once using SIMD,
  * also calculates the pre-factor required for the dihedral force update.
+ * When dr_pbc!=NULL, the pbc corrected r_ij, r_kj and r_kl are stored there.
  * Note that bv and buf should be register aligned.
  */
 static gmx_inline void
@@ -1513,6 +1771,7 @@ dih_angle_simd(const rvec *x,
                const int *ai, const int *aj, const int *ak, const int *al,
                const pbc_simd_t *pbc,
                real *dr,
+               real *dr_pbc,
                gmx_mm_pr *phi_S,
                gmx_mm_pr *mx_S, gmx_mm_pr *my_S, gmx_mm_pr *mz_S,
                gmx_mm_pr *nx_S, gmx_mm_pr *ny_S, gmx_mm_pr *nz_S,
@@ -1572,6 +1831,19 @@ dih_angle_simd(const rvec *x,
     pbc_dx_simd(&rkjx_S, &rkjy_S, &rkjz_S, pbc);
     pbc_dx_simd(&rklx_S, &rkly_S, &rklz_S, pbc);
 
+    if (dr_pbc != NULL)
+    {
+        gmx_store_pr(dr_pbc + 0*UNROLL, rijx_S);
+        gmx_store_pr(dr_pbc + 1*UNROLL, rijy_S);
+        gmx_store_pr(dr_pbc + 2*UNROLL, rijz_S);
+        gmx_store_pr(dr_pbc + 3*UNROLL, rkjx_S);
+        gmx_store_pr(dr_pbc + 4*UNROLL, rkjy_S);
+        gmx_store_pr(dr_pbc + 5*UNROLL, rkjz_S);
+        gmx_store_pr(dr_pbc + 6*UNROLL, rklx_S);
+        gmx_store_pr(dr_pbc + 7*UNROLL, rkly_S);
+        gmx_store_pr(dr_pbc + 8*UNROLL, rklz_S);
+    }
+
     gmx_cprod_pr(rijx_S, rijy_S, rijz_S,
                  rkjx_S, rkjy_S, rkjz_S,
                  mx_S, my_S, mz_S);
@@ -1773,6 +2045,42 @@ do_dih_fup_noshiftf_precalc(int i, int j, int k, int l,
     rvec_inc(f[l], f_l);
 }
 
+/* As do_dih_fup_noshiftf_precalc above, but also updates the shift forces
+ * using the shift indices t1, t2, t3 of atoms i, k, l with respect to j.
+ */
+static gmx_inline void
+do_dih_fup_precalc(int i, int j, int k, int l,
+                   real p, real q,
+                   real f_i_x, real f_i_y, real f_i_z,
+                   real mf_l_x, real mf_l_y, real mf_l_z,
+                   rvec f[], rvec fshift[],
+                   int t1, int t2, int t3)
+{
+    rvec f_i, f_j, f_k, f_l;
+    rvec uvec, vvec, svec;
+
+    f_i[XX] = f_i_x;
+    f_i[YY] = f_i_y;
+    f_i[ZZ] = f_i_z;
+    f_l[XX] = -mf_l_x;
+    f_l[YY] = -mf_l_y;
+    f_l[ZZ] = -mf_l_z;
+    svmul(p, f_i, uvec);
+    svmul(q, f_l, vvec);
+    rvec_sub(uvec, vvec, svec);
+    rvec_sub(f_i, svec, f_j);
+    rvec_add(f_l, svec, f_k);
+    rvec_inc(f[i], f_i);
+    rvec_dec(f[j], f_j);
+    rvec_dec(f[k], f_k);
+    rvec_inc(f[l], f_l);
+
+    rvec_inc(fshift[t1], f_i);
+    rvec_dec(fshift[CENTRAL], f_j);
+    rvec_dec(fshift[t2], f_k);
+    rvec_inc(fshift[t3], f_l);
+}
+
 
 real dopdihs(real cpA, real cpB, real phiA, real phiB, int mult,
              real phi, real lambda, real *V, real *F)
@@ -1971,50 +2279,58 @@ pdihs_noener(int nbonds,
 
 #ifdef SIMD_BONDEDS
 
-/* As pdihs_noner above, but using SIMD to calculate many dihedrals at once */
-static void
-pdihs_noener_simd(int nbonds,
-                  const t_iatom forceatoms[], const t_iparams forceparams[],
-                  const rvec x[], rvec f[],
-                  const t_pbc *pbc, const t_graph gmx_unused *g,
-                  real gmx_unused lambda,
-                  const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
-                  int gmx_unused *global_atom_index)
+/* As pdihs, idihs and rbdihs, but using SIMD to calculate many dihedrals
+ * at once, ftype should be F_PDIHS, F_PIDIHS, F_IDIHS or F_RBDIHS.
+ * Energies and shift forces are only calculated when fshift!=NULL.
+ */
+static real
+dihs_simd(int ftype, int nbonds,
+          const t_iatom forceatoms[], const t_iparams forceparams[],
+          const rvec x[], rvec f[], rvec fshift[],
+          const t_pbc *pbc, const t_graph *g)
 {
 #define UNROLL GMX_SIMD_WIDTH_HERE
     const int       nfa1 = 5;
-    int             i, iu, s;
+    int             i, iu, s, m, j;
     int             type, ai[UNROLL], aj[UNROLL], ak[UNROLL], al[UNROLL];
-    int             t1[UNROLL], t2[UNROLL], t3[UNROLL];
-    real            ddphi;
+    int             t1, t2, t3;
     real            dr_array[3*DIM*UNROLL+UNROLL], *dr;
-    real            buf_array[7*UNROLL+UNROLL], *buf;
-    real           *cp, *phi0, *mult, *phi, *p, *q, *sf_i, *msf_l;
-    gmx_mm_pr       phi0_S, phi_S;
+    real            dr_pbc_array[3*DIM*UNROLL+UNROLL], *dr_pbc;
+    real            buf_array[(NR_RBDIHS+5)*UNROLL+UNROLL], *buf;
+    real           *parm, *p, *q, *v;
+    real            vtot;
+    rvec            r_ij, r_kj, r_lj;
+    gmx_mm_pr       phi_S;
     gmx_mm_pr       mx_S, my_S, mz_S;
     gmx_mm_pr       nx_S, ny_S, nz_S;
     gmx_mm_pr       nrkj_m2_S, nrkj_n2_S;
-    gmx_mm_pr       cp_S, mdphi_S, mult_S;
-    gmx_mm_pr       sin_S, cos_S;
-    gmx_mm_pr       mddphi_S;
+    gmx_mm_pr       c_S[NR_RBDIHS];
+    gmx_mm_pr       mdphi_S, dp_S, cos_S, sin_S, dvdc_S;
+    gmx_mm_pr       mddphi_S, v_S;
     gmx_mm_pr       sf_i_S, msf_l_S;
+    gmx_mm_pr       one_S, half_S, two_pi_S, inv_two_pi_S;
     pbc_simd_t      pbc_simd;
 
     /* Ensure SIMD register alignment */
-    dr  = gmx_simd_align_real(dr_array);
-    buf = gmx_simd_align_real(buf_array);
+    dr     = gmx_simd_align_real(dr_array);
+    dr_pbc = gmx_simd_align_real(dr_pbc_array);
+    buf    = gmx_simd_align_real(buf_array);
 
     /* Extract aligned pointer for parameters and variables */
-    cp    = buf + 0*UNROLL;
-    phi0  = buf + 1*UNROLL;
-    mult  = buf + 2*UNROLL;
-    p     = buf + 3*UNROLL;
-    q     = buf + 4*UNROLL;
-    sf_i  = buf + 5*UNROLL;
-    msf_l = buf + 6*UNROLL;
+    parm  = buf + 0*UNROLL;
+    p     = buf + (NR_RBDIHS + 0)*UNROLL;
+    q     = buf + (NR_RBDIHS + 1)*UNROLL;
+    v     = buf + (NR_RBDIHS + 2)*UNROLL;
 
     set_pbc_simd(pbc, &pbc_simd);
 
+    one_S        = gmx_set1_pr(1.0);
+    half_S       = gmx_set1_pr(0.5);
+    two_pi_S     = gmx_set1_pr(2*M_PI);
+    inv_two_pi_S = gmx_set1_pr(1/(2*M_PI));
+
+    vtot = 0;
+
     /* nbonds is the number of dihedrals times nfa1, here we step UNROLL dihs */
     for (i = 0; (i < nbonds); i += UNROLL*nfa1)
     {
@@ -2030,9 +2346,24 @@ pdihs_noener_simd(int nbonds,
             ak[s] = forceatoms[iu+3];
             al[s] = forceatoms[iu+4];
 
-            cp[s]   = forceparams[type].pdihs.cpA;
-            phi0[s] = forceparams[type].pdihs.phiA*DEG2RAD;
-            mult[s] = forceparams[type].pdihs.mult;
+            switch (ftype)
+            {
+                case F_RBDIHS:
+                    for (j = 0; j < NR_RBDIHS; j++)
+                    {
+                        parm[j*UNROLL+s] = forceparams[type].rbdihs.rbcA[j];
+                    }
+                    break;
+                case F_IDIHS:
+                    parm[s]          = forceparams[type].harmonic.krA;
+                    parm[UNROLL+s]   = forceparams[type].harmonic.rA*DEG2RAD;
+                    break;
+                default:
+                    parm[s]          = forceparams[type].pdihs.cpA;
+                    parm[UNROLL+s]   = forceparams[type].pdihs.phiA*DEG2RAD;
+                    parm[2*UNROLL+s] = forceparams[type].pdihs.mult;
+                    break;
+            }
 
             /* At the end fill the arrays with identical entries */
             if (iu + nfa1 < nbonds)
@@ -2043,7 +2374,7 @@ pdihs_noener_simd(int nbonds,
 
         /* Caclulate UNROLL dihedral angles at once */
         dih_angle_simd(x, ai, aj, ak, al, &pbc_simd,
-                       dr,
+                       dr, fshift != NULL ? dr_pbc : NULL,
                        &phi_S,
                        &mx_S, &my_S, &mz_S,
                        &nx_S, &ny_S, &nz_S,
@@ -2051,15 +2382,55 @@ pdihs_noener_simd(int nbonds,
                        &nrkj_n2_S,
                        p, q);
 
-        cp_S     = gmx_load_pr(cp);
-        phi0_S   = gmx_load_pr(phi0);
-        mult_S   = gmx_load_pr(mult);
-
-        mdphi_S  = gmx_sub_pr(gmx_mul_pr(mult_S, phi_S), phi0_S);
+        /* Calculate minus the derivative and the energy */
+        switch (ftype)
+        {
+            case F_RBDIHS:
+                for (j = 0; j < NR_RBDIHS; j++)
+                {
+                    c_S[j] = gmx_load_pr(parm + j*UNROLL);
+                }
+                /* In the polymer convention psi = phi - pi,
+                 * so cos(psi) = -cos(phi) and sin(psi) = -sin(phi).
+                 */
+                gmx_sincos_pr(phi_S, &sin_S, &cos_S);
+                cos_S    = gmx_sub_pr(gmx_setzero_pr(), cos_S);
+                /* Evaluate the polynomial and its derivative with Horner */
+                v_S      = c_S[NR_RBDIHS-1];
+                dvdc_S   = gmx_mul_pr(gmx_set1_pr(NR_RBDIHS-1), c_S[NR_RBDIHS-1]);
+                for (j = NR_RBDIHS-2; j >= 1; j--)
+                {
+                    v_S    = gmx_madd_pr(v_S, cos_S, c_S[j]);
+                    dvdc_S = gmx_madd_pr(dvdc_S, cos_S,
+                                         gmx_mul_pr(gmx_set1_pr(j), c_S[j]));
+                }
+                v_S      = gmx_madd_pr(v_S, cos_S, c_S[0]);
+                mddphi_S = gmx_mul_pr(gmx_sub_pr(gmx_setzero_pr(), dvdc_S), sin_S);
+                break;
+            case F_IDIHS:
+                c_S[0]   = gmx_load_pr(parm);
+                c_S[1]   = gmx_load_pr(parm + UNROLL);
+                /* Take phi - phi0 modulo (-pi, pi) */
+                dp_S     = gmx_sub_pr(phi_S, c_S[1]);
+                dp_S     = gmx_nmsub_pr(two_pi_S,
+                                        gmx_round_pr(gmx_mul_pr(dp_S, inv_two_pi_S)),
+                                        dp_S);
+                mddphi_S = gmx_mul_pr(gmx_sub_pr(gmx_setzero_pr(), c_S[0]), dp_S);
+                v_S      = gmx_mul_pr(half_S, gmx_mul_pr(c_S[0], gmx_mul_pr(dp_S, dp_S)));
+                break;
+            default:
+                c_S[0]   = gmx_load_pr(parm);
+                c_S[1]   = gmx_load_pr(parm + UNROLL);
+                c_S[2]   = gmx_load_pr(parm + 2*UNROLL);
+                mdphi_S  = gmx_sub_pr(gmx_mul_pr(c_S[2], phi_S), c_S[1]);
+                /* Calculate UNROLL sines at once */
+                gmx_sincos_pr(mdphi_S, &sin_S, &cos_S);
+                mddphi_S = gmx_mul_pr(gmx_mul_pr(c_S[0], c_S[2]), sin_S);
+                v_S      = gmx_mul_pr(c_S[0], gmx_add_pr(one_S, cos_S));
+                break;
+        }
+        gmx_store_pr(v, v_S);
 
-        /* Calculate UNROLL sines at once */
-        gmx_sincos_pr(mdphi_S, &sin_S, &cos_S);
-        mddphi_S = gmx_mul_pr(gmx_mul_pr(cp_S, mult_S), sin_S);
         sf_i_S   = gmx_mul_pr(mddphi_S, nrkj_m2_S);
         msf_l_S  = gmx_mul_pr(mddphi_S, nrkj_n2_S);
 
@@ -2084,21 +2455,100 @@ pdihs_noener_simd(int nbonds,
         s  = 0;
         do
         {
-            do_dih_fup_noshiftf_precalc(ai[s], aj[s], ak[s], al[s],
-                                        p[s], q[s],
-                                        dr[     XX *UNROLL+s],
-                                        dr[     YY *UNROLL+s],
-                                        dr[     ZZ *UNROLL+s],
-                                        dr[(DIM+XX)*UNROLL+s],
-                                        dr[(DIM+YY)*UNROLL+s],
-                                        dr[(DIM+ZZ)*UNROLL+s],
-                                        f);
+            if (fshift == NULL)
+            {
+                do_dih_fup_noshiftf_precalc(ai[s], aj[s], ak[s], al[s],
+                                            p[s], q[s],
+                                            dr[     XX *UNROLL+s],
+                                            dr[     YY *UNROLL+s],
+                                            dr[     ZZ *UNROLL+s],
+                                            dr[(DIM+XX)*UNROLL+s],
+                                            dr[(DIM+YY)*UNROLL+s],
+                                            dr[(DIM+ZZ)*UNROLL+s],
+                                            f);
+            }
+            else
+            {
+                for (m = 0; m < DIM; m++)
+                {
+                    r_ij[m] = dr_pbc[(0*DIM+m)*UNROLL+s];
+                    r_kj[m] = dr_pbc[(1*DIM+m)*UNROLL+s];
+                    r_lj[m] = r_kj[m] - dr_pbc[(2*DIM+m)*UNROLL+s];
+                }
+                t1 = shift_index_simd(pbc, g, x, ai[s], aj[s], r_ij);
+                t2 = shift_index_simd(pbc, g, x, ak[s], aj[s], r_kj);
+                t3 = shift_index_simd(pbc, g, x, al[s], aj[s], r_lj);
+
+                do_dih_fup_precalc(ai[s], aj[s], ak[s], al[s],
+                                   p[s], q[s],
+                                   dr[     XX *UNROLL+s],
+                                   dr[     YY *UNROLL+s],
+                                   dr[     ZZ *UNROLL+s],
+                                   dr[(DIM+XX)*UNROLL+s],
+                                   dr[(DIM+YY)*UNROLL+s],
+                                   dr[(DIM+ZZ)*UNROLL+s],
+                                   f, fshift, t1, t2, t3);
+
+                vtot += v[s];
+            }
             s++;
             iu += nfa1;
         }
         while (s < UNROLL && iu < nbonds);
     }
 #undef UNROLL
+
+    return vtot;
+}
+
+/* Returns whether there is a SIMD kernel for bonded type ftype */
+static gmx_bool ftype_is_simd(int ftype)
+{
+    switch (ftype)
+    {
+        case F_BONDS:
+        case F_ANGLES:
+        case F_UREY_BRADLEY:
+        case F_PDIHS:
+        case F_PIDIHS:
+        case F_IDIHS:
+        case F_RBDIHS:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/* Calculates bonded interactions of type ftype using SIMD kernels,
+ * only the A-state parameters are used.
+ * Energies and shift forces are only calculated when fshift!=NULL.
+ */
+static real calc_one_bond_simd(int ftype, int nbonds,
+                               const t_iatom forceatoms[],
+                               const t_iparams forceparams[],
+                               const rvec x[], rvec f[], rvec fshift[],
+                               const t_pbc *pbc, const t_graph *g)
+{
+    real v;
+
+    switch (ftype)
+    {
+        case F_BONDS:
+            v = bonds_simd(nbonds, forceatoms, forceparams,
+                           x, f, fshift, pbc, g);
+            break;
+        case F_ANGLES:
+        case F_UREY_BRADLEY:
+            v = angles_simd(ftype, nbonds, forceatoms, forceparams,
+                            x, f, fshift, pbc, g);
+            break;
+        default:
+            v = dihs_simd(ftype, nbonds, forceatoms, forceparams,
+                          x, f, fshift, pbc, g);
+            break;
+    }
+
+    return v;
 }
 
 #endif /* SIMD_BONDEDS */
@@ -3831,6 +4281,18 @@ static void divide_bondeds_over_threads(t_idef *idef, int nthreads)
                  * (not implemented yet) will do better.
                  */
                 il_nr_thread = (((idef->il[ftype].nr/nat1)*t)/nthreads)*nat1;
+#ifdef SIMD_BONDEDS
+                if (ftype_is_simd(ftype) && t < nthreads)
+                {
+                    /* Round to a multiple of the SIMD width, so the SIMD
+                     * kernels only process a partially filled batch
+                     * at the end of the last thread.
+                     */
+                    il_nr_thread = il_nr_thread/nat1 + GMX_SIMD_WIDTH_HERE/2;
+                    il_nr_thread = il_nr_thread - il_nr_thread % GMX_SIMD_WIDTH_HERE;
+                    il_nr_thread = min(il_nr_thread*nat1, idef->il[ftype].nr);
+                }
+#endif
 
                 /* Ensure that distance restraint pairs with the same label
                  * end up on the same thread.
@@ -3854,15 +4316,29 @@ static void divide_bondeds_over_threads(t_idef *idef, int nthreads)
     }
 }
 
-static unsigned
+/* The number of bits in a word of the reduction mask */
+#define RED_MASK_BITS 32
+
+/* Sets the mask and list of force blocks thread t writes to */
+static void
 calc_bonded_reduction_mask(const t_idef *idef,
-                           int shift,
-                           int t, int nt)
+                           int shift, int nblock,
+                           int t, int nt,
+                           f_thread_t *f_t)
 {
-    unsigned mask;
-    int      ftype, nb, nat1, nb0, nb1, i, a;
+    int      nword, ftype, nb, nat1, nb0, nb1, i, a, b;
+    unsigned bit;
 
-    mask = 0;
+    nword = (nblock + RED_MASK_BITS - 1)/RED_MASK_BITS;
+    if (nword > f_t->red_mask_nalloc)
+    {
+        f_t->red_mask_nalloc = over_alloc_large(nword);
+        srenew(f_t->red_mask, f_t->red_mask_nalloc);
+    }
+    for (i = 0; i < nword; i++)
+    {
+        f_t->red_mask[i] = 0;
+    }
 
     for (ftype = 0; ftype < F_NRE; ftype++)
     {
@@ -3883,21 +4359,41 @@ calc_bonded_reduction_mask(const t_idef *idef,
                 {
                     for (a = 1; a < nat1; a++)
                     {
-                        mask |= (1U << (idef->il[ftype].iatoms[i+a]>>shift));
+                        b = (idef->il[ftype].iatoms[i+a]>>shift);
+                        f_t->red_mask[b/RED_MASK_BITS] |= (1U << (b % RED_MASK_BITS));
                     }
                 }
             }
         }
     }
 
-    return mask;
+    /* Make a list of the marked blocks, so the clearing of the buffer
+     * only touches the parts of f this thread writes to.
+     */
+    f_t->red_nblock = 0;
+    for (i = 0; i < nword; i++)
+    {
+        if (f_t->red_mask[i] != 0)
+        {
+            for (bit = 0; bit < RED_MASK_BITS; bit++)
+            {
+                if (f_t->red_mask[i] & (1U << bit))
+                {
+                    if (f_t->red_nblock >= f_t->red_block_nalloc)
+                    {
+                        f_t->red_block_nalloc = over_alloc_large(f_t->red_nblock + 1);
+                        srenew(f_t->red_block, f_t->red_block_nalloc);
+                    }
+                    f_t->red_block[f_t->red_nblock++] = i*RED_MASK_BITS + bit;
+                }
+            }
+        }
+    }
 }
 
 void setup_bonded_threading(t_forcerec   *fr, t_idef *idef)
 {
-#define MAX_BLOCK_BITS 32
-    int t;
-    int ctot, c, b;
+    int t, b, i, ind, ctot;
 
     assert(fr->nthreads >= 1);
 
@@ -3906,19 +4402,18 @@ void setup_bonded_threading(t_forcerec   *fr, t_idef *idef)
 
     if (fr->nthreads == 1)
     {
-        fr->red_nblock = 0;
+        fr->red_nblock      = 0;
+        fr->red_nblock_used = 0;
 
         return;
     }
 
-    /* We divide the force array in a maximum of 32 blocks.
-     * Minimum force block reduction size is 2^6=64.
+    /* We divide the force array in blocks of 32 atoms, which is fine
+     * enough to only clear and reduce the parts of the thread force
+     * buffers that are actually written to, also with many threads.
      */
-    fr->red_ashift = 6;
-    while (fr->natoms_force > (int)(MAX_BLOCK_BITS*(1U<<fr->red_ashift)))
-    {
-        fr->red_ashift++;
-    }
+    fr->red_ashift = 5;
+    fr->red_nblock = (fr->natoms_force + (1<<fr->red_ashift) - 1)>>fr->red_ashift;
     if (debug)
     {
         fprintf(debug, "bonded force buffer block atom shift %d bits\n",
@@ -3931,45 +4426,93 @@ void setup_bonded_threading(t_forcerec   *fr, t_idef *idef)
 #pragma omp parallel for num_threads(fr->nthreads) schedule(static)
     for (t = 1; t < fr->nthreads; t++)
     {
-        fr->f_t[t].red_mask =
-            calc_bonded_reduction_mask(idef, fr->red_ashift, t, fr->nthreads);
+        calc_bonded_reduction_mask(idef, fr->red_ashift, fr->red_nblock,
+                                   t, fr->nthreads, &fr->f_t[t]);
     }
 
-    /* Determine the maximum number of blocks we need to reduce over */
-    fr->red_nblock = 0;
-    ctot           = 0;
-    for (t = 0; t < fr->nthreads; t++)
+    /* Make the list of blocks that need to be reduced, with for each block
+     * the list of threads that contribute to it. Each block is reduced
+     * by a single thread, so no atomic operations are required.
+     */
+    if (fr->red_nblock + 1 > fr->red_block_nalloc)
     {
-        c = 0;
-        for (b = 0; b < MAX_BLOCK_BITS; b++)
+        fr->red_block_nalloc = over_alloc_large(fr->red_nblock + 1);
+        srenew(fr->red_block_used, fr->red_block_nalloc);
+        srenew(fr->red_thread_ind, fr->red_block_nalloc);
+    }
+    /* Count the contributing threads per block in red_thread_ind */
+    for (b = 0; b < fr->red_nblock; b++)
+    {
+        fr->red_thread_ind[b] = 0;
+    }
+    ctot = 0;
+    for (t = 1; t < fr->nthreads; t++)
+    {
+        for (i = 0; i < fr->f_t[t].red_nblock; i++)
         {
-            if (fr->f_t[t].red_mask & (1U<<b))
-            {
-                fr->red_nblock = max(fr->red_nblock, b+1);
-                c++;
-            }
+            fr->red_thread_ind[fr->f_t[t].red_block[i]]++;
         }
+        ctot += fr->f_t[t].red_nblock;
         if (debug)
         {
-            fprintf(debug, "thread %d flags %x count %d\n",
-                    t, fr->f_t[t].red_mask, c);
+            fprintf(debug, "thread %d count %d\n", t, fr->f_t[t].red_nblock);
+        }
+    }
+    /* Compact the list to the used blocks and convert counts to indices */
+    fr->red_nblock_used = 0;
+    ind                 = 0;
+    for (b = 0; b < fr->red_nblock; b++)
+    {
+        if (fr->red_thread_ind[b] > 0)
+        {
+            fr->red_block_used[fr->red_nblock_used] = b;
+            i                                       = fr->red_thread_ind[b];
+            fr->red_thread_ind[fr->red_nblock_used] = ind;
+            fr->red_nblock_used++;
+            ind += i;
+        }
+    }
+    fr->red_thread_ind[fr->red_nblock_used] = ind;
+
+    if (ctot > fr->red_thread_nalloc)
+    {
+        fr->red_thread_nalloc = over_alloc_large(ctot);
+        srenew(fr->red_thread, fr->red_thread_nalloc);
+    }
+    /* Fill the thread lists, the block lists of each thread are ordered */
+    {
+        int *fill;
+
+        snew(fill, fr->red_nblock_used);
+        for (t = 1; t < fr->nthreads; t++)
+        {
+            b = 0;
+            for (i = 0; i < fr->f_t[t].red_nblock; i++)
+            {
+                /* Both lists are sorted, so we can search forward */
+                while (fr->red_block_used[b] != fr->f_t[t].red_block[i])
+                {
+                    b++;
+                }
+                fr->red_thread[fr->red_thread_ind[b] + fill[b]++] = t;
+            }
         }
-        ctot += c;
+        sfree(fill);
     }
+
     if (debug)
     {
-        fprintf(debug, "Number of blocks to reduce: %d of size %d\n",
-                fr->red_nblock, 1<<fr->red_ashift);
+        fprintf(debug, "Number of blocks to reduce: %d of %d, size %d\n",
+                fr->red_nblock_used, fr->red_nblock, 1<<fr->red_ashift);
         fprintf(debug, "Reduction density %.2f density/#thread %.2f\n",
                 ctot*(1<<fr->red_ashift)/(double)fr->natoms_force,
                 ctot*(1<<fr->red_ashift)/(double)(fr->natoms_force*fr->nthreads));
     }
 }
 
-static void zero_thread_forces(f_thread_t *f_t, int n,
-                               int nblock, int blocksize)
+static void zero_thread_forces(f_thread_t *f_t, int n, int ashift)
 {
-    int b, a0, a1, a, i, j;
+    int i, j, b, a0, a1, a;
 
     if (n > f_t->f_nalloc)
     {
@@ -3977,19 +4520,15 @@ static void zero_thread_forces(f_thread_t *f_t, int n,
         srenew(f_t->f, f_t->f_nalloc);
     }
 
-    if (f_t->red_mask != 0)
+    /* Only clear the blocks this thread writes to */
+    for (i = 0; i < f_t->red_nblock; i++)
     {
-        for (b = 0; b < nblock; b++)
+        b  = f_t->red_block[i];
+        a0 = b<<ashift;
+        a1 = min(a0 + (1<<ashift), n);
+        for (a = a0; a < a1; a++)
         {
-            if (f_t->red_mask && (1U<<b))
-            {
-                a0 = b*blocksize;
-                a1 = min((b+1)*blocksize, n);
-                for (a = a0; a < a1; a++)
-                {
-                    clear_rvec(f_t->f[a]);
-                }
-            }
+            clear_rvec(f_t->f[a]);
         }
     }
     for (i = 0; i < SHIFTS; i++)
@@ -4013,54 +4552,31 @@ static void zero_thread_forces(f_thread_t *f_t, int n,
     }
 }
 
-static void reduce_thread_force_buffer(int n, rvec *f,
-                                       int nthreads, f_thread_t *f_t,
-                                       int nblock, int block_size)
+static void reduce_thread_force_buffer(int n, rvec *f, const t_forcerec *fr)
 {
-    /* The max thread number is arbitrary,
-     * we used a fixed number to avoid memory management.
-     * Using more than 16 threads is probably never useful performance wise.
-     */
-#define MAX_BONDED_THREADS 256
-    int b;
-
-    if (nthreads > MAX_BONDED_THREADS)
-    {
-        gmx_fatal(FARGS, "Can not reduce bonded forces on more than %d threads",
-                  MAX_BONDED_THREADS);
-    }
+    int i;
 
     /* This reduction can run on any number of threads,
      * independently of nthreads.
      */
-#pragma omp parallel for num_threads(nthreads) schedule(static)
-    for (b = 0; b < nblock; b++)
+#pragma omp parallel for num_threads(fr->nthreads) schedule(static)
+    for (i = 0; i < fr->red_nblock_used; i++)
     {
-        rvec *fp[MAX_BONDED_THREADS];
-        int   nfb, ft, fb;
-        int   a0, a1, a;
+        int   t0, t1, t, a0, a1, a;
 
-        /* Determine which threads contribute to this block */
-        nfb = 0;
-        for (ft = 1; ft < nthreads; ft++)
+        /* Reduce force buffers for threads that contribute to this block */
+        t0 = fr->red_thread_ind[i];
+        t1 = fr->red_thread_ind[i+1];
+        a0 = fr->red_block_used[i]<<fr->red_ashift;
+        a1 = min(a0 + (1<<fr->red_ashift), n);
+        for (t = t0; t < t1; t++)
         {
-            if (f_t[ft].red_mask & (1U<<b))
-            {
-                fp[nfb++] = f_t[ft].f;
-            }
-        }
-        if (nfb > 0)
-        {
-            /* Reduce force buffers for threads that contribute */
-            a0 =  b   *block_size;
-            a1 = (b+1)*block_size;
-            a1 = min(a1, n);
+            rvec *fp;
+
+            fp = fr->f_t[fr->red_thread[t]].f;
             for (a = a0; a < a1; a++)
             {
-                for (fb = 0; fb < nfb; fb++)
-                {
-                    rvec_inc(f[a], fp[fb][a]);
-                }
+                rvec_inc(f[a], fp[a]);
             }
         }
     }
@@ -4068,15 +4584,20 @@ static void reduce_thread_force_buffer(int n, rvec *f,
 
 static void reduce_thread_forces(int n, rvec *f, rvec *fshift,
                                  real *ener, gmx_grppairener_t *grpp, real *dvdl,
-                                 int nthreads, f_thread_t *f_t,
-                                 int nblock, int block_size,
+                                 const t_forcerec *fr,
                                  gmx_bool bCalcEnerVir,
                                  gmx_bool bDHDL)
 {
-    if (nblock > 0)
+    int         nthreads;
+    f_thread_t *f_t;
+
+    nthreads = fr->nthreads;
+    f_t      = fr->f_t;
+
+    if (fr->red_nblock_used > 0)
     {
         /* Reduce the bonded force buffer */
-        reduce_thread_force_buffer(n, f, nthreads, f_t, nblock, block_size);
+        reduce_thread_force_buffer(n, f, fr);
     }
 
     /* When necessary, reduce energy and virial using one thread only */
@@ -4167,32 +4688,26 @@ static real calc_one_bond(FILE *fplog, int thread,
                           md, fcd, global_atom_index);
         }
 #ifdef SIMD_BONDEDS
-        else if (ftype == F_ANGLES &&
-                 !bCalcEnerVir && fr->efep == efepNO)
-        {
-            /* No energies, shift forces, dvdl */
-            angles_noener_simd(nbn, idef->il[ftype].iatoms+nb0,
-                               idef->iparams,
-                               (const rvec*)x, f,
-                               pbc, g, lambda[efptFTYPE], md, fcd,
-                               global_atom_index);
-            v = 0;
+        else if (fr->bSimdBondeds && ftype_is_simd(ftype) &&
+                 fr->efep == efepNO)
+        {
+            /* No dvdl, energies and shift forces only when requested */
+            v = calc_one_bond_simd(ftype, nbn, iatoms+nb0,
+                                   idef->iparams,
+                                   (const rvec*)x, f,
+                                   bCalcEnerVir ? fshift : NULL,
+                                   pbc, g);
         }
 #endif
         else if (ftype == F_PDIHS &&
                  !bCalcEnerVir && fr->efep == efepNO)
         {
             /* No energies, shift forces, dvdl */
-#ifndef SIMD_BONDEDS
-            pdihs_noener
-#else
-            pdihs_noener_simd
-#endif
-                (nbn, idef->il[ftype].iatoms+nb0,
-                 idef->iparams,
-                 (const rvec*)x, f,
-                 pbc, g, lambda[efptFTYPE], md, fcd,
-                 global_atom_index);
+            pdihs_noener(nbn, idef->il[ftype].iatoms+nb0,
+                         idef->iparams,
+                         (const rvec*)x, f,
+                         pbc, g, lambda[efptFTYPE], md, fcd,
+                         global_atom_index);
             v = 0;
         }
         else
@@ -4328,7 +4843,7 @@ void calc_bonds(FILE *fplog, const gmx_multisim_t *ms,
         else
         {
             zero_thread_forces(&fr->f_t[thread], fr->natoms_force,
-                               fr->red_nblock, 1<<fr->red_ashift);
+                               fr->red_ashift);
 
             ft     = fr->f_t[thread].f;
             fshift = fr->f_t[thread].fshift;
@@ -4354,8 +4869,7 @@ void calc_bonds(FILE *fplog, const gmx_multisim_t *ms,
     {
         reduce_thread_forces(fr->natoms_force, f, fr->fshift,
                              enerd->term, &enerd->grpp, dvdl,
-                             fr->nthreads, fr->f_t,
-                             fr->red_nblock, 1<<fr->red_ashift,
+                             fr,
                              bCalcEnerVir,
                              force_flags & GMX_FORCE_DHDL);
     }
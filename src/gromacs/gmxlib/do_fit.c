@@ -38,6 +38,7 @@
 #endif
 
 #include "maths.h"
+#include "macros.h"
 #include "sysstuff.h"
 #include "typedefs.h"
 #include "nrjac.h"
@@ -45,6 +46,7 @@
 #include "txtdump.h"
 #include "smalloc.h"
 #include "do_fit.h"
+#include "gromacs/utility/gmxomp.h"
 
 #define EPS 1.0e-09
 
@@ -291,6 +293,198 @@ void do_fit(int natoms, real *w_rls, rvec *xp, rvec *x)
     do_fit_ndim(3, natoms, w_rls, xp, x);
 }
 
+/* Returns the RMSD after optimal superposition of the n packed
+ * atoms in a and b, stored as n x, n y and n z coordinates premultiplied
+ * by sqrt(weight). ga and gb are the weighted inner products of a and b
+ * with themselves, wtot is the sum of the weights.
+ * The quaternion characteristic polynomial (QCP) method is used:
+ * D. L. Theobald, Acta Cryst. A61, 478 (2005);
+ * P. Liu, D. K. Agrafiotis and D. L. Theobald, J. Comp. Chem. 31, 1561 (2010).
+ */
+static real rmsd_qcp(int n, const real *a, const real *b,
+                     double ga, double gb, double wtot)
+{
+    const real *ax, *ay, *az, *bx, *by, *bz;
+    double      sxx, sxy, sxz, syx, syy, syz, szx, szy, szz;
+    double      sxx2, syy2, szz2, sxy2, syz2, sxz2, syx2, szy2, szx2;
+    double      syzszymsyyszz2, sxx2syy2szz2syz2szy2, sxy2sxz2syx2szx2;
+    double      sxzpszx, syzpszy, sxypsyx, syzmszy, sxzmszx, sxymsyx;
+    double      sxxpsyy, sxxmsyy;
+    double      c0, c1, c2, e0, lambda, lambda_old, x2, b2, a2;
+    int         i;
+
+    ax = a;
+    ay = a + n;
+    az = a + 2*n;
+    bx = b;
+    by = b + n;
+    bz = b + 2*n;
+
+    sxx = sxy = sxz = 0;
+    syx = syy = syz = 0;
+    szx = szy = szz = 0;
+    /* This loop, which does nearly all the work, is easily vectorized */
+    for (i = 0; i < n; i++)
+    {
+        sxx += ax[i]*bx[i];
+        sxy += ax[i]*by[i];
+        sxz += ax[i]*bz[i];
+        syx += ay[i]*bx[i];
+        syy += ay[i]*by[i];
+        syz += ay[i]*bz[i];
+        szx += az[i]*bx[i];
+        szy += az[i]*by[i];
+        szz += az[i]*bz[i];
+    }
+
+    /* The coefficients of the characteristic polynomial of the 4x4
+     * key matrix, the x^3 coefficient is zero.
+     */
+    sxx2 = sxx*sxx;
+    syy2 = syy*syy;
+    szz2 = szz*szz;
+    sxy2 = sxy*sxy;
+    syz2 = syz*syz;
+    sxz2 = sxz*sxz;
+    syx2 = syx*syx;
+    szy2 = szy*szy;
+    szx2 = szx*szx;
+
+    syzszymsyyszz2       = 2.0*(syz*szy - syy*szz);
+    sxx2syy2szz2syz2szy2 = syy2 + szz2 - sxx2 + syz2 + szy2;
+
+    c2 = -2.0*(sxx2 + syy2 + szz2 + sxy2 + syx2 + sxz2 + szx2 + syz2 + szy2);
+    c1 = 8.0*(sxx*syz*szy + syy*szx*sxz + szz*sxy*syx -
+              sxx*syy*szz - syz*szx*sxy - szy*syx*sxz);
+
+    sxzpszx = sxz + szx;
+    syzpszy = syz + szy;
+    sxypsyx = sxy + syx;
+    syzmszy = syz - szy;
+    sxzmszx = sxz - szx;
+    sxymsyx = sxy - syx;
+    sxxpsyy = sxx + syy;
+    sxxmsyy = sxx - syy;
+
+    sxy2sxz2syx2szx2 = sxy2 + sxz2 - syx2 - szx2;
+
+    c0 = sxy2sxz2syx2szx2*sxy2sxz2syx2szx2
+        + (sxx2syy2szz2syz2szy2 + syzszymsyyszz2)*(sxx2syy2szz2syz2szy2 - syzszymsyyszz2)
+        + (-sxzpszx*syzmszy + sxymsyx*(sxxmsyy - szz))*(-sxzmszx*syzpszy + sxymsyx*(sxxmsyy + szz))
+        + (-sxzpszx*syzpszy - sxypsyx*(sxxpsyy - szz))*(-sxzmszx*syzmszy - sxypsyx*(sxxpsyy + szz))
+        + (sxypsyx*syzpszy + sxzpszx*(sxxmsyy + szz))*(-sxymsyx*syzmszy + sxzpszx*(sxxpsyy + szz))
+        + (sxypsyx*syzmszy + sxzmszx*(sxxmsyy - szz))*(-sxymsyx*syzpszy + sxzmszx*(sxxpsyy - szz));
+
+    /* Newton-Raphson for the largest eigenvalue, which is bounded by e0 */
+    e0     = 0.5*(ga + gb);
+    lambda = e0;
+    for (i = 0; i < 50; i++)
+    {
+        lambda_old = lambda;
+        x2         = lambda*lambda;
+        b2         = (x2 + c2)*lambda;
+        a2         = b2 + c1;
+        lambda    -= (a2*lambda + c0)/(2.0*x2*lambda + b2 + a2);
+        if (fabs(lambda - lambda_old) < fabs(1e-11*lambda))
+        {
+            break;
+        }
+    }
+
+    return sqrt(fabs(2.0*(e0 - lambda)/wtot));
+}
+
+void calc_rmsd_matrix_qcp(int natoms, const real *w,
+                          int nframe1, rvec **x1, int nframe2, rvec **x2,
+                          real **rmsd)
+{
+    gmx_bool bSym;
+    int      nw, i, j, f, d, n, nframe, nb, ntile1, ntile2, t, nthreads;
+    int     *ind;
+    real    *sqrtw, *xpack;
+    double  *g, wtot;
+    rvec   **xf;
+
+    bSym = (x2 == x1);
+
+    /* Only atoms with non-zero weight contribute, pack only those */
+    snew(ind, natoms);
+    snew(sqrtw, natoms);
+    nw   = 0;
+    wtot = 0;
+    for (i = 0; i < natoms; i++)
+    {
+        if (w[i] > 0)
+        {
+            ind[nw]   = i;
+            sqrtw[nw] = sqrt(w[i]);
+            wtot     += w[i];
+            nw++;
+        }
+    }
+
+    /* Store the weighted coordinates of each frame as x, y and z arrays */
+    nframe = nframe1 + (bSym ? 0 : nframe2);
+    snew(xpack, (size_t)nframe*DIM*nw);
+    snew(g, nframe);
+    for (f = 0; f < nframe; f++)
+    {
+        xf = (f < nframe1 ? x1 : x2);
+        n  = (f < nframe1 ? f : f - nframe1);
+        for (d = 0; d < DIM; d++)
+        {
+            for (i = 0; i < nw; i++)
+            {
+                xpack[((size_t)f*DIM + d)*nw + i] = sqrtw[i]*xf[n][ind[i]][d];
+            }
+        }
+        g[f] = 0;
+        for (i = 0; i < DIM*nw; i++)
+        {
+            g[f] += xpack[(size_t)f*DIM*nw + i]*xpack[(size_t)f*DIM*nw + i];
+        }
+    }
+
+    /* Loop over tiles of frame pairs, with tiles small enough
+     * for the frames of a tile to stay in cache.
+     */
+    nb       = min(64, max(1, 16384/(DIM*max(nw, 1))));
+    ntile1   = (nframe1 + nb - 1)/nb;
+    ntile2   = (nframe2 + nb - 1)/nb;
+    nthreads = gmx_omp_get_max_threads();
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic) private(i, j)
+    for (t = 0; t < ntile1*ntile2; t++)
+    {
+        int i0, i1, j0, j1, jf;
+
+        i0 = (t/ntile2)*nb;
+        i1 = min(i0 + nb, nframe1);
+        j0 = (t % ntile2)*nb;
+        j1 = min(j0 + nb, nframe2);
+        if (bSym && j1 <= i0 + 1)
+        {
+            /* This tile only contains elements with j<=i */
+            continue;
+        }
+        for (i = i0; i < i1; i++)
+        {
+            for (j = (bSym ? max(j0, i + 1) : j0); j < j1; j++)
+            {
+                jf         = (bSym ? j : nframe1 + j);
+                rmsd[i][j] = rmsd_qcp(nw,
+                                      xpack + (size_t)i*DIM*nw,
+                                      xpack + (size_t)jf*DIM*nw,
+                                      g[i], g[jf], wtot);
+            }
+        }
+    }
+
+    sfree(g);
+    sfree(xpack);
+    sfree(sqrtw);
+    sfree(ind);
+}
+
 void reset_x_ndim(int ndim, int ncm, const atom_id *ind_cm,
                   int nreset, const atom_id *ind_reset,
                   rvec x[], const real mass[])
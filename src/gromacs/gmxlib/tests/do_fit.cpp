@@ -0,0 +1,291 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2013, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the QCP RMSD matrix against do_fit() and rmsdev().
+ */
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/legacyheaders/do_fit.h"
+#include "gromacs/legacyheaders/gmx_random.h"
+#include "gromacs/legacyheaders/smalloc.h"
+#include "gromacs/legacyheaders/vec.h"
+
+namespace
+{
+
+//! Number of atoms in the test structures.
+const int natoms = 40;
+//! Number of frames in the test structures.
+const int nframes = 6;
+
+/*! \brief
+ * Test fixture for calc_rmsd_matrix_qcp().
+ *
+ * Holds nframes frames of natoms atoms and the fit weights.
+ */
+class RmsdMatrixQcpTest : public ::testing::Test
+{
+    public:
+        RmsdMatrixQcpTest()
+            : rng_(gmx_rng_init(1993))
+        {
+            snew(w_, natoms);
+            snew(x_, nframes);
+            for (int f = 0; f < nframes; f++)
+            {
+                snew(x_[f], natoms);
+            }
+            snew(rmsd_, nframes);
+            for (int f = 0; f < nframes; f++)
+            {
+                snew(rmsd_[f], nframes);
+            }
+        }
+        ~RmsdMatrixQcpTest()
+        {
+            for (int f = 0; f < nframes; f++)
+            {
+                sfree(rmsd_[f]);
+                sfree(x_[f]);
+            }
+            sfree(rmsd_);
+            sfree(x_);
+            sfree(w_);
+            gmx_rng_destroy(rng_);
+        }
+
+        //! Returns a random number in [-1, 1).
+        real random() { return 2*gmx_rng_uniform_real(rng_) - 1; }
+
+        /*! \brief
+         * Sets random weights, with zero weight for every fifth atom.
+         */
+        void setRandomWeights()
+        {
+            for (int i = 0; i < natoms; i++)
+            {
+                w_[i] = (i % 5 == 4 ? 0 : 1 + random());
+            }
+        }
+
+        //! Sets frame f to random coordinates, with z=0 when bPlanar.
+        void setRandomFrame(int f, bool bPlanar)
+        {
+            for (int i = 0; i < natoms; i++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    x_[f][i][d] = (bPlanar && d == ZZ ? 0 : 2*random());
+                }
+            }
+        }
+
+        //! Sets frame f to a random rotation and small perturbation of frame f0.
+        void setRotatedFrame(int f, int f0, real noise)
+        {
+            rvec   axis;
+            matrix R;
+            real   angle = M_PI*random();
+
+            axis[XX] = random();
+            axis[YY] = random();
+            axis[ZZ] = random();
+            unitv(axis, axis);
+            /* Rodrigues' rotation formula */
+            for (int r = 0; r < DIM; r++)
+            {
+                for (int c = 0; c < DIM; c++)
+                {
+                    R[r][c] = (1 - std::cos(angle))*axis[r]*axis[c]
+                        + (r == c ? std::cos(angle) : 0);
+                }
+            }
+            R[XX][YY] -= std::sin(angle)*axis[ZZ];
+            R[YY][XX] += std::sin(angle)*axis[ZZ];
+            R[XX][ZZ] += std::sin(angle)*axis[YY];
+            R[ZZ][XX] -= std::sin(angle)*axis[YY];
+            R[YY][ZZ] -= std::sin(angle)*axis[XX];
+            R[ZZ][YY] += std::sin(angle)*axis[XX];
+            for (int i = 0; i < natoms; i++)
+            {
+                mvmul(R, x_[f0][i], x_[f][i]);
+                for (int d = 0; d < DIM; d++)
+                {
+                    x_[f][i][d] += noise*random();
+                }
+            }
+        }
+
+        //! Puts the weighted center of all frames in the origin.
+        void centerFrames()
+        {
+            for (int f = 0; f < nframes; f++)
+            {
+                reset_x(natoms, NULL, natoms, NULL, x_[f], w_);
+            }
+        }
+
+        /*! \brief
+         * Returns the RMSD of frames f1 and f2 with do_fit() and rmsdev().
+         */
+        real referenceRmsd(int f1, int f2)
+        {
+            rvec *xfit;
+            real  rmsd;
+
+            snew(xfit, natoms);
+            for (int i = 0; i < natoms; i++)
+            {
+                copy_rvec(x_[f2][i], xfit[i]);
+            }
+            do_fit(natoms, w_, x_[f1], xfit);
+            rmsd = rmsdev(natoms, w_, x_[f1], xfit);
+            sfree(xfit);
+
+            return rmsd;
+        }
+
+        /*! \brief
+         * Checks the symmetric and the rectangular QCP matrix
+         * against the do_fit() reference for all pairs of frames.
+         */
+        void checkAgainstReference(real tolerance)
+        {
+            calc_rmsd_matrix_qcp(natoms, w_, nframes, x_, nframes, x_, rmsd_);
+            for (int i = 0; i < nframes; i++)
+            {
+                for (int j = i + 1; j < nframes; j++)
+                {
+                    EXPECT_NEAR(referenceRmsd(i, j), rmsd_[i][j], tolerance)
+                    << "frames " << i << " and " << j;
+                }
+            }
+
+            /* With different frame lists all elements are set */
+            const int nframes1 = nframes/2;
+            const int nframes2 = nframes - nframes1;
+            calc_rmsd_matrix_qcp(natoms, w_, nframes1, x_,
+                                 nframes2, x_ + nframes1, rmsd_);
+            for (int i = 0; i < nframes1; i++)
+            {
+                for (int j = 0; j < nframes2; j++)
+                {
+                    EXPECT_NEAR(referenceRmsd(i, nframes1 + j), rmsd_[i][j], tolerance)
+                    << "frames " << i << " and " << nframes1 + j;
+                }
+            }
+        }
+
+        gmx_rng_t  rng_;
+        real      *w_;
+        rvec     **x_;
+        real     **rmsd_;
+};
+
+TEST_F(RmsdMatrixQcpTest, MatchesFitForRandomStructures)
+{
+    setRandomWeights();
+    for (int f = 0; f < nframes; f++)
+    {
+        setRandomFrame(f, false);
+    }
+    centerFrames();
+    checkAgainstReference(1e-4);
+}
+
+TEST_F(RmsdMatrixQcpTest, MatchesFitForSimilarStructures)
+{
+    setRandomWeights();
+    setRandomFrame(0, false);
+    for (int f = 1; f < nframes; f++)
+    {
+        setRotatedFrame(f, 0, 0.1);
+    }
+    centerFrames();
+    checkAgainstReference(1e-4);
+}
+
+TEST_F(RmsdMatrixQcpTest, GivesZeroForIdenticalAndRotatedStructures)
+{
+    setRandomWeights();
+    setRandomFrame(0, false);
+    for (int i = 0; i < natoms; i++)
+    {
+        copy_rvec(x_[0][i], x_[1][i]);
+    }
+    for (int f = 2; f < nframes; f++)
+    {
+        setRotatedFrame(f, 0, 0);
+    }
+    centerFrames();
+    calc_rmsd_matrix_qcp(natoms, w_, nframes, x_, nframes, x_, rmsd_);
+    for (int i = 0; i < nframes; i++)
+    {
+        for (int j = i + 1; j < nframes; j++)
+        {
+            EXPECT_NEAR(0, rmsd_[i][j], 1e-3) << "frames " << i << " and " << j;
+        }
+    }
+}
+
+TEST_F(RmsdMatrixQcpTest, MatchesFitForPlanarStructures)
+{
+    setRandomWeights();
+    for (int f = 0; f < nframes; f++)
+    {
+        setRandomFrame(f, true);
+    }
+    centerFrames();
+    checkAgainstReference(1e-4);
+}
+
+TEST_F(RmsdMatrixQcpTest, MatchesFitForUnitWeights)
+{
+    for (int i = 0; i < natoms; i++)
+    {
+        w_[i] = 1;
+    }
+    for (int f = 0; f < nframes; f++)
+    {
+        setRandomFrame(f, f % 2 == 0);
+    }
+    centerFrames();
+    checkAgainstReference(1e-4);
+}
+
+} // namespace
@@ -83,6 +83,17 @@ void do_fit_ndim(int ndim, int natoms, real *w_rls, rvec *xp, rvec *x);
 void do_fit(int natoms, real *w_rls, rvec *xp, rvec *x);
 /* Calls do_fit with ndim=3, thus fitting in 3D */
 
+void calc_rmsd_matrix_qcp(int natoms, const real *w,
+                          int nframe1, rvec **x1, int nframe2, rvec **x2,
+                          real **rmsd);
+/* Sets rmsd[i][j] to the weighted RMSD of frames x1[i] and x2[j] after
+ * optimal rotational superposition, which gives the same result as
+ * do_fit followed by rmsdev, but is much faster. Only atoms with w>0 are
+ * used. All frames should have their weighted center in the origin.
+ * When x2==x1, only the elements with j>i are set.
+ * The pairs are divided over the OpenMP threads.
+ */
+
 void reset_x_ndim(int ndim, int ncm, const atom_id *ind_cm,
                   int nreset, const atom_id *ind_reset,
                   rvec x[], const real mass[]);
@@ -160,6 +160,16 @@ float dd_pme_f_ratio(gmx_domdec_t *dd);
 void dd_move_x(gmx_domdec_t *dd, matrix box, rvec x[]);
 /* Communicate the coordinates to the neighboring cells and do pbc. */
 
+void dd_move_x_start(gmx_domdec_t *dd, matrix box, rvec x[]);
+/* Start the coordinate communication of dd_move_x, without waiting.
+ * Only the first communication pulse is started, as this only
+ * involves home atoms. Between this call and dd_move_x_finish
+ * the non-local coordinates in x should not be accessed.
+ */
+
+void dd_move_x_finish(gmx_domdec_t *dd, matrix box, rvec x[]);
+/* Complete the coordinate communication started with dd_move_x_start */
+
 void dd_move_f(gmx_domdec_t *dd, rvec f[], rvec *fshift);
 /* Sum the forces over the neighboring cells.
  * When fshift!=NULL the shift forces are updated to obtain
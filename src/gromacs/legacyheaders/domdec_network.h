@@ -30,6 +30,13 @@ enum {
     dddirForward, dddirBackward
 };
 
+/* Set up direct shared memory communication between the DD ranks,
+ * which is only possible with thread-MPI. Should be called by all
+ * PP ranks after the PP communicator has been set up.
+ */
+void
+dd_init_shm(FILE *fplog, gmx_domdec_t *dd);
+
 /* Move integers in the comm. region one cell along the domain decomposition
  * in the dimension indexed by ddimind
  * forward (direction=dddirFoward) or backward (direction=dddirBackward).
@@ -60,6 +67,33 @@ dd_sendrecv_rvec(const gmx_domdec_t *dd,
                  rvec *buf_s, int n_s,
                  rvec *buf_r, int n_r);
 
+/* Handle for a non-blocking rvec communication */
+typedef struct {
+    int         nreq;
+#ifdef GMX_MPI
+    MPI_Request req[2];
+#endif
+    /* The receive side, only used with shared memory communication */
+    int         ddimind;
+    int         direction;
+    rvec       *buf_r;
+    int         n_r;
+} dd_sendrecv_req_t;
+
+/* As dd_sendrecv_rvec, but only posts the receive and send and returns.
+ * The buffers should not be accessed before dd_sendrecv_rvec_finish
+ * has been called with the same req.
+ */
+void
+dd_sendrecv_rvec_start(const gmx_domdec_t *dd,
+                       int ddimind, int direction,
+                       rvec *buf_s, int n_s,
+                       rvec *buf_r, int n_r,
+                       dd_sendrecv_req_t *req);
+
+/* Waits for the communication started with dd_sendrecv_rvec_start */
+void
+dd_sendrecv_rvec_finish(const gmx_domdec_t *dd, dd_sendrecv_req_t *req);
 
 /* Move revc's in the comm. region one cell along the domain decomposition
  * in dimension indexed by ddimind
@@ -119,6 +119,30 @@ t_pargs *add_acf_pargs(int *npargs, t_pargs *pa);
 void cross_corr(int n, real f[], real g[], real corr[]);
 /* Simple minded cross correlation algorithm */
 
+typedef struct gmx_acf_work *gmx_acf_work_t;
+/* Buffers and FFT setups for computing correlation functions of single
+ * items. The functions below are thread-safe when each thread uses
+ * its own work data, so callers can divide items over threads and
+ * generate the time series of each item on the fly.
+ */
+
+gmx_acf_work_t init_acf_work(int nframes, unsigned long mode);
+/* Returns work data for ACFs of type mode of up to nframes frames.
+ * Whether FFTs are used is set by the options of add_acf_pargs.
+ */
+
+void done_acf_work(gmx_acf_work_t work);
+/* Frees the work data */
+
+void calc_acf_item(gmx_acf_work_t work, unsigned long mode,
+                   int nframes, int nout, int nrestart, real c1[]);
+/* Computes the ACF of a single item in place, without normalization,
+ * as low_do_autocorr does for each item.
+ */
+
+void calc_cross_corr(gmx_acf_work_t work, int n, real f[], real g[], real corr[]);
+/* As cross_corr, but using the buffers and FFT setup of work */
+
 real fit_acf(int ncorr, int fitfn, const output_env_t oenv, gmx_bool bVerbose,
              real tbeginfit, real tendfit, real dt, real c1[], real *fit);
 /* Fit an ACF to a given function */
@@ -174,7 +198,7 @@ void low_do_autocorr(const char *fn, const output_env_t oenv,
  * fn is output filename (.xvg) where the correlation function(s) are printed
  * title is the title in the output file
  * nframes is the number of frames in the time series
- * nitem is the number of items
+ * nitem is the number of items, these are divided over the OpenMP threads
  * c1       is an array of dimension [ 0 .. nitem-1 ] [ 0 .. nframes-1 ]
  *          on output, this array is filled with the correlation function
  *          to reduce storage
@@ -77,6 +77,7 @@ extern "C" {
 #define MD_RESETCOUNTERSHALFWAY (1<<19)
 #define MD_TUNEPME        (1<<20)
 #define MD_TESTVERLET     (1<<22)
+#define MD_ASYNCIO        (1<<23)
 
 /* The options for the domain decomposition MPI task ordering */
 enum {
@@ -96,6 +96,8 @@ typedef struct gmx_domdec_specat_comm *gmx_domdec_specat_comm_p_t;
 
 typedef struct gmx_domdec_comm *gmx_domdec_comm_p_t;
 
+typedef struct gmx_domdec_shm *gmx_domdec_shm_p_t;
+
 typedef struct gmx_pme_comm_n_box *gmx_pme_comm_n_box_p_t;
 
 typedef struct {
@@ -139,6 +141,10 @@ typedef struct {
     MPI_Comm               mpi_comm_all;
     /* Use MPI_Sendrecv communication instead of non-blocking calls */
     gmx_bool               bSendRecv2;
+    /* Overlap the coordinate communication with the local force calculation */
+    gmx_bool               bOverlapX;
+    /* Shared memory communication between thread-MPI ranks, NULL if unused */
+    gmx_domdec_shm_p_t     shm;
     /* The local DD cell index and rank */
     ivec                   ci;
     int                    rank;
@@ -176,7 +176,11 @@ typedef struct ewald_tab *ewald_tab_t;
 typedef struct {
     rvec             *f;
     int               f_nalloc;
-    unsigned          red_mask; /* Mask for marking which parts of f are filled */
+    unsigned         *red_mask;        /* Mask for marking which blocks of f are filled */
+    int               red_mask_nalloc; /* Allocation size of red_mask */
+    int               red_nblock;      /* The number of filled blocks */
+    int              *red_block;       /* List of the filled blocks */
+    int               red_block_nalloc;
     rvec             *fshift;
     real              ener[F_NRE];
     gmx_grppairener_t grpp;
@@ -466,11 +470,21 @@ typedef struct {
     real userreal3;
     real userreal4;
 
+    /* Use the SIMD kernels for bonded interactions, when available */
+    gmx_bool    bSimdBondeds;
+
     /* Thread local force and energy data */
     /* FIXME move to bonded_thread_data_t */
     int         nthreads;
     int         red_ashift;
     int         red_nblock;
+    /* The blocks to reduce, with for each block the contributing threads */
+    int         red_nblock_used;
+    int        *red_block_used;
+    int        *red_thread_ind;
+    int         red_block_nalloc;
+    int        *red_thread;
+    int         red_thread_nalloc;
     f_thread_t *f_t;
 
     /* Exclusion load distribution over the threads */
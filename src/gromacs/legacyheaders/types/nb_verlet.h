@@ -126,6 +126,9 @@ typedef struct {
     int                   ewald_excl;  /* Ewald exclusion - see enum above   */
 } nonbonded_verlet_group_t;
 
+/* Data for generating pair lists in the background, see nbnxn_async_search.h */
+typedef struct nbnxn_async_search *nbnxn_async_search_t;
+
 /* non-bonded data structure with Verlet-type cut-off */
 typedef struct {
     nbnxn_search_t           nbs;             /* n vs n atom pair searching data       */
@@ -136,6 +139,10 @@ typedef struct {
     nbnxn_cuda_ptr_t         cu_nbv;          /* pointer to CUDA nb verlet data     */
     int                      min_ci_balanced; /* pair list balancing parameter
                                                  used for the 8x8x8 CUDA kernels    */
+    nbnxn_async_search_t     async_search;    /* background pair search, can be NULL */
+    int                      nstprune;        /* dynamic pruning interval, 0 = off   */
+    real                     rlist_prune;     /* radius for dynamic pruning          */
+    real                     rbuf_prune;      /* rlist_prune - max(rcoulomb, rvdw)   */
 } nonbonded_verlet_t;
 
 #ifdef __cplusplus
@@ -160,6 +160,16 @@ typedef struct {
     int                     excl_nalloc; /* The allocation size for excl             */
     int                     nci_tot;     /* The total number of i clusters           */
 
+    /* With dynamic pruning, ci and cj contain the pruned list and these
+     * store the list as generated by the search with the full rlist.
+     */
+    int                     nci_outer;       /* The number of unpruned i-clusters    */
+    nbnxn_ci_t             *ci_outer;        /* The unpruned i-cluster list          */
+    int                     ci_outer_nalloc; /* The allocation size of ci_outer      */
+    int                     ncj_outer;       /* The number of unpruned j-clusters    */
+    nbnxn_cj_t             *cj_outer;        /* The unpruned j-cluster list          */
+    int                     cj_outer_nalloc; /* The allocation size of cj_outer      */
+
     struct nbnxn_list_work *work;
 
     gmx_cache_protect_t     cp1;
@@ -76,6 +76,7 @@ typedef struct {
     gmx_vsite_thread_t *tdata;                /* Thread local vsites and work structs    */
     int                *th_ind;               /* Work array                              */
     int                 th_ind_nalloc;        /* Size of th_ind                          */
+    gmx_bool            bUseSimd;             /* Use SIMD for the non-linear vsite types */
 } gmx_vsite_t;
 
 void construct_vsites(gmx_vsite_t *vsite,
@@ -39,6 +39,7 @@
 #endif
 
 #include <math.h>
+#include <stdlib.h>
 #include "main.h"
 #include "constr.h"
 #include "copyrite.h"
@@ -56,9 +57,21 @@
 #include "gromacs/fileio/gmxfio.h"
 #include "gromacs/utility/gmxomp.h"
 
+/* Include the SIMD macro file and then check for support */
+#include "gromacs/simd/macros.h"
+#ifdef GMX_HAVE_SIMD_MACROS
+/* Turn on SIMD intrinsics for the LINCS direction and distance
+ * calculations, processing GMX_SIMD_WIDTH_HERE constraints at once.
+ */
+#define LINCS_SIMD
+#include "gromacs/simd/vector_operations.h"
+#endif
+
 typedef struct {
     int    b0;         /* first constraint for this thread */
     int    b1;         /* b1-1 is the last constraint for this thread */
+    int    tri0;       /* first triangle constraint for this thread */
+    int    tri1;       /* tri1-1 is the last triangle constraint for this thread */
     int    nind;       /* number of indices */
     int   *ind;        /* constraint index for updating atom data */
     int    nind_r;     /* number of indices */
@@ -94,6 +107,8 @@ typedef struct gmx_lincsdata {
     real           *blmf1;        /* as blmf, but with all masses 1 */
     real           *bllen;        /* the reference bond length */
     int             nth;          /* The number of threads doing LINCS */
+    gmx_bool        bTaskDep;     /* Are there couplings between constraints of different threads? */
+    gmx_bool        bUseSimd;     /* Use SIMD for the direction and distance calculations */
     lincs_thread_t *th;           /* LINCS thread division */
     unsigned       *atf;          /* atom flags for thread parallelization */
     int             atf_nalloc;   /* allocation size of atf */
@@ -126,27 +141,73 @@ real lincs_rmsd(struct gmx_lincsdata *lincsd, gmx_bool bSD2)
     }
 }
 
+/* Do nrec LINCS matrix multiplications for the constraints
+ * in triangles tb0 to tb1. Requires rhs2 to be equal to rhs1
+ * for the triangle constraints on input.
+ */
+static void lincs_matrix_expand_triangles(const struct gmx_lincsdata *lincsd,
+                                          int tb0, int tb1,
+                                          const real *blcc,
+                                          real *rhs1, real *rhs2, real *sol)
+{
+    int        nrec, rec, tb, b, j, n, nr0, nr1, bits;
+    real       mvb, *swap;
+    const int *blnr     = lincsd->blnr, *blbnb = lincsd->blbnb;
+    const int *triangle = lincsd->triangle, *tri_bits = lincsd->tri_bits;
+
+    nrec = lincsd->nOrder;
+
+    for (rec = 0; rec < nrec; rec++)
+    {
+        for (tb = tb0; tb < tb1; tb++)
+        {
+            b    = triangle[tb];
+            bits = tri_bits[tb];
+            mvb  = 0;
+            nr0  = blnr[b];
+            nr1  = blnr[b+1];
+            for (n = nr0; n < nr1; n++)
+            {
+                if (bits & (1<<(n-nr0)))
+                {
+                    j   = blbnb[n];
+                    mvb = mvb + blcc[n]*rhs1[j];
+                }
+            }
+            rhs2[b] = mvb;
+            sol[b]  = sol[b] + mvb;
+        }
+        swap = rhs1;
+        rhs1 = rhs2;
+        rhs2 = swap;
+    } /* flops count is missing here */
+}
+
 /* Do a set of nrec LINCS matrix multiplications.
  * This function will return with up to date thread-local
  * constraint data, without an OpenMP barrier.
+ * When the constraints of different threads are not coupled,
+ * no OpenMP barriers are used at all.
  */
 static void lincs_matrix_expand(const struct gmx_lincsdata *lincsd,
-                                int b0, int b1,
+                                const lincs_thread_t *li_th,
                                 const real *blcc,
                                 real *rhs1, real *rhs2, real *sol)
 {
-    int        nrec, rec, b, j, n, nr0, nr1;
+    int        b0, b1, nrec, rec, b, j, n;
     real       mvb, *swap;
-    int        ntriangle, tb, bits;
     const int *blnr     = lincsd->blnr, *blbnb = lincsd->blbnb;
-    const int *triangle = lincsd->triangle, *tri_bits = lincsd->tri_bits;
 
-    ntriangle = lincsd->ntriangle;
-    nrec      = lincsd->nOrder;
+    b0   = li_th->b0;
+    b1   = li_th->b1;
+    nrec = lincsd->nOrder;
 
     for (rec = 0; rec < nrec; rec++)
     {
+        if (lincsd->bTaskDep)
+        {
 #pragma omp barrier
+        }
         for (b = b0; b < b1; b++)
         {
             mvb = 0;
@@ -163,7 +224,7 @@ static void lincs_matrix_expand(const struct gmx_lincsdata *lincsd,
         rhs2 = swap;
     } /* nrec*(ncons+2*nrtot) flops */
 
-    if (ntriangle > 0)
+    if (lincsd->ntriangle > 0)
     {
         /* Perform an extra nrec recursions for only the constraints
          * involved in rigid triangles.
@@ -175,46 +236,40 @@ static void lincs_matrix_expand(const struct gmx_lincsdata *lincsd,
         /* We need to copy the temporary array, since only the elements
          * for constraints involved in triangles are updated and then
          * the pointers are swapped. This saving copying the whole arrary.
-         * We need barrier as other threads might still be reading from rhs2.
          */
-#pragma omp barrier
-        for (b = b0; b < b1; b++)
+        if (!lincsd->bTaskDep)
         {
-            rhs2[b] = rhs1[b];
+            /* All couplings of our triangle constraints are to our own
+             * constraints, so we can do our triangles without barriers.
+             */
+            for (b = b0; b < b1; b++)
+            {
+                rhs2[b] = rhs1[b];
+            }
+            lincs_matrix_expand_triangles(lincsd, li_th->tri0, li_th->tri1,
+                                          blcc, rhs1, rhs2, sol);
         }
+        else
+        {
+            /* We need barrier as other threads might still be reading from rhs2.
+             */
+#pragma omp barrier
+            for (b = b0; b < b1; b++)
+            {
+                rhs2[b] = rhs1[b];
+            }
 #pragma omp barrier
 #pragma omp master
-        {
-            for (rec = 0; rec < nrec; rec++)
             {
-                for (tb = 0; tb < ntriangle; tb++)
-                {
-                    b    = triangle[tb];
-                    bits = tri_bits[tb];
-                    mvb  = 0;
-                    nr0  = blnr[b];
-                    nr1  = blnr[b+1];
-                    for (n = nr0; n < nr1; n++)
-                    {
-                        if (bits & (1<<(n-nr0)))
-                        {
-                            j   = blbnb[n];
-                            mvb = mvb + blcc[n]*rhs1[j];
-                        }
-                    }
-                    rhs2[b] = mvb;
-                    sol[b]  = sol[b] + mvb;
-                }
-                swap = rhs1;
-                rhs1 = rhs2;
-                rhs2 = swap;
+                lincs_matrix_expand_triangles(lincsd, 0, lincsd->ntriangle,
+                                              blcc, rhs1, rhs2, sol);
             }
-        } /* flops count is missing here */
 
-        /* We need a barrier here as the calling routine will continue
-         * to operate on the thread-local constraints without barrier.
-         */
+            /* We need a barrier here as the calling routine will continue
+             * to operate on the thread-local constraints without barrier.
+             */
 #pragma omp barrier
+        }
     }
 }
 
@@ -324,10 +379,15 @@ static void lincs_update_atoms(struct gmx_lincsdata *li, int th,
                                const real *invmass,
                                rvec *x)
 {
-    if (li->nth == 1)
+    if (!li->bTaskDep)
     {
-        /* Single thread, we simply update for all constraints */
-        lincs_update_atoms_noind(li->nc, li->bla, prefac, fac, r, invmass, x);
+        /* Our constraints do not share atoms with constraints
+         * of other threads, we simply update for our constraints.
+         */
+        int b0 = li->th[th].b0;
+
+        lincs_update_atoms_noind(li->th[th].b1 - b0, li->bla + 2*b0,
+                                 prefac, fac + b0, r + b0, invmass, x);
     }
     else
     {
@@ -354,6 +414,186 @@ static void lincs_update_atoms(struct gmx_lincsdata *li, int th,
     }
 }
 
+#ifdef LINCS_SIMD
+/* Indices into the SIMD gather buffer for LINCS */
+enum {
+    lbDX, lbDXP, lbR
+};
+#define LB(q, d)     (((q)*DIM + (d))*GMX_SIMD_WIDTH_HERE)
+#define LB_LEN       LB(lbR + 1, 0)
+#define LB_BLC       (LB_LEN + GMX_SIMD_WIDTH_HERE)
+#define LB_RHS       (LB_BLC + GMX_SIMD_WIDTH_HERE)
+#define LB_SIZE      (LB_RHS + GMX_SIMD_WIDTH_HERE)
+
+/* Gathers the (pbc) distance vectors between the atoms of the constraints
+ * b to b+GMX_SIMD_WIDTH_HERE-1 in x into buf, in SIMD layout at offset q.
+ */
+static gmx_inline void lincs_gather_dx(int b, const int *bla,
+                                       rvec *x, const t_pbc *pbc,
+                                       real *buf, int q)
+{
+    int  l, d;
+    rvec dx;
+
+    for (l = 0; l < GMX_SIMD_WIDTH_HERE; l++)
+    {
+        if (pbc)
+        {
+            pbc_dx_aiuc(pbc, x[bla[2*(b+l)]], x[bla[2*(b+l)+1]], dx);
+        }
+        else
+        {
+            rvec_sub(x[bla[2*(b+l)]], x[bla[2*(b+l)+1]], dx);
+        }
+        for (d = 0; d < DIM; d++)
+        {
+            buf[LB(q, d) + l] = dx[d];
+        }
+    }
+}
+
+/* Calculates the normalized constraint directions r from x and,
+ * when xp!=NULL, the right-hand side of the LINCS matrix equation
+ * blc*(r.(xp_i - xp_j) - bllen), which is stored in rhs and sol.
+ * Handles blocks of GMX_SIMD_WIDTH_HERE constraints starting at b0,
+ * returns the index of the first constraint that was not handled.
+ */
+static int calc_dr_x_xp_simd(int b0, int b1, const int *bla,
+                             rvec *x, rvec *xp, const t_pbc *pbc,
+                             const real *bllen, const real *blc,
+                             rvec *r, real *rhs, real *sol,
+                             real *buf)
+{
+    int       b, l, d;
+    gmx_mm_pr rx_S, ry_S, rz_S, rlen_S, ip_S, rhs_S;
+
+    for (b = b0; b + GMX_SIMD_WIDTH_HERE <= b1; b += GMX_SIMD_WIDTH_HERE)
+    {
+        lincs_gather_dx(b, bla, x, pbc, buf, lbDX);
+
+        rx_S   = gmx_load_pr(buf + LB(lbDX, XX));
+        ry_S   = gmx_load_pr(buf + LB(lbDX, YY));
+        rz_S   = gmx_load_pr(buf + LB(lbDX, ZZ));
+
+        rlen_S = gmx_invsqrt_pr(gmx_norm2_pr(rx_S, ry_S, rz_S));
+        rx_S   = gmx_mul_pr(rx_S, rlen_S);
+        ry_S   = gmx_mul_pr(ry_S, rlen_S);
+        rz_S   = gmx_mul_pr(rz_S, rlen_S);
+
+        gmx_store_pr(buf + LB(lbR, XX), rx_S);
+        gmx_store_pr(buf + LB(lbR, YY), ry_S);
+        gmx_store_pr(buf + LB(lbR, ZZ), rz_S);
+
+        for (l = 0; l < GMX_SIMD_WIDTH_HERE; l++)
+        {
+            for (d = 0; d < DIM; d++)
+            {
+                r[b+l][d] = buf[LB(lbR, d) + l];
+            }
+        }
+
+        if (xp != NULL)
+        {
+            lincs_gather_dx(b, bla, xp, pbc, buf, lbDXP);
+            for (l = 0; l < GMX_SIMD_WIDTH_HERE; l++)
+            {
+                buf[LB_LEN + l] = bllen[b+l];
+                buf[LB_BLC + l] = blc[b+l];
+            }
+
+            ip_S  = gmx_iprod_pr(rx_S, ry_S, rz_S,
+                                 gmx_load_pr(buf + LB(lbDXP, XX)),
+                                 gmx_load_pr(buf + LB(lbDXP, YY)),
+                                 gmx_load_pr(buf + LB(lbDXP, ZZ)));
+            rhs_S = gmx_mul_pr(gmx_load_pr(buf + LB_BLC),
+                               gmx_sub_pr(ip_S, gmx_load_pr(buf + LB_LEN)));
+            gmx_store_pr(buf + LB_RHS, rhs_S);
+
+            for (l = 0; l < GMX_SIMD_WIDTH_HERE; l++)
+            {
+                rhs[b+l] = buf[LB_RHS + l];
+                sol[b+l] = buf[LB_RHS + l];
+            }
+        }
+    }
+
+    return b;
+}
+
+/* Calculates the right-hand side of the LINCS matrix equation for
+ * the correction for rotational lengthening, stored in rhs and sol.
+ * Handles blocks of GMX_SIMD_WIDTH_HERE constraints starting at b0,
+ * returns the index of the first constraint that was not handled.
+ */
+static int calc_dist_iter_simd(int b0, int b1, const int *bla,
+                               rvec *xp, const t_pbc *pbc,
+                               const real *bllen, const real *blc,
+                               const int *nlocat, real wfac, int *warn,
+                               real *rhs, real *sol,
+                               real *buf)
+{
+    int       b, l;
+    gmx_mm_pr len_S, len2_S, dlen2_S, lc_S, blc_S;
+    gmx_mm_pb bWarn_S, bPos_S;
+
+    for (b = b0; b + GMX_SIMD_WIDTH_HERE <= b1; b += GMX_SIMD_WIDTH_HERE)
+    {
+        lincs_gather_dx(b, bla, xp, pbc, buf, lbDXP);
+        for (l = 0; l < GMX_SIMD_WIDTH_HERE; l++)
+        {
+            buf[LB_LEN + l] = bllen[b+l];
+            buf[LB_BLC + l] = blc[b+l];
+        }
+
+        len_S   = gmx_load_pr(buf + LB_LEN);
+        blc_S   = gmx_load_pr(buf + LB_BLC);
+        len2_S  = gmx_mul_pr(len_S, len_S);
+        dlen2_S = gmx_sub_pr(gmx_add_pr(len2_S, len2_S),
+                             gmx_norm2_pr(gmx_load_pr(buf + LB(lbDXP, XX)),
+                                          gmx_load_pr(buf + LB(lbDXP, YY)),
+                                          gmx_load_pr(buf + LB(lbDXP, ZZ))));
+
+        bWarn_S = gmx_cmplt_pr(dlen2_S, gmx_mul_pr(gmx_set1_pr(wfac), len2_S));
+        if (gmx_anytrue_pb(bWarn_S))
+        {
+            /* Let the plain C check decide, as it takes nlocat into account */
+            for (l = 0; l < GMX_SIMD_WIDTH_HERE; l++)
+            {
+                real len2, dlen2;
+
+                len2  = bllen[b+l]*bllen[b+l];
+                dlen2 = 2*len2 - (sqr(buf[LB(lbDXP, XX) + l]) +
+                                  sqr(buf[LB(lbDXP, YY) + l]) +
+                                  sqr(buf[LB(lbDXP, ZZ) + l]));
+                if (dlen2 < wfac*len2 &&
+                    (nlocat == NULL || nlocat[b+l]))
+                {
+                    *warn = b + l;
+                }
+            }
+        }
+
+        /* For dlen2 <= 0 we use 0 for the length correction term.
+         * We avoid taking the inverse square root of values <= 0.
+         */
+        bPos_S  = gmx_cmplt_pr(gmx_setzero_pr(), dlen2_S);
+        lc_S    = gmx_mul_pr(dlen2_S,
+                             gmx_invsqrt_pr(gmx_max_pr(dlen2_S,
+                                                       gmx_set1_pr(GMX_REAL_MIN))));
+        lc_S    = gmx_blendzero_pr(lc_S, bPos_S);
+        gmx_store_pr(buf + LB_RHS, gmx_mul_pr(blc_S, gmx_sub_pr(len_S, lc_S)));
+
+        for (l = 0; l < GMX_SIMD_WIDTH_HERE; l++)
+        {
+            rhs[b+l] = buf[LB_RHS + l];
+            sol[b+l] = buf[LB_RHS + l];
+        }
+    }
+
+    return b;
+}
+#endif /* LINCS_SIMD */
+
 /* LINCS projection, works on derivatives of the coordinates */
 static void do_lincsp(rvec *x, rvec *f, rvec *fp, t_pbc *pbc,
                       struct gmx_lincsdata *lincsd, int th,
@@ -393,24 +633,35 @@ static void do_lincsp(rvec *x, rvec *f, rvec *fp, t_pbc *pbc,
     sol    = lincsd->tmp3;
 
     /* Compute normalized i-j vectors */
-    if (pbc)
+    b = b0;
+#ifdef LINCS_SIMD
+    if (lincsd->bUseSimd)
     {
-        for (b = b0; b < b1; b++)
+        real buf_unaligned[LB_SIZE + GMX_SIMD_WIDTH_HERE];
+
+        b = calc_dr_x_xp_simd(b0, b1, bla, x, NULL, pbc, NULL, NULL,
+                              r, NULL, NULL,
+                              gmx_simd_align_real(buf_unaligned));
+    }
+#endif
+    for (; b < b1; b++)
+    {
+        if (pbc)
         {
             pbc_dx_aiuc(pbc, x[bla[2*b]], x[bla[2*b+1]], dx);
-            unitv(dx, r[b]);
         }
-    }
-    else
-    {
-        for (b = b0; b < b1; b++)
+        else
         {
             rvec_sub(x[bla[2*b]], x[bla[2*b+1]], dx);
-            unitv(dx, r[b]);
-        } /* 16 ncons flops */
-    }
+        }
+        unitv(dx, r[b]);
+    } /* 16 ncons flops */
 
+    if (lincsd->bTaskDep)
+    {
+        /* Wait for the directions of constraints of other threads */
 #pragma omp barrier
+    }
     for (b = b0; b < b1; b++)
     {
         tmp0 = r[b][0];
@@ -432,7 +683,7 @@ static void do_lincsp(rvec *x, rvec *f, rvec *fp, t_pbc *pbc,
     }
     /* Together: 23*ncons + 6*nrtot flops */
 
-    lincs_matrix_expand(lincsd, b0, b1, blcc, rhs1, rhs2, sol);
+    lincs_matrix_expand(lincsd, &lincsd->th[th], blcc, rhs1, rhs2, sol);
     /* nrec*(ncons+2*nrtot) flops */
 
     if (econq == econqDeriv_FlexCon)
@@ -509,6 +760,12 @@ static void do_lincs(rvec *x, rvec *xp, matrix box, t_pbc *pbc,
     rvec    *r;
     real    *blc, *blmf, *bllen, *blcc, *rhs1, *rhs2, *sol, *blc_sol, *mlambda;
     int     *nlocat;
+    gmx_bool bCommIter;
+#ifdef LINCS_SIMD
+    real     buf_unaligned[LB_SIZE + GMX_SIMD_WIDTH_HERE], *buf;
+
+    buf = gmx_simd_align_real(buf_unaligned);
+#endif
 
     b0 = lincsd->th[th].b0;
     b1 = lincsd->th[th].b1;
@@ -540,68 +797,63 @@ static void do_lincs(rvec *x, rvec *xp, matrix box, t_pbc *pbc,
         nlocat = NULL;
     }
 
-    if (pbc)
+    /* Compute normalized i-j vectors and the right-hand side */
+    b = b0;
+#ifdef LINCS_SIMD
+    if (lincsd->bUseSimd)
     {
-        /* Compute normalized i-j vectors */
-        for (b = b0; b < b1; b++)
+        b = calc_dr_x_xp_simd(b0, b1, bla, x, xp, pbc, bllen, blc,
+                              r, rhs1, sol, buf);
+    }
+#endif
+    for (; b < b1; b++)
+    {
+        i = bla[2*b];
+        j = bla[2*b+1];
+        if (pbc)
         {
-            pbc_dx_aiuc(pbc, x[bla[2*b]], x[bla[2*b+1]], dx);
-            unitv(dx, r[b]);
+            pbc_dx_aiuc(pbc, x[i], x[j], dx);
         }
-#pragma omp barrier
-        for (b = b0; b < b1; b++)
+        else
         {
-            for (n = blnr[b]; n < blnr[b+1]; n++)
-            {
-                blcc[n] = blmf[n]*iprod(r[b], r[blbnb[n]]);
-            }
-            pbc_dx_aiuc(pbc, xp[bla[2*b]], xp[bla[2*b+1]], dx);
-            mvb     = blc[b]*(iprod(r[b], dx) - bllen[b]);
-            rhs1[b] = mvb;
-            sol[b]  = mvb;
+            rvec_sub(x[i], x[j], dx);
         }
-    }
-    else
-    {
-        /* Compute normalized i-j vectors */
-        for (b = b0; b < b1; b++)
+        rlen    = gmx_invsqrt(norm2(dx));
+        r[b][0] = rlen*dx[0];
+        r[b][1] = rlen*dx[1];
+        r[b][2] = rlen*dx[2];
+        if (pbc)
         {
-            i       = bla[2*b];
-            j       = bla[2*b+1];
-            tmp0    = x[i][0] - x[j][0];
-            tmp1    = x[i][1] - x[j][1];
-            tmp2    = x[i][2] - x[j][2];
-            rlen    = gmx_invsqrt(tmp0*tmp0+tmp1*tmp1+tmp2*tmp2);
-            r[b][0] = rlen*tmp0;
-            r[b][1] = rlen*tmp1;
-            r[b][2] = rlen*tmp2;
-        } /* 16 ncons flops */
+            pbc_dx_aiuc(pbc, xp[i], xp[j], dx);
+        }
+        else
+        {
+            rvec_sub(xp[i], xp[j], dx);
+        }
+        mvb     = blc[b]*(iprod(r[b], dx) - bllen[b]);
+        rhs1[b] = mvb;
+        sol[b]  = mvb;
+    } /* 26 ncons flops */
 
+    if (lincsd->bTaskDep)
+    {
+        /* Wait for the directions of constraints of other threads */
 #pragma omp barrier
-        for (b = b0; b < b1; b++)
+    }
+    for (b = b0; b < b1; b++)
+    {
+        tmp0 = r[b][0];
+        tmp1 = r[b][1];
+        tmp2 = r[b][2];
+        for (n = blnr[b]; n < blnr[b+1]; n++)
         {
-            tmp0 = r[b][0];
-            tmp1 = r[b][1];
-            tmp2 = r[b][2];
-            len  = bllen[b];
-            i    = bla[2*b];
-            j    = bla[2*b+1];
-            for (n = blnr[b]; n < blnr[b+1]; n++)
-            {
-                k       = blbnb[n];
-                blcc[n] = blmf[n]*(tmp0*r[k][0] + tmp1*r[k][1] + tmp2*r[k][2]);
-            } /* 6 nr flops */
-            mvb = blc[b]*(tmp0*(xp[i][0] - xp[j][0]) +
-                          tmp1*(xp[i][1] - xp[j][1]) +
-                          tmp2*(xp[i][2] - xp[j][2]) - len);
-            rhs1[b] = mvb;
-            sol[b]  = mvb;
-            /* 10 flops */
-        }
-        /* Together: 26*ncons + 6*nrtot flops */
+            k       = blbnb[n];
+            blcc[n] = blmf[n]*(tmp0*r[k][0] + tmp1*r[k][1] + tmp2*r[k][2]);
+        } /* 6 nr flops */
     }
+    /* Together: 26*ncons + 6*nrtot flops */
 
-    lincs_matrix_expand(lincsd, b0, b1, blcc, rhs1, rhs2, sol);
+    lincs_matrix_expand(lincsd, &lincsd->th[th], blcc, rhs1, rhs2, sol);
     /* nrec*(ncons+2*nrtot) flops */
 
     for (b = b0; b < b1; b++)
@@ -619,10 +871,12 @@ static void do_lincs(rvec *x, rvec *xp, matrix box, t_pbc *pbc,
     wfac = cos(DEG2RAD*wangle);
     wfac = wfac*wfac;
 
+    bCommIter = ((lincsd->bCommIter && DOMAINDECOMP(cr) && cr->dd->constraints) ||
+                 PARTDECOMP(cr));
+
     for (iter = 0; iter < lincsd->nIter; iter++)
     {
-        if ((lincsd->bCommIter && DOMAINDECOMP(cr) && cr->dd->constraints) ||
-            PARTDECOMP(cr))
+        if (bCommIter)
         {
 #pragma omp barrier
 #pragma omp master
@@ -639,8 +893,21 @@ static void do_lincs(rvec *x, rvec *xp, matrix box, t_pbc *pbc,
             }
         }
 
+        if (bCommIter || lincsd->bTaskDep)
+        {
+            /* Wait for the coordinate updates of the other threads */
 #pragma omp barrier
-        for (b = b0; b < b1; b++)
+        }
+
+        b = b0;
+#ifdef LINCS_SIMD
+        if (lincsd->bUseSimd)
+        {
+            b = calc_dist_iter_simd(b0, b1, bla, xp, pbc, bllen, blc,
+                                    nlocat, wfac, warn, rhs1, sol, buf);
+        }
+#endif
+        for (; b < b1; b++)
         {
             len = bllen[b];
             if (pbc)
@@ -669,7 +936,7 @@ static void do_lincs(rvec *x, rvec *xp, matrix box, t_pbc *pbc,
             sol[b]  = mvb;
         } /* 20*ncons flops */
 
-        lincs_matrix_expand(lincsd, b0, b1, blcc, rhs1, rhs2, sol);
+        lincs_matrix_expand(lincsd, &lincsd->th[th], blcc, rhs1, rhs2, sol);
         /* nrec*(ncons+2*nrtot) flops */
 
         for (b = b0; b < b1; b++)
@@ -693,8 +960,11 @@ static void do_lincs(rvec *x, rvec *xp, matrix box, t_pbc *pbc,
 
     if (nlocat != NULL && bCalcLambda)
     {
-        /* In lincs_update_atoms thread might cross-read mlambda */
+        if (lincsd->bTaskDep)
+        {
+            /* In lincs_update_atoms thread might cross-read mlambda */
 #pragma omp barrier
+        }
 
         /* Only account for local atoms */
         for (b = b0; b < b1; b++)
@@ -734,7 +1004,7 @@ static void do_lincs(rvec *x, rvec *xp, matrix box, t_pbc *pbc,
 void set_lincs_matrix(struct gmx_lincsdata *li, real *invmass, real lambda)
 {
     int        i, a1, a2, n, k, sign, center;
-    int        end, nk, kk;
+    int        end, nk, kk, th, tb;
     const real invsqrt2 = 0.7071067811865475244;
 
     for (i = 0; (i < li->nc); i++)
@@ -814,6 +1084,24 @@ void set_lincs_matrix(struct gmx_lincsdata *li, real *invmass, real lambda)
                 li->ncc, li->ncc_triangle);
     }
 
+    /* Set the triangle constraint ranges for the threads,
+     * the triangle list is ordered on constraint index.
+     */
+    tb = 0;
+    for (th = 0; th < li->nth; th++)
+    {
+        while (tb < li->ntriangle && li->triangle[tb] < li->th[th].b0)
+        {
+            tb++;
+        }
+        li->th[th].tri0 = tb;
+        while (tb < li->ntriangle && li->triangle[tb] < li->th[th].b1)
+        {
+            tb++;
+        }
+        li->th[th].tri1 = tb;
+    }
+
     /* Set matlam,
      * so we know with which lambda value the masses have been set.
      */
@@ -983,11 +1271,22 @@ gmx_lincsdata_t init_lincs(FILE *fplog, gmx_mtop_t *mtop,
         /* Allocate an extra elements for "thread-overlap" constraints */
         snew(li->th, li->nth+1);
     }
+    li->bTaskDep = (li->nth > 1);
     if (debug)
     {
         fprintf(debug, "LINCS: using %d threads\n", li->nth);
     }
 
+#ifdef LINCS_SIMD
+    li->bUseSimd = (getenv("GMX_NO_SIMD_LINCS") == NULL);
+#else
+    li->bUseSimd = FALSE;
+#endif
+    if (debug)
+    {
+        fprintf(debug, "LINCS: using SIMD: %d\n", li->bUseSimd);
+    }
+
     if (bPLINCS || li->ncg_triangle > 0)
     {
         please_cite(fplog, "Hess2008a");
@@ -1018,6 +1317,72 @@ gmx_lincsdata_t init_lincs(FILE *fplog, gmx_mtop_t *mtop,
     return li;
 }
 
+/* Tries to divide the constraints over the threads such that
+ * there are no couplings between constraints of different threads.
+ * We allow the thread boundaries to shift by 1/8 of the average
+ * number of constraints per thread. Returns TRUE when successful.
+ */
+static gmx_bool lincs_thread_split_independent(struct gmx_lincsdata *li)
+{
+    int       th, b, n, bmax, target, shift, max_shift;
+    gmx_bool *bSplit, bOK;
+
+    /* Determine at which constraint indices no coupling crosses */
+    snew(bSplit, li->nc + 1);
+    /* bmax is one more than the highest index coupled to constraints < b */
+    bmax = 0;
+    for (b = 0; b < li->nc; b++)
+    {
+        bSplit[b] = (bmax <= b);
+        if (b + 1 > bmax)
+        {
+            bmax = b + 1;
+        }
+        for (n = li->blnr[b]; n < li->blnr[b+1]; n++)
+        {
+            if (li->blbnb[n] + 1 > bmax)
+            {
+                bmax = li->blbnb[n] + 1;
+            }
+        }
+    }
+    bSplit[li->nc] = TRUE;
+
+    max_shift = li->nc/(8*li->nth);
+
+    /* Put each thread boundary at the split point closest to
+     * the boundary of an equal division.
+     */
+    bOK = TRUE;
+    for (th = 1; th < li->nth && bOK; th++)
+    {
+        target = (li->nc*th)/li->nth;
+        for (shift = 0; shift <= max_shift; shift++)
+        {
+            if (bSplit[target - shift])
+            {
+                target -= shift;
+                break;
+            }
+            if (target + shift <= li->nc && bSplit[target + shift])
+            {
+                target += shift;
+                break;
+            }
+        }
+        bOK = (shift <= max_shift);
+
+        li->th[th-1].b1 = target;
+        li->th[th].b0   = target;
+    }
+    li->th[0].b0         = 0;
+    li->th[li->nth-1].b1 = li->nc;
+
+    sfree(bSplit);
+
+    return bOK;
+}
+
 /* Sets up the work division over the threads */
 static void lincs_thread_setup(struct gmx_lincsdata *li, int natoms)
 {
@@ -1026,6 +1391,26 @@ static void lincs_thread_setup(struct gmx_lincsdata *li, int natoms)
     unsigned       *atf;
     int             a;
 
+    li->bTaskDep = !lincs_thread_split_independent(li);
+
+    if (!li->bTaskDep)
+    {
+        /* All constraints only operate on atoms of their own thread */
+        for (th = 0; th < li->nth; th++)
+        {
+            li->th[th].nind   = 0;
+            li->th[th].nind_r = 0;
+            if (debug)
+            {
+                fprintf(debug, "LINCS thread %d: %d independent constraints\n",
+                        th, li->th[th].b1 - li->th[th].b0);
+            }
+        }
+        li->th[li->nth].nind = 0;
+
+        return;
+    }
+
     if (natoms > li->atf_nalloc)
     {
         li->atf_nalloc = over_alloc_large(natoms);
@@ -1171,6 +1556,8 @@ void set_lincs(t_idef *idef, t_mdatoms *md,
     {
         li->th[i].b0   = 0;
         li->th[i].b1   = 0;
+        li->th[i].tri0 = 0;
+        li->th[i].tri1 = 0;
         li->th[i].nind = 0;
     }
     if (li->nth > 1)
@@ -1341,6 +1728,7 @@ void set_lincs(t_idef *idef, t_mdatoms *md,
     {
         li->th[0].b0 = 0;
         li->th[0].b1 = li->nc;
+        li->bTaskDep = FALSE;
     }
     else
     {
@@ -39,12 +39,23 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "vec.h"
 #include "constr.h"
 #include "gmx_fatal.h"
 #include "smalloc.h"
 #include "pbc.h"
 
+/* Include the SIMD macro file and then check for support */
+#include "gromacs/simd/macros.h"
+#ifdef GMX_HAVE_SIMD_MACROS
+/* Turn on SIMD intrinsics for SETTLE, processing GMX_SIMD_WIDTH_HERE
+ * waters at once.
+ */
+#define SETTLE_SIMD
+#include "gromacs/simd/vector_operations.h"
+#endif
+
 typedef struct
 {
     real   mO;
@@ -68,6 +79,7 @@ typedef struct gmx_settledata
 {
     settleparam_t massw;
     settleparam_t mass1;
+    gmx_bool      bUseSimd; /* Use the SIMD code path in csettle */
 } t_gmx_settledata;
 
 
@@ -145,6 +157,18 @@ gmx_settledata_t settle_init(real mO, real mH, real invmO, real invmH,
 
     settleparam_init(&settled->mass1, 1.0, 1.0, 1.0, 1.0, dOH, dHH);
 
+#ifdef SETTLE_SIMD
+    /* The plain C code can be selected for validation */
+    settled->bUseSimd = (getenv("GMX_NO_SIMD_SETTLE") == NULL);
+#else
+    settled->bUseSimd = FALSE;
+#endif
+    if (debug)
+    {
+        fprintf(debug, "Using %s SETTLE\n",
+                settled->bUseSimd ? "SIMD" : "plain C");
+    }
+
     return settled;
 }
 
@@ -307,14 +331,14 @@ void settle_proj(gmx_settledata_t settled, int econq,
 }
 
 
-void csettle(gmx_settledata_t settled,
-             int nsettle, t_iatom iatoms[],
-             const t_pbc *pbc,
-             real b4[], real after[],
-             real invdt, real *v, int CalcVirAtomEnd,
-             tensor vir_r_m_dr,
-             int *error,
-             t_vetavars *vetavar)
+static void csettle_plain(gmx_settledata_t settled,
+                          int i_start, int i_end, t_iatom iatoms[],
+                          const t_pbc *pbc,
+                          real b4[], real after[],
+                          real invdt, real *v, int CalcVirAtomEnd,
+                          tensor vir_r_m_dr,
+                          int *error,
+                          t_vetavars *vetavar)
 {
     /* ***************************************************************** */
     /*                                                               ** */
@@ -355,8 +379,6 @@ void csettle(gmx_settledata_t settled,
     rvec     doh2, doh3;
     int      is;
 
-    *error = -1;
-
     CalcVirAtomEnd *= 3;
 
     p    = &settled->massw;
@@ -373,7 +395,7 @@ void csettle(gmx_settledata_t settled,
 #ifdef PRAGMAS
 #pragma ivdep
 #endif
-    for (i = 0; i < nsettle; ++i)
+    for (i = i_start; i < i_end; ++i)
     {
         bOK = TRUE;
         /*    --- Step1  A1' ---      */
@@ -641,3 +663,436 @@ void csettle(gmx_settledata_t settled,
 #endif
     }
 }
+
+#ifdef SETTLE_SIMD
+/* Indices of the quantities in the SIMD gather/scatter buffer,
+ * each quantity uses a stride of DIM*GMX_SIMD_WIDTH_HERE
+ * (the last two only GMX_SIMD_WIDTH_HERE).
+ */
+enum {
+    ssbB0, ssbC0, ssbOB4, ssbO, ssbH2, ssbH3, ssbDOH2, ssbDOH3, ssbSH2, ssbSH3
+};
+#define SSB(q, d)    (((q)*DIM + (d))*GMX_SIMD_WIDTH_HERE)
+#define SSB_VIR      SSB(ssbSH3 + 1, 0)
+#define SSB_OK       (SSB_VIR + GMX_SIMD_WIDTH_HERE)
+#define SSB_SIZE     (SSB_OK + GMX_SIMD_WIDTH_HERE)
+
+/* SETTLE GMX_SIMD_WIDTH_HERE waters starting at iatoms using SIMD.
+ * The coordinates are gathered into a structure-of-arrays buffer,
+ * with PBC applied in the same way as in csettle_plain.
+ * Returns FALSE, without modifying any data, when at least one
+ * of the waters could not be settled.
+ */
+static gmx_bool csettle_simd_block(const settleparam_t *p,
+                                   const t_iatom iatoms[],
+                                   const t_pbc *pbc,
+                                   real b4[], real after[],
+                                   real invdts, real *v,
+                                   int calcvir_atom_end,
+                                   real mOs, real mHs,
+                                   real *buf,
+                                   gmx_mm_pr sum_r_m_dr_S[DIM][DIM])
+{
+    const gmx_mm_pr zero_S   = gmx_setzero_pr();
+    const gmx_mm_pr one_S    = gmx_set1_pr(1.0);
+    const gmx_mm_pr mwh_S    = gmx_set1_pr(-p->wh);
+    const gmx_mm_pr ra_S     = gmx_set1_pr(p->ra);
+    const gmx_mm_pr rb_S     = gmx_set1_pr(p->rb);
+    const gmx_mm_pr rc_S     = gmx_set1_pr(p->rc);
+    const gmx_mm_pr irc2_S   = gmx_set1_pr(p->irc2);
+    const gmx_mm_pr invra_S  = gmx_set1_pr(gmx_invsqrt(p->ra*p->ra));
+    const gmx_mm_pr invdts_S = gmx_set1_pr(invdts);
+
+    int             l, d, d2, ow1, hw2, hw3, is;
+    rvec            dx, doh2, doh3;
+
+    gmx_mm_pr       xb0, yb0, zb0, xc0, yc0, zc0;
+    gmx_mm_pr       xO, yO, zO, xH2, yH2, zH2, xH3, yH3, zH3;
+    gmx_mm_pr       xdoh2, ydoh2, zdoh2, xdoh3, ydoh3, zdoh3;
+    gmx_mm_pr       xa1, ya1, za1, xb1, yb1, zb1, xc1, yc1, zc1;
+    gmx_mm_pr       xcom, ycom, zcom;
+    gmx_mm_pr       xakszd, yakszd, zakszd, xaksxd, yaksxd, zaksxd;
+    gmx_mm_pr       xaksyd, yaksyd, zaksyd;
+    gmx_mm_pr       axlng, aylng, azlng;
+    gmx_mm_pr       trns11, trns21, trns31, trns12, trns22, trns32;
+    gmx_mm_pr       trns13, trns23, trns33;
+    gmx_mm_pr       xb0d, yb0d, xc0d, yc0d, za1d;
+    gmx_mm_pr       xb1d, yb1d, zb1d, xc1d, yc1d, zc1d;
+    gmx_mm_pr       sinphi, cosphi, sinpsi, cospsi, sinthe, costhe;
+    gmx_mm_pr       tmp, tmp2, ok_S;
+    gmx_mm_pr       ya2d, xb2d, yb2d, yc2d, t1, t2;
+    gmx_mm_pr       alpa, beta, gama, al2be2;
+    gmx_mm_pr       xa3d, ya3d, za3d, xb3d, yb3d, zb3d, xc3d, yc3d, zc3d;
+    gmx_mm_pr       xa3, ya3, za3, xb3, yb3, zb3, xc3, yc3, zc3;
+    gmx_mm_pr       dax, day, daz, dbx, dby, dbz, dcx, dcy, dcz;
+    gmx_mm_pr       mOs_S, mHs_S;
+    gmx_mm_pr       mda[DIM], mdb[DIM], mdc[DIM], rO[DIM], rB[DIM], rC[DIM];
+
+    /* Gather the coordinates into the buffer */
+    for (l = 0; l < GMX_SIMD_WIDTH_HERE; l++)
+    {
+        ow1 = iatoms[l*4+1] * 3;
+        hw2 = iatoms[l*4+2] * 3;
+        hw3 = iatoms[l*4+3] * 3;
+
+        for (d = 0; d < DIM; d++)
+        {
+            buf[SSB(ssbOB4, d) + l] = b4[ow1 + d];
+            buf[SSB(ssbO, d) + l]   = after[ow1 + d];
+        }
+
+        if (pbc == NULL)
+        {
+            for (d = 0; d < DIM; d++)
+            {
+                buf[SSB(ssbB0, d) + l]   = b4[hw2 + d] - b4[ow1 + d];
+                buf[SSB(ssbC0, d) + l]   = b4[hw3 + d] - b4[ow1 + d];
+                buf[SSB(ssbH2, d) + l]   = after[hw2 + d];
+                buf[SSB(ssbH3, d) + l]   = after[hw3 + d];
+                buf[SSB(ssbDOH2, d) + l] = after[hw2 + d] - after[ow1 + d];
+                buf[SSB(ssbDOH3, d) + l] = after[hw3 + d] - after[ow1 + d];
+            }
+        }
+        else
+        {
+            pbc_dx_aiuc(pbc, b4+hw2, b4+ow1, dx);
+            for (d = 0; d < DIM; d++)
+            {
+                buf[SSB(ssbB0, d) + l] = dx[d];
+            }
+            pbc_dx_aiuc(pbc, b4+hw3, b4+ow1, dx);
+            for (d = 0; d < DIM; d++)
+            {
+                buf[SSB(ssbC0, d) + l] = dx[d];
+            }
+
+            /* Shift the hydrogens next to the oxygen, as in csettle_plain */
+            is = pbc_dx_aiuc(pbc, after+hw2, after+ow1, doh2);
+            for (d = 0; d < DIM; d++)
+            {
+                buf[SSB(ssbSH2, d) + l]  = (is == CENTRAL ? 0 :
+                                            after[hw2 + d] - (after[ow1 + d] + doh2[d]));
+                buf[SSB(ssbH2, d) + l]   = after[hw2 + d] - buf[SSB(ssbSH2, d) + l];
+                buf[SSB(ssbDOH2, d) + l] = doh2[d];
+            }
+            is = pbc_dx_aiuc(pbc, after+hw3, after+ow1, doh3);
+            for (d = 0; d < DIM; d++)
+            {
+                buf[SSB(ssbSH3, d) + l]  = (is == CENTRAL ? 0 :
+                                            after[hw3 + d] - (after[ow1 + d] + doh3[d]));
+                buf[SSB(ssbH3, d) + l]   = after[hw3 + d] - buf[SSB(ssbSH3, d) + l];
+                buf[SSB(ssbDOH3, d) + l] = doh3[d];
+            }
+        }
+
+        buf[SSB_VIR + l] = (ow1 < calcvir_atom_end*3 ? 1 : 0);
+    }
+
+    xb0   = gmx_load_pr(buf + SSB(ssbB0, XX));
+    yb0   = gmx_load_pr(buf + SSB(ssbB0, YY));
+    zb0   = gmx_load_pr(buf + SSB(ssbB0, ZZ));
+    xc0   = gmx_load_pr(buf + SSB(ssbC0, XX));
+    yc0   = gmx_load_pr(buf + SSB(ssbC0, YY));
+    zc0   = gmx_load_pr(buf + SSB(ssbC0, ZZ));
+    xO    = gmx_load_pr(buf + SSB(ssbO, XX));
+    yO    = gmx_load_pr(buf + SSB(ssbO, YY));
+    zO    = gmx_load_pr(buf + SSB(ssbO, ZZ));
+    xH2   = gmx_load_pr(buf + SSB(ssbH2, XX));
+    yH2   = gmx_load_pr(buf + SSB(ssbH2, YY));
+    zH2   = gmx_load_pr(buf + SSB(ssbH2, ZZ));
+    xH3   = gmx_load_pr(buf + SSB(ssbH3, XX));
+    yH3   = gmx_load_pr(buf + SSB(ssbH3, YY));
+    zH3   = gmx_load_pr(buf + SSB(ssbH3, ZZ));
+    xdoh2 = gmx_load_pr(buf + SSB(ssbDOH2, XX));
+    ydoh2 = gmx_load_pr(buf + SSB(ssbDOH2, YY));
+    zdoh2 = gmx_load_pr(buf + SSB(ssbDOH2, ZZ));
+    xdoh3 = gmx_load_pr(buf + SSB(ssbDOH3, XX));
+    ydoh3 = gmx_load_pr(buf + SSB(ssbDOH3, YY));
+    zdoh3 = gmx_load_pr(buf + SSB(ssbDOH3, ZZ));
+
+    /* The same algorithm as in csettle_plain, see there for comments */
+    xa1 = gmx_mul_pr(gmx_add_pr(xdoh2, xdoh3), mwh_S);
+    ya1 = gmx_mul_pr(gmx_add_pr(ydoh2, ydoh3), mwh_S);
+    za1 = gmx_mul_pr(gmx_add_pr(zdoh2, zdoh3), mwh_S);
+
+    xcom = gmx_sub_pr(xO, xa1);
+    ycom = gmx_sub_pr(yO, ya1);
+    zcom = gmx_sub_pr(zO, za1);
+
+    xb1 = gmx_sub_pr(xH2, xcom);
+    yb1 = gmx_sub_pr(yH2, ycom);
+    zb1 = gmx_sub_pr(zH2, zcom);
+    xc1 = gmx_sub_pr(xH3, xcom);
+    yc1 = gmx_sub_pr(yH3, ycom);
+    zc1 = gmx_sub_pr(zH3, zcom);
+
+    gmx_cprod_pr(xb0, yb0, zb0, xc0, yc0, zc0, &xakszd, &yakszd, &zakszd);
+    gmx_cprod_pr(xa1, ya1, za1, xakszd, yakszd, zakszd, &xaksxd, &yaksxd, &zaksxd);
+    gmx_cprod_pr(xakszd, yakszd, zakszd, xaksxd, yaksxd, zaksxd, &xaksyd, &yaksyd, &zaksyd);
+
+    axlng = gmx_invsqrt_pr(gmx_norm2_pr(xaksxd, yaksxd, zaksxd));
+    aylng = gmx_invsqrt_pr(gmx_norm2_pr(xaksyd, yaksyd, zaksyd));
+    azlng = gmx_invsqrt_pr(gmx_norm2_pr(xakszd, yakszd, zakszd));
+
+    trns11 = gmx_mul_pr(xaksxd, axlng);
+    trns21 = gmx_mul_pr(yaksxd, axlng);
+    trns31 = gmx_mul_pr(zaksxd, axlng);
+    trns12 = gmx_mul_pr(xaksyd, aylng);
+    trns22 = gmx_mul_pr(yaksyd, aylng);
+    trns32 = gmx_mul_pr(zaksyd, aylng);
+    trns13 = gmx_mul_pr(xakszd, azlng);
+    trns23 = gmx_mul_pr(yakszd, azlng);
+    trns33 = gmx_mul_pr(zakszd, azlng);
+
+    xb0d = gmx_iprod_pr(trns11, trns21, trns31, xb0, yb0, zb0);
+    yb0d = gmx_iprod_pr(trns12, trns22, trns32, xb0, yb0, zb0);
+    xc0d = gmx_iprod_pr(trns11, trns21, trns31, xc0, yc0, zc0);
+    yc0d = gmx_iprod_pr(trns12, trns22, trns32, xc0, yc0, zc0);
+    za1d = gmx_iprod_pr(trns13, trns23, trns33, xa1, ya1, za1);
+    xb1d = gmx_iprod_pr(trns11, trns21, trns31, xb1, yb1, zb1);
+    yb1d = gmx_iprod_pr(trns12, trns22, trns32, xb1, yb1, zb1);
+    zb1d = gmx_iprod_pr(trns13, trns23, trns33, xb1, yb1, zb1);
+    xc1d = gmx_iprod_pr(trns11, trns21, trns31, xc1, yc1, zc1);
+    yc1d = gmx_iprod_pr(trns12, trns22, trns32, xc1, yc1, zc1);
+    zc1d = gmx_iprod_pr(trns13, trns23, trns33, xc1, yc1, zc1);
+
+    sinphi = gmx_mul_pr(za1d, invra_S);
+    tmp    = gmx_nmsub_pr(sinphi, sinphi, one_S);
+    ok_S   = gmx_blendzero_pr(one_S, gmx_cmplt_pr(zero_S, tmp));
+    tmp2   = gmx_invsqrt_pr(tmp);
+    cosphi = gmx_mul_pr(tmp, tmp2);
+    sinpsi = gmx_mul_pr(gmx_mul_pr(gmx_sub_pr(zb1d, zc1d), irc2_S), tmp2);
+    tmp2   = gmx_nmsub_pr(sinpsi, sinpsi, one_S);
+    ok_S   = gmx_blendzero_pr(ok_S, gmx_cmplt_pr(zero_S, tmp2));
+
+    /* Check if all waters can be settled, before we modify anything */
+    gmx_store_pr(buf + SSB_OK, ok_S);
+    for (l = 0; l < GMX_SIMD_WIDTH_HERE; l++)
+    {
+        if (buf[SSB_OK + l] == 0)
+        {
+            return FALSE;
+        }
+    }
+
+    cospsi = gmx_mul_pr(tmp2, gmx_invsqrt_pr(tmp2));
+
+    ya2d = gmx_mul_pr(ra_S, cosphi);
+    xb2d = gmx_sub_pr(zero_S, gmx_mul_pr(rc_S, cospsi));
+    t1   = gmx_sub_pr(zero_S, gmx_mul_pr(rb_S, cosphi));
+    t2   = gmx_mul_pr(gmx_mul_pr(rc_S, sinpsi), sinphi);
+    yb2d = gmx_sub_pr(t1, t2);
+    yc2d = gmx_add_pr(t1, t2);
+
+    alpa   = gmx_iprod_pr(xb2d, yb0d, yc0d, gmx_sub_pr(xb0d, xc0d), yb2d, yc2d);
+    beta   = gmx_iprod_pr(xb2d, xb0d, xc0d, gmx_sub_pr(yc0d, yb0d), yb2d, yc2d);
+    gama   = gmx_sub_pr(gmx_add_pr(gmx_sub_pr(gmx_mul_pr(xb0d, yb1d),
+                                              gmx_mul_pr(xb1d, yb0d)),
+                                   gmx_mul_pr(xc0d, yc1d)),
+                        gmx_mul_pr(xc1d, yc0d));
+    al2be2 = gmx_madd_pr(beta, beta, gmx_mul_pr(alpa, alpa));
+    tmp2   = gmx_nmsub_pr(gama, gama, al2be2);
+    sinthe = gmx_mul_pr(gmx_nmsub_pr(gmx_mul_pr(beta, tmp2), gmx_invsqrt_pr(tmp2),
+                                     gmx_mul_pr(alpa, gama)),
+                        gmx_invsqrt_pr(gmx_mul_pr(al2be2, al2be2)));
+
+    tmp2   = gmx_nmsub_pr(sinthe, sinthe, one_S);
+    costhe = gmx_mul_pr(tmp2, gmx_invsqrt_pr(tmp2));
+    xa3d   = gmx_sub_pr(zero_S, gmx_mul_pr(ya2d, sinthe));
+    ya3d   = gmx_mul_pr(ya2d, costhe);
+    za3d   = za1d;
+    xb3d   = gmx_nmsub_pr(yb2d, sinthe, gmx_mul_pr(xb2d, costhe));
+    yb3d   = gmx_madd_pr(yb2d, costhe, gmx_mul_pr(xb2d, sinthe));
+    zb3d   = zb1d;
+    xc3d   = gmx_nmsub_pr(yc2d, sinthe, gmx_sub_pr(zero_S, gmx_mul_pr(xb2d, costhe)));
+    yc3d   = gmx_madd_pr(yc2d, costhe, gmx_sub_pr(zero_S, gmx_mul_pr(xb2d, sinthe)));
+    zc3d   = zc1d;
+
+    xa3 = gmx_iprod_pr(trns11, trns12, trns13, xa3d, ya3d, za3d);
+    ya3 = gmx_iprod_pr(trns21, trns22, trns23, xa3d, ya3d, za3d);
+    za3 = gmx_iprod_pr(trns31, trns32, trns33, xa3d, ya3d, za3d);
+    xb3 = gmx_iprod_pr(trns11, trns12, trns13, xb3d, yb3d, zb3d);
+    yb3 = gmx_iprod_pr(trns21, trns22, trns23, xb3d, yb3d, zb3d);
+    zb3 = gmx_iprod_pr(trns31, trns32, trns33, xb3d, yb3d, zb3d);
+    xc3 = gmx_iprod_pr(trns11, trns12, trns13, xc3d, yc3d, zc3d);
+    yc3 = gmx_iprod_pr(trns21, trns22, trns23, xc3d, yc3d, zc3d);
+    zc3 = gmx_iprod_pr(trns31, trns32, trns33, xc3d, yc3d, zc3d);
+
+    dax = gmx_sub_pr(xa3, xa1);
+    day = gmx_sub_pr(ya3, ya1);
+    daz = gmx_sub_pr(za3, za1);
+    dbx = gmx_sub_pr(xb3, xb1);
+    dby = gmx_sub_pr(yb3, yb1);
+    dbz = gmx_sub_pr(zb3, zb1);
+    dcx = gmx_sub_pr(xc3, xc1);
+    dcy = gmx_sub_pr(yc3, yc1);
+    dcz = gmx_sub_pr(zc3, zc1);
+
+    if (calcvir_atom_end > 0)
+    {
+        /* Only waters with the oxygen below calcvir_atom_end contribute */
+        mOs_S  = gmx_mul_pr(gmx_set1_pr(mOs), gmx_load_pr(buf + SSB_VIR));
+        mHs_S  = gmx_mul_pr(gmx_set1_pr(mHs), gmx_load_pr(buf + SSB_VIR));
+        mda[XX] = gmx_mul_pr(mOs_S, dax);
+        mda[YY] = gmx_mul_pr(mOs_S, day);
+        mda[ZZ] = gmx_mul_pr(mOs_S, daz);
+        mdb[XX] = gmx_mul_pr(mHs_S, dbx);
+        mdb[YY] = gmx_mul_pr(mHs_S, dby);
+        mdb[ZZ] = gmx_mul_pr(mHs_S, dbz);
+        mdc[XX] = gmx_mul_pr(mHs_S, dcx);
+        mdc[YY] = gmx_mul_pr(mHs_S, dcy);
+        mdc[ZZ] = gmx_mul_pr(mHs_S, dcz);
+        for (d = 0; d < DIM; d++)
+        {
+            rO[d] = gmx_load_pr(buf + SSB(ssbOB4, d));
+        }
+        rB[XX] = gmx_add_pr(rO[XX], xb0);
+        rB[YY] = gmx_add_pr(rO[YY], yb0);
+        rB[ZZ] = gmx_add_pr(rO[ZZ], zb0);
+        rC[XX] = gmx_add_pr(rO[XX], xc0);
+        rC[YY] = gmx_add_pr(rO[YY], yc0);
+        rC[ZZ] = gmx_add_pr(rO[ZZ], zc0);
+        for (d = 0; d < DIM; d++)
+        {
+            for (d2 = 0; d2 < DIM; d2++)
+            {
+                sum_r_m_dr_S[d][d2] =
+                    gmx_madd_pr(rO[d], mda[d2],
+                                gmx_madd_pr(rB[d], mdb[d2],
+                                            gmx_madd_pr(rC[d], mdc[d2],
+                                                        sum_r_m_dr_S[d][d2])));
+            }
+        }
+    }
+
+    /* Store the new positions and velocity corrections */
+    gmx_store_pr(buf + SSB(ssbO, XX), gmx_add_pr(xcom, xa3));
+    gmx_store_pr(buf + SSB(ssbO, YY), gmx_add_pr(ycom, ya3));
+    gmx_store_pr(buf + SSB(ssbO, ZZ), gmx_add_pr(zcom, za3));
+    gmx_store_pr(buf + SSB(ssbH2, XX), gmx_add_pr(xcom, xb3));
+    gmx_store_pr(buf + SSB(ssbH2, YY), gmx_add_pr(ycom, yb3));
+    gmx_store_pr(buf + SSB(ssbH2, ZZ), gmx_add_pr(zcom, zb3));
+    gmx_store_pr(buf + SSB(ssbH3, XX), gmx_add_pr(xcom, xc3));
+    gmx_store_pr(buf + SSB(ssbH3, YY), gmx_add_pr(ycom, yc3));
+    gmx_store_pr(buf + SSB(ssbH3, ZZ), gmx_add_pr(zcom, zc3));
+    if (v != NULL)
+    {
+        gmx_store_pr(buf + SSB(ssbDOH2, XX), gmx_mul_pr(dax, invdts_S));
+        gmx_store_pr(buf + SSB(ssbDOH2, YY), gmx_mul_pr(day, invdts_S));
+        gmx_store_pr(buf + SSB(ssbDOH2, ZZ), gmx_mul_pr(daz, invdts_S));
+        gmx_store_pr(buf + SSB(ssbDOH3, XX), gmx_mul_pr(dbx, invdts_S));
+        gmx_store_pr(buf + SSB(ssbDOH3, YY), gmx_mul_pr(dby, invdts_S));
+        gmx_store_pr(buf + SSB(ssbDOH3, ZZ), gmx_mul_pr(dbz, invdts_S));
+        gmx_store_pr(buf + SSB(ssbB0, XX), gmx_mul_pr(dcx, invdts_S));
+        gmx_store_pr(buf + SSB(ssbB0, YY), gmx_mul_pr(dcy, invdts_S));
+        gmx_store_pr(buf + SSB(ssbB0, ZZ), gmx_mul_pr(dcz, invdts_S));
+    }
+
+    /* Scatter the results */
+    for (l = 0; l < GMX_SIMD_WIDTH_HERE; l++)
+    {
+        ow1 = iatoms[l*4+1] * 3;
+        hw2 = iatoms[l*4+2] * 3;
+        hw3 = iatoms[l*4+3] * 3;
+
+        for (d = 0; d < DIM; d++)
+        {
+            after[ow1 + d] = buf[SSB(ssbO, d) + l];
+            after[hw2 + d] = buf[SSB(ssbH2, d) + l];
+            after[hw3 + d] = buf[SSB(ssbH3, d) + l];
+        }
+        if (pbc != NULL)
+        {
+            for (d = 0; d < DIM; d++)
+            {
+                after[hw2 + d] += buf[SSB(ssbSH2, d) + l];
+                after[hw3 + d] += buf[SSB(ssbSH3, d) + l];
+            }
+        }
+        if (v != NULL)
+        {
+            for (d = 0; d < DIM; d++)
+            {
+                v[ow1 + d] += buf[SSB(ssbDOH2, d) + l];
+                v[hw2 + d] += buf[SSB(ssbDOH3, d) + l];
+                v[hw3 + d] += buf[SSB(ssbB0, d) + l];
+            }
+        }
+    }
+
+    return TRUE;
+}
+#endif /* SETTLE_SIMD */
+
+void csettle(gmx_settledata_t settled,
+             int nsettle, t_iatom iatoms[],
+             const t_pbc *pbc,
+             real b4[], real after[],
+             real invdt, real *v, int CalcVirAtomEnd,
+             tensor vir_r_m_dr,
+             int *error,
+             t_vetavars *vetavar)
+{
+    int i;
+
+    *error = -1;
+
+    i = 0;
+#ifdef SETTLE_SIMD
+    if (settled->bUseSimd && nsettle >= GMX_SIMD_WIDTH_HERE)
+    {
+        settleparam_t *p;
+        real           mOs, mHs, invdts;
+        real           buf_unaligned[SSB_SIZE + GMX_SIMD_WIDTH_HERE], *buf;
+        gmx_mm_pr      sum_r_m_dr_S[DIM][DIM];
+        int            d, d2, l;
+
+        buf = gmx_simd_align_real(buf_unaligned);
+
+        p      = &settled->massw;
+        mOs    = p->mO / vetavar->rvscale;
+        mHs    = p->mH / vetavar->rvscale;
+        invdts = invdt / vetavar->rscale;
+
+        for (d = 0; d < DIM; d++)
+        {
+            for (d2 = 0; d2 < DIM; d2++)
+            {
+                sum_r_m_dr_S[d][d2] = gmx_setzero_pr();
+            }
+        }
+
+        for (i = 0; i + GMX_SIMD_WIDTH_HERE <= nsettle; i += GMX_SIMD_WIDTH_HERE)
+        {
+            if (!csettle_simd_block(p, iatoms + i*4, pbc, b4, after,
+                                    invdts, v, CalcVirAtomEnd, mOs, mHs,
+                                    buf, sum_r_m_dr_S))
+            {
+                /* Let the plain C code handle the error reporting */
+                csettle_plain(settled, i, i + GMX_SIMD_WIDTH_HERE, iatoms,
+                              pbc, b4, after, invdt, v, CalcVirAtomEnd,
+                              vir_r_m_dr, error, vetavar);
+            }
+        }
+
+        if (CalcVirAtomEnd > 0)
+        {
+            for (d = 0; d < DIM; d++)
+            {
+                for (d2 = 0; d2 < DIM; d2++)
+                {
+                    gmx_store_pr(buf, sum_r_m_dr_S[d][d2]);
+                    for (l = 0; l < GMX_SIMD_WIDTH_HERE; l++)
+                    {
+                        vir_r_m_dr[d][d2] -= buf[l];
+                    }
+                }
+            }
+        }
+    }
+#endif
+
+    /* Settle the remaining waters with plain C */
+    csettle_plain(settled, i, nsettle, iatoms, pbc, b4, after,
+                  invdt, v, CalcVirAtomEnd, vir_r_m_dr, error, vetavar);
+}
@@ -348,6 +348,9 @@ typedef struct gmx_domdec_comm
     int        nalloc_int2;
     vec_rvec_t vbuf2;
 
+    /* Handle for the coordinate communication started in dd_move_x_start */
+    dd_sendrecv_req_t move_x_req;
+
     /* Communication buffers for local redistribution */
     int  **cggl_flag;
     int    cggl_flag_nalloc[DIM*2];
@@ -373,6 +376,8 @@ typedef struct gmx_domdec_comm
 
     /* Maximum DLB scaling per load balancing step in percent */
     int dlb_scale_lim;
+    /* Place the DLB cell boundaries at equal cumulative load */
+    gmx_bool bDLBCumulative;
 
     /* Cycle counters */
     float  cycl[ddCyclNr];
@@ -637,19 +642,130 @@ void dd_get_constraint_range(gmx_domdec_t *dd, int *at_start, int *at_end)
     *at_end   = dd->comm->nat[ddnatCON];
 }
 
-void dd_move_x(gmx_domdec_t *dd, matrix box, rvec x[])
+/* Packs the coordinates to send for pulse ind along dimension index d */
+static void dd_move_x_pack(gmx_domdec_t *dd, matrix box, rvec x[],
+                           int d, const gmx_domdec_ind_t *ind, int nzone,
+                           rvec *buf)
+{
+    int       n, i, j, at0, at1;
+    int      *index, *cgindex;
+    rvec      shift = {0, 0, 0};
+    gmx_bool  bPBC, bScrew;
+
+    cgindex = dd->cgindex;
+
+    bPBC   = (dd->ci[dd->dim[d]] == 0);
+    bScrew = (bPBC && dd->bScrewPBC && dd->dim[d] == XX);
+    if (bPBC)
+    {
+        copy_rvec(box[dd->dim[d]], shift);
+    }
+    index = ind->index;
+    n     = 0;
+    if (!bPBC)
+    {
+        for (i = 0; i < ind->nsend[nzone]; i++)
+        {
+            at0 = cgindex[index[i]];
+            at1 = cgindex[index[i]+1];
+            for (j = at0; j < at1; j++)
+            {
+                copy_rvec(x[j], buf[n]);
+                n++;
+            }
+        }
+    }
+    else if (!bScrew)
+    {
+        for (i = 0; i < ind->nsend[nzone]; i++)
+        {
+            at0 = cgindex[index[i]];
+            at1 = cgindex[index[i]+1];
+            for (j = at0; j < at1; j++)
+            {
+                /* We need to shift the coordinates */
+                rvec_add(x[j], shift, buf[n]);
+                n++;
+            }
+        }
+    }
+    else
+    {
+        for (i = 0; i < ind->nsend[nzone]; i++)
+        {
+            at0 = cgindex[index[i]];
+            at1 = cgindex[index[i]+1];
+            for (j = at0; j < at1; j++)
+            {
+                /* Shift x */
+                buf[n][XX] = x[j][XX] + shift[XX];
+                /* Rotate y and z.
+                 * This operation requires a special shift force
+                 * treatment, which is performed in calc_vir.
+                 */
+                buf[n][YY] = box[YY][YY] - x[j][YY];
+                buf[n][ZZ] = box[ZZ][ZZ] - x[j][ZZ];
+                n++;
+            }
+        }
+    }
+}
+
+/* Copies received coordinates to x, when not received in place */
+static void dd_move_x_unpack(const gmx_domdec_comm_dim_t *cd,
+                             const gmx_domdec_ind_t *ind, int nzone,
+                             rvec *rbuf, rvec x[])
+{
+    int i, j, zone;
+
+    if (!cd->bInPlace)
+    {
+        j = 0;
+        for (zone = 0; zone < nzone; zone++)
+        {
+            for (i = ind->cell2at0[zone]; i < ind->cell2at1[zone]; i++)
+            {
+                copy_rvec(rbuf[j], x[i]);
+                j++;
+            }
+        }
+    }
+}
+
+void dd_move_x_start(gmx_domdec_t *dd, matrix box, rvec x[])
 {
-    int                    nzone, nat_tot, n, d, p, i, j, at0, at1, zone;
-    int                   *index, *cgindex;
     gmx_domdec_comm_t     *comm;
     gmx_domdec_comm_dim_t *cd;
     gmx_domdec_ind_t      *ind;
-    rvec                   shift = {0, 0, 0}, *buf, *rbuf;
-    gmx_bool               bPBC, bScrew;
+    rvec                  *rbuf;
 
     comm = dd->comm;
 
-    cgindex = dd->cgindex;
+    /* The first pulse along the first dimension only sends home atoms,
+     * so it can be started as soon as the home coordinates are known.
+     * All later pulses forward received coordinates and have to wait.
+     */
+    cd  = &comm->cd[0];
+    ind = &cd->ind[0];
+
+    dd_move_x_pack(dd, box, x, 0, ind, 1, comm->vbuf.v);
+
+    rbuf = (cd->bInPlace ? x + dd->nat_home : comm->vbuf2.v);
+    dd_sendrecv_rvec_start(dd, 0, dddirBackward,
+                           comm->vbuf.v, ind->nsend[2],
+                           rbuf, ind->nrecv[2],
+                           &comm->move_x_req);
+}
+
+void dd_move_x_finish(gmx_domdec_t *dd, matrix box, rvec x[])
+{
+    int                    nzone, nat_tot, d, p;
+    gmx_domdec_comm_t     *comm;
+    gmx_domdec_comm_dim_t *cd;
+    gmx_domdec_ind_t      *ind;
+    rvec                  *buf, *rbuf;
+
+    comm = dd->comm;
 
     buf = comm->vbuf.v;
 
@@ -657,65 +773,10 @@ void dd_move_x(gmx_domdec_t *dd, matrix box, rvec x[])
     nat_tot = dd->nat_home;
     for (d = 0; d < dd->ndim; d++)
     {
-        bPBC   = (dd->ci[dd->dim[d]] == 0);
-        bScrew = (bPBC && dd->bScrewPBC && dd->dim[d] == XX);
-        if (bPBC)
-        {
-            copy_rvec(box[dd->dim[d]], shift);
-        }
         cd = &comm->cd[d];
         for (p = 0; p < cd->np; p++)
         {
-            ind   = &cd->ind[p];
-            index = ind->index;
-            n     = 0;
-            if (!bPBC)
-            {
-                for (i = 0; i < ind->nsend[nzone]; i++)
-                {
-                    at0 = cgindex[index[i]];
-                    at1 = cgindex[index[i]+1];
-                    for (j = at0; j < at1; j++)
-                    {
-                        copy_rvec(x[j], buf[n]);
-                        n++;
-                    }
-                }
-            }
-            else if (!bScrew)
-            {
-                for (i = 0; i < ind->nsend[nzone]; i++)
-                {
-                    at0 = cgindex[index[i]];
-                    at1 = cgindex[index[i]+1];
-                    for (j = at0; j < at1; j++)
-                    {
-                        /* We need to shift the coordinates */
-                        rvec_add(x[j], shift, buf[n]);
-                        n++;
-                    }
-                }
-            }
-            else
-            {
-                for (i = 0; i < ind->nsend[nzone]; i++)
-                {
-                    at0 = cgindex[index[i]];
-                    at1 = cgindex[index[i]+1];
-                    for (j = at0; j < at1; j++)
-                    {
-                        /* Shift x */
-                        buf[n][XX] = x[j][XX] + shift[XX];
-                        /* Rotate y and z.
-                         * This operation requires a special shift force
-                         * treatment, which is performed in calc_vir.
-                         */
-                        buf[n][YY] = box[YY][YY] - x[j][YY];
-                        buf[n][ZZ] = box[ZZ][ZZ] - x[j][ZZ];
-                        n++;
-                    }
-                }
-            }
+            ind = &cd->ind[p];
 
             if (cd->bInPlace)
             {
@@ -725,28 +786,34 @@ void dd_move_x(gmx_domdec_t *dd, matrix box, rvec x[])
             {
                 rbuf = comm->vbuf2.v;
             }
-            /* Send and receive the coordinates */
-            dd_sendrecv_rvec(dd, d, dddirBackward,
-                             buf,  ind->nsend[nzone+1],
-                             rbuf, ind->nrecv[nzone+1]);
-            if (!cd->bInPlace)
+            if (d == 0 && p == 0)
             {
-                j = 0;
-                for (zone = 0; zone < nzone; zone++)
-                {
-                    for (i = ind->cell2at0[zone]; i < ind->cell2at1[zone]; i++)
-                    {
-                        copy_rvec(rbuf[j], x[i]);
-                        j++;
-                    }
-                }
+                /* This pulse was started in dd_move_x_start */
+                dd_sendrecv_rvec_finish(dd, &comm->move_x_req);
             }
+            else
+            {
+                dd_move_x_pack(dd, box, x, d, ind, nzone, buf);
+
+                /* Send and receive the coordinates */
+                dd_sendrecv_rvec(dd, d, dddirBackward,
+                                 buf,  ind->nsend[nzone+1],
+                                 rbuf, ind->nrecv[nzone+1]);
+            }
+            dd_move_x_unpack(cd, ind, nzone, rbuf, x);
+
             nat_tot += ind->nrecv[nzone+1];
         }
         nzone += nzone;
     }
 }
 
+void dd_move_x(gmx_domdec_t *dd, matrix box, rvec x[])
+{
+    dd_move_x_start(dd, box, x);
+    dd_move_x_finish(dd, box, x);
+}
+
 void dd_move_f(gmx_domdec_t *dd, rvec f[], rvec *fshift)
 {
     int                    nzone, nat_tot, n, d, p, i, j, at0, at1, zone;
@@ -3449,6 +3516,68 @@ static void dd_cell_sizes_dlb_root_enforce_limits(gmx_domdec_t *dd,
 }
 
 
+/* Sets the cell sizes of a row of ncd cells such that the measured load,
+ * assumed to be distributed uniformly within each current cell,
+ * is divided equally over the cells. This applies the bisection
+ * recursively over the DD dimensions, as the load of a cell in
+ * a lower dimension is the summed load of its row in the next dimension.
+ * In contrast to the default scaling, which assumes the load is
+ * proportional to the cell volume, this converges in a few steps
+ * for strongly inhomogeneous systems, e.g. with vacuum regions.
+ */
+static void dd_cell_sizes_dlb_cumulative(const gmx_domdec_root_t *root,
+                                         const gmx_domdec_load_t *load,
+                                         int ncd, real relax,
+                                         real *cell_size)
+{
+    int  i, k;
+    real load_tot, load_i, load_cum, target, frac, bound, bound_prev;
+
+    load_tot = 0;
+    for (i = 0; i < ncd; i++)
+    {
+        load_tot += load->load[i*load->nload+2];
+    }
+    if (load_tot <= 0)
+    {
+        for (i = 0; i < ncd; i++)
+        {
+            cell_size[i] = root->cell_f[i+1] - root->cell_f[i];
+        }
+        return;
+    }
+
+    i          = 0;
+    load_cum   = 0;
+    bound_prev = 0;
+    for (k = 1; k <= ncd; k++)
+    {
+        if (k < ncd)
+        {
+            /* Find the cell i where the cumulative load reaches k/ncd */
+            target = k*load_tot/ncd;
+            load_i = load->load[i*load->nload+2];
+            while (i < ncd - 1 && load_cum + load_i < target)
+            {
+                load_cum += load_i;
+                i++;
+                load_i    = load->load[i*load->nload+2];
+            }
+            frac  = (load_i > 0 ? (target - load_cum)/load_i : 0);
+            frac  = min(max(frac, 0), 1);
+            bound = root->cell_f[i] + frac*(root->cell_f[i+1] - root->cell_f[i]);
+        }
+        else
+        {
+            bound = 1;
+        }
+        /* Underrelax the change of cell k-1 */
+        cell_size[k-1] = (1 - relax)*(root->cell_f[k] - root->cell_f[k-1]) +
+            relax*(bound - bound_prev);
+        bound_prev     = bound;
+    }
+}
+
 static void set_dd_cell_sizes_dlb_root(gmx_domdec_t *dd,
                                        int d, int dim, gmx_domdec_root_t *root,
                                        gmx_ddbox_t *ddbox, gmx_bool bDynamicBox,
@@ -3487,6 +3616,11 @@ static void set_dd_cell_sizes_dlb_root(gmx_domdec_t *dd,
             cell_size[i] = 1.0/ncd;
         }
     }
+    else if (dd_load_count(comm) && comm->bDLBCumulative)
+    {
+        dd_cell_sizes_dlb_cumulative(root, &comm->load[d], ncd, relax,
+                                     cell_size);
+    }
     else if (dd_load_count(comm))
     {
         load_aver  = comm->load[d].sum_m/ncd;
@@ -6320,6 +6454,8 @@ void make_dd_communicators(FILE *fplog, t_commrec *cr, int dd_node_order)
     {
         /* Copy or make a new PP communicator */
         make_pp_communicator(fplog, cr, CartReorder);
+
+        dd_init_shm(fplog, dd);
     }
     else
     {
@@ -6667,7 +6803,9 @@ gmx_domdec_t *init_domain_decomposition(FILE *fplog, t_commrec *cr,
     dd->bScrewPBC = (ir->ePBC == epbcSCREW);
 
     dd->bSendRecv2      = dd_nst_env(fplog, "GMX_DD_SENDRECV2", 0);
+    dd->bOverlapX       = (dd_nst_env(fplog, "GMX_DD_NO_OVERLAP", 0) == 0);
     comm->dlb_scale_lim = dd_nst_env(fplog, "GMX_DLB_MAX", 10);
+    comm->bDLBCumulative = (dd_nst_env(fplog, "GMX_DLB_CUMULATIVE", 0) != 0);
     comm->eFlop         = dd_nst_env(fplog, "GMX_DLB_FLOP", 0);
     recload             = dd_nst_env(fplog, "GMX_DD_LOAD", 1);
     comm->nstSortCG     = dd_nst_env(fplog, "GMX_DD_SORT", 1);
@@ -20,14 +20,158 @@
 #include <config.h>
 #endif
 
+#include <stdlib.h>
 #include <string.h>
 #include "domdec_network.h"
+#include "smalloc.h"
+#include "gmx_fatal.h"
 
 #include "gromacs/utility/gmxmpi.h"
+#ifdef GMX_THREAD_MPI
+#include "thread_mpi/atomic.h"
+#include "thread_mpi/wait.h"
+#endif
 
 
 #define DDMASTERRANK(dd)   (dd->masterrank)
 
+#ifdef GMX_THREAD_MPI
+/* The shared memory communication state of one DD rank.
+ * Only the owning rank writes to it, its neighbors only read it.
+ * Messages are matched per dimension index and direction,
+ * as with MPI all ranks should communicate in the same order.
+ */
+typedef struct {
+    /* The posted send buffer and its size in bytes */
+    const void    *buf[DIM][2];
+    int            nbytes[DIM][2];
+    /* The number of messages posted */
+    tMPI_Atomic_t  nposted[DIM][2];
+    /* The number of messages received from our neighbor */
+    tMPI_Atomic_t  nread[DIM][2];
+    /* Avoid false sharing with the data of the next rank */
+    char           pad[64];
+} dd_shm_rank_t;
+
+struct gmx_domdec_shm {
+    dd_shm_rank_t *rank;
+};
+#endif
+
+void dd_init_shm(FILE *fplog, gmx_domdec_t *dd)
+{
+    dd->shm = NULL;
+
+#ifdef GMX_THREAD_MPI
+    /* With thread-MPI all ranks share the address space, so we can
+     * copy the halo data directly between the buffers of neighboring
+     * ranks, instead of going through the message passing layer.
+     */
+    if (getenv("GMX_DD_NO_SHM") == NULL)
+    {
+        struct gmx_domdec_shm *shm = NULL;
+        int                    r, d, dir;
+
+        if (DDMASTER(dd))
+        {
+            snew(shm, 1);
+            snew(shm->rank, dd->nnodes);
+            for (r = 0; r < dd->nnodes; r++)
+            {
+                for (d = 0; d < DIM; d++)
+                {
+                    for (dir = 0; dir < 2; dir++)
+                    {
+                        tMPI_Atomic_set(&shm->rank[r].nposted[d][dir], 0);
+                        tMPI_Atomic_set(&shm->rank[r].nread[d][dir], 0);
+                    }
+                }
+            }
+            tMPI_Atomic_memory_barrier();
+        }
+        /* All thread-MPI ranks use the same shared data */
+        dd_bcast(dd, sizeof(shm), &shm);
+
+        dd->shm = shm;
+
+        if (fplog)
+        {
+            fprintf(fplog, "Using direct shared memory copies for the DD halo communication\n");
+        }
+    }
+#else
+    GMX_UNUSED_VALUE(fplog);
+#endif
+}
+
+#ifdef GMX_THREAD_MPI
+/* Posts nbytes_s bytes from buf_s for our neighbor along ddimind,
+ * the receive is done with dd_shm_finish.
+ */
+static void dd_shm_start(const gmx_domdec_t *dd,
+                         int ddimind, int direction,
+                         const void *buf_s, int nbytes_s)
+{
+    dd_shm_rank_t *me;
+
+    me = &dd->shm->rank[dd->rank];
+
+    me->buf[ddimind][direction]    = buf_s;
+    me->nbytes[ddimind][direction] = nbytes_s;
+    /* The buffer and size should be visible before the post count */
+    tMPI_Atomic_memory_barrier_rel();
+    tMPI_Atomic_set(&me->nposted[ddimind][direction],
+                    tMPI_Atomic_get(&me->nposted[ddimind][direction]) + 1);
+}
+
+/* Copies the data posted by our neighbor into buf_r and waits until
+ * our own posted data has been read, after which buf_s can be reused.
+ */
+static void dd_shm_finish(const gmx_domdec_t *dd,
+                          int ddimind, int direction,
+                          void *buf_r, int nbytes_r)
+{
+    dd_shm_rank_t *me, *src, *dest;
+    int            rank_s, rank_r, n, nbytes;
+
+    rank_s = dd->neighbor[ddimind][direction == dddirForward ? 0 : 1];
+    rank_r = dd->neighbor[ddimind][direction == dddirForward ? 1 : 0];
+
+    me   = &dd->shm->rank[dd->rank];
+    src  = &dd->shm->rank[rank_r];
+    dest = &dd->shm->rank[rank_s];
+
+    /* The sequence number of the message pair on this channel */
+    n = tMPI_Atomic_get(&me->nposted[ddimind][direction]);
+
+    while (tMPI_Atomic_get(&src->nposted[ddimind][direction]) < n)
+    {
+        TMPI_YIELD_WAIT(NULL);
+    }
+    tMPI_Atomic_memory_barrier_acq();
+
+    nbytes = src->nbytes[ddimind][direction];
+    if (nbytes > nbytes_r)
+    {
+        gmx_incons("DD shared memory communication receive buffer is too small");
+    }
+    if (nbytes > 0)
+    {
+        memcpy(buf_r, src->buf[ddimind][direction], nbytes);
+    }
+
+    /* Signal that the data of our neighbor has been read */
+    tMPI_Atomic_memory_barrier_rel();
+    tMPI_Atomic_set(&me->nread[ddimind][direction], n);
+
+    while (tMPI_Atomic_get(&dest->nread[ddimind][direction]) < n)
+    {
+        TMPI_YIELD_WAIT(NULL);
+    }
+    tMPI_Atomic_memory_barrier_acq();
+}
+#endif
+
 
 void dd_sendrecv_int(const gmx_domdec_t gmx_unused *dd,
                      int gmx_unused ddimind, int gmx_unused direction,
@@ -38,6 +182,16 @@ void dd_sendrecv_int(const gmx_domdec_t gmx_unused *dd,
     int        rank_s, rank_r;
     MPI_Status stat;
 
+#ifdef GMX_THREAD_MPI
+    if (dd->shm != NULL)
+    {
+        dd_shm_start(dd, ddimind, direction, buf_s, n_s*sizeof(int));
+        dd_shm_finish(dd, ddimind, direction, buf_r, n_r*sizeof(int));
+
+        return;
+    }
+#endif
+
     rank_s = dd->neighbor[ddimind][direction == dddirForward ? 0 : 1];
     rank_r = dd->neighbor[ddimind][direction == dddirForward ? 1 : 0];
 
@@ -70,6 +224,16 @@ void dd_sendrecv_real(const gmx_domdec_t gmx_unused *dd,
     int        rank_s, rank_r;
     MPI_Status stat;
 
+#ifdef GMX_THREAD_MPI
+    if (dd->shm != NULL)
+    {
+        dd_shm_start(dd, ddimind, direction, buf_s, n_s*sizeof(real));
+        dd_shm_finish(dd, ddimind, direction, buf_r, n_r*sizeof(real));
+
+        return;
+    }
+#endif
+
     rank_s = dd->neighbor[ddimind][direction == dddirForward ? 0 : 1];
     rank_r = dd->neighbor[ddimind][direction == dddirForward ? 1 : 0];
 
@@ -102,6 +266,16 @@ void dd_sendrecv_rvec(const gmx_domdec_t gmx_unused *dd,
     int        rank_s, rank_r;
     MPI_Status stat;
 
+#ifdef GMX_THREAD_MPI
+    if (dd->shm != NULL)
+    {
+        dd_shm_start(dd, ddimind, direction, buf_s, n_s*sizeof(rvec));
+        dd_shm_finish(dd, ddimind, direction, buf_r, n_r*sizeof(rvec));
+
+        return;
+    }
+#endif
+
     rank_s = dd->neighbor[ddimind][direction == dddirForward ? 0 : 1];
     rank_r = dd->neighbor[ddimind][direction == dddirForward ? 1 : 0];
 
@@ -125,6 +299,71 @@ void dd_sendrecv_rvec(const gmx_domdec_t gmx_unused *dd,
 #endif
 }
 
+void dd_sendrecv_rvec_start(const gmx_domdec_t gmx_unused *dd,
+                            int gmx_unused ddimind, int gmx_unused direction,
+                            rvec gmx_unused *buf_s, int gmx_unused n_s,
+                            rvec gmx_unused *buf_r, int gmx_unused n_r,
+                            dd_sendrecv_req_t *req)
+{
+    req->nreq = 0;
+#ifdef GMX_THREAD_MPI
+    if (dd->shm != NULL)
+    {
+        /* Store the receive side for dd_sendrecv_rvec_finish */
+        req->ddimind   = ddimind;
+        req->direction = direction;
+        req->buf_r     = buf_r;
+        req->n_r       = n_r;
+        dd_shm_start(dd, ddimind, direction, buf_s, n_s*sizeof(rvec));
+
+        return;
+    }
+#endif
+#ifdef GMX_MPI
+    {
+        int rank_s, rank_r;
+
+        rank_s = dd->neighbor[ddimind][direction == dddirForward ? 0 : 1];
+        rank_r = dd->neighbor[ddimind][direction == dddirForward ? 1 : 0];
+
+        /* Post the receive first, so the data can go directly into buf_r */
+        if (n_r)
+        {
+            MPI_Irecv(buf_r[0], n_r*sizeof(rvec), MPI_BYTE,
+                      rank_r, 0, dd->mpi_comm_all, &req->req[req->nreq++]);
+        }
+        if (n_s)
+        {
+            MPI_Isend(buf_s[0], n_s*sizeof(rvec), MPI_BYTE,
+                      rank_s, 0, dd->mpi_comm_all, &req->req[req->nreq++]);
+        }
+    }
+#endif
+}
+
+void dd_sendrecv_rvec_finish(const gmx_domdec_t gmx_unused *dd,
+                             dd_sendrecv_req_t *req)
+{
+#ifdef GMX_THREAD_MPI
+    if (dd->shm != NULL)
+    {
+        dd_shm_finish(dd, req->ddimind, req->direction,
+                      req->buf_r, req->n_r*sizeof(rvec));
+
+        return;
+    }
+#endif
+#ifdef GMX_MPI
+    MPI_Status stat[2];
+
+    if (req->nreq > 0)
+    {
+        MPI_Waitall(req->nreq, req->req, stat);
+    }
+#endif
+    req->nreq = 0;
+}
+
 void dd_sendrecv2_rvec(const gmx_domdec_t gmx_unused *dd,
                        int gmx_unused ddimind,
                        rvec gmx_unused *buf_s_fw, int gmx_unused n_s_fw,
@@ -137,6 +376,19 @@ void dd_sendrecv2_rvec(const gmx_domdec_t gmx_unused *dd,
     MPI_Request req[4];
     MPI_Status  stat[4];
 
+#ifdef GMX_THREAD_MPI
+    if (dd->shm != NULL)
+    {
+        /* Post both directions before waiting for either of them */
+        dd_shm_start(dd, ddimind, dddirForward, buf_s_fw, n_s_fw*sizeof(rvec));
+        dd_shm_start(dd, ddimind, dddirBackward, buf_s_bw, n_s_bw*sizeof(rvec));
+        dd_shm_finish(dd, ddimind, dddirForward, buf_r_fw, n_r_fw*sizeof(rvec));
+        dd_shm_finish(dd, ddimind, dddirBackward, buf_r_bw, n_r_bw*sizeof(rvec));
+
+        return;
+    }
+#endif
+
     rank_fw = dd->neighbor[ddimind][0];
     rank_bw = dd->neighbor[ddimind][1];
 
@@ -54,6 +54,21 @@ typedef struct {
     int  type;
 } gmx_molblock_ind_t;
 
+/* Cache of the bonded interactions assigned to the home zone,
+ * used to update the local topology incrementally.
+ * Only atoms of which all linked interactions were assigned and have
+ * all their atoms in the home zone are cached.
+ */
+typedef struct {
+    int  nat;        /* The number of home atoms                          */
+    int *gat;        /* The global atom index of each home atom           */
+    int *start;      /* Start in il of each home atom, -1 when not cached */
+    int  nat_nalloc; /* Allocation size of gat and start                  */
+    int *il;         /* Per atom: count|ftype|type|a0|...|an|ftype|...    */
+    int  il_nr;      /* The number of entries in il                       */
+    int  il_nalloc;  /* Allocation size of il                             */
+} gmx_incr_top_t;
+
 typedef struct gmx_reverse_top {
     gmx_bool             bExclRequired; /* Do we require all exclusions to be assigned? */
     gmx_bool             bConstr;       /* Are there constraints in this revserse top?  */
@@ -75,6 +90,17 @@ typedef struct gmx_reverse_top {
     t_blocka   *excl_thread;
     int        *excl_count_thread;
 
+    /* Incremental home zone update of the local topology */
+    gmx_bool        bIncr;         /* Use incremental updates                */
+    gmx_bool        bIncrRCheck2B; /* bRCheck2B used for incr_old            */
+    gmx_incr_top_t  incr_old;      /* The cache of the last partitioning     */
+    gmx_incr_top_t  incr_new;      /* The cache of the current partitioning  */
+    gmx_incr_top_t *incr_thread;   /* Thread-local cache interaction buffers */
+    int            *incr_old2new;  /* Old to new home atom index, or -1      */
+    int            *incr_new2old;  /* New to old home atom index, or -1      */
+    int             incr_old2new_nalloc;
+    int             incr_new2old_nalloc;
+
     /* Pointers only used for an error message */
     gmx_mtop_t     *err_top_global;
     gmx_localtop_t *err_top_local;
@@ -680,6 +706,12 @@ static gmx_reverse_top_t *make_reverse_top(gmx_mtop_t *mtop, gmx_bool bFE,
     snew(rt->excl_thread, rt->nthread);
     snew(rt->excl_count_thread, rt->nthread);
 
+    /* Between partitionings most atoms stay home, so we can reuse
+     * most of the home zone assignments of the previous partitioning.
+     */
+    rt->bIncr = (getenv("GMX_DD_NO_INCR_TOP") == NULL);
+    snew(rt->incr_thread, rt->nthread);
+
     return rt;
 }
 
@@ -1153,6 +1185,104 @@ static void combine_idef(t_idef *dest, const t_idef *src, int nsrc,
  * With thread parallelizing each thread acts on a different atom range:
  * at_start to at_end.
  */
+/* Returns if this interaction is counted for the interaction check */
+static gmx_bool count_bonded(gmx_bool bBCheck, int ftype)
+{
+    return (ftype == F_SETTLE || bBCheck ||
+            !(interaction_function[ftype].flags & IF_LIMZERO));
+}
+
+/* Ensures that n more elements fit in the interaction buffer of it */
+static void incr_il_alloc(gmx_incr_top_t *it, int n)
+{
+    if (it->il_nr + n > it->il_nalloc)
+    {
+        it->il_nalloc = over_alloc_large(it->il_nr + n);
+        srenew(it->il, it->il_nalloc);
+    }
+}
+
+/* Adds interaction tiatoms to the cache record starting at rec in it */
+static void incr_add_ifunc(gmx_incr_top_t *it, int rec,
+                           int ftype, int nral, const t_iatom *tiatoms)
+{
+    int k;
+
+    incr_il_alloc(it, 2 + nral);
+    it->il[it->il_nr++] = ftype;
+    for (k = 0; k < 1 + nral; k++)
+    {
+        it->il[it->il_nr++] = tiatoms[k];
+    }
+    it->il[rec]++;
+}
+
+/* Adds the cached interactions of home atom i of the last partitioning
+ * to idef and to the new cache record in it, using new atom indices.
+ * Returns FALSE, without adding anything, when atom i was not cached
+ * or when not all its interaction atoms are still home atoms.
+ */
+static gmx_bool incr_add_cached(const gmx_reverse_top_t *rt, int i,
+                                t_idef *idef, gmx_incr_top_t *it,
+                                int *nbonded_local)
+{
+    const gmx_incr_top_t *old;
+    const int            *il;
+    int                   a_old, n, b, j, k, ftype, nral, rec;
+    t_iatom               tiatoms[1+MAXATOMLIST];
+
+    old   = &rt->incr_old;
+    a_old = rt->incr_new2old[i];
+    if (a_old < 0 || old->start[a_old] < 0)
+    {
+        return FALSE;
+    }
+
+    il = old->il + old->start[a_old];
+    n  = il[0];
+
+    /* Check if all atoms are still home atoms */
+    j = 1;
+    for (b = 0; b < n; b++)
+    {
+        nral = NRAL(il[j]);
+        for (k = 0; k < nral; k++)
+        {
+            if (rt->incr_old2new[il[j+2+k]] < 0)
+            {
+                return FALSE;
+            }
+        }
+        j += 2 + nral;
+    }
+
+    rec = it->il_nr;
+    incr_il_alloc(it, 1);
+    it->il[it->il_nr++] = 0;
+
+    j = 1;
+    for (b = 0; b < n; b++)
+    {
+        ftype      = il[j];
+        nral       = NRAL(ftype);
+        tiatoms[0] = il[j+1];
+        for (k = 0; k < nral; k++)
+        {
+            tiatoms[1+k] = rt->incr_old2new[il[j+2+k]];
+        }
+        add_ifunc(nral, tiatoms, &idef->il[ftype]);
+        if (count_bonded(rt->bBCheck, ftype))
+        {
+            (*nbonded_local)++;
+        }
+        incr_add_ifunc(it, rec, ftype, nral, tiatoms);
+        j += 2 + nral;
+    }
+    rt->incr_new.start[i] = rec;
+
+    return TRUE;
+}
+
 static int make_bondeds_zone(gmx_domdec_t *dd,
                              const gmx_domdec_zones_t *zones,
                              const gmx_molblock_t *molb,
@@ -1164,12 +1294,14 @@ static int make_bondeds_zone(gmx_domdec_t *dd,
                              int **vsite_pbc,
                              int *vsite_pbc_nalloc,
                              int iz, int nzone,
-                             int at_start, int at_end)
+                             int at_start, int at_end,
+                             gmx_bool bIncrUse, gmx_incr_top_t *incr_t)
 {
     int                           i, i_gl, mb, mt, mol, i_mol, j, ftype, nral, d, k;
     int                          *index, *rtil;
     t_iatom                      *iatoms, tiatoms[1+MAXATOMLIST];
-    gmx_bool                      bBCheck, bUse, bLocal;
+    gmx_bool                      bBCheck, bUse, bLocal, bCache, bHome;
+    int                           rec = 0;
     ivec                          k_zero, k_plus;
     gmx_ga2la_t                   ga2la;
     int                           a_loc;
@@ -1192,6 +1324,22 @@ static int make_bondeds_zone(gmx_domdec_t *dd,
 
     for (i = at_start; i < at_end; i++)
     {
+        /* With incr_t!=NULL we are in the home zone and we record
+         * the assignments for incremental updates at the next step.
+         */
+        if (incr_t != NULL)
+        {
+            if (bIncrUse &&
+                incr_add_cached(rt, i, idef, incr_t, &nbonded_local))
+            {
+                continue;
+            }
+            rec = incr_t->il_nr;
+            incr_il_alloc(incr_t, 1);
+            incr_t->il[incr_t->il_nr++] = 0;
+        }
+        bCache = (incr_t != NULL);
+
         /* Get the global atom number */
         i_gl = dd->gatindex[i];
         global_atomnr_to_moltype_ind(rt, i_gl, &mb, &mt, &mol, &i_mol);
@@ -1220,6 +1368,10 @@ static int make_bondeds_zone(gmx_domdec_t *dd,
                     tiatoms[3] = i + iatoms[3] - iatoms[1];
                     add_ifunc(nral, tiatoms, &idef->il[ftype]);
                     nbonded_local++;
+                    if (bCache)
+                    {
+                        incr_add_ifunc(incr_t, rec, ftype, nral, tiatoms);
+                    }
                 }
                 j += 1 + nral;
             }
@@ -1232,6 +1384,8 @@ static int make_bondeds_zone(gmx_domdec_t *dd,
                               TRUE, i, i_gl, i_mol,
                               iatoms, idef, vsite_pbc, vsite_pbc_nalloc);
                 }
+                /* We do not cache vsites, as these can be recursive */
+                bCache = FALSE;
                 j += 1 + nral + 2;
             }
             else
@@ -1250,11 +1404,14 @@ static int make_bondeds_zone(gmx_domdec_t *dd,
                         {
                             add_posres(mol, i_mol, &molb[mb], tiatoms, ip_in,
                                        idef);
+                            /* The position restraint parameters are local */
+                            bCache = FALSE;
                         }
                         else if (ftype == F_FBPOSRES)
                         {
                             add_fbposres(mol, i_mol, &molb[mb], tiatoms, ip_in,
                                          idef);
+                            bCache = FALSE;
                         }
                     }
                     else
@@ -1295,6 +1452,8 @@ static int make_bondeds_zone(gmx_domdec_t *dd,
                             }
                         }
                     }
+                    /* Distance checked assignments can change */
+                    bCache = (bCache && bUse && kz == 0 && !bRCheck2B);
                 }
                 else
                 {
@@ -1304,13 +1463,15 @@ static int make_bondeds_zone(gmx_domdec_t *dd,
                      * in each dimension is zero, for dimensions
                      * with 2 DD cells an extra check may be necessary.
                      */
-                    bUse = TRUE;
+                    bUse  = TRUE;
+                    bHome = TRUE;
                     clear_ivec(k_zero);
                     clear_ivec(k_plus);
                     for (k = 1; k <= nral && bUse; k++)
                     {
                         bLocal = ga2la_get(ga2la, i_gl+iatoms[k]-i_mol,
                                            &a_loc, &kz);
+                        bHome  = (bHome && bLocal && kz == 0);
                         if (!bLocal || kz >= zones->n)
                         {
                             /* We do not have this atom of this interaction
@@ -1354,6 +1515,8 @@ static int make_bondeds_zone(gmx_domdec_t *dd,
                             }
                         }
                     }
+                    /* Assignments with atoms in all home zone are fixed */
+                    bCache = (bCache && bUse && bHome);
                 }
                 if (bUse)
                 {
@@ -1367,10 +1530,27 @@ static int make_bondeds_zone(gmx_domdec_t *dd,
                     {
                         nbonded_local++;
                     }
+                    if (bCache)
+                    {
+                        incr_add_ifunc(incr_t, rec, ftype, nral, tiatoms);
+                    }
                 }
                 j += 1 + nral;
             }
         }
+
+        if (incr_t != NULL)
+        {
+            if (bCache)
+            {
+                rt->incr_new.start[i] = rec;
+            }
+            else
+            {
+                rt->incr_new.start[i] = -1;
+                incr_t->il_nr         = rec;
+            }
+        }
     }
 
     return nbonded_local;
@@ -1590,6 +1770,124 @@ static void clear_idef(t_idef *idef)
     }
 }
 
+/* Sets up the home atom index mapping between the last and the current
+ * partitioning, returns if the cached assignments can be used.
+ */
+static gmx_bool incr_prepare(gmx_domdec_t *dd, gmx_bool bRCheck2B)
+{
+    gmx_reverse_top_t *rt;
+    gmx_incr_top_t    *old;
+    int                i, a_loc;
+
+    rt  = dd->reverse_top;
+    old = &rt->incr_old;
+
+    if (dd->nat_home > rt->incr_new.nat_nalloc)
+    {
+        rt->incr_new.nat_nalloc = over_alloc_dd(dd->nat_home);
+        srenew(rt->incr_new.gat, rt->incr_new.nat_nalloc);
+        srenew(rt->incr_new.start, rt->incr_new.nat_nalloc);
+    }
+
+    /* Changes in distance checks could change the cached assignments */
+    if (old->nat == 0 || bRCheck2B != rt->bIncrRCheck2B)
+    {
+        return FALSE;
+    }
+
+    if (old->nat > rt->incr_old2new_nalloc)
+    {
+        rt->incr_old2new_nalloc = over_alloc_dd(old->nat);
+        srenew(rt->incr_old2new, rt->incr_old2new_nalloc);
+    }
+    if (dd->nat_home > rt->incr_new2old_nalloc)
+    {
+        rt->incr_new2old_nalloc = over_alloc_dd(dd->nat_home);
+        srenew(rt->incr_new2old, rt->incr_new2old_nalloc);
+    }
+
+    for (i = 0; i < dd->nat_home; i++)
+    {
+        rt->incr_new2old[i] = -1;
+    }
+    for (i = 0; i < old->nat; i++)
+    {
+        if (ga2la_get_home(dd->ga2la, old->gat[i], &a_loc))
+        {
+            rt->incr_old2new[i]     = a_loc;
+            rt->incr_new2old[a_loc] = i;
+        }
+        else
+        {
+            rt->incr_old2new[i] = -1;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Collects the thread-local cache records of the home zone,
+ * with charge groups cg0 to cg1, into a new cache and makes
+ * this the cache for the next partitioning.
+ */
+static void incr_finish(gmx_domdec_t *dd, int cg0, int cg1,
+                        gmx_bool bRCheck2B)
+{
+    gmx_reverse_top_t *rt;
+    gmx_incr_top_t    *it, tmp;
+    int                thread, nr, a0, a1, a, ncached;
+
+    rt = dd->reverse_top;
+    it = &rt->incr_new;
+
+    nr = 0;
+    for (thread = 0; thread < rt->nthread; thread++)
+    {
+        nr += rt->incr_thread[thread].il_nr;
+    }
+    if (nr > it->il_nalloc)
+    {
+        it->il_nalloc = over_alloc_large(nr);
+        srenew(it->il, it->il_nalloc);
+    }
+
+    nr      = 0;
+    ncached = 0;
+    for (thread = 0; thread < rt->nthread; thread++)
+    {
+        a0 = dd->cgindex[cg0 + ((cg1 - cg0)* thread   )/rt->nthread];
+        a1 = dd->cgindex[cg0 + ((cg1 - cg0)*(thread+1))/rt->nthread];
+        for (a = a0; a < a1; a++)
+        {
+            if (it->start[a] >= 0)
+            {
+                it->start[a] += nr;
+                ncached++;
+            }
+        }
+        memcpy(it->il + nr, rt->incr_thread[thread].il,
+               rt->incr_thread[thread].il_nr*sizeof(*it->il));
+        nr += rt->incr_thread[thread].il_nr;
+    }
+    it->il_nr = nr;
+
+    it->nat = dd->nat_home;
+    memcpy(it->gat, dd->gatindex, dd->nat_home*sizeof(*it->gat));
+
+    if (debug)
+    {
+        fprintf(debug, "Incremental topology: %d of %d home atoms cached\n",
+                ncached, dd->nat_home);
+    }
+
+    /* Swap the caches, the old one will be overwritten next time */
+    tmp           = rt->incr_old;
+    rt->incr_old  = rt->incr_new;
+    rt->incr_new  = tmp;
+
+    rt->bIncrRCheck2B = bRCheck2B;
+}
+
 static int make_local_bondeds_excls(gmx_domdec_t *dd,
                                     gmx_domdec_zones_t *zones,
                                     const gmx_mtop_t *mtop,
@@ -1606,6 +1904,7 @@ static int make_local_bondeds_excls(gmx_domdec_t *dd,
     int                nbonded_local;
     int                thread;
     gmx_reverse_top_t *rt;
+    gmx_bool           bIncrUse;
 
     if (dd->reverse_top->bMultiCGmols)
     {
@@ -1636,6 +1935,15 @@ static int make_local_bondeds_excls(gmx_domdec_t *dd,
 
     rc2 = rc*rc;
 
+    if (rt->bIncr)
+    {
+        bIncrUse = incr_prepare(dd, bRCheck2B);
+    }
+    else
+    {
+        bIncrUse = FALSE;
+    }
+
     /* Clear the counts */
     clear_idef(idef);
     nbonded_local = 0;
@@ -1662,6 +1970,11 @@ static int make_local_bondeds_excls(gmx_domdec_t *dd,
             cg0t = cg0 + ((cg1 - cg0)* thread   )/rt->nthread;
             cg1t = cg0 + ((cg1 - cg0)*(thread+1))/rt->nthread;
 
+            if (rt->bIncr && iz == 0)
+            {
+                rt->incr_thread[thread].il_nr = 0;
+            }
+
             if (thread == 0)
             {
                 idef_t = idef;
@@ -1699,7 +2012,9 @@ static int make_local_bondeds_excls(gmx_domdec_t *dd,
                                   idef_t,
                                   vsite_pbc, vsite_pbc_nalloc,
                                   iz, zones->n,
-                                  dd->cgindex[cg0t], dd->cgindex[cg1t]);
+                                  dd->cgindex[cg0t], dd->cgindex[cg1t],
+                                  bIncrUse,
+                                  (rt->bIncr && iz == 0) ? &rt->incr_thread[thread] : NULL);
 
             if (iz < nzone_excl)
             {
@@ -1730,6 +2045,11 @@ static int make_local_bondeds_excls(gmx_domdec_t *dd,
                          vsite, rt->vsite_pbc+1);
         }
 
+        if (rt->bIncr && iz == 0)
+        {
+            incr_finish(dd, cg0, cg1, bRCheck2B);
+        }
+
         for (thread = 0; thread < rt->nthread; thread++)
         {
             nbonded_local += rt->nbonded_thread[thread];
@@ -1979,7 +1979,11 @@ static void init_nb_verlet(FILE                *fp,
                          &bEmulateGPU,
                          fr->gpu_opt);
 
-    nbv->nbs = NULL;
+    nbv->nbs          = NULL;
+    nbv->async_search = NULL;
+    nbv->nstprune     = 0;
+    nbv->rlist_prune  = 0;
+    nbv->rbuf_prune   = 0;
 
     nbv->ngrp = (DOMAINDECOMP(cr) ? 2 : 1);
     for (i = 0; i < nbv->ngrp; i++)
@@ -2974,6 +2978,13 @@ void init_forcerec(FILE              *fp,
     /* Initialize the thread working data for bonded interactions */
     init_forcerec_f_threads(fr, mtop->groups.grps[egcENER].nr);
 
+    /* The SIMD bonded kernels can be turned off for validation */
+    fr->bSimdBondeds = (getenv("GMX_NO_SIMD_BONDEDS") == NULL);
+    if (debug)
+    {
+        fprintf(debug, "Using SIMD bonded kernels: %d\n", fr->bSimdBondeds);
+    }
+
     snew(fr->excl_load, fr->nthreads+1);
 
     if (fr->cutoff_scheme == ecutsVERLET)
@@ -0,0 +1,374 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "typedefs.h"
+#include "smalloc.h"
+#include "macros.h"
+#include "vec.h"
+#include "pbc.h"
+#include "nrnb.h"
+#include "gmx_omp_nthreads.h"
+#include "nbnxn_atomdata.h"
+#include "nbnxn_search.h"
+#include "nbnxn_async_search.h"
+#include "gromacs/legacyheaders/thread_mpi/threads.h"
+
+struct nbnxn_async_search {
+    int                   lag;          /* Steps the search is done ahead     */
+    real                  rlist_inc;    /* Increase of rlist for the lag      */
+    int                   nthread;      /* OpenMP threads used for the search */
+
+    /* The grid, atom data and pair list set that are being generated */
+    nbnxn_search_t        nbs;
+    nbnxn_atomdata_t     *nbat;
+    nbnxn_pairlist_set_t  nbl_lists;
+
+    /* The search input, set at launch */
+    gmx_bool              bLaunched;    /* A search has been launched         */
+    gmx_large_int_t       step_target;  /* The step the list is meant for     */
+    int                   ePBC;
+    matrix                box;
+    int                   natoms;
+    rvec                 *x;            /* Copy of x, put in the box          */
+    rvec                 *shift;        /* The shifts of x by putting in box  */
+    int                   x_nalloc;
+    const t_mdatoms      *mdatoms;
+    const int            *atinfo;
+    const t_blocka       *excl;
+    real                  rlist;
+    int                   min_ci_balanced;
+    int                   kernel_type;
+    t_nrnb                nrnb;         /* Flop counts of the helper thread   */
+
+    tMPI_Thread_t         thread;
+    tMPI_Thread_mutex_t   mutex;
+    tMPI_Thread_cond_t    cond_job;
+    tMPI_Thread_cond_t    cond_done;
+    gmx_bool              bJob;         /* A search is queued or running      */
+    gmx_bool              bFinish;      /* Signals the helper thread to stop  */
+};
+
+static void async_search_run(nbnxn_async_search_t as)
+{
+    matrix box;
+    rvec   zero, box_diag;
+    int    t;
+
+    /* Put the atoms in the box, as is done for the normal search,
+     * and store the shifts to apply the same to x at the search step.
+     */
+#pragma omp parallel for num_threads(as->nthread) schedule(static)
+    for (t = 0; t < as->nthread; t++)
+    {
+        int a0, a1, i;
+
+        a0 = (as->natoms*t      )/as->nthread;
+        a1 = (as->natoms*(t + 1))/as->nthread;
+        memcpy(as->x[a0], as->shift[a0], (a1 - a0)*sizeof(*as->x));
+        put_atoms_in_box(as->ePBC, as->box, a1 - a0, as->x + a0);
+        for (i = a0; i < a1; i++)
+        {
+            rvec_sub(as->x[i], as->shift[i], as->shift[i]);
+        }
+    }
+
+    /* Pass a local copy of the box, as for the normal search */
+    copy_mat(as->box, box);
+    clear_rvec(zero);
+    box_diag[XX] = box[XX][XX];
+    box_diag[YY] = box[YY][YY];
+    box_diag[ZZ] = box[ZZ][ZZ];
+
+    nbnxn_put_on_grid(as->nbs, as->ePBC, box,
+                      0, zero, box_diag,
+                      0, as->natoms, -1, as->atinfo, as->x,
+                      0, NULL,
+                      as->kernel_type, as->nbat);
+
+    nbnxn_atomdata_set(as->nbat, eatAll, as->nbs, as->mdatoms, as->atinfo);
+
+    nbnxn_make_pairlist(as->nbs, as->nbat, as->excl,
+                        as->rlist, as->min_ci_balanced,
+                        &as->nbl_lists, eintLocal, as->kernel_type,
+                        &as->nrnb);
+}
+
+static void *async_search_thread(void *arg)
+{
+    nbnxn_async_search_t as = (nbnxn_async_search_t)arg;
+
+    tMPI_Thread_mutex_lock(&as->mutex);
+    for (;; )
+    {
+        while (!as->bJob && !as->bFinish)
+        {
+            tMPI_Thread_cond_wait(&as->cond_job, &as->mutex);
+        }
+        if (!as->bJob)
+        {
+            break;
+        }
+        /* The main thread does not touch the search data
+         * while a job is queued, so we can search without the lock.
+         */
+        tMPI_Thread_mutex_unlock(&as->mutex);
+
+        async_search_run(as);
+
+        tMPI_Thread_mutex_lock(&as->mutex);
+        as->bJob = FALSE;
+        tMPI_Thread_cond_broadcast(&as->cond_done);
+    }
+    tMPI_Thread_mutex_unlock(&as->mutex);
+
+    return NULL;
+}
+
+static void async_search_wait(nbnxn_async_search_t as)
+{
+    tMPI_Thread_mutex_lock(&as->mutex);
+    while (as->bJob)
+    {
+        tMPI_Thread_cond_wait(&as->cond_done, &as->mutex);
+    }
+    tMPI_Thread_mutex_unlock(&as->mutex);
+}
+
+nbnxn_async_search_t nbnxn_async_search_create(int nthread)
+{
+    nbnxn_async_search_t as;
+
+    if (tMPI_Thread_support() == TMPI_THREAD_SUPPORT_NO)
+    {
+        return NULL;
+    }
+
+    snew(as, 1);
+    as->nthread   = max(1, nthread);
+
+    as->bLaunched = FALSE;
+    as->bJob      = FALSE;
+    as->bFinish   = FALSE;
+
+    tMPI_Thread_mutex_init(&as->mutex);
+    tMPI_Thread_cond_init(&as->cond_job);
+    tMPI_Thread_cond_init(&as->cond_done);
+
+    /* The thread only accesses the search data when a job is launched,
+     * so we can start it before the search data is set up.
+     */
+    if (tMPI_Thread_create(&as->thread, async_search_thread, as) != 0)
+    {
+        tMPI_Thread_cond_destroy(&as->cond_done);
+        tMPI_Thread_cond_destroy(&as->cond_job);
+        tMPI_Thread_mutex_destroy(&as->mutex);
+        sfree(as);
+
+        return NULL;
+    }
+
+    return as;
+}
+
+void nbnxn_async_search_init(FILE                *fp,
+                             nbnxn_async_search_t as,
+                             nonbonded_verlet_t  *nbv,
+                             const t_inputrec    *ir,
+                             const t_forcerec    *fr,
+                             int                  lag,
+                             real                 rlist_inc)
+{
+    int kernel_type;
+
+    kernel_type = nbv->grp[eintLocal].kernel_type;
+
+    as->lag       = lag;
+    as->rlist_inc = rlist_inc;
+
+    /* Set up a second copy of the local search data of nbv */
+    nbnxn_init_search(&as->nbs, NULL, NULL,
+                      gmx_omp_nthreads_get(emntNonbonded));
+    nbnxn_search_set_omp_nthreads(as->nbs, as->nthread);
+    nbnxn_init_pairlist_set(&as->nbl_lists,
+                            nbnxn_kernel_pairlist_simple(kernel_type),
+                            !nbnxn_kernel_pairlist_simple(kernel_type),
+                            NULL, NULL);
+    snew(as->nbat, 1);
+    nbnxn_atomdata_init(fp, as->nbat, kernel_type,
+                        fr->ntype, fr->nbfp,
+                        ir->opts.ngener,
+                        nbnxn_kernel_pairlist_simple(kernel_type) ? gmx_omp_nthreads_get(emntNonbonded) : 1,
+                        NULL, NULL);
+    as->kernel_type     = kernel_type;
+    as->min_ci_balanced = nbv->min_ci_balanced;
+    init_nrnb(&as->nrnb);
+
+    nbv->async_search = as;
+}
+
+void nbnxn_async_search_launch(nonbonded_verlet_t  *nbv,
+                               gmx_large_int_t      step,
+                               int                  nstlist,
+                               int                  ePBC,
+                               matrix               box,
+                               int                  natoms,
+                               rvec                *x,
+                               const t_mdatoms     *mdatoms,
+                               const int           *atinfo,
+                               const t_blocka      *excl,
+                               real                 rlist)
+{
+    nbnxn_async_search_t as;
+
+    as = nbv->async_search;
+
+    if (nstlist <= as->lag || (step + as->lag) % nstlist != 0)
+    {
+        return;
+    }
+
+    /* Wait for, and discard, a search that has not been used */
+    async_search_wait(as);
+
+    as->bLaunched   = TRUE;
+    as->step_target = step + as->lag;
+    as->ePBC        = ePBC;
+    copy_mat(box, as->box);
+    as->natoms      = natoms;
+    if (natoms > as->x_nalloc)
+    {
+        as->x_nalloc = over_alloc_large(natoms);
+        srenew(as->x, as->x_nalloc);
+        srenew(as->shift, as->x_nalloc);
+    }
+    /* The helper thread turns this copy into shifts */
+    memcpy(as->shift, x, natoms*sizeof(*x));
+    as->mdatoms     = mdatoms;
+    as->atinfo      = atinfo;
+    as->excl        = excl;
+    as->rlist       = rlist + as->rlist_inc;
+
+    tMPI_Thread_mutex_lock(&as->mutex);
+    as->bJob = TRUE;
+    tMPI_Thread_cond_signal(&as->cond_job);
+    tMPI_Thread_mutex_unlock(&as->mutex);
+}
+
+gmx_bool nbnxn_async_search_swap(nonbonded_verlet_t *nbv,
+                                 gmx_large_int_t     step,
+                                 int                 natoms,
+                                 rvec               *x,
+                                 t_nrnb             *nrnb)
+{
+    nbnxn_async_search_t as;
+    nbnxn_search_t       nbs;
+    nbnxn_atomdata_t    *nbat;
+    nbnxn_pairlist_set_t nbl_lists;
+    int                  i;
+
+    as = nbv->async_search;
+
+    if (!as->bLaunched)
+    {
+        return FALSE;
+    }
+
+    async_search_wait(as);
+    as->bLaunched = FALSE;
+
+    add_nrnb(nrnb, nrnb, &as->nrnb);
+    init_nrnb(&as->nrnb);
+
+    if (as->step_target != step || as->natoms != natoms)
+    {
+        /* The state changed with an extra search, e.g. at the first step */
+        return FALSE;
+    }
+
+    nbs                           = nbv->nbs;
+    nbv->nbs                      = as->nbs;
+    as->nbs                       = nbs;
+    nbat                          = nbv->grp[eintLocal].nbat;
+    nbv->grp[eintLocal].nbat      = as->nbat;
+    as->nbat                      = nbat;
+    nbl_lists                     = nbv->grp[eintLocal].nbl_lists;
+    nbv->grp[eintLocal].nbl_lists = as->nbl_lists;
+    as->nbl_lists                 = nbl_lists;
+
+    /* Only searches on the helper thread use a reduced thread count */
+    nbnxn_search_set_omp_nthreads(nbv->nbs, gmx_omp_nthreads_get(emntNonbonded));
+    nbnxn_search_set_omp_nthreads(as->nbs, as->nthread);
+
+    /* Apply the shifts of putting the atoms in the box during the search */
+#pragma omp parallel for num_threads(gmx_omp_nthreads_get(emntDefault)) schedule(static)
+    for (i = 0; i < natoms; i++)
+    {
+        rvec_inc(x[i], as->shift[i]);
+    }
+
+    return TRUE;
+}
+
+void nbnxn_async_search_done(nonbonded_verlet_t *nbv)
+{
+    nbnxn_async_search_t as;
+
+    as = nbv->async_search;
+    if (as == NULL)
+    {
+        return;
+    }
+
+    tMPI_Thread_mutex_lock(&as->mutex);
+    as->bFinish = TRUE;
+    tMPI_Thread_cond_signal(&as->cond_job);
+    tMPI_Thread_mutex_unlock(&as->mutex);
+
+    tMPI_Thread_join(as->thread, NULL);
+
+    tMPI_Thread_cond_destroy(&as->cond_done);
+    tMPI_Thread_cond_destroy(&as->cond_job);
+    tMPI_Thread_mutex_destroy(&as->mutex);
+
+    sfree(as->x);
+    sfree(as->shift);
+    sfree(as);
+    nbv->async_search = NULL;
+}
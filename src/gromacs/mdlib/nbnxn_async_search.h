@@ -0,0 +1,109 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+#ifndef _nbnxn_async_search_h
+#define _nbnxn_async_search_h
+
+#include "typedefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Background generation of the nbnxn pair list.
+ *
+ * The pair list for search step S is generated on a helper thread,
+ * using the coordinates of step S-lag, while the main thread continues
+ * to compute forces with the current pair list. At step S the grid,
+ * atom data and pair list are swapped with the current ones.
+ * As the list is used for nstlist+lag steps, it is generated with
+ * a cut-off larger by rlist_inc than ic->rlist.
+ * Only supported with a single rank, without GPU and for dynamics.
+ */
+
+/* Starts the helper thread for background pair search, which will use
+ * nthread OpenMP threads. This can be called before the OpenMP thread
+ * counts are reduced for the helper, so these do not need to be restored
+ * on failure. Returns NULL when threads are not supported or the thread
+ * could not be started.
+ */
+nbnxn_async_search_t nbnxn_async_search_create(int nthread);
+
+/* Sets up the search data of as for nbv and attaches as to nbv */
+void nbnxn_async_search_init(FILE                *fp,
+                             nbnxn_async_search_t as,
+                             nonbonded_verlet_t  *nbv,
+                             const t_inputrec    *ir,
+                             const t_forcerec    *fr,
+                             int                  lag,
+                             real                 rlist_inc);
+
+/* When a search for step+lag is due, copies the coordinates and box
+ * and starts the search on the helper thread. The pointer arguments
+ * should stay valid and unchanged until the next search step.
+ */
+void nbnxn_async_search_launch(nonbonded_verlet_t  *nbv,
+                               gmx_large_int_t      step,
+                               int                  nstlist,
+                               int                  ePBC,
+                               matrix               box,
+                               int                  natoms,
+                               rvec                *x,
+                               const t_mdatoms     *mdatoms,
+                               const int           *atinfo,
+                               const t_blocka      *excl,
+                               real                 rlist);
+
+/* Should be called at every search step before the grid is used.
+ * Waits for a launched search to complete. When the search was
+ * launched for this step, swaps the generated grid, atom data
+ * and pair list into nbv, shifts x consistently with the search
+ * and returns TRUE. Otherwise the search result is discarded
+ * and FALSE is returned, in which case a normal search is required.
+ */
+gmx_bool nbnxn_async_search_swap(nonbonded_verlet_t *nbv,
+                                 gmx_large_int_t     step,
+                                 int                 natoms,
+                                 rvec               *x,
+                                 t_nrnb             *nrnb);
+
+/* Waits for the helper thread to finish and stops it */
+void nbnxn_async_search_done(nonbonded_verlet_t *nbv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -274,6 +274,7 @@ typedef struct nbnxn_search {
     gmx_icell_set_x_t   *icell_set_x; /* Function for setting i-coords    */
 
     int                  nthread_max; /* Maximum number of threads for pair-search  */
+    int                  nthread_omp; /* OpenMP team size used, <= nthread_max      */
     nbnxn_search_work_t *work;        /* Work array, size nthread_max          */
 } nbnxn_search_t_t;
 
@@ -357,6 +357,7 @@ void nbnxn_init_search(nbnxn_search_t    * nbs_ptr,
     nbs->a_nalloc    = 0;
 
     nbs->nthread_max = nthread_max;
+    nbs->nthread_omp = nthread_max;
 
     /* Initialize the work data structures for each thread */
     snew(nbs->work, nbs->nthread_max);
@@ -378,6 +379,14 @@ void nbnxn_init_search(nbnxn_search_t    * nbs_ptr,
     }
 }
 
+void nbnxn_search_set_omp_nthreads(nbnxn_search_t nbs, int nthread)
+{
+    /* The work is still divided over nthread_max parts,
+     * only the number of threads processing these parts is reduced.
+     */
+    nbs->nthread_omp = max(1, min(nthread, nbs->nthread_max));
+}
+
 static real grid_atom_density(int n, rvec corner0, rvec corner1)
 {
     rvec size;
@@ -1110,6 +1119,48 @@ void sort_on_lj(int na_c,
     }
 }
 
+/* Sets the bounding box(es) of the simple grid cell with atoms a0 to a1,
+ * using the coordinates stored in nbat.
+ */
+static void calc_cell_bb_simple(nbnxn_grid_t           *grid,
+                                const nbnxn_atomdata_t *nbat,
+                                int a0, int a1)
+{
+    int         na;
+    size_t      offset;
+    nbnxn_bb_t *bb_ptr;
+
+    na = a1 - a0;
+
+    /* Store the bounding boxes as xyz.xyz. */
+    offset = (a0 - grid->cell0*grid->na_sc) >> grid->na_c_2log;
+    bb_ptr = grid->bb + offset;
+
+    if (nbat->XFormat == nbatX4)
+    {
+#if defined GMX_NBNXN_SIMD && GMX_SIMD_WIDTH_HERE == 2
+        if (2*grid->na_cj == grid->na_c)
+        {
+            calc_bounding_box_x_x4_halves(na, nbat->x+X4_IND_A(a0), bb_ptr,
+                                          grid->bbj+offset*2);
+        }
+        else
+#endif
+        {
+            calc_bounding_box_x_x4(na, nbat->x+X4_IND_A(a0), bb_ptr);
+        }
+    }
+    else if (nbat->XFormat == nbatX8)
+    {
+        calc_bounding_box_x_x8(na, nbat->x+X8_IND_A(a0), bb_ptr);
+    }
+    else
+    {
+        calc_bounding_box(na, nbat->xstride, nbat->x+a0*nbat->xstride,
+                          bb_ptr);
+    }
+}
+
 /* Fill a pair search cell with atoms.
  * Potentially sorts atoms and sets the interaction flags.
  */
@@ -1123,7 +1174,6 @@ void fill_cell(const nbnxn_search_t nbs,
                nbnxn_bb_t gmx_unused *bb_work_aligned)
 {
     int         na, a;
-    size_t      offset;
     nbnxn_bb_t *bb_ptr;
 #ifdef NBNXN_BBXXXX
     float      *pbb_ptr;
@@ -1147,31 +1197,9 @@ void fill_cell(const nbnxn_search_t nbs,
                            nbat->XFormat, nbat->x, a0,
                            sx, sy, sz);
 
-    if (nbat->XFormat == nbatX4)
-    {
-        /* Store the bounding boxes as xyz.xyz. */
-        offset = (a0 - grid->cell0*grid->na_sc) >> grid->na_c_2log;
-        bb_ptr = grid->bb + offset;
-
-#if defined GMX_NBNXN_SIMD && GMX_SIMD_WIDTH_HERE == 2
-        if (2*grid->na_cj == grid->na_c)
-        {
-            calc_bounding_box_x_x4_halves(na, nbat->x+X4_IND_A(a0), bb_ptr,
-                                          grid->bbj+offset*2);
-        }
-        else
-#endif
-        {
-            calc_bounding_box_x_x4(na, nbat->x+X4_IND_A(a0), bb_ptr);
-        }
-    }
-    else if (nbat->XFormat == nbatX8)
+    if (nbat->XFormat == nbatX4 || nbat->XFormat == nbatX8)
     {
-        /* Store the bounding boxes as xyz.xyz. */
-        offset = (a0 - grid->cell0*grid->na_sc) >> grid->na_c_2log;
-        bb_ptr = grid->bb + offset;
-
-        calc_bounding_box_x_x8(na, nbat->x+X8_IND_A(a0), bb_ptr);
+        calc_cell_bb_simple(grid, nbat, a0, a1);
     }
 #ifdef NBNXN_BBXXXX
     else if (!grid->bSimple)
@@ -1536,7 +1564,7 @@ static void calc_cell_indices(const nbnxn_search_t nbs,
 
     nthread = gmx_omp_nthreads_get(emntPairsearch);
 
-#pragma omp parallel for num_threads(nthread) schedule(static)
+#pragma omp parallel for num_threads(min(nthread, nbs->nthread_omp)) schedule(static)
     for (thread = 0; thread < nthread; thread++)
     {
         calc_column_indices(grid, a0, a1, x, dd_zone, move, thread, nthread,
@@ -1639,7 +1667,7 @@ static void calc_cell_indices(const nbnxn_search_t nbs,
     }
 
     /* Sort the super-cell columns along z into the sub-cells. */
-#pragma omp parallel for num_threads(nbs->nthread_max) schedule(static)
+#pragma omp parallel for num_threads(nbs->nthread_omp) schedule(static)
     for (thread = 0; thread < nbs->nthread_max; thread++)
     {
         if (grid->bSimple)
@@ -2455,6 +2483,13 @@ static void nbnxn_init_pairlist(nbnxn_pairlist_t *nbl,
     nbl->cj4         = NULL;
     nbl->nci_tot     = 0;
 
+    nbl->nci_outer       = 0;
+    nbl->ci_outer        = NULL;
+    nbl->ci_outer_nalloc = 0;
+    nbl->ncj_outer       = 0;
+    nbl->cj_outer        = NULL;
+    nbl->cj_outer_nalloc = 0;
+
     if (!nbl->bSimple)
     {
         nbl->excl        = NULL;
@@ -5045,7 +5080,7 @@ void nbnxn_make_pairlist(const nbnxn_search_t  nbs,
                 ci_block = get_ci_block_size(gridi, nbs->DomDec, nnbl);
             }
 
-#pragma omp parallel for num_threads(nnbl) schedule(static)
+#pragma omp parallel for num_threads(min(nnbl, nbs->nthread_omp)) schedule(static)
             for (th = 0; th < nnbl; th++)
             {
                 /* Re-init the thread-local work flag data before making
@@ -5182,3 +5217,183 @@ void nbnxn_make_pairlist(const nbnxn_search_t  nbs,
         }
     }
 }
+
+/* Recomputes the bounding boxes of simple grid grid using the current
+ * coordinates in nbat.
+ */
+static void update_grid_bb_simple(const nbnxn_search_t    nbs,
+                                  nbnxn_grid_t           *grid,
+                                  const nbnxn_atomdata_t *nbat)
+{
+    int cxy;
+
+#pragma omp parallel for num_threads(nbs->nthread_omp) schedule(static)
+    for (cxy = 0; cxy < grid->ncx*grid->ncy; cxy++)
+    {
+        int na, ncz, ash, cz, ash_c, na_c;
+
+        na  = grid->cxy_na[cxy];
+        ncz = grid->cxy_ind[cxy+1] - grid->cxy_ind[cxy];
+        ash = (grid->cell0 + grid->cxy_ind[cxy])*grid->na_sc;
+
+        for (cz = 0; cz < ncz; cz++)
+        {
+            ash_c = ash + cz*grid->na_sc;
+            na_c  = min(grid->na_sc, na-(ash_c-ash));
+
+            calc_cell_bb_simple(grid, nbat, ash_c, ash_c+na_c);
+        }
+    }
+
+    if (nbat->XFormat == nbatX8)
+    {
+        combine_bounding_box_pairs(grid, grid->bb);
+    }
+}
+
+/* Returns the grid containing cluster c, which has 2^na_c_2log atoms */
+static const nbnxn_grid_t *grid_of_cluster(const nbnxn_search_t nbs,
+                                           int na_c_2log, int c)
+{
+    int g;
+
+    g = nbs->ngrid - 1;
+    while (g > 0 && c < ci_to_cj(na_c_2log, nbs->grid[g].cell0))
+    {
+        g--;
+    }
+
+    return &nbs->grid[g];
+}
+
+/* Prunes the simple list nbl, stored as the outer list when bNewList,
+ * into nbl->ci and nbl->cj using bounding box distances.
+ */
+static void prune_pairlist_simple(const nbnxn_search_t    nbs,
+                                  const nbnxn_atomdata_t *nbat,
+                                  real                    rl2,
+                                  gmx_bool                bNewList,
+                                  nbnxn_pairlist_t       *nbl,
+                                  int                    *ndistc)
+{
+    const nbnxn_grid_t *gridi, *gridj;
+    const nbnxn_ci_t   *ci_outer;
+    nbnxn_bb_t         *bb_ci;
+    int                 na_cj_2log, ish, i, j, cj, cj_ind_start;
+    float               d2;
+
+    if (bNewList)
+    {
+        if (nbl->nci > nbl->ci_outer_nalloc)
+        {
+            nbl->ci_outer_nalloc = over_alloc_small(nbl->nci);
+            nbnxn_realloc_void((void **)&nbl->ci_outer,
+                               0,
+                               nbl->ci_outer_nalloc*sizeof(*nbl->ci_outer),
+                               nbl->alloc, nbl->free);
+        }
+        if (nbl->ncj > nbl->cj_outer_nalloc)
+        {
+            nbl->cj_outer_nalloc = over_alloc_small(nbl->ncj);
+            nbnxn_realloc_void((void **)&nbl->cj_outer,
+                               0,
+                               nbl->cj_outer_nalloc*sizeof(*nbl->cj_outer),
+                               nbl->alloc, nbl->free);
+        }
+        memcpy(nbl->ci_outer, nbl->ci, nbl->nci*sizeof(*nbl->ci));
+        memcpy(nbl->cj_outer, nbl->cj, nbl->ncj*sizeof(*nbl->cj));
+        nbl->nci_outer = nbl->nci;
+        nbl->ncj_outer = nbl->ncj;
+    }
+
+    na_cj_2log = get_2log(nbl->na_cj);
+    bb_ci      = nbl->work->bb_ci;
+
+    /* The ci and cj arrays are at least as large as the outer ones */
+    nbl->nci = 0;
+    nbl->ncj = 0;
+    for (i = 0; i < nbl->nci_outer; i++)
+    {
+        ci_outer = &nbl->ci_outer[i];
+
+        gridi = grid_of_cluster(nbs, get_2log(nbl->na_ci), ci_outer->ci);
+        ish   = (ci_outer->shift & NBNXN_CI_SHIFT);
+        set_icell_bb_simple(gridi->bb, ci_outer->ci - gridi->cell0,
+                            nbat->shift_vec[ish][XX],
+                            nbat->shift_vec[ish][YY],
+                            nbat->shift_vec[ish][ZZ],
+                            bb_ci);
+
+        cj_ind_start = nbl->ncj;
+        for (j = ci_outer->cj_ind_start; j < ci_outer->cj_ind_end; j++)
+        {
+            cj    = nbl->cj_outer[j].cj;
+            gridj = grid_of_cluster(nbs, na_cj_2log, cj);
+
+#ifdef NBNXN_SEARCH_BB_SIMD4
+            d2 = subc_bb_dist2_simd4(0, bb_ci,
+                                     cj - ci_to_cj(na_cj_2log, gridj->cell0),
+                                     gridj->bbj);
+#else
+            d2 = subc_bb_dist2(0, bb_ci,
+                               cj - ci_to_cj(na_cj_2log, gridj->cell0),
+                               gridj->bbj);
+#endif
+            /* As the order is maintained, a self-interaction cj entry,
+             * which has distance zero, stays the first entry.
+             */
+            if (d2 < rl2)
+            {
+                nbl->cj[nbl->ncj++] = nbl->cj_outer[j];
+            }
+        }
+        *ndistc += 2*(ci_outer->cj_ind_end - ci_outer->cj_ind_start);
+
+        if (nbl->ncj > cj_ind_start)
+        {
+            nbl->ci[nbl->nci]              = *ci_outer;
+            nbl->ci[nbl->nci].cj_ind_start = cj_ind_start;
+            nbl->ci[nbl->nci].cj_ind_end   = nbl->ncj;
+            nbl->nci++;
+        }
+    }
+}
+
+void nbnxn_prune_pairlist(nbnxn_search_t          nbs,
+                          int                     iloc,
+                          const nbnxn_atomdata_t *nbat,
+                          real                    rlist,
+                          gmx_bool                bNewList,
+                          nbnxn_pairlist_set_t   *nbl_list,
+                          t_nrnb                 *nrnb)
+{
+    int  g, g0, g1, th, ndistc;
+    real rl2;
+
+    if (!nbl_list->bSimple)
+    {
+        gmx_incons("Dynamic pruning is only implemented for simple pair lists");
+    }
+
+    /* The local grid is needed for both local and non-local lists,
+     * for non-local lists it should have been updated already.
+     */
+    g0 = (LOCAL_I(iloc) ? 0 : 1);
+    g1 = (LOCAL_I(iloc) ? 1 : nbs->ngrid);
+    for (g = g0; g < g1; g++)
+    {
+        update_grid_bb_simple(nbs, &nbs->grid[g], nbat);
+    }
+
+    rl2 = rlist*rlist;
+
+    ndistc = 0;
+#pragma omp parallel for num_threads(min(nbl_list->nnbl, nbs->nthread_omp)) schedule(static) reduction(+:ndistc)
+    for (th = 0; th < nbl_list->nnbl; th++)
+    {
+        prune_pairlist_simple(nbs, nbat, rl2, bNewList,
+                              nbl_list->nbl[th], &ndistc);
+    }
+
+    inc_nrnb(nrnb, eNR_NBNXN_DIST2, ndistc);
+}
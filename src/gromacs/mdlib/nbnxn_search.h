@@ -61,6 +61,12 @@ void nbnxn_init_search(nbnxn_search_t    * nbs_ptr,
                        gmx_domdec_zones_t *zones,
                        int                 nthread_max);
 
+/* Limits the number of OpenMP threads used for grid and pair search
+ * operations on nbs to nthread, which should be at least 1.
+ * This is used when the search runs concurrently with other work.
+ */
+void nbnxn_search_set_omp_nthreads(nbnxn_search_t nbs, int nthread);
+
 /* Put the atoms on the pair search grid.
  * Only atoms a0 to a1 in x are put on the grid.
  * The atom_density is used to determine the grid size.
@@ -128,6 +134,22 @@ void nbnxn_make_pairlist(const nbnxn_search_t  nbs,
                          int                   nb_kernel_type,
                          t_nrnb               *nrnb);
 
+/* Prunes the simple pair lists in nbl_list using bounding box distances
+ * of the clusters at the current coordinates in nbat and radius rlist.
+ * With bNewList the lists have just been generated and are stored
+ * as outer lists, otherwise pruning starts again from the stored
+ * outer lists. The coordinates for locality iloc should have been
+ * copied to nbat. For non-local lists the local lists should have been
+ * pruned first during the same step, as the local grid is also used.
+ */
+void nbnxn_prune_pairlist(nbnxn_search_t          nbs,
+                          int                     iloc,
+                          const nbnxn_atomdata_t *nbat,
+                          real                    rlist,
+                          gmx_bool                bNewList,
+                          nbnxn_pairlist_set_t   *nbl_list,
+                          t_nrnb                 *nrnb);
+
 #ifdef __cplusplus
 }
 #endif
@@ -113,7 +113,8 @@ const real lb_scale_factor_symm[] = { 2.0/64, 12.0/64, 30.0/64, 20.0/64 };
 /* Check if we have 4-wide SIMD macro support */
 #ifdef GMX_HAVE_SIMD4_MACROS
 /* Do PME spread and gather with 4-wide SIMD.
- * NOTE: SIMD is only used with PME order 4 and 5 (which are the most common).
+ * PME order 4 and 5 (which are the most common) have dedicated kernels,
+ * all other orders use a generic kernel that loops over SIMD4 chunks in z.
  */
 #define PME_SIMD4_SPREAD_GATHER
 
@@ -157,6 +158,15 @@ const real lb_scale_factor_symm[] = { 2.0/64, 12.0/64, 30.0/64, 20.0/64 };
  */
 #define PME_ORDER_MAX 12
 
+#ifdef PME_SIMD4_SPREAD_GATHER
+/* The maximum number of SIMD4 chunks a z-spline can cover: the alignment
+ * offset of up to 3 plus PME_ORDER_MAX, rounded up to a multiple of 4.
+ */
+#define PME_SIMD4_NZ4_MAX  ((3 + PME_ORDER_MAX + 3)/4)
+/* Buffer size for an aligned z-spline, includes space for the alignment */
+#define PME_SIMD4_BUF_SIZE (4*PME_SIMD4_NZ4_MAX + GMX_SIMD4_WIDTH)
+#endif
+
 /* Internal datastructures */
 typedef struct {
     int send_index0;
@@ -191,6 +201,8 @@ typedef struct {
     int      *thread_one;
     int       n;
     int      *ind;
+    int      *col_count;  /* Atom count per grid column, for sorting ind */
+    int       col_nalloc; /* Allocation size of col_count                */
     splinevec theta;
     real     *ptr_theta_z;
     splinevec dtheta;
@@ -304,6 +316,13 @@ typedef struct gmx_pme {
     gmx_bool   bUseThreads;   /* Does any of the PME ranks have nthread>1 ?  */
     int        nthread;       /* The number of threads doing PME on our rank */
 
+    gmx_bool   bSingleComm;   /* Communicate grid data in single precision   */
+    float     *comm_single;   /* Buffer for single precision grid comm.      */
+    int        comm_single_nalloc;
+
+    int        nrank_node;    /* >=0: node-aggregated FFT transposes, 0: by
+                               * physical node, >0: per this many ranks   */
+
     gmx_bool   bPPnode;       /* Node also does particle-particle forces */
     gmx_bool   bFEP;          /* Compute Free energy contribution */
     gmx_bool   bFEP_q;
@@ -510,19 +529,74 @@ static void calc_interpolation_idx(gmx_pme_t pme, pme_atomcomm_t *atc,
 }
 
 static void make_thread_local_ind(pme_atomcomm_t *atc,
-                                  int thread, splinedata_t *spline)
+                                  int thread, const pmegrid_t *grid,
+                                  splinedata_t *spline)
 {
     int             n, t, i, start, end;
+    int             ncol_y, ncol, c, a, cnt, sum;
+    int            *col_count;
     thread_plist_t *tpl;
 
-    /* Combine the indices made by each thread into one index */
+    /* Combine the indices made by each thread into one index,
+     * sorted on the (x,y) grid column within our thread-local grid.
+     * With the atoms sorted, consecutive atoms spread to and gather from
+     * nearby grid lines, which keeps the working set of the thread-local
+     * grid in cache. We use a counting sort, which is stable and thus
+     * gives the same order on repeated calls, as required for reusing
+     * the splines with a second grid.
+     */
+
+    ncol_y = grid->n[YY] - (grid->order - 1);
+    ncol   = (grid->n[XX] - (grid->order - 1))*ncol_y;
+    if (ncol + 1 > spline->col_nalloc)
+    {
+        spline->col_nalloc = over_alloc_large(ncol + 1);
+        srenew(spline->col_count, spline->col_nalloc);
+    }
+    col_count = spline->col_count;
+    for (c = 0; c < ncol; c++)
+    {
+        col_count[c] = 0;
+    }
+
+    /* Count the number of atoms per column */
+    start = 0;
+    for (t = 0; t < atc->nthread; t++)
+    {
+        tpl = &atc->thread_plist[t];
+        /* Loop over our part (start - end) from the list of thread t */
+        if (thread > 0)
+        {
+            start = tpl->n[thread-1];
+        }
+        end = tpl->n[thread];
+        for (i = start; i < end; i++)
+        {
+            a = tpl->i[i];
+            c = (atc->idx[a][XX] - grid->offset[XX])*ncol_y +
+                atc->idx[a][YY] - grid->offset[YY];
+#ifdef DEBUG
+            range_check(c, 0, ncol);
+#endif
+            col_count[c]++;
+        }
+    }
+
+    /* Convert the counts to the start index of each column */
+    sum = 0;
+    for (c = 0; c < ncol; c++)
+    {
+        cnt          = col_count[c];
+        col_count[c] = sum;
+        sum         += cnt;
+    }
+    n = sum;
 
-    n     = 0;
+    /* Put the indices in column order */
     start = 0;
     for (t = 0; t < atc->nthread; t++)
     {
         tpl = &atc->thread_plist[t];
-        /* Copy our part (start - end) from the list of thread t */
         if (thread > 0)
         {
             start = tpl->n[thread-1];
@@ -530,7 +604,10 @@ static void make_thread_local_ind(pme_atomcomm_t *atc,
         end = tpl->n[thread];
         for (i = start; i < end; i++)
         {
-            spline->ind[n++] = tpl->i[i];
+            a = tpl->i[i];
+            c = (atc->idx[a][XX] - grid->offset[XX])*ncol_y +
+                atc->idx[a][YY] - grid->offset[YY];
+            spline->ind[col_count[c]++] = a;
         }
     }
 
@@ -1026,12 +1103,54 @@ static void dd_pmeredist_f(gmx_pme_t pme, pme_atomcomm_t *atc,
 }
 
 #ifdef GMX_MPI
+/* Send nsend and receive nrecv grid reals. With pme->bSingleComm,
+ * which is only set with double precision, the data is communicated
+ * in single precision to halve the communication volume.
+ */
+static void pme_sendrecv_grid(gmx_pme_t pme,
+                              real *sendbuf, int nsend, int send_id,
+                              real *recvbuf, int nrecv, int recv_id,
+                              int tag, MPI_Comm comm)
+{
+    MPI_Status stat;
+    float     *sbuf, *rbuf;
+    int        i;
+
+    if (pme->bSingleComm)
+    {
+        if (nsend + nrecv > pme->comm_single_nalloc)
+        {
+            pme->comm_single_nalloc = over_alloc_large(nsend + nrecv);
+            srenew(pme->comm_single, pme->comm_single_nalloc);
+        }
+        sbuf = pme->comm_single;
+        rbuf = pme->comm_single + nsend;
+
+        for (i = 0; i < nsend; i++)
+        {
+            sbuf[i] = sendbuf[i];
+        }
+        MPI_Sendrecv(sbuf, nsend, MPI_FLOAT, send_id, tag,
+                     rbuf, nrecv, MPI_FLOAT, recv_id, tag,
+                     comm, &stat);
+        for (i = 0; i < nrecv; i++)
+        {
+            recvbuf[i] = rbuf[i];
+        }
+    }
+    else
+    {
+        MPI_Sendrecv(sendbuf, nsend, GMX_MPI_REAL, send_id, tag,
+                     recvbuf, nrecv, GMX_MPI_REAL, recv_id, tag,
+                     comm, &stat);
+    }
+}
+
 static void gmx_sum_qgrid_dd(gmx_pme_t pme, real *grid, int direction)
 {
     pme_overlap_t *overlap;
     int            send_index0, send_nindex;
     int            recv_index0, recv_nindex;
-    MPI_Status     stat;
     int            i, j, k, ix, iy, iz, icnt;
     int            ipulse, send_id, recv_id, datasize;
     real          *p;
@@ -1090,11 +1209,10 @@ static void gmx_sum_qgrid_dd(gmx_pme_t pme, real *grid, int direction)
 
         datasize      = pme->pmegrid_nx * pme->nkz;
 
-        MPI_Sendrecv(overlap->sendbuf, send_nindex*datasize, GMX_MPI_REAL,
-                     send_id, ipulse,
-                     overlap->recvbuf, recv_nindex*datasize, GMX_MPI_REAL,
-                     recv_id, ipulse,
-                     overlap->mpi_comm, &stat);
+        pme_sendrecv_grid(pme,
+                          overlap->sendbuf, send_nindex*datasize, send_id,
+                          overlap->recvbuf, recv_nindex*datasize, recv_id,
+                          ipulse, overlap->mpi_comm);
 
         /* Get data from contiguous recv buffer */
         if (debug)
@@ -1175,11 +1293,10 @@ static void gmx_sum_qgrid_dd(gmx_pme_t pme, real *grid, int direction)
                     recv_index0-pme->pmegrid_start_ix+recv_nindex);
         }
 
-        MPI_Sendrecv(sendptr, send_nindex*datasize, GMX_MPI_REAL,
-                     send_id, ipulse,
-                     recvptr, recv_nindex*datasize, GMX_MPI_REAL,
-                     recv_id, ipulse,
-                     overlap->mpi_comm, &stat);
+        pme_sendrecv_grid(pme,
+                          sendptr, send_nindex*datasize, send_id,
+                          recvptr, recv_nindex*datasize, recv_id,
+                          ipulse, overlap->mpi_comm);
 
         /* ADD data from contiguous recv buffer */
         if (direction == GMX_SUM_QGRID_FORWARD)
@@ -1504,8 +1621,8 @@ static void spread_q_bsplines_thread(pmegrid_t                    *pmegrid,
     int            pnx, pny, pnz, ndatatot;
     int            offx, offy, offz;
 
-#if defined PME_SIMD4_SPREAD_GATHER && !defined PME_SIMD4_UNALIGNED
-    real           thz_buffer[12], *thz_aligned;
+#ifdef PME_SIMD4_SPREAD_GATHER
+    real           thz_buffer[PME_SIMD4_BUF_SIZE], *thz_aligned;
 
     thz_aligned = gmx_simd4_align_real(thz_buffer);
 #endif
@@ -1570,7 +1687,12 @@ static void spread_q_bsplines_thread(pmegrid_t                    *pmegrid,
 #endif
                     break;
                 default:
+#ifdef PME_SIMD4_SPREAD_GATHER
+#define PME_SPREAD_SIMD4_GENERIC
+#include "pme_simd4.h"
+#else
                     DO_BSPLINE(order);
+#endif
                     break;
             }
         }
@@ -1580,11 +1702,15 @@ static void spread_q_bsplines_thread(pmegrid_t                    *pmegrid,
 static void set_grid_alignment(int gmx_unused *pmegrid_nz, int gmx_unused pme_order)
 {
 #ifdef PME_SIMD4_SPREAD_GATHER
-    if (pme_order == 5
-#ifndef PME_SIMD4_UNALIGNED
-        || pme_order == 4
+    gmx_bool bAlign;
+
+    /* Only order 4 with unaligned SIMD4 does not need an aligned grid */
+#ifdef PME_SIMD4_UNALIGNED
+    bAlign = (pme_order != 4);
+#else
+    bAlign = TRUE;
 #endif
-        )
+    if (bAlign)
     {
         /* Round nz up to a multiple of 4 to ensure alignment */
         *pmegrid_nz = ((*pmegrid_nz + 3) & ~3);
@@ -1600,7 +1726,7 @@ static void set_gridsize_alignment(int gmx_unused *gridsize, int gmx_unused pme_
     {
         /* Add extra elements to ensured aligned operations do not go
          * beyond the allocated grid size.
-         * Note that for pme_order=5, the pme grid z-size alignment
+         * Note that for pme_order!=4, the pme grid z-size alignment
          * ensures that we will not go beyond the grid size.
          */
         *gridsize += 4;
@@ -2645,9 +2771,9 @@ static void gather_f_bsplines(gmx_pme_t pme, real *grid,
 
     pme_spline_work_t *work;
 
-#if defined PME_SIMD4_SPREAD_GATHER && !defined PME_SIMD4_UNALIGNED
-    real           thz_buffer[12],  *thz_aligned;
-    real           dthz_buffer[12], *dthz_aligned;
+#ifdef PME_SIMD4_SPREAD_GATHER
+    real           thz_buffer[PME_SIMD4_BUF_SIZE],  *thz_aligned;
+    real           dthz_buffer[PME_SIMD4_BUF_SIZE], *dthz_aligned;
 
     thz_aligned  = gmx_simd4_align_real(thz_buffer);
     dthz_aligned = gmx_simd4_align_real(dthz_buffer);
@@ -2732,7 +2858,12 @@ static void gather_f_bsplines(gmx_pme_t pme, real *grid,
 #endif
                     break;
                 default:
+#ifdef PME_SIMD4_SPREAD_GATHER
+#define PME_GATHER_F_SIMD4_GENERIC
+#include "pme_simd4.h"
+#else
                     DO_FSPLINE(order);
+#endif
                     break;
             }
 
@@ -3113,6 +3244,7 @@ int gmx_pme_destroy(FILE *log, gmx_pme_t *pmedata)
 
     sfree((*pmedata)->lb_buf1);
     sfree((*pmedata)->lb_buf2);
+    sfree((*pmedata)->comm_single);
 
     for (thread = 0; thread < (*pmedata)->nthread; thread++)
     {
@@ -3615,6 +3747,38 @@ int gmx_pme_init(gmx_pme_t *         pmedata,
     }
     pme->bUseThreads = (sum_use_threads > 0);
 
+    /* With double precision the grid communication, which is
+     * the bulk of the PME communication volume, can be done in single
+     * precision. Spreading, FFTs, solve and gathering remain in double.
+     */
+    pme->bSingleComm        = FALSE;
+    pme->comm_single        = NULL;
+    pme->comm_single_nalloc = 0;
+#ifdef GMX_DOUBLE
+    if (pme->nnodes > 1 && getenv("GMX_PME_SINGLE_COMM") != NULL)
+    {
+        pme->bSingleComm = TRUE;
+        if (pme->nodeid == 0)
+        {
+            fprintf(stderr, "\nNOTE: GMX_PME_SINGLE_COMM set, PME grid communication will use single precision\n\n");
+        }
+    }
+#endif
+
+    /* With many PME ranks per node, the FFT transposes can aggregate
+     * the data of all ranks in a node, which reduces the number of
+     * inter-node messages by the number of PME ranks per node.
+     */
+    pme->nrank_node = -1;
+    if (pme->nnodes > 2 && getenv("GMX_PME_HIER_COMM") != NULL)
+    {
+        pme->nrank_node = max(0, (int)strtol(getenv("GMX_PME_HIER_COMM"), NULL, 10));
+        if (pme->nodeid == 0)
+        {
+            fprintf(stderr, "\nNOTE: GMX_PME_HIER_COMM set, PME FFT transposes will be aggregated per node\n\n");
+        }
+    }
+
     if (ir->ePBC == epbcSCREW)
     {
         gmx_fatal(FARGS, "pme does not (yet) work with pbc = screw");
@@ -3761,7 +3925,8 @@ int gmx_pme_init(gmx_pme_t *         pmedata,
             gmx_parallel_3dfft_init(&pme->pfft_setup[i], ndata,
                                     &pme->fftgrid[i], &pme->cfftgrid[i],
                                     pme->mpi_comm_d,
-                                    bReproducible, pme->nthread);
+                                    bReproducible, pme->bSingleComm,
+                                    pme->nrank_node, pme->nthread);
 
         }
     }
@@ -4164,9 +4329,6 @@ static void sum_fftgrid_dd(gmx_pme_t pme, real *fftgrid)
     pme_overlap_t *overlap;
     int  send_index0, send_nindex;
     int  recv_nindex;
-#ifdef GMX_MPI
-    MPI_Status stat;
-#endif
     int  send_size_y, recv_size_y;
     int  ipulse, send_id, recv_id, datasize, gridsize, size_yx;
     real *sendptr, *recvptr;
@@ -4217,11 +4379,10 @@ static void sum_fftgrid_dd(gmx_pme_t pme, real *fftgrid)
             recvptr = overlap->recvbuf;
 
 #ifdef GMX_MPI
-            MPI_Sendrecv(sendptr, send_size_y*datasize, GMX_MPI_REAL,
-                         send_id, ipulse,
-                         recvptr, recv_size_y*datasize, GMX_MPI_REAL,
-                         recv_id, ipulse,
-                         overlap->mpi_comm, &stat);
+            pme_sendrecv_grid(pme,
+                              sendptr, send_size_y*datasize, send_id,
+                              recvptr, recv_size_y*datasize, recv_id,
+                              ipulse, overlap->mpi_comm);
 #endif
 
             for (x = 0; x < local_fft_ndata[XX]; x++)
@@ -4287,11 +4448,10 @@ static void sum_fftgrid_dd(gmx_pme_t pme, real *fftgrid)
         }
 
 #ifdef GMX_MPI
-        MPI_Sendrecv(sendptr, send_nindex*datasize, GMX_MPI_REAL,
-                     send_id, ipulse,
-                     recvptr, recv_nindex*datasize, GMX_MPI_REAL,
-                     recv_id, ipulse,
-                     overlap->mpi_comm, &stat);
+        pme_sendrecv_grid(pme,
+                          sendptr, send_nindex*datasize, send_id,
+                          recvptr, recv_nindex*datasize, recv_id,
+                          ipulse, overlap->mpi_comm);
 #endif
 
         for (x = 0; x < recv_nindex; x++)
@@ -4383,7 +4543,8 @@ static void spread_on_grid(gmx_pme_t pme,
             else
             {
                 /* Get the indices our thread should operate on */
-                make_thread_local_ind(atc, thread, spline);
+                make_thread_local_ind(atc, thread, &grids->grid_th[thread],
+                                      spline);
             }
 
             grid = &grids->grid_th[thread];
@@ -353,3 +353,138 @@
 #undef PME_ORDER
 #undef PME_GATHER_F_SIMD4_ALIGNED
 #endif
+
+
+#ifdef PME_SPREAD_SIMD4_GENERIC
+/* Spread one charge with any pme_order with aligned SIMD4 load+store.
+ * This code assumes that the grid is allocated 4-real aligned
+ * and that pnz is a multiple of 4.
+ * The z-spline is copied into a zero padded aligned buffer,
+ * so the unused grid entries in the SIMD4 chunks get zero added.
+ */
+{
+    int          offset, nz4, index, k;
+    gmx_simd4_pr tz_S[PME_SIMD4_NZ4_MAX];
+    gmx_simd4_pr vxy_S;
+    gmx_simd4_pr gri_S;
+
+    offset = k0 & 3;
+    nz4    = (offset + order + 3) >> 2;
+
+    for (k = 0; k < 4*nz4; k++)
+    {
+        thz_aligned[k] = 0;
+    }
+    for (k = 0; k < order; k++)
+    {
+        thz_aligned[offset+k] = thz[k];
+    }
+    for (k = 0; k < nz4; k++)
+    {
+        tz_S[k] = gmx_simd4_load_pr(thz_aligned+4*k);
+    }
+
+    for (ithx = 0; (ithx < order); ithx++)
+    {
+        index_x = (i0+ithx)*pny*pnz + k0 - offset;
+        valx    = qn*thx[ithx];
+
+        for (ithy = 0; (ithy < order); ithy++)
+        {
+            index = index_x + (j0+ithy)*pnz;
+            vxy_S = gmx_simd4_set1_pr(valx*thy[ithy]);
+
+            for (k = 0; k < nz4; k++)
+            {
+                gri_S = gmx_simd4_load_pr(grid+index+4*k);
+                gri_S = gmx_simd4_madd_pr(vxy_S, tz_S[k], gri_S);
+                gmx_simd4_store_pr(grid+index+4*k, gri_S);
+            }
+        }
+    }
+}
+#undef PME_SPREAD_SIMD4_GENERIC
+#endif
+
+
+#ifdef PME_GATHER_F_SIMD4_GENERIC
+/* Gather for one charge with any pme_order with aligned SIMD4 loads.
+ * This code assumes that the grid is allocated 4-real aligned
+ * and that pnz is a multiple of 4.
+ * The (d)z-splines are copied into zero padded aligned buffers,
+ * so the unused grid entries in the SIMD4 chunks do not contribute.
+ */
+{
+    int          offset, nz4, k;
+
+    gmx_simd4_pr fx_S, fy_S, fz_S;
+
+    gmx_simd4_pr tx_S, ty_S, tz_S[PME_SIMD4_NZ4_MAX];
+    gmx_simd4_pr dx_S, dy_S, dz_S[PME_SIMD4_NZ4_MAX];
+
+    gmx_simd4_pr gval_S;
+
+    gmx_simd4_pr fxy1_S;
+    gmx_simd4_pr fz1_S;
+
+    offset = k0 & 3;
+    nz4    = (offset + order + 3) >> 2;
+
+    for (k = 0; k < 4*nz4; k++)
+    {
+        thz_aligned[k]  = 0;
+        dthz_aligned[k] = 0;
+    }
+    for (k = 0; k < order; k++)
+    {
+        thz_aligned[offset+k]  = thz[k];
+        dthz_aligned[offset+k] = dthz[k];
+    }
+    for (k = 0; k < nz4; k++)
+    {
+        tz_S[k] = gmx_simd4_load_pr(thz_aligned+4*k);
+        dz_S[k] = gmx_simd4_load_pr(dthz_aligned+4*k);
+    }
+
+    fx_S = gmx_simd4_setzero_pr();
+    fy_S = gmx_simd4_setzero_pr();
+    fz_S = gmx_simd4_setzero_pr();
+
+    for (ithx = 0; (ithx < order); ithx++)
+    {
+        index_x  = (i0+ithx)*pny*pnz;
+        tx_S   = gmx_simd4_set1_pr(thx[ithx]);
+        dx_S   = gmx_simd4_set1_pr(dthx[ithx]);
+
+        for (ithy = 0; (ithy < order); ithy++)
+        {
+            index_xy = index_x+(j0+ithy)*pnz+k0-offset;
+            ty_S   = gmx_simd4_set1_pr(thy[ithy]);
+            dy_S   = gmx_simd4_set1_pr(dthy[ithy]);
+
+            fxy1_S = gmx_simd4_setzero_pr();
+            fz1_S  = gmx_simd4_setzero_pr();
+            for (k = 0; k < nz4; k++)
+            {
+                gval_S = gmx_simd4_load_pr(grid+index_xy+4*k);
+                fxy1_S = gmx_simd4_madd_pr(tz_S[k], gval_S, fxy1_S);
+                fz1_S  = gmx_simd4_madd_pr(dz_S[k], gval_S, fz1_S);
+            }
+
+            fx_S = gmx_simd4_madd_pr(gmx_simd4_mul_pr(dx_S, ty_S), fxy1_S, fx_S);
+            fy_S = gmx_simd4_madd_pr(gmx_simd4_mul_pr(tx_S, dy_S), fxy1_S, fy_S);
+            fz_S = gmx_simd4_madd_pr(gmx_simd4_mul_pr(tx_S, ty_S), fz1_S, fz_S);
+        }
+    }
+
+    /* Reuse the aligned spline buffer for the reduction */
+    gmx_simd4_store_pr(thz_aligned+0, fx_S);
+    gmx_simd4_store_pr(thz_aligned+4, fy_S);
+    gmx_simd4_store_pr(thz_aligned+8, fz_S);
+
+    fx += thz_aligned[0]+thz_aligned[1]+thz_aligned[2]+thz_aligned[3];
+    fy += thz_aligned[4]+thz_aligned[5]+thz_aligned[6]+thz_aligned[7];
+    fz += thz_aligned[8]+thz_aligned[9]+thz_aligned[10]+thz_aligned[11];
+}
+#undef PME_GATHER_F_SIMD4_GENERIC
+#endif
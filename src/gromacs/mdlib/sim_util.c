@@ -77,6 +77,7 @@
 #include "genborn.h"
 #include "nbnxn_atomdata.h"
 #include "nbnxn_search.h"
+#include "nbnxn_async_search.h"
 #include "nbnxn_kernels/nbnxn_kernel_ref.h"
 #include "nbnxn_kernels/simd_4xn/nbnxn_kernel_simd_4xn.h"
 #include "nbnxn_kernels/simd_2xnn/nbnxn_kernel_simd_2xnn.h"
@@ -660,6 +661,7 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
     gmx_bool            bSepDVDL, bStateChanged, bNS, bFillGrid, bCalcCGCM, bBS;
     gmx_bool            bDoLongRange, bDoForces, bSepLRF, bUseGPU, bUseOrEmulGPU;
     gmx_bool            bDiffKernels = FALSE;
+    gmx_bool            bAsyncNS, bPrune, bOverlapX;
     matrix              boxs;
     rvec                vzero, box_diag;
     real                e, v, dvdl;
@@ -701,6 +703,22 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
     bSepLRF       = (bDoLongRange && bDoForces && (flags & GMX_FORCE_SEPLRF));
     bUseGPU       = fr->nbv->bUseGPU;
     bUseOrEmulGPU = bUseGPU || (nbv->grp[0].kernel_type == nbnxnk8x8x8_PlainC);
+    /* With dynamic pruning we prune at search steps and every nstprune steps */
+    bPrune        = (nbv->nstprune > 0 && (bNS || step % nbv->nstprune == 0));
+    if (bPrune && bNS &&
+        (nbv->rlist_prune < fr->ic->rcoulomb ||
+         nbv->rlist_prune < fr->ic->rvdw))
+    {
+        /* This would silently remove interacting pairs from the list */
+        gmx_incons("The dynamic pruning radius is shorter than the interaction cut-off");
+    }
+    /* With the CPU kernels we can overlap the non-local coordinate
+     * communication with the local non-bonded force calculation,
+     * as is done with the GPU non-bonded launches.
+     * Enforced rotation needs the communicated coordinates earlier.
+     */
+    bOverlapX     = (DOMAINDECOMP(cr) && cr->dd->bOverlapX &&
+                     !bUseOrEmulGPU && !bNS && !inputrec->bRot);
 
     if (bStateChanged)
     {
@@ -717,6 +735,17 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
         }
     }
 
+    /* With background pair search, the grid and pair list for this
+     * search step might have been generated already.
+     */
+    bAsyncNS = FALSE;
+    if (bNS && nbv->async_search != NULL)
+    {
+        wallcycle_start(wcycle, ewcNS);
+        bAsyncNS = nbnxn_async_search_swap(nbv, step, homenr, x, nrnb);
+        wallcycle_stop(wcycle, ewcNS);
+    }
+
     if (fr->ePBC != epbcNONE)
     {
         /* Compute shift vectors every step,
@@ -727,7 +756,7 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
             calc_shifts(box, fr->shift_vec);
         }
 
-        if (bCalcCGCM)
+        if (bCalcCGCM && !bAsyncNS)
         {
             put_atoms_in_box_omp(fr->ePBC, box, homenr, x);
             inc_nrnb(nrnb, eNR_SHIFTX, homenr);
@@ -784,15 +813,15 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
     }
 #endif /* GMX_MPI */
 
-    /* do gridding for pair search */
-    if (bNS)
+    if (bNS && graph && bStateChanged)
     {
-        if (graph && bStateChanged)
-        {
-            /* Calculate intramolecular shift vectors to make molecules whole */
-            mk_mshift(fplog, graph, fr->ePBC, box, x);
-        }
+        /* Calculate intramolecular shift vectors to make molecules whole */
+        mk_mshift(fplog, graph, fr->ePBC, box, x);
+    }
 
+    /* do gridding for pair search */
+    if (bNS && !bAsyncNS)
+    {
         clear_rvec(vzero);
         box_diag[XX] = box[XX][XX];
         box_diag[YY] = box[YY][YY];
@@ -852,7 +881,7 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
     }
 
     /* do local pair search */
-    if (bNS)
+    if (bNS && !bAsyncNS)
     {
         wallcycle_start_nocount(wcycle, ewcNS);
         wallcycle_sub_start(wcycle, ewcsNBS_SEARCH_LOCAL);
@@ -885,6 +914,17 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
         wallcycle_stop(wcycle, ewcNB_XF_BUF_OPS);
     }
 
+    if (nbv->async_search != NULL)
+    {
+        /* Start generating the next pair list, when due,
+         * on a helper thread while we compute the forces.
+         */
+        nbnxn_async_search_launch(nbv, step, inputrec->nstlist,
+                                  fr->ePBC, box, homenr, x,
+                                  mdatoms, fr->cginfo, &top->excls,
+                                  ic->rlist);
+    }
+
     if (bUseGPU)
     {
         wallcycle_start(wcycle, ewcLAUNCH_GPU_NB);
@@ -949,7 +989,15 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
         else
         {
             wallcycle_start(wcycle, ewcMOVEX);
-            dd_move_x(cr->dd, box, x);
+            if (bOverlapX)
+            {
+                /* Completed after the local non-bonded calculation */
+                dd_move_x_start(cr->dd, box, x);
+            }
+            else
+            {
+                dd_move_x(cr->dd, box, x);
+            }
 
             /* When we don't need the total dipole we sum it in global_stat */
             if (bStateChanged && NEED_MUTOT(*inputrec))
@@ -958,12 +1006,15 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
             }
             wallcycle_stop(wcycle, ewcMOVEX);
 
-            wallcycle_start(wcycle, ewcNB_XF_BUF_OPS);
-            wallcycle_sub_start(wcycle, ewcsNB_X_BUF_OPS);
-            nbnxn_atomdata_copy_x_to_nbat_x(nbv->nbs, eatNonlocal, FALSE, x,
-                                            nbv->grp[eintNonlocal].nbat);
-            wallcycle_sub_stop(wcycle, ewcsNB_X_BUF_OPS);
-            cycles_force += wallcycle_stop(wcycle, ewcNB_XF_BUF_OPS);
+            if (!bOverlapX)
+            {
+                wallcycle_start(wcycle, ewcNB_XF_BUF_OPS);
+                wallcycle_sub_start(wcycle, ewcsNB_X_BUF_OPS);
+                nbnxn_atomdata_copy_x_to_nbat_x(nbv->nbs, eatNonlocal, FALSE, x,
+                                                nbv->grp[eintNonlocal].nbat);
+                wallcycle_sub_stop(wcycle, ewcsNB_X_BUF_OPS);
+                cycles_force += wallcycle_stop(wcycle, ewcNB_XF_BUF_OPS);
+            }
         }
 
         if (bUseGPU && !bDiffKernels)
@@ -1100,17 +1151,55 @@ void do_force_cutsVERLET(FILE *fplog, t_commrec *cr,
 
     if (!bUseOrEmulGPU)
     {
+        if (bPrune)
+        {
+            nbnxn_prune_pairlist(nbv->nbs, eintLocal,
+                                 nbv->grp[eintLocal].nbat,
+                                 nbv->rlist_prune, bNS,
+                                 &nbv->grp[eintLocal].nbl_lists,
+                                 nrnb);
+        }
+
         /* Maybe we should move this into do_force_lowlevel */
         do_nb_verlet(fr, ic, enerd, flags, eintLocal, enbvClearFYes,
                      nrnb, wcycle);
     }
 
+    if (bOverlapX)
+    {
+        /* Complete the coordinate communication, which should have
+         * (largely) finished during the local non-bonded calculation.
+         * The waiting time should not be counted as force time.
+         */
+        cycles_force += wallcycle_stop(wcycle, ewcFORCE);
+        wallcycle_start(wcycle, ewcMOVEX);
+        dd_move_x_finish(cr->dd, box, x);
+        wallcycle_stop(wcycle, ewcMOVEX);
+
+        wallcycle_start(wcycle, ewcNB_XF_BUF_OPS);
+        wallcycle_sub_start(wcycle, ewcsNB_X_BUF_OPS);
+        nbnxn_atomdata_copy_x_to_nbat_x(nbv->nbs, eatNonlocal, FALSE, x,
+                                        nbv->grp[eintNonlocal].nbat);
+        wallcycle_sub_stop(wcycle, ewcsNB_X_BUF_OPS);
+        cycles_force += wallcycle_stop(wcycle, ewcNB_XF_BUF_OPS);
+        wallcycle_start_nocount(wcycle, ewcFORCE);
+    }
+
     if (!bUseOrEmulGPU || bDiffKernels)
     {
         int aloc;
 
         if (DOMAINDECOMP(cr))
         {
+            if (bPrune)
+            {
+                nbnxn_prune_pairlist(nbv->nbs, eintNonlocal,
+                                     nbv->grp[eintNonlocal].nbat,
+                                     nbv->rlist_prune, bNS,
+                                     &nbv->grp[eintNonlocal].nbl_lists,
+                                     nrnb);
+            }
+
             do_nb_verlet(fr, ic, enerd, flags, eintNonlocal,
                          bDiffKernels ? enbvClearFYes : enbvClearFNo,
                          nrnb, wcycle);
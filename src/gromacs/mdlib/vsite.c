@@ -38,6 +38,7 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include "typedefs.h"
 #include "vsite.h"
 #include "macros.h"
@@ -55,6 +56,17 @@
 
 #include "gromacs/utility/gmxomp.h"
 
+/* Include the SIMD macro file and then check for support */
+#include "gromacs/simd/macros.h"
+#ifdef GMX_HAVE_SIMD_MACROS
+/* Turn on SIMD intrinsics for construction and force spreading
+ * of the non-linear vsite types without pbc,
+ * processing GMX_SIMD_WIDTH_HERE vsites at once.
+ */
+#define VSITE_SIMD
+#include "gromacs/simd/vector_operations.h"
+#endif
+
 /* Routines to send/recieve coordinates and force
  * of constructing atoms.
  */
@@ -421,6 +433,209 @@ static int constr_vsiten(t_iatom *ia, t_iparams ip[],
 }
 
 
+#ifdef VSITE_SIMD
+/* Indices into the SIMD gather buffer for vsites */
+enum {
+    vbI, vbJ, vbK, vbL, vbV, vbF
+};
+#define VB(q, d)     (((q)*DIM + (d))*GMX_SIMD_WIDTH_HERE)
+#define VB_A         VB(vbF + 1, 0)
+#define VB_B         (VB_A + GMX_SIMD_WIDTH_HERE)
+#define VB_C         (VB_B + GMX_SIMD_WIDTH_HERE)
+#define VB_SIZE      (VB_C + GMX_SIMD_WIDTH_HERE)
+/* The number of shift indices per vsite: vsite, j, k, l */
+#define VB_NSHIFT    4
+
+/* Returns whether the vsite types we handle with SIMD include ftype */
+static gmx_bool vsite_type_simd(int ftype)
+{
+    return (ftype == F_VSITE3FD || ftype == F_VSITE3OUT || ftype == F_VSITE4FDN);
+}
+
+/* Returns TRUE when one of the GMX_SIMD_WIDTH_HERE vsites in ia
+ * is a constructing atom of another vsite in the same block.
+ * Such blocks are handled with plain C to preserve the order.
+ */
+static gmx_bool vsite_block_has_dep(const t_iatom *ia, int nral1)
+{
+    int l, m, j;
+
+    for (l = 0; l < GMX_SIMD_WIDTH_HERE; l++)
+    {
+        for (m = 0; m < GMX_SIMD_WIDTH_HERE; m++)
+        {
+            for (j = 2; j < nral1; j++)
+            {
+                if (m != l && ia[m*nral1 + j] == ia[l*nral1 + 1])
+                {
+                    return TRUE;
+                }
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+/* Gathers the coordinates of the atoms of GMX_SIMD_WIDTH_HERE vsites
+ * starting at ia into buf. The coordinates of the constructing atoms
+ * j, k, l are stored relative to atom i, their shift indices are
+ * stored in shift. When f!=NULL, the vsite forces and the vsite
+ * coordinates relative to atom i, with shift index, are also stored.
+ */
+static void vsite_gather(const t_iatom *ia, int nral1, t_iparams ip[],
+                         rvec x[], rvec f[], const t_pbc *pbc,
+                         real *buf, int *shift)
+{
+    int            l, j, d;
+    const t_iatom *ial;
+    rvec           dx;
+
+    for (l = 0; l < GMX_SIMD_WIDTH_HERE; l++)
+    {
+        ial = ia + l*nral1;
+        for (j = 3; j < nral1; j++)
+        {
+            shift[l*VB_NSHIFT + j - 2] = pbc_rvec_sub(pbc, x[ial[j]], x[ial[2]], dx);
+            for (d = 0; d < DIM; d++)
+            {
+                buf[VB(vbJ + j - 3, d) + l] = dx[d];
+            }
+        }
+        for (d = 0; d < DIM; d++)
+        {
+            buf[VB(vbI, d) + l] = x[ial[2]][d];
+        }
+        if (f != NULL)
+        {
+            shift[l*VB_NSHIFT] = pbc_rvec_sub(pbc, x[ial[1]], x[ial[2]], dx);
+            for (d = 0; d < DIM; d++)
+            {
+                buf[VB(vbV, d) + l] = dx[d];
+                buf[VB(vbF, d) + l] = f[ial[1]][d];
+            }
+        }
+        buf[VB_A + l] = ip[ial[0]].vsite.a;
+        buf[VB_B + l] = ip[ial[0]].vsite.b;
+        buf[VB_C + l] = ip[ial[0]].vsite.c;
+    }
+}
+
+/* Constructs vsites of type ftype in blocks of GMX_SIMD_WIDTH_HERE.
+ * With pbc, each vsite follows its own pbc, as without charge groups.
+ * Returns the number of ilist entries that were handled.
+ */
+static int construct_vsites_simd(int ftype, int nr, t_iatom *ia,
+                                 t_iparams ip[], rvec x[],
+                                 rvec *v, real inv_dt, const t_pbc *pbc,
+                                 real *buf)
+{
+    int       nral1, i, l, d;
+    int       shift[GMX_SIMD_WIDTH_HERE*VB_NSHIFT];
+    rvec      xv, dx;
+    gmx_mm_pr a_S, b_S, c_S, d_S;
+    gmx_mm_pr xij_S, yij_S, zij_S, xik_S, yik_S, zik_S, xil_S, yil_S, zil_S;
+    gmx_mm_pr tx_S, ty_S, tz_S, rx_S, ry_S, rz_S;
+
+    nral1 = 1 + NRAL(ftype);
+
+    for (i = 0; i + GMX_SIMD_WIDTH_HERE*nral1 <= nr; i += GMX_SIMD_WIDTH_HERE*nral1)
+    {
+        if (vsite_block_has_dep(ia + i, nral1))
+        {
+            break;
+        }
+
+        vsite_gather(ia + i, nral1, ip, x, NULL, pbc, buf, shift);
+
+        a_S   = gmx_load_pr(buf + VB_A);
+        b_S   = gmx_load_pr(buf + VB_B);
+        c_S   = gmx_load_pr(buf + VB_C);
+        xij_S = gmx_load_pr(buf + VB(vbJ, XX));
+        yij_S = gmx_load_pr(buf + VB(vbJ, YY));
+        zij_S = gmx_load_pr(buf + VB(vbJ, ZZ));
+        xik_S = gmx_load_pr(buf + VB(vbK, XX));
+        yik_S = gmx_load_pr(buf + VB(vbK, YY));
+        zik_S = gmx_load_pr(buf + VB(vbK, ZZ));
+
+        switch (ftype)
+        {
+            case F_VSITE3FD:
+                /* temp goes from i to a point on the line jk */
+                tx_S = gmx_madd_pr(a_S, gmx_sub_pr(xik_S, xij_S), xij_S);
+                ty_S = gmx_madd_pr(a_S, gmx_sub_pr(yik_S, yij_S), yij_S);
+                tz_S = gmx_madd_pr(a_S, gmx_sub_pr(zik_S, zij_S), zij_S);
+                d_S  = gmx_mul_pr(b_S, gmx_invsqrt_pr(gmx_norm2_pr(tx_S, ty_S, tz_S)));
+                rx_S = gmx_mul_pr(d_S, tx_S);
+                ry_S = gmx_mul_pr(d_S, ty_S);
+                rz_S = gmx_mul_pr(d_S, tz_S);
+                break;
+            case F_VSITE3OUT:
+                gmx_cprod_pr(xij_S, yij_S, zij_S, xik_S, yik_S, zik_S,
+                             &tx_S, &ty_S, &tz_S);
+                rx_S = gmx_madd_pr(c_S, tx_S, gmx_madd_pr(b_S, xik_S, gmx_mul_pr(a_S, xij_S)));
+                ry_S = gmx_madd_pr(c_S, ty_S, gmx_madd_pr(b_S, yik_S, gmx_mul_pr(a_S, yij_S)));
+                rz_S = gmx_madd_pr(c_S, tz_S, gmx_madd_pr(b_S, zik_S, gmx_mul_pr(a_S, zij_S)));
+                break;
+            case F_VSITE4FDN:
+                xil_S = gmx_load_pr(buf + VB(vbL, XX));
+                yil_S = gmx_load_pr(buf + VB(vbL, YY));
+                zil_S = gmx_load_pr(buf + VB(vbL, ZZ));
+                /* rja = a*xik - xij, rjb = b*xil - xij, rm = rja x rjb */
+                gmx_cprod_pr(gmx_sub_pr(gmx_mul_pr(a_S, xik_S), xij_S),
+                             gmx_sub_pr(gmx_mul_pr(a_S, yik_S), yij_S),
+                             gmx_sub_pr(gmx_mul_pr(a_S, zik_S), zij_S),
+                             gmx_sub_pr(gmx_mul_pr(b_S, xil_S), xij_S),
+                             gmx_sub_pr(gmx_mul_pr(b_S, yil_S), yij_S),
+                             gmx_sub_pr(gmx_mul_pr(b_S, zil_S), zij_S),
+                             &tx_S, &ty_S, &tz_S);
+                d_S  = gmx_mul_pr(c_S, gmx_invsqrt_pr(gmx_norm2_pr(tx_S, ty_S, tz_S)));
+                rx_S = gmx_mul_pr(d_S, tx_S);
+                ry_S = gmx_mul_pr(d_S, ty_S);
+                rz_S = gmx_mul_pr(d_S, tz_S);
+                break;
+            default:
+                rx_S = gmx_setzero_pr();
+                ry_S = gmx_setzero_pr();
+                rz_S = gmx_setzero_pr();
+                gmx_incons("Unsupported vsite type in construct_vsites_simd");
+        }
+
+        /* Store the vsite positions relative to atom i */
+        gmx_store_pr(buf + VB(vbJ, XX), rx_S);
+        gmx_store_pr(buf + VB(vbJ, YY), ry_S);
+        gmx_store_pr(buf + VB(vbJ, ZZ), rz_S);
+
+        for (l = 0; l < GMX_SIMD_WIDTH_HERE; l++)
+        {
+            t_iatom av;
+
+            av = ia[i + l*nral1 + 1];
+            /* Copy the old position */
+            copy_rvec(x[av], xv);
+            for (d = 0; d < DIM; d++)
+            {
+                x[av][d] = buf[VB(vbI, d) + l] + buf[VB(vbJ, d) + l];
+            }
+            if (pbc != NULL &&
+                pbc_dx_aiuc(pbc, x[av], xv, dx) != CENTRAL)
+            {
+                /* The vsite follows its own pbc */
+                rvec_add(xv, dx, x[av]);
+            }
+            if (v != NULL)
+            {
+                /* Calculate velocity of vsite... */
+                rvec_sub(x[av], xv, dx);
+                svmul(inv_dt, dx, v[av]);
+            }
+        }
+    }
+
+    return i;
+}
+#endif /* VSITE_SIMD */
+
 void construct_vsites_thread(gmx_vsite_t *vsite,
                              rvec x[],
                              real dt, rvec *v,
@@ -436,6 +651,11 @@ void construct_vsites_thread(gmx_vsite_t *vsite,
     t_pbc     *pbc_null2;
     int       *vsite_pbc, ishift;
     rvec       reftmp, vtmp, rtmp;
+#ifdef VSITE_SIMD
+    real       buf_unaligned[VB_SIZE + GMX_SIMD_WIDTH_HERE], *buf;
+
+    buf = gmx_simd_align_real(buf_unaligned);
+#endif
 
     if (v != NULL)
     {
@@ -469,7 +689,16 @@ void construct_vsites_thread(gmx_vsite_t *vsite,
                 vsite_pbc = vsite->vsite_pbc_loc[ftype-F_VSITE2];
             }
 
-            for (i = 0; i < nr; )
+            i = 0;
+#ifdef VSITE_SIMD
+            if (vsite->bUseSimd && vsite_pbc == NULL && vsite_type_simd(ftype))
+            {
+                i   = construct_vsites_simd(ftype, nr, ia, ip, x, v, inv_dt,
+                                            pbc_null2, buf);
+                ia += i;
+            }
+#endif
+            for (; i < nr; )
             {
                 tp   = ia[0];
 
@@ -1441,6 +1670,254 @@ static int vsite_count(const t_ilist *ilist, int ftype)
     }
 }
 
+#ifdef VSITE_SIMD
+/* Adds (or subtracts with bSub=TRUE) the outer product x*f to dxdf_S */
+static gmx_inline void vsite_dxdf_simd(gmx_mm_pr dxdf_S[DIM][DIM],
+                                       const gmx_mm_pr *x_S, const gmx_mm_pr *f_S,
+                                       gmx_bool bSub)
+{
+    int i, j;
+
+    for (i = 0; i < DIM; i++)
+    {
+        for (j = 0; j < DIM; j++)
+        {
+            if (bSub)
+            {
+                dxdf_S[i][j] = gmx_nmsub_pr(x_S[i], f_S[j], dxdf_S[i][j]);
+            }
+            else
+            {
+                dxdf_S[i][j] = gmx_madd_pr(x_S[i], f_S[j], dxdf_S[i][j]);
+            }
+        }
+    }
+}
+
+/* Spreads the forces of vsites of type ftype in blocks of
+ * GMX_SIMD_WIDTH_HERE, without graph. With pbc, the shift indices
+ * are determined from the atom distances, as without charge groups.
+ * Returns the number of ilist entries that were handled.
+ */
+static int spread_vsites_simd(int ftype, int nr, t_iatom *ia,
+                              t_iparams ip[], rvec x[], rvec f[],
+                              rvec fshift[], const t_pbc *pbc,
+                              gmx_bool VirCorr, gmx_mm_pr dxdf_S[DIM][DIM],
+                              real *buf)
+{
+    int       nral1, i, l, d, j;
+    int       shift[GMX_SIMD_WIDTH_HERE*VB_NSHIFT];
+    gmx_bool  bShift;
+    gmx_mm_pr a_S, b_S, c_S, invl_S, s_S;
+    gmx_mm_pr xij_S[DIM], xik_S[DIM], xil_S[DIM], xiv_S[DIM], t_S[DIM];
+    gmx_mm_pr fv_S[DIM], fj_S[DIM], fk_S[DIM], fl_S[DIM], cf_S[DIM];
+    gmx_mm_pr rja_S[DIM], rjb_S[DIM], rab_S[DIM], rm_S[DIM], rt_S[DIM];
+
+    nral1 = 1 + NRAL(ftype);
+
+    for (i = 0; i + GMX_SIMD_WIDTH_HERE*nral1 <= nr; i += GMX_SIMD_WIDTH_HERE*nral1)
+    {
+        if (vsite_block_has_dep(ia + i, nral1))
+        {
+            break;
+        }
+
+        vsite_gather(ia + i, nral1, ip, x, f, pbc, buf, shift);
+
+        a_S = gmx_load_pr(buf + VB_A);
+        b_S = gmx_load_pr(buf + VB_B);
+        c_S = gmx_load_pr(buf + VB_C);
+        for (d = 0; d < DIM; d++)
+        {
+            xij_S[d] = gmx_load_pr(buf + VB(vbJ, d));
+            xik_S[d] = gmx_load_pr(buf + VB(vbK, d));
+            xiv_S[d] = gmx_load_pr(buf + VB(vbV, d));
+            fv_S[d]  = gmx_load_pr(buf + VB(vbF, d));
+        }
+
+        switch (ftype)
+        {
+            case F_VSITE3FD:
+                /* t goes from i to point x on the line jk */
+                for (d = 0; d < DIM; d++)
+                {
+                    t_S[d] = gmx_madd_pr(a_S, gmx_sub_pr(xik_S[d], xij_S[d]), xij_S[d]);
+                }
+                invl_S = gmx_invsqrt_pr(gmx_norm2_pr(t_S[XX], t_S[YY], t_S[ZZ]));
+                /* s = (t . fv)/(t . t) */
+                s_S    = gmx_mul_pr(gmx_iprod_pr(t_S[XX], t_S[YY], t_S[ZZ],
+                                                 fv_S[XX], fv_S[YY], fv_S[ZZ]),
+                                    gmx_mul_pr(invl_S, invl_S));
+                invl_S = gmx_mul_pr(b_S, invl_S);
+                for (d = 0; d < DIM; d++)
+                {
+                    /* fk is the force on the point on the line jk */
+                    fk_S[d] = gmx_mul_pr(invl_S, gmx_nmsub_pr(s_S, t_S[d], fv_S[d]));
+                    /* fj here is fv - fk, the force on atom i */
+                    fj_S[d] = gmx_sub_pr(fv_S[d], fk_S[d]);
+                    rt_S[d] = gmx_mul_pr(a_S, fk_S[d]);
+                    rm_S[d] = gmx_sub_pr(fk_S[d], rt_S[d]);
+                }
+                /* Store the forces on i, j and k */
+                for (d = 0; d < DIM; d++)
+                {
+                    gmx_store_pr(buf + VB(vbI, d), fj_S[d]);
+                    gmx_store_pr(buf + VB(vbJ, d), rm_S[d]);
+                    gmx_store_pr(buf + VB(vbK, d), rt_S[d]);
+                }
+                if (VirCorr)
+                {
+                    /* As t is a linear combination of j and k, use that here */
+                    vsite_dxdf_simd(dxdf_S, xiv_S, fv_S, TRUE);
+                    vsite_dxdf_simd(dxdf_S, t_S, fk_S, FALSE);
+                }
+                break;
+            case F_VSITE3OUT:
+                for (d = 0; d < DIM; d++)
+                {
+                    cf_S[d] = gmx_mul_pr(c_S, fv_S[d]);
+                }
+                /* fj = a*fv + xik x cf, fk = b*fv + cf x xij */
+                gmx_cprod_pr(xik_S[XX], xik_S[YY], xik_S[ZZ],
+                             cf_S[XX], cf_S[YY], cf_S[ZZ],
+                             &fj_S[XX], &fj_S[YY], &fj_S[ZZ]);
+                gmx_cprod_pr(cf_S[XX], cf_S[YY], cf_S[ZZ],
+                             xij_S[XX], xij_S[YY], xij_S[ZZ],
+                             &fk_S[XX], &fk_S[YY], &fk_S[ZZ]);
+                for (d = 0; d < DIM; d++)
+                {
+                    fj_S[d] = gmx_madd_pr(a_S, fv_S[d], fj_S[d]);
+                    fk_S[d] = gmx_madd_pr(b_S, fv_S[d], fk_S[d]);
+                    t_S[d]  = gmx_sub_pr(gmx_sub_pr(fv_S[d], fj_S[d]), fk_S[d]);
+                    gmx_store_pr(buf + VB(vbI, d), t_S[d]);
+                    gmx_store_pr(buf + VB(vbJ, d), fj_S[d]);
+                    gmx_store_pr(buf + VB(vbK, d), fk_S[d]);
+                }
+                if (VirCorr)
+                {
+                    vsite_dxdf_simd(dxdf_S, xiv_S, fv_S, TRUE);
+                    vsite_dxdf_simd(dxdf_S, xij_S, fj_S, FALSE);
+                    vsite_dxdf_simd(dxdf_S, xik_S, fk_S, FALSE);
+                }
+                break;
+            case F_VSITE4FDN:
+                for (d = 0; d < DIM; d++)
+                {
+                    xil_S[d] = gmx_load_pr(buf + VB(vbL, d));
+                    rja_S[d] = gmx_sub_pr(gmx_mul_pr(a_S, xik_S[d]), xij_S[d]);
+                    rjb_S[d] = gmx_sub_pr(gmx_mul_pr(b_S, xil_S[d]), xij_S[d]);
+                    rab_S[d] = gmx_sub_pr(rjb_S[d], rja_S[d]);
+                }
+                gmx_cprod_pr(rja_S[XX], rja_S[YY], rja_S[ZZ],
+                             rjb_S[XX], rjb_S[YY], rjb_S[ZZ],
+                             &rm_S[XX], &rm_S[YY], &rm_S[ZZ]);
+                invl_S = gmx_invsqrt_pr(gmx_norm2_pr(rm_S[XX], rm_S[YY], rm_S[ZZ]));
+                for (d = 0; d < DIM; d++)
+                {
+                    cf_S[d] = gmx_mul_pr(gmx_mul_pr(c_S, invl_S), fv_S[d]);
+                }
+                /* s = (rm . cf)/(rm . rm) */
+                s_S = gmx_mul_pr(gmx_iprod_pr(rm_S[XX], rm_S[YY], rm_S[ZZ],
+                                              cf_S[XX], cf_S[YY], cf_S[ZZ]),
+                                 gmx_mul_pr(invl_S, invl_S));
+
+                /* fj = cf x rab - s*(rm x rab) */
+                gmx_cprod_pr(rm_S[XX], rm_S[YY], rm_S[ZZ],
+                             rab_S[XX], rab_S[YY], rab_S[ZZ],
+                             &rt_S[XX], &rt_S[YY], &rt_S[ZZ]);
+                gmx_cprod_pr(cf_S[XX], cf_S[YY], cf_S[ZZ],
+                             rab_S[XX], rab_S[YY], rab_S[ZZ],
+                             &fj_S[XX], &fj_S[YY], &fj_S[ZZ]);
+                for (d = 0; d < DIM; d++)
+                {
+                    fj_S[d] = gmx_nmsub_pr(s_S, rt_S[d], fj_S[d]);
+                }
+
+                /* fk = a*(rjb x cf - s*(rjb x rm)) */
+                gmx_cprod_pr(rjb_S[XX], rjb_S[YY], rjb_S[ZZ],
+                             rm_S[XX], rm_S[YY], rm_S[ZZ],
+                             &rt_S[XX], &rt_S[YY], &rt_S[ZZ]);
+                gmx_cprod_pr(rjb_S[XX], rjb_S[YY], rjb_S[ZZ],
+                             cf_S[XX], cf_S[YY], cf_S[ZZ],
+                             &fk_S[XX], &fk_S[YY], &fk_S[ZZ]);
+                for (d = 0; d < DIM; d++)
+                {
+                    fk_S[d] = gmx_mul_pr(a_S, gmx_nmsub_pr(s_S, rt_S[d], fk_S[d]));
+                }
+
+                /* fl = b*(cf x rja - s*(rm x rja)) */
+                gmx_cprod_pr(rm_S[XX], rm_S[YY], rm_S[ZZ],
+                             rja_S[XX], rja_S[YY], rja_S[ZZ],
+                             &rt_S[XX], &rt_S[YY], &rt_S[ZZ]);
+                gmx_cprod_pr(cf_S[XX], cf_S[YY], cf_S[ZZ],
+                             rja_S[XX], rja_S[YY], rja_S[ZZ],
+                             &fl_S[XX], &fl_S[YY], &fl_S[ZZ]);
+                for (d = 0; d < DIM; d++)
+                {
+                    fl_S[d] = gmx_mul_pr(b_S, gmx_nmsub_pr(s_S, rt_S[d], fl_S[d]));
+                    t_S[d]  = gmx_sub_pr(gmx_sub_pr(fv_S[d], fj_S[d]),
+                                         gmx_add_pr(fk_S[d], fl_S[d]));
+                    gmx_store_pr(buf + VB(vbI, d), t_S[d]);
+                    gmx_store_pr(buf + VB(vbJ, d), fj_S[d]);
+                    gmx_store_pr(buf + VB(vbK, d), fk_S[d]);
+                    gmx_store_pr(buf + VB(vbL, d), fl_S[d]);
+                }
+                if (VirCorr)
+                {
+                    vsite_dxdf_simd(dxdf_S, xiv_S, fv_S, TRUE);
+                    vsite_dxdf_simd(dxdf_S, xij_S, fj_S, FALSE);
+                    vsite_dxdf_simd(dxdf_S, xik_S, fk_S, FALSE);
+                    vsite_dxdf_simd(dxdf_S, xil_S, fl_S, FALSE);
+                }
+                break;
+            default:
+                gmx_incons("Unsupported vsite type in spread_vsites_simd");
+        }
+
+        /* Add the forces to the constructing atoms and clear the vsite force */
+        for (l = 0; l < GMX_SIMD_WIDTH_HERE; l++)
+        {
+            const t_iatom *ial;
+
+            ial = ia + i + l*nral1;
+            for (j = 2; j < nral1; j++)
+            {
+                for (d = 0; d < DIM; d++)
+                {
+                    f[ial[j]][d] += buf[VB(vbI + j - 2, d) + l];
+                }
+            }
+
+            if (fshift != NULL && pbc != NULL)
+            {
+                bShift = (shift[l*VB_NSHIFT] != CENTRAL);
+                for (j = 3; j < nral1; j++)
+                {
+                    bShift = bShift || (shift[l*VB_NSHIFT + j - 2] != CENTRAL);
+                }
+                if (bShift)
+                {
+                    /* Atom j gets shift index shift[j-2], i is central */
+                    rvec_dec(fshift[shift[l*VB_NSHIFT]], f[ial[1]]);
+                    for (j = 2; j < nral1; j++)
+                    {
+                        for (d = 0; d < DIM; d++)
+                        {
+                            fshift[j == 2 ? CENTRAL : shift[l*VB_NSHIFT + j - 2]][d] +=
+                                buf[VB(vbI + j - 2, d) + l];
+                        }
+                    }
+                }
+            }
+
+            clear_rvec(f[ial[1]]);
+        }
+    }
+
+    return i;
+}
+#endif /* VSITE_SIMD */
+
 static void spread_vsite_f_thread(gmx_vsite_t *vsite,
                                   rvec x[], rvec f[], rvec *fshift,
                                   gmx_bool VirCorr, matrix dxdf,
@@ -1453,6 +1930,20 @@ static void spread_vsite_f_thread(gmx_vsite_t *vsite,
     t_iatom   *ia;
     t_pbc     *pbc_null2;
     int       *vsite_pbc;
+#ifdef VSITE_SIMD
+    real       buf_unaligned[VB_SIZE + GMX_SIMD_WIDTH_HERE], *buf;
+    gmx_mm_pr  dxdf_S[DIM][DIM];
+    int        d, d2, l;
+
+    buf = gmx_simd_align_real(buf_unaligned);
+    for (d = 0; d < DIM; d++)
+    {
+        for (d2 = 0; d2 < DIM; d2++)
+        {
+            dxdf_S[d][d2] = gmx_setzero_pr();
+        }
+    }
+#endif
 
     if (VirCorr)
     {
@@ -1484,7 +1975,18 @@ static void spread_vsite_f_thread(gmx_vsite_t *vsite,
                 vsite_pbc = vsite->vsite_pbc_loc[ftype-F_VSITE2];
             }
 
-            for (i = 0; i < nr; )
+            i = 0;
+#ifdef VSITE_SIMD
+            if (vsite->bUseSimd && vsite_pbc == NULL && g == NULL &&
+                vsite_type_simd(ftype))
+            {
+                i   = spread_vsites_simd(ftype, nr, ia, ip, x, f,
+                                         fshift, pbc_null2,
+                                         VirCorr, dxdf_S, buf);
+                ia += i;
+            }
+#endif
+            for (; i < nr; )
             {
                 if (vsite_pbc != NULL)
                 {
@@ -1550,6 +2052,23 @@ static void spread_vsite_f_thread(gmx_vsite_t *vsite,
             }
         }
     }
+
+#ifdef VSITE_SIMD
+    if (VirCorr)
+    {
+        for (d = 0; d < DIM; d++)
+        {
+            for (d2 = 0; d2 < DIM; d2++)
+            {
+                gmx_store_pr(buf, dxdf_S[d][d2]);
+                for (l = 0; l < GMX_SIMD_WIDTH_HERE; l++)
+                {
+                    dxdf[d][d2] += buf[l];
+                }
+            }
+        }
+    }
+#endif
 }
 
 void spread_vsite_f(gmx_vsite_t *vsite,
@@ -1963,6 +2482,16 @@ gmx_vsite_t *init_vsite(gmx_mtop_t *mtop, t_commrec *cr,
     vsite->th_ind        = NULL;
     vsite->th_ind_nalloc = 0;
 
+#ifdef VSITE_SIMD
+    vsite->bUseSimd = (getenv("GMX_NO_SIMD_VSITE") == NULL);
+#else
+    vsite->bUseSimd = FALSE;
+#endif
+    if (debug)
+    {
+        fprintf(debug, "Virtual sites: using SIMD: %d\n", vsite->bUseSimd);
+    }
+
     return vsite;
 }
 
@@ -1992,8 +2521,8 @@ void split_vsites_over_threads(const t_ilist   *ilist,
                                gmx_vsite_t     *vsite)
 {
     int      th;
-    int      vsite_atom_range, natperthread;
-    int     *th_ind;
+    int      vsite_atom_range, nvsite, count;
+    int     *th_atom_end, *th_ind;
     int      ftype;
     t_iatom *iat;
     t_ilist *il_th;
@@ -2013,9 +2542,9 @@ void split_vsites_over_threads(const t_ilist   *ilist,
     /* Master threads does the (potential) overlap vsites */
     prepare_vsite_thread(ilist, &vsite->tdata[vsite->nthreads]);
 
-    /* The current way of distributing the vsites over threads in primitive.
-     * We divide the atom range 0 - natoms_in_vsite uniformly over threads,
-     * without taking into account how the vsites are distributed.
+    /* We divide the atom range 0 - natoms_in_vsite over the threads
+     * such that each thread gets a nearly equal number of vsites,
+     * based on the first constructing atom of each vsite.
      * Without domain decomposition we bLimitRange=TRUE and we at least
      * tighten the upper bound of the range (useful for common systems
      * such as a vsite-protein in 3-site water).
@@ -2045,12 +2574,6 @@ void split_vsites_over_threads(const t_ilist   *ilist,
     {
         vsite_atom_range = mdatoms->homenr;
     }
-    natperthread = (vsite_atom_range + vsite->nthreads - 1)/vsite->nthreads;
-
-    if (debug)
-    {
-        fprintf(debug, "virtual site thread dist: natoms %d, range %d, natperthread %d\n", mdatoms->nr, vsite_atom_range, natperthread);
-    }
 
     /* To simplify the vsite assignment, we make an index which tells us
      * to which thread particles, both non-vsites and vsites, are assigned.
@@ -2061,22 +2584,79 @@ void split_vsites_over_threads(const t_ilist   *ilist,
         srenew(vsite->th_ind, vsite->th_ind_nalloc);
     }
     th_ind = vsite->th_ind;
-    th     = 0;
+
+    /* Count the vsites per first constructing atom in th_ind */
+    nvsite = 0;
     for (i = 0; i < mdatoms->nr; i++)
     {
+        th_ind[i] = 0;
+    }
+    for (ftype = 0; ftype < F_NRE; ftype++)
+    {
+        if ((interaction_function[ftype].flags & IF_VSITE) &&
+            ftype != F_VSITEN)
+        {
+            nral1 = 1 + NRAL(ftype);
+            iat   = ilist[ftype].iatoms;
+            for (i = 0; i < ilist[ftype].nr; i += nral1)
+            {
+                if (iat[i+2] < vsite_atom_range)
+                {
+                    th_ind[iat[i+2]]++;
+                    nvsite++;
+                }
+            }
+        }
+    }
+
+    /* Set the thread atom boundaries, such that thread th
+     * gets the atoms th_atom_end[th-1] to th_atom_end[th]-1.
+     */
+    snew(th_atom_end, vsite->nthreads);
+    th    = 0;
+    count = 0;
+    for (i = 0; i < vsite_atom_range; i++)
+    {
+        count += th_ind[i];
+        while (th < vsite->nthreads - 1 &&
+               count*vsite->nthreads >= (th + 1)*nvsite)
+        {
+            th_atom_end[th++] = i + 1;
+        }
+    }
+    while (th < vsite->nthreads)
+    {
+        th_atom_end[th++] = vsite_atom_range;
+    }
+
+    if (debug)
+    {
+        fprintf(debug, "virtual site thread dist: natoms %d, range %d, nvsite %d\n", mdatoms->nr, vsite_atom_range, nvsite);
+    }
+
+    /* Assign the non-vsite particles in the range to the threads.
+     * Particles outside the range are not assigned (th_ind=-2)
+     * and are claimed by the first vsite that uses them.
+     * vsites are not assigned to a thread yet (th_ind=-1).
+     */
+    th = 0;
+    for (i = 0; i < mdatoms->nr; i++)
+    {
+        while (th < vsite->nthreads && i >= th_atom_end[th])
+        {
+            th++;
+        }
         if (mdatoms->ptype[i] == eptVSite)
         {
-            /* vsites are not assigned to a thread yet */
             th_ind[i] = -1;
         }
-        else
+        else if (th < vsite->nthreads)
         {
-            /* assign non-vsite particles to thread th */
             th_ind[i] = th;
         }
-        if (i == (th + 1)*natperthread && th < vsite->nthreads)
+        else
         {
-            th++;
+            th_ind[i] = -2;
         }
     }
 
@@ -2090,32 +2670,42 @@ void split_vsites_over_threads(const t_ilist   *ilist,
             iat   = ilist[ftype].iatoms;
             for (i = 0; i < ilist[ftype].nr; )
             {
-                th = iat[1+i]/natperthread;
-                /* We would like to assign this vsite the thread th,
-                 * but it might depend on atoms outside the atom range of th
-                 * or on another vsite not assigned to thread th.
+                /* We would like to assign this vsite to the thread
+                 * of its first constructing atom, but it might depend
+                 * on atoms of another thread or on a vsite not assigned
+                 * to the same thread.
                  */
-                if (ftype != F_VSITEN)
+                th = th_ind[iat[i+2]];
+                if (th < 0)
                 {
-                    for (j = i+2; j < i+nral1; j++)
+                    /* Use the thread of the atom range of the vsite */
+                    th = 0;
+                    while (th < vsite->nthreads - 1 &&
+                           iat[i+1] >= th_atom_end[th])
                     {
-                        if (th_ind[iat[j]] != th)
-                        {
-                            /* Some constructing atoms are not assigned to
-                             * thread th, move this vsite to a separate batch.
-                             */
-                            th = vsite->nthreads;
-                        }
+                        th++;
                     }
                 }
-                else
+                for (j = i+2; j < i+nral1; j++)
+                {
+                    if (th_ind[iat[j]] != th && th_ind[iat[j]] != -2)
+                    {
+                        /* Some constructing atoms are not assigned to
+                         * thread th, move this vsite to a separate batch.
+                         */
+                        th = vsite->nthreads;
+                    }
+                }
+                if (th < vsite->nthreads)
                 {
-                    inc = iat[i];
-                    for (j = i+2; j < i+inc; j += 3)
+                    /* Claim the unassigned constructing atoms,
+                     * so no other thread will spread forces to them.
+                     */
+                    for (j = i+2; j < i+nral1; j++)
                     {
-                        if (th_ind[iat[j]] != th)
+                        if (th_ind[iat[j]] == -2)
                         {
-                            th = vsite->nthreads;
+                            th_ind[iat[j]] = th;
                         }
                     }
                 }
@@ -2133,6 +2723,15 @@ void split_vsites_over_threads(const t_ilist   *ilist,
         }
     }
 
+    /* F_VSITEN vsites are rare, we put them all in the separate batch */
+    il_th = &vsite->tdata[vsite->nthreads].ilist[F_VSITEN];
+    for (i = 0; i < ilist[F_VSITEN].nr; i++)
+    {
+        il_th->iatoms[il_th->nr++] = ilist[F_VSITEN].iatoms[i];
+    }
+
+    sfree(th_atom_end);
+
     if (debug)
     {
         for (ftype = 0; ftype < F_NRE; ftype++)
@@ -40,9 +40,8 @@
  * The grid implementation could still be optimized in several different ways:
  *   - Triclinic grid cells are not the most efficient shape, but make PBC
  *     handling easier.
- *   - Precalculating the required PBC shift for a pair of cells outside the
- *     inner loop. After this is done, it should be quite straightforward to
- *     move to rectangular cells.
+ *   - Moving to rectangular cells now that the required PBC shift is
+ *     computed once per neighboring cell.
  *   - Pruning grid cells from the search list if they are completely outside
  *     the sphere that is being considered.
  *   - A better heuristic could be added for falling back to simple loops for a
@@ -57,6 +56,10 @@
  */
 #include "gromacs/selection/nbsearch.h"
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <math.h>
 
 #include <algorithm>
@@ -71,6 +74,31 @@
 #include "gromacs/selection/position.h"
 #include "gromacs/utility/arrayref.h"
 #include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/gmxomp.h"
+
+/* Include the SIMD macro file and then check for support */
+#include "gromacs/simd/macros.h"
+#ifdef GMX_HAVE_SIMD_MACROS
+/* Compute distances to the reference positions in a cell with SIMD */
+#define NBSEARCH_SIMD
+#endif
+
+namespace
+{
+
+#ifdef NBSEARCH_SIMD
+//! Number of reference positions handled at once in the cell loops.
+const int  c_cellBlockSize = GMX_SIMD_WIDTH_HERE;
+#else
+//! Number of reference positions handled at once in the cell loops.
+const int  c_cellBlockSize = 1;
+#endif
+//! Coordinate used for padding the cells up to a multiple of the block size.
+const real c_cellPadCoordinate = 1e10;
+//! Minimum number of test positions per thread in batched searches.
+const int  c_minPositionsPerThread = 256;
+
+}   // namespace
 
 namespace gmx
 {
@@ -82,13 +110,27 @@ namespace internal
  * Implementation class declarations
  */
 
+/*! \internal \brief
+ * PBC shift of a neighboring grid cell.
+ *
+ * The box vectors are stored separately, in the order in which
+ * pbc_dx_aiuc() subtracts them.  Subtracting them one by one from the
+ * difference vector gives the same rounding as pbc_dx_aiuc().
+ */
+struct CellShift
+{
+    //! Number of box vectors in \p vec.
+    int  count;
+    //! Box vectors to subtract from the difference vector, in order.
+    rvec vec[DIM];
+};
+
 class AnalysisNeighborhoodSearchImpl
 {
     public:
         typedef AnalysisNeighborhoodPairSearch::ImplPointer
             PairSearchImplPointer;
         typedef std::vector<PairSearchImplPointer> PairSearchList;
-        typedef std::vector<std::vector<int> > CellList;
 
         explicit AnalysisNeighborhoodSearchImpl(real cutoff);
         ~AnalysisNeighborhoodSearchImpl();
@@ -107,6 +149,41 @@ class AnalysisNeighborhoodSearchImpl
 
         real cutoffSquared() const { return cutoff2_; }
         bool usesGridSearch() const { return bGrid_; }
+        /*! \brief
+         * Whether the cell-based search without pair state can be used.
+         *
+         * If true, isWithinCells() and minimumDistance2Cells() can be used
+         * instead of a pair search.
+         */
+        bool usesCellSearch() const { return bGrid_ && nexcl_ == 0; }
+
+        /*! \brief
+         * Checks whether any of the test positions is within the cutoff.
+         *
+         * Can only be called if usesCellSearch() returns true.
+         */
+        bool isWithinCells(const AnalysisNeighborhoodPositions &positions) const;
+        /*! \brief
+         * Calculates the minimum distance squared from the test positions.
+         *
+         * Returns the cutoff squared if no reference position is within the
+         * cutoff.  Can only be called if usesCellSearch() returns true.
+         */
+        real minimumDistance2Cells(const AnalysisNeighborhoodPositions &positions) const;
+        /*! \brief
+         * Finds the test positions that are within the cutoff.
+         *
+         * Implements AnalysisNeighborhoodSearch::findPositionsWithin().
+         */
+        void findPositionsWithin(const AnalysisNeighborhoodPositions &positions,
+                                 std::vector<int>                    *within) const;
+        /*! \brief
+         * Calculates the minimum distance for each test position.
+         *
+         * Implements AnalysisNeighborhoodSearch::minimumDistances().
+         */
+        void minimumDistances(const AnalysisNeighborhoodPositions &positions,
+                              real                                *dist) const;
 
     private:
         //! Calculates offsets to neighboring grid cells that should be considered.
@@ -142,12 +219,44 @@ class AnalysisNeighborhoodSearchImpl
          */
         int getGridCellIndex(const ivec cell) const;
         /*! \brief
-         * Adds an index into a grid cell.
+         * Sorts the reference positions into the grid cells.
+         *
+         * Fills \p cellStart_, \p cellCount_, \p cellRefIndex_ and the
+         * cell coordinate arrays from \p xref_.
+         */
+        void sortReferencesIntoCells();
+        /*! \brief
+         * Finds a neighboring grid cell and the PBC shift for it.
+         *
+         * \param[in]  testcell Cell of the test position.
+         * \param[in]  nbi      Index of the neighbor cell offset.
+         * \param[out] shift    Shift to add to the reference positions in the
+         *     returned cell to get the images closest to \p testcell.
+         * \returns    Linear index of the neighboring cell.
+         */
+        int getNeighborCell(const ivec testcell, int nbi, CellShift *shift) const;
+        /*! \brief
+         * Calculates the minimum distance squared from \p x to a cell.
+         *
+         * \param[in]  ci     Linear index of the cell.
+         * \param[in]  x      Test position.
+         * \param[in]  shift  PBC shift for the cell from getNeighborCell().
+         * \returns    Minimum distance squared to any reference position in
+         *     the cell, or GMX_REAL_MAX if the cell is empty.
          *
-         * \param[in]     cell Cell into which \p i should be added.
-         * \param[in]     i    Index to add.
+         * The shift is applied to the difference vectors as in pbc_dx_aiuc()
+         * to get the same rounding as the pair search.
          */
-        void addToGridCell(const ivec cell, int i);
+        real cellMinimumDistance2(int ci, const rvec x, const CellShift &shift) const;
+        /*! \brief
+         * Calculates the minimum distance squared from a single position.
+         *
+         * \param[in]  x      Test position.
+         * \param[in]  bStop  If true, returns as soon as a distance within
+         *     the cutoff is found.
+         * \returns    Minimum distance squared, limited to the cutoff squared.
+         */
+        real positionMinimumDistance2(const rvec x, bool bStop) const;
 
         //! Whether to try grid searching.
         bool                    bTryGrid_;
@@ -184,8 +293,23 @@ class AnalysisNeighborhoodSearchImpl
         matrix                  recipcell_;
         //! Number of cells along each dimension.
         ivec                    ncelldim_;
-        //! Data structure to hold the grid cell contents.
-        CellList                cells_;
+        /*! \brief
+         * Start of each cell in the cell-sorted reference arrays.
+         *
+         * Each cell is padded to a multiple of the SIMD width, and the entry
+         * after the last cell gives the total padded size.
+         */
+        std::vector<int>        cellStart_;
+        //! Number of reference positions in each cell.
+        std::vector<int>        cellCount_;
+        //! Reference position index for each entry in the cell-sorted arrays.
+        std::vector<int>        cellRefIndex_;
+        //! Cell index of each reference position (temporary during init).
+        std::vector<int>        refCell_;
+        //! Cell-sorted reference x, y and z coordinates (SIMD aligned).
+        real                   *cellx_[DIM];
+        //! Allocation count for \p cellx_.
+        int                     cellx_nalloc_;
         //! Number of neighboring cells to consider.
         int                     ngridnb_;
         //! Offsets of the neighboring cells to consider.
@@ -281,6 +405,11 @@ AnalysisNeighborhoodSearchImpl::AnalysisNeighborhoodSearchImpl(real cutoff)
     clear_mat(cellbox_);
     clear_mat(recipcell_);
     clear_ivec(ncelldim_);
+    for (int dd = 0; dd < DIM; ++dd)
+    {
+        cellx_[dd]  = NULL;
+    }
+    cellx_nalloc_   = 0;
 
     ngridnb_        = 0;
     gnboffs_        = NULL;
@@ -297,6 +426,10 @@ AnalysisNeighborhoodSearchImpl::~AnalysisNeighborhoodSearchImpl()
     }
     sfree(xref_alloc_);
     sfree(gnboffs_);
+    for (int dd = 0; dd < DIM; ++dd)
+    {
+        sfree_aligned(cellx_[dd]);
+    }
 }
 
 AnalysisNeighborhoodSearchImpl::PairSearchImplPointer
@@ -373,17 +506,8 @@ bool AnalysisNeighborhoodSearchImpl::initGridCells(const t_pbc *pbc)
             return false;
         }
     }
-    // Never decrease the size of the cell vector to avoid reallocating
-    // memory for the nested vectors.  The actual size of the vector is not
-    // used outside this function.
-    if (cells_.size() < static_cast<size_t>(cellCount))
-    {
-        cells_.resize(cellCount);
-    }
-    for (int ci = 0; ci < cellCount; ++ci)
-    {
-        cells_[ci].clear();
-    }
+    cellStart_.resize(cellCount + 1);
+    cellCount_.assign(cellCount, 0);
     return true;
 }
 
@@ -455,10 +579,217 @@ int AnalysisNeighborhoodSearchImpl::getGridCellIndex(const ivec cell) const
            + cell[ZZ] * ncelldim_[XX] * ncelldim_[YY];
 }
 
-void AnalysisNeighborhoodSearchImpl::addToGridCell(const ivec cell, int i)
+void AnalysisNeighborhoodSearchImpl::sortReferencesIntoCells()
 {
-    const int ci = getGridCellIndex(cell);
-    cells_[ci].push_back(i);
+    const int cellCount = static_cast<int>(cellCount_.size());
+
+    refCell_.resize(nref_);
+    for (int i = 0; i < nref_; ++i)
+    {
+        ivec refcell;
+
+        mapPointToGridCell(xref_[i], refcell);
+        refCell_[i] = getGridCellIndex(refcell);
+        ++cellCount_[refCell_[i]];
+    }
+    // Pad each cell such that the SIMD loops can process full blocks.
+    int totalSize = 0;
+    for (int ci = 0; ci < cellCount; ++ci)
+    {
+        cellStart_[ci] = totalSize;
+        totalSize     += (cellCount_[ci] + c_cellBlockSize - 1)
+            / c_cellBlockSize * c_cellBlockSize;
+    }
+    cellStart_[cellCount] = totalSize;
+
+    if (cellx_nalloc_ < totalSize)
+    {
+        cellx_nalloc_ = over_alloc_large(totalSize);
+        for (int dd = 0; dd < DIM; ++dd)
+        {
+            sfree_aligned(cellx_[dd]);
+            snew_aligned(cellx_[dd], cellx_nalloc_, c_cellBlockSize*sizeof(real));
+        }
+    }
+    cellRefIndex_.resize(totalSize);
+    for (int ci = 0; ci < cellCount; ++ci)
+    {
+        for (int j = cellStart_[ci] + cellCount_[ci]; j < cellStart_[ci+1]; ++j)
+        {
+            cellRefIndex_[j] = -1;
+            for (int dd = 0; dd < DIM; ++dd)
+            {
+                cellx_[dd][j] = c_cellPadCoordinate;
+            }
+        }
+        // Temporarily use the count as the insertion point.
+        cellCount_[ci] = 0;
+    }
+    // Positions are inserted in index order, which keeps each cell sorted as
+    // is needed for the exclusion handling.
+    for (int i = 0; i < nref_; ++i)
+    {
+        const int ci = refCell_[i];
+        const int j  = cellStart_[ci] + cellCount_[ci];
+        cellRefIndex_[j] = i;
+        for (int dd = 0; dd < DIM; ++dd)
+        {
+            cellx_[dd][j] = xref_[i][dd];
+        }
+        ++cellCount_[ci];
+    }
+}
+
+int AnalysisNeighborhoodSearchImpl::getNeighborCell(const ivec testcell,
+                                                    int        nbi,
+                                                    CellShift *shift) const
+{
+    ivec cell;
+
+    shift->count = 0;
+    // pbc_dx_aiuc() shifts along the last box vector first.
+    for (int dd = DIM - 1; dd >= 0; --dd)
+    {
+        int nshift = 0;
+        cell[dd] = testcell[dd] + gnboffs_[nbi][dd];
+        while (cell[dd] < 0)
+        {
+            cell[dd] += ncelldim_[dd];
+            --nshift;
+        }
+        while (cell[dd] >= ncelldim_[dd])
+        {
+            cell[dd] -= ncelldim_[dd];
+            ++nshift;
+        }
+        if (nshift != 0)
+        {
+            svmul(nshift, pbc_->box[dd], shift->vec[shift->count]);
+            ++shift->count;
+        }
+    }
+    return getGridCellIndex(cell);
+}
+
+real AnalysisNeighborhoodSearchImpl::cellMinimumDistance2(int              ci,
+                                                          const rvec       x,
+                                                          const CellShift &shift) const
+{
+    const int start = cellStart_[ci];
+    const int end   = cellStart_[ci+1];
+    real      minr2 = GMX_REAL_MAX;
+#ifdef NBSEARCH_SIMD
+    if (start < end)
+    {
+        const gmx_mm_pr tx     = gmx_set1_pr(x[XX]);
+        const gmx_mm_pr ty     = gmx_set1_pr(x[YY]);
+        const gmx_mm_pr tz     = gmx_set1_pr(x[ZZ]);
+        gmx_mm_pr       sx[DIM], sy[DIM], sz[DIM];
+        for (int s = 0; s < shift.count; ++s)
+        {
+            sx[s] = gmx_set1_pr(shift.vec[s][XX]);
+            sy[s] = gmx_set1_pr(shift.vec[s][YY]);
+            sz[s] = gmx_set1_pr(shift.vec[s][ZZ]);
+        }
+        const gmx_mm_pr zero   = gmx_setzero_pr();
+        // There is no SIMD minimum, so track the maximum of -r2.
+        gmx_mm_pr       negmin = gmx_set1_pr(-GMX_REAL_MAX);
+        for (int j = start; j < end; j += GMX_SIMD_WIDTH_HERE)
+        {
+            gmx_mm_pr dx = gmx_sub_pr(tx, gmx_load_pr(cellx_[XX] + j));
+            gmx_mm_pr dy = gmx_sub_pr(ty, gmx_load_pr(cellx_[YY] + j));
+            gmx_mm_pr dz = gmx_sub_pr(tz, gmx_load_pr(cellx_[ZZ] + j));
+            for (int s = 0; s < shift.count; ++s)
+            {
+                dx = gmx_sub_pr(dx, sx[s]);
+                dy = gmx_sub_pr(dy, sy[s]);
+                dz = gmx_sub_pr(dz, sz[s]);
+            }
+            gmx_mm_pr r2 = gmx_mul_pr(dx, dx);
+            r2     = gmx_madd_pr(dy, dy, r2);
+            r2     = gmx_madd_pr(dz, dz, r2);
+            negmin = gmx_max_pr(negmin, gmx_sub_pr(zero, r2));
+        }
+        real  buf[2*GMX_SIMD_WIDTH_HERE];
+        real *r2buf = gmx_simd_align_real(buf);
+        gmx_store_pr(r2buf, negmin);
+        for (int k = 0; k < GMX_SIMD_WIDTH_HERE; ++k)
+        {
+            minr2 = std::min(minr2, -r2buf[k]);
+        }
+    }
+#else
+    for (int j = start; j < end; ++j)
+    {
+        rvec dx;
+        for (int dd = 0; dd < DIM; ++dd)
+        {
+            dx[dd] = x[dd] - cellx_[dd][j];
+        }
+        for (int s = 0; s < shift.count; ++s)
+        {
+            rvec_dec(dx, shift.vec[s]);
+        }
+        minr2 = std::min(minr2, norm2(dx));
+    }
+#endif
+    return minr2;
+}
+
+real AnalysisNeighborhoodSearchImpl::positionMinimumDistance2(const rvec x,
+                                                              bool       bStop) const
+{
+    rvec xtest;
+    ivec testcell;
+
+    copy_rvec(x, xtest);
+    put_atoms_in_triclinic_unitcell(ecenterTRIC, pbc_->box, 1, &xtest);
+    mapPointToGridCell(xtest, testcell);
+
+    real minr2 = cutoff2_;
+    for (int nbi = 0; nbi < ngridnb_; ++nbi)
+    {
+        CellShift  shift;
+        const int  ci = getNeighborCell(testcell, nbi, &shift);
+        const real r2 = cellMinimumDistance2(ci, xtest, shift);
+        if (r2 <= minr2)
+        {
+            minr2 = r2;
+            if (bStop)
+            {
+                break;
+            }
+        }
+    }
+    return minr2;
+}
+
+bool AnalysisNeighborhoodSearchImpl::isWithinCells(
+        const AnalysisNeighborhoodPositions &positions) const
+{
+    const int first = (positions.index_ < 0 ? 0 : positions.index_);
+    const int last  = (positions.index_ < 0 ? positions.count_ : positions.index_ + 1);
+    for (int i = first; i < last; ++i)
+    {
+        if (positionMinimumDistance2(positions.x_[i], true) <= cutoff2_)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+real AnalysisNeighborhoodSearchImpl::minimumDistance2Cells(
+        const AnalysisNeighborhoodPositions &positions) const
+{
+    const int first = (positions.index_ < 0 ? 0 : positions.index_);
+    const int last  = (positions.index_ < 0 ? positions.count_ : positions.index_ + 1);
+    real      minr2 = cutoff2_;
+    for (int i = first; i < last; ++i)
+    {
+        minr2 = std::min(minr2, positionMinimumDistance2(positions.x_[i], false));
+    }
+    return minr2;
 }
 
 void AnalysisNeighborhoodSearchImpl::init(
@@ -497,13 +828,7 @@ void AnalysisNeighborhoodSearchImpl::init(
         }
         put_atoms_in_triclinic_unitcell(ecenterTRIC, pbc_->box,
                                         nref_, xref_alloc_);
-        for (int i = 0; i < nref_; ++i)
-        {
-            ivec refcell;
-
-            mapPointToGridCell(xref_[i], refcell);
-            addToGridCell(refcell, i);
-        }
+        sortReferencesIntoCells();
     }
     else
     {
@@ -629,25 +954,26 @@ bool AnalysisNeighborhoodPairSearchImpl::searchNext(Action action)
 
             for (; nbi < search_.ngridnb_; ++nbi)
             {
-                ivec cell;
-
-                ivec_add(testcell_, search_.gnboffs_[nbi], cell);
-                cell[XX] = (cell[XX] + search_.ncelldim_[XX]) % search_.ncelldim_[XX];
-                cell[YY] = (cell[YY] + search_.ncelldim_[YY]) % search_.ncelldim_[YY];
-                cell[ZZ] = (cell[ZZ] + search_.ncelldim_[ZZ]) % search_.ncelldim_[ZZ];
-
-                const int ci       = search_.getGridCellIndex(cell);
-                const int cellSize = static_cast<int>(search_.cells_[ci].size());
-                /* TODO: Calculate the required PBC shift outside the inner loop */
+                CellShift shift;
+                const int ci        = search_.getNeighborCell(testcell_, nbi, &shift);
+                const int cellStart = search_.cellStart_[ci];
+                const int cellSize  = search_.cellCount_[ci];
                 for (; cai < cellSize; ++cai)
                 {
-                    const int i = search_.cells_[ci][cai];
+                    const int i = search_.cellRefIndex_[cellStart + cai];
                     if (isExcluded(i))
                     {
                         continue;
                     }
                     rvec       dx;
-                    pbc_dx_aiuc(search_.pbc_, xtest_, search_.xref_[i], dx);
+                    for (int dd = 0; dd < DIM; ++dd)
+                    {
+                        dx[dd] = xtest_[dd] - search_.cellx_[dd][cellStart + cai];
+                    }
+                    for (int s = 0; s < shift.count; ++s)
+                    {
+                        rvec_dec(dx, shift.vec[s]);
+                    }
                     const real r2 = norm2(dx);
                     if (r2 <= search_.cutoff2_)
                     {
@@ -775,8 +1101,96 @@ class MindistAction
         GMX_DISALLOW_ASSIGN(MindistAction);
 };
 
+//! Returns the number of threads to use for \p count test positions.
+int batchedSearchThreadCount(int count)
+{
+    const int nthreads = std::min(gmx_omp_get_max_threads(),
+                                  count / c_minPositionsPerThread);
+    return std::max(nthreads, 1);
+}
+
 }   // namespace
 
+namespace internal
+{
+
+/********************************************************************
+ * AnalysisNeighborhoodSearchImpl batched searches
+ */
+
+void AnalysisNeighborhoodSearchImpl::findPositionsWithin(
+        const AnalysisNeighborhoodPositions &positions,
+        std::vector<int>                    *within) const
+{
+    GMX_RELEASE_ASSERT(positions.index_ == -1,
+                       "Individual indexed positions not supported in batched search");
+    const int         count    = positions.count_;
+    const int         nthreads = batchedSearchThreadCount(count);
+    std::vector<char> bWithin(count);
+
+#pragma omp parallel num_threads(nthreads)
+    {
+        AnalysisNeighborhoodPairSearchImpl pairSearch(*this);
+#pragma omp for schedule(static)
+        for (int i = 0; i < count; ++i)
+        {
+            if (usesCellSearch())
+            {
+                bWithin[i] = (positionMinimumDistance2(positions.x_[i], true)
+                              <= cutoff2_);
+            }
+            else
+            {
+                pairSearch.startSearch(AnalysisNeighborhoodPositions(positions.x_[i]));
+                bWithin[i] = pairSearch.searchNext(&withinAction);
+            }
+        }
+    }
+    within->clear();
+    for (int i = 0; i < count; ++i)
+    {
+        if (bWithin[i])
+        {
+            within->push_back(i);
+        }
+    }
+}
+
+void AnalysisNeighborhoodSearchImpl::minimumDistances(
+        const AnalysisNeighborhoodPositions &positions,
+        real                                *dist) const
+{
+    GMX_RELEASE_ASSERT(positions.index_ == -1,
+                       "Individual indexed positions not supported in batched search");
+    const int count    = positions.count_;
+    const int nthreads = batchedSearchThreadCount(count);
+
+#pragma omp parallel num_threads(nthreads)
+    {
+        AnalysisNeighborhoodPairSearchImpl pairSearch(*this);
+#pragma omp for schedule(static)
+        for (int i = 0; i < count; ++i)
+        {
+            real minDist2 = cutoff2_;
+            if (usesCellSearch())
+            {
+                minDist2 = positionMinimumDistance2(positions.x_[i], false);
+            }
+            else
+            {
+                int           closestPoint = -1;
+                MindistAction action(&closestPoint, &minDist2);
+                pairSearch.startSearch(AnalysisNeighborhoodPositions(positions.x_[i]));
+                // Pass the action by reference, it can not be copied.
+                (void)pairSearch.searchNext<MindistAction &>(action);
+            }
+            dist[i] = sqrt(minDist2);
+        }
+    }
+}
+
+}   // namespace internal
+
 /********************************************************************
  * AnalysisNeighborhood::Impl
  */
@@ -896,6 +1310,10 @@ bool AnalysisNeighborhoodSearch::isWithin(
         const AnalysisNeighborhoodPositions &positions) const
 {
     GMX_RELEASE_ASSERT(impl_, "Accessing an invalid search object");
+    if (impl_->usesCellSearch())
+    {
+        return impl_->isWithinCells(positions);
+    }
     internal::AnalysisNeighborhoodPairSearchImpl pairSearch(*impl_);
     pairSearch.startSearch(positions);
     return pairSearch.searchNext(&withinAction);
@@ -905,6 +1323,10 @@ real AnalysisNeighborhoodSearch::minimumDistance(
         const AnalysisNeighborhoodPositions &positions) const
 {
     GMX_RELEASE_ASSERT(impl_, "Accessing an invalid search object");
+    if (impl_->usesCellSearch())
+    {
+        return sqrt(impl_->minimumDistance2Cells(positions));
+    }
     internal::AnalysisNeighborhoodPairSearchImpl pairSearch(*impl_);
     pairSearch.startSearch(positions);
     real          minDist2     = impl_->cutoffSquared();
@@ -914,6 +1336,22 @@ real AnalysisNeighborhoodSearch::minimumDistance(
     return sqrt(minDist2);
 }
 
+void AnalysisNeighborhoodSearch::findPositionsWithin(
+        const AnalysisNeighborhoodPositions &positions,
+        std::vector<int>                    *within) const
+{
+    GMX_RELEASE_ASSERT(impl_, "Accessing an invalid search object");
+    impl_->findPositionsWithin(positions, within);
+}
+
+void AnalysisNeighborhoodSearch::minimumDistances(
+        const AnalysisNeighborhoodPositions &positions,
+        real                                *dist) const
+{
+    GMX_RELEASE_ASSERT(impl_, "Accessing an invalid search object");
+    impl_->minimumDistances(positions, dist);
+}
+
 AnalysisNeighborhoodPair
 AnalysisNeighborhoodSearch::nearestPoint(
         const AnalysisNeighborhoodPositions &positions) const
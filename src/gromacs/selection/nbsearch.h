@@ -49,6 +49,8 @@
 #ifndef GMX_SELECTION_NBSEARCH_H
 #define GMX_SELECTION_NBSEARCH_H
 
+#include <vector>
+
 #include <boost/shared_ptr.hpp>
 
 #include "../legacyheaders/typedefs.h"
@@ -395,6 +397,35 @@ class AnalysisNeighborhoodSearch
          *     cutoff.
          */
         real minimumDistance(const AnalysisNeighborhoodPositions &positions) const;
+        /*! \brief
+         * Finds the test positions that are within the cutoff.
+         *
+         * \param[in]  positions  Set of test positions to use.
+         * \param[out] within     Indices of test positions that are within
+         *     the cutoff of any reference position, in increasing order.
+         * \throws     std::bad_alloc if out of memory.
+         *
+         * Equivalent to calling isWithin() separately for each test position,
+         * but a large set of test positions is divided over OpenMP threads.
+         * Individual indexed positions are not supported.
+         */
+        void findPositionsWithin(const AnalysisNeighborhoodPositions &positions,
+                                 std::vector<int>                    *within) const;
+        /*! \brief
+         * Calculates the minimum distance for each test position.
+         *
+         * \param[in]  positions  Set of test positions to use.
+         * \param[out] dist       Distance to the nearest reference position
+         *     for each test position, or the cutoff if there is none within
+         *     the cutoff.  Must have space for all test positions.
+         * \throws     std::bad_alloc if out of memory.
+         *
+         * Equivalent to calling minimumDistance() separately for each test
+         * position, but a large set of test positions is divided over OpenMP
+         * threads.  Individual indexed positions are not supported.
+         */
+        void minimumDistances(const AnalysisNeighborhoodPositions &positions,
+                              real                                *dist) const;
         /*! \brief
          * Finds the closest reference point.
          *
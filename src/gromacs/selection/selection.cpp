@@ -41,6 +41,12 @@
  */
 #include "selection.h"
 
+#include <cstring>
+
+#include <algorithm>
+
+#include "gromacs/legacyheaders/smalloc.h"
+
 #include "nbsearch.h"
 #include "position.h"
 #include "selelem.h"
@@ -103,6 +109,29 @@ SelectionData::SelectionData(SelectionTreeElement *elem,
 }
 
 
+SelectionData::SelectionData(const SelectionData &source)
+    : name_(source.name_), selectionText_(source.selectionText_),
+      posMass_(source.posMass_), posCharge_(source.posCharge_),
+      flags_(source.flags_), rootElement_(source.rootElement_),
+      coveredFractionType_(source.coveredFractionType_),
+      coveredFraction_(source.coveredFraction_),
+      averageCoveredFraction_(source.averageCoveredFraction_),
+      bDynamic_(source.bDynamic_),
+      bDynamicCoveredFraction_(source.bDynamicCoveredFraction_)
+{
+    gmx_ana_pos_t &src = const_cast<gmx_ana_pos_t &>(source.rawPositions_);
+    // Reserve for the maximum number of positions of dynamic selections.
+    gmx_ana_pos_reserve(&rawPositions_, src.nalloc_x, 0);
+    gmx_ana_pos_copy(&rawPositions_, &src, true);
+    if (rawPositions_.m.mapb.nalloc_a == 0)
+    {
+        // Shared with the source; copyFrameData() allocates a separate array.
+        rawPositions_.m.mapb.a = NULL;
+    }
+    copyFrameData(source);
+}
+
+
 SelectionData::~SelectionData()
 {
 }
@@ -225,6 +254,33 @@ SelectionData::computeAverageCoveredFraction(int nframes)
 }
 
 
+void
+SelectionData::copyFrameData(const SelectionData &source)
+{
+    gmx_ana_pos_t &src  = const_cast<gmx_ana_pos_t &>(source.rawPositions_);
+    gmx_ana_pos_t &dest = rawPositions_;
+    gmx_ana_pos_reserve(&dest, src.count(), 0);
+    const int      nra  = std::max(src.m.mapb.nra, 1);
+    if (dest.m.mapb.nalloc_a < nra)
+    {
+        srenew(dest.m.mapb.a, nra);
+        dest.m.mapb.nalloc_a = nra;
+    }
+    // gmx_ana_pos_copy() makes the atoms point to those of the source if the
+    // source does not own them, but those change in the next evaluation.
+    int           *atoms = dest.m.mapb.a;
+    gmx_ana_pos_copy(&dest, &src, false);
+    if (dest.m.mapb.a != atoms)
+    {
+        dest.m.mapb.a = atoms;
+        std::memcpy(atoms, src.m.mapb.a, src.m.mapb.nra*sizeof(*atoms));
+    }
+    posMass_         = source.posMass_;
+    posCharge_       = source.posCharge_;
+    coveredFraction_ = source.coveredFraction_;
+}
+
+
 void
 SelectionData::restoreOriginalPositions(const t_topology *top)
 {
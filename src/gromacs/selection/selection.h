@@ -95,6 +95,17 @@ class SelectionData
          * \throws    std::bad_alloc if out of memory.
          */
         SelectionData(SelectionTreeElement *elem, const char *selstr);
+        /*! \brief
+         * Creates a copy of a selection for use in another thread.
+         *
+         * \param[in] source  Selection to copy.
+         * \throws    std::bad_alloc if out of memory.
+         *
+         * The copy shares the evaluation tree with \p source, but is not
+         * updated when the selection is evaluated; copyFrameData() needs to
+         * be called to update it.
+         */
+        explicit SelectionData(const SelectionData &source);
         ~SelectionData();
 
         //! Returns the name for this selection.
@@ -184,6 +195,17 @@ class SelectionData
          * Called by SelectionEvaluator::evaluateFinal().
          */
         void restoreOriginalPositions(const t_topology *top);
+        /*! \brief
+         * Copies the evaluated positions for the current frame.
+         *
+         * \param[in] source  Selection this object is a copy of.
+         * \throws    std::bad_alloc if out of memory.
+         *
+         * After the call, this object is not affected by evaluating
+         * \p source for another frame.
+         * Called by SelectionFrameCopy.
+         */
+        void copyFrameData(const SelectionData &source);
 
     private:
         //! Name of the selection.
@@ -219,7 +241,7 @@ class SelectionData
          */
         friend class gmx::SelectionPosition;
 
-        GMX_DISALLOW_COPY_AND_ASSIGN(SelectionData);
+        GMX_DISALLOW_ASSIGN(SelectionData);
 };
 
 }   // namespace internal
@@ -523,6 +545,10 @@ class Selection
          * Needed to access the data to adjust flags.
          */
         friend class SelectionOptionStorage;
+        /*! \brief
+         * Needed to map selections to their thread-local copies.
+         */
+        friend class SelectionFrameCopy;
 };
 
 /*! \brief
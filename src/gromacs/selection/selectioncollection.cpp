@@ -676,4 +676,73 @@ SelectionCollection::createDefaultHelpTopic()
     return createSelectionHelpTopic();
 }
 
+/********************************************************************
+ * SelectionFrameCopy
+ */
+
+/*! \internal \brief
+ * Private implementation class for SelectionFrameCopy.
+ *
+ * \ingroup module_selection
+ */
+class SelectionFrameCopy::Impl
+{
+    public:
+        //! Creates the copies of the selections in \p selections.
+        explicit Impl(const SelectionCollection &selections);
+
+        //! Selections in the collection, in the same order as \a copies_.
+        const SelectionDataList &sources_;
+        //! Copies of the selections.
+        SelectionDataList        copies_;
+};
+
+SelectionFrameCopy::Impl::Impl(const SelectionCollection &selections)
+    : sources_(selections.impl_->sc_.sel)
+{
+    copies_.reserve(sources_.size());
+    for (size_t i = 0; i < sources_.size(); ++i)
+    {
+        SelectionDataPointer copy(new internal::SelectionData(*sources_[i]));
+        copies_.push_back(move(copy));
+    }
+}
+
+
+SelectionFrameCopy::SelectionFrameCopy(const SelectionCollection &selections)
+    : impl_(new Impl(selections))
+{
+}
+
+
+SelectionFrameCopy::~SelectionFrameCopy()
+{
+}
+
+
+void
+SelectionFrameCopy::copyFrame()
+{
+    for (size_t i = 0; i < impl_->copies_.size(); ++i)
+    {
+        impl_->copies_[i]->copyFrameData(*impl_->sources_[i]);
+    }
+}
+
+
+Selection
+SelectionFrameCopy::selection(const Selection &selection) const
+{
+    for (size_t i = 0; i < impl_->sources_.size(); ++i)
+    {
+        if (impl_->sources_[i].get() == selection.sel_)
+        {
+            return Selection(impl_->copies_[i].get());
+        }
+    }
+    GMX_RELEASE_ASSERT(selection.sel_ == NULL,
+                       "Selection is not from the copied collection");
+    return selection;
+}
+
 } // namespace gmx
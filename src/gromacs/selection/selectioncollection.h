@@ -60,6 +60,7 @@ namespace gmx
 class Options;
 class SelectionCompiler;
 class SelectionEvaluator;
+class SelectionFrameCopy;
 
 /*! \brief
  * Collection of selections.
@@ -367,6 +368,60 @@ class SelectionCollection
          * Needed for the evaluator to freely modify the collection.
          */
         friend class SelectionEvaluator;
+        /*! \brief
+         * Needed to copy the selections in the collection.
+         */
+        friend class SelectionFrameCopy;
+};
+
+/*! \brief
+ * Copies of evaluated selections for analyzing frames in parallel.
+ *
+ * An object of this class keeps a copy of each selection in a
+ * SelectionCollection.  After SelectionCollection::evaluate(), copyFrame()
+ * updates the copies with the evaluated positions.  The copies are then not
+ * affected when the collection is evaluated for the next frame, so that
+ * one thread can use them while another thread evaluates the collection.
+ *
+ * \inpublicapi
+ * \ingroup module_selection
+ */
+class SelectionFrameCopy
+{
+    public:
+        /*! \brief
+         * Creates copies of all selections in a collection.
+         *
+         * \param[in] selections  Compiled selection collection.
+         * \throws    std::bad_alloc if out of memory.
+         *
+         * \p selections must remain valid for the lifetime of this object.
+         */
+        explicit SelectionFrameCopy(const SelectionCollection &selections);
+        ~SelectionFrameCopy();
+
+        /*! \brief
+         * Copies the positions of the current frame from the collection.
+         *
+         * \throws    std::bad_alloc if out of memory.
+         */
+        void copyFrame();
+        /*! \brief
+         * Returns the copy of a selection.
+         *
+         * \param[in] selection  Selection from the collection.
+         * \returns   Selection that accesses the copied data.
+         *
+         * Returns \p selection unchanged if it is not initialized.
+         *
+         * Does not throw.
+         */
+        Selection selection(const Selection &selection) const;
+
+    private:
+        class Impl;
+
+        PrivateImplPointer<Impl> impl_;
 };
 
 } // namespace gmx
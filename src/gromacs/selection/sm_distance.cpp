@@ -42,8 +42,14 @@
  * \author Teemu Murtola <teemu.murtola@gmail.com>
  * \ingroup module_selection
  */
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
 #include "gromacs/legacyheaders/macros.h"
 #include "gromacs/legacyheaders/pbc.h"
+#include "gromacs/legacyheaders/smalloc.h"
 #include "gromacs/legacyheaders/vec.h"
 
 #include "gromacs/selection/nbsearch.h"
@@ -61,8 +67,19 @@
  */
 struct t_methoddata_distance
 {
-    t_methoddata_distance() : cutoff(-1.0)
+    t_methoddata_distance()
+        : cutoff(-1.0), skin(0.0), bCache(false), cacheEPBC(-1),
+          cacheNRef(0), cacheXRef(NULL), cacheRefId(NULL), cacheRefNalloc(0),
+          cacheNTest(0), cacheXTest(NULL), cacheDist(NULL)
+    {
+        clear_mat(cacheBox);
+    }
+    ~t_methoddata_distance()
     {
+        sfree(cacheXRef);
+        sfree(cacheRefId);
+        sfree(cacheXTest);
+        sfree(cacheDist);
     }
 
     /** Cutoff distance. */
@@ -73,6 +90,47 @@ struct t_methoddata_distance
     gmx::AnalysisNeighborhood        nb;
     /** Neighborhood search for an invididual frame. */
     gmx::AnalysisNeighborhoodSearch  nbsearch;
+    /** Indices of positions found by \p within (reused between frames). */
+    std::vector<int>                 within;
+    /** Distances computed by \p distance (reused between frames). */
+    std::vector<real>                dist;
+
+    /*! \brief
+     * Skin for incremental evaluation of \p within (0 if not used).
+     *
+     * If set, the distances from the reference positions are computed up to
+     * \c cutoff+skin and cached.  In subsequent frames, only positions whose
+     * cached distance is close to the cutoff are searched again, as long as
+     * the positions have in total moved less than the skin.
+     */
+    real                             skin;
+    /** Neighborhood search data with the cutoff extended by \p skin. */
+    gmx::AnalysisNeighborhood        nbskin;
+    /** Whether the cached data below is valid. */
+    bool                             bCache;
+    /** PBC type for the cached data (-1 if no PBC). */
+    int                              cacheEPBC;
+    /** Box for the cached data. */
+    matrix                           cacheBox;
+    /** Number of reference positions in the cache. */
+    int                              cacheNRef;
+    /** Reference positions in the cache. */
+    rvec                            *cacheXRef;
+    /** Reference IDs of the reference positions in the cache. */
+    int                             *cacheRefId;
+    /** Number of elements allocated for \p cacheXRef and \p cacheRefId. */
+    int                              cacheRefNalloc;
+    /** Number of test positions (blocks in the original group) in the cache. */
+    int                              cacheNTest;
+    /** Cached test positions, indexed by the reference ID of the position. */
+    rvec                            *cacheXTest;
+    /*! \brief
+     * Cached distances, indexed by the reference ID of the test position.
+     *
+     * The distances are limited to \c cutoff+skin, and -1 marks positions
+     * that are not in the cache.
+     */
+    real                            *cacheDist;
 };
 
 /*! \brief
@@ -131,7 +189,7 @@ evaluate_distance(t_topology * /* top */, t_trxframe * /* fr */, t_pbc * /* pbc
                   gmx_ana_pos_t *pos, gmx_ana_selvalue_t *out, void *data);
 /** Evaluates the \p within selection method. */
 static void
-evaluate_within(t_topology * /* top */, t_trxframe * /* fr */, t_pbc * /* pbc */,
+evaluate_within(t_topology * /* top */, t_trxframe * /* fr */, t_pbc *pbc,
                 gmx_ana_pos_t *pos, gmx_ana_selvalue_t *out, void *data);
 
 /** Parameters for the \p distance selection method. */
@@ -237,6 +295,16 @@ init_common(t_topology * /* top */, int /* npar */, gmx_ana_selparam_t *param, v
         GMX_THROW(gmx::InvalidInputError("Distance cutoff should be > 0"));
     }
     d->nb.setCutoff(d->cutoff);
+
+    const char *env = getenv("GMX_SELECTION_SKIN");
+    if (env != NULL && d->cutoff > 0)
+    {
+        d->skin = strtod(env, NULL);
+        if (d->skin > 0)
+        {
+            d->nbskin.setCutoff(d->cutoff + d->skin);
+        }
+    }
 }
 
 /*!
@@ -275,12 +343,192 @@ evaluate_distance(t_topology * /* top */, t_trxframe * /* fr */, t_pbc * /* pbc
     t_methoddata_distance *d = (t_methoddata_distance *)data;
 
     out->nr = pos->m.mapb.nra;
+    d->dist.resize(pos->count());
+    if (pos->count() > 0)
+    {
+        gmx::AnalysisNeighborhoodPositions testPos(pos->x, pos->count());
+        d->nbsearch.minimumDistances(testPos, &d->dist[0]);
+    }
     for (int b = 0; b < pos->count(); ++b)
     {
-        real dist = d->nbsearch.minimumDistance(pos->x[b]);
         for (int i = pos->m.mapb.index[b]; i < pos->m.mapb.index[b+1]; ++i)
         {
-            out->u.r[i] = dist;
+            out->u.r[i] = d->dist[b];
+        }
+    }
+}
+
+/*! \brief
+ * Checks whether the cached \p within distances can be used.
+ *
+ * \param[in] d    Method data.
+ * \param[in] pbc  PBC structure for the current frame.
+ * \param[in] pos  Positions for which the method is evaluated.
+ * \returns   The maximum change in the distances since the cache was built
+ *     (an upper bound), or -1 if the cache cannot be used.
+ */
+static real
+within_cache_displacement(t_methoddata_distance *d, t_pbc *pbc, gmx_ana_pos_t *pos)
+{
+    if (!d->bCache)
+    {
+        return -1;
+    }
+    // The images of the positions change with the box.
+    if ((pbc == NULL ? -1 : pbc->ePBC) != d->cacheEPBC)
+    {
+        return -1;
+    }
+    if (pbc != NULL)
+    {
+        for (int i = 0; i < DIM; ++i)
+        {
+            for (int j = 0; j < DIM; ++j)
+            {
+                if (pbc->box[i][j] != d->cacheBox[i][j])
+                {
+                    return -1;
+                }
+            }
+        }
+    }
+    if (d->p.count() != d->cacheNRef || pos->m.b.nr != d->cacheNTest)
+    {
+        return -1;
+    }
+    real maxdx2 = 0;
+    for (int i = 0; i < d->cacheNRef; ++i)
+    {
+        if (d->p.m.refid[i] != d->cacheRefId[i])
+        {
+            return -1;
+        }
+        maxdx2 = std::max(maxdx2, distance2(d->p.x[i], d->cacheXRef[i]));
+    }
+    const real refdisp = sqrt(maxdx2);
+    if (refdisp >= d->skin)
+    {
+        return -1;
+    }
+    maxdx2 = 0;
+    for (int b = 0; b < pos->count(); ++b)
+    {
+        const int id = pos->m.refid[b];
+        if (id >= 0)
+        {
+            if (d->cacheDist[id] < 0)
+            {
+                return -1;
+            }
+            maxdx2 = std::max(maxdx2, distance2(pos->x[b], d->cacheXTest[id]));
+        }
+    }
+    const real disp = refdisp + sqrt(maxdx2);
+    return (disp < d->skin ? disp : -1);
+}
+
+/*! \brief
+ * Recomputes the cached \p within distances for the current frame.
+ *
+ * \param[in,out] d    Method data.
+ * \param[in]     pbc  PBC structure for the current frame.
+ * \param[in]     pos  Positions for which the method is evaluated.
+ */
+static void
+update_within_cache(t_methoddata_distance *d, t_pbc *pbc, gmx_ana_pos_t *pos)
+{
+    d->bCache = false;
+    d->dist.resize(pos->count());
+    if (pos->count() > 0)
+    {
+        gmx::AnalysisNeighborhoodPositions refPos(d->p.x, d->p.count());
+        gmx::AnalysisNeighborhoodSearch    search = d->nbskin.initSearch(pbc, refPos);
+        gmx::AnalysisNeighborhoodPositions testPos(pos->x, pos->count());
+        search.minimumDistances(testPos, &d->dist[0]);
+    }
+
+    if (d->cacheNTest != pos->m.b.nr)
+    {
+        d->cacheNTest = pos->m.b.nr;
+        srenew(d->cacheXTest, d->cacheNTest);
+        srenew(d->cacheDist, d->cacheNTest);
+    }
+    for (int i = 0; i < d->cacheNTest; ++i)
+    {
+        d->cacheDist[i] = -1;
+    }
+    for (int b = 0; b < pos->count(); ++b)
+    {
+        const int id = pos->m.refid[b];
+        if (id >= 0)
+        {
+            copy_rvec(pos->x[b], d->cacheXTest[id]);
+            d->cacheDist[id] = d->dist[b];
+        }
+    }
+
+    d->cacheNRef = d->p.count();
+    if (d->cacheRefNalloc < d->cacheNRef)
+    {
+        d->cacheRefNalloc = d->cacheNRef;
+        srenew(d->cacheXRef, d->cacheRefNalloc);
+        srenew(d->cacheRefId, d->cacheRefNalloc);
+    }
+    for (int i = 0; i < d->cacheNRef; ++i)
+    {
+        copy_rvec(d->p.x[i], d->cacheXRef[i]);
+        d->cacheRefId[i] = d->p.m.refid[i];
+    }
+    d->cacheEPBC = (pbc == NULL ? -1 : pbc->ePBC);
+    if (pbc != NULL)
+    {
+        copy_mat(pbc->box, d->cacheBox);
+    }
+    d->bCache = true;
+}
+
+/*! \brief
+ * Evaluates the \p within selection method using cached distances.
+ *
+ * \param[in,out] d    Method data.
+ * \param[in]     pbc  PBC structure for the current frame.
+ * \param[in]     pos  Positions for which the method is evaluated.
+ * \param[out]    out  Output group.
+ *
+ * If the positions have moved too much since the cache was built, the cache
+ * is rebuilt first.  The result is the same as without the cache.
+ */
+static void
+evaluate_within_cached(t_methoddata_distance *d, t_pbc *pbc,
+                       gmx_ana_pos_t *pos, gmx_ana_selvalue_t *out)
+{
+    real disp = within_cache_displacement(d, pbc, pos);
+    if (disp < 0)
+    {
+        update_within_cache(d, pbc, pos);
+        disp = 0;
+    }
+    // Margin for rounding differences between the searches.
+    const real margin = disp + 10*GMX_REAL_EPS*(d->cutoff + d->skin);
+    for (int b = 0; b < pos->count(); ++b)
+    {
+        const int id = pos->m.refid[b];
+        bool      bWithin;
+        if (id >= 0 && d->cacheDist[id] + margin <= d->cutoff)
+        {
+            bWithin = true;
+        }
+        else if (id >= 0 && d->cacheDist[id] - margin > d->cutoff)
+        {
+            bWithin = false;
+        }
+        else
+        {
+            bWithin = d->nbsearch.isWithin(pos->x[b]);
+        }
+        if (bWithin)
+        {
+            gmx_ana_pos_add_to_group(out->u.g, pos, b);
         }
     }
 }
@@ -293,17 +541,21 @@ evaluate_distance(t_topology * /* top */, t_trxframe * /* fr */, t_pbc * /* pbc
  * \c t_methoddata_distance::xref and puts them in \p out.g.
  */
 static void
-evaluate_within(t_topology * /* top */, t_trxframe * /* fr */, t_pbc * /* pbc */,
+evaluate_within(t_topology * /* top */, t_trxframe * /* fr */, t_pbc *pbc,
                 gmx_ana_pos_t *pos, gmx_ana_selvalue_t *out, void *data)
 {
     t_methoddata_distance *d = (t_methoddata_distance *)data;
 
     out->u.g->isize = 0;
-    for (int b = 0; b < pos->count(); ++b)
+    if (d->skin > 0)
     {
-        if (d->nbsearch.isWithin(pos->x[b]))
-        {
-            gmx_ana_pos_add_to_group(out->u.g, pos, b);
-        }
+        evaluate_within_cached(d, pbc, pos, out);
+        return;
+    }
+    gmx::AnalysisNeighborhoodPositions testPos(pos->x, pos->count());
+    d->nbsearch.findPositionsWithin(testPos, &d->within);
+    for (size_t i = 0; i < d->within.size(); ++i)
+    {
+        gmx_ana_pos_add_to_group(out->u.g, pos, d->within[i]);
     }
 }
@@ -244,6 +244,9 @@ class NeighborhoodSearchTest : public ::testing::Test
                               const NeighborhoodSearchTestData &data);
         void testPairSearch(gmx::AnalysisNeighborhoodSearch  *search,
                             const NeighborhoodSearchTestData &data);
+        void testBatchedSearch(gmx::AnalysisNeighborhoodSearch  *search,
+                               const NeighborhoodSearchTestData &data,
+                               real                              tolerance);
 
         gmx::AnalysisNeighborhood        nb_;
 };
@@ -321,6 +324,34 @@ void NeighborhoodSearchTest::testPairSearch(
     }
 }
 
+void NeighborhoodSearchTest::testBatchedSearch(
+        gmx::AnalysisNeighborhoodSearch  *search,
+        const NeighborhoodSearchTestData &data,
+        real                              tolerance)
+{
+    const int         count = static_cast<int>(data.testPositions_.size());
+    std::vector<int>  within;
+    std::vector<real> dist(count);
+    search->findPositionsWithin(data.testPositions(), &within);
+    search->minimumDistances(data.testPositions(), &dist[0]);
+
+    std::vector<int>::const_iterator w = within.begin();
+    for (int i = 0; i < count; ++i)
+    {
+        const NeighborhoodSearchTestData::TestPosition &pos
+            = data.testPositions_[i];
+        const bool bWithin = (w != within.end() && *w == i);
+        if (bWithin)
+        {
+            ++w;
+        }
+        EXPECT_EQ(pos.refMinDist <= data.cutoff_, bWithin)
+        << "Distance is " << pos.refMinDist;
+        EXPECT_NEAR_REL(pos.refMinDist, dist[i], tolerance);
+    }
+    EXPECT_TRUE(w == within.end()) << "Position indices are not in order.";
+}
+
 /********************************************************************
  * Test data generation
  */
@@ -375,6 +406,31 @@ class RandomBoxFullPBCData
         NeighborhoodSearchTestData data_;
 };
 
+class RandomBoxManyTestPositionsData
+{
+    public:
+        static const NeighborhoodSearchTestData &get()
+        {
+            static RandomBoxManyTestPositionsData singleton;
+            return singleton.data_;
+        }
+
+        RandomBoxManyTestPositionsData() : data_(12345, 1.0)
+        {
+            data_.box_[XX][XX] = 10.0;
+            data_.box_[YY][YY] = 5.0;
+            data_.box_[ZZ][ZZ] = 7.0;
+            // Enough test positions for the batched searches to use threads.
+            data_.generateRandomRefPositions(1000);
+            data_.generateRandomTestPositions(5000);
+            set_pbc(&data_.pbc_, epbcXYZ, data_.box_);
+            data_.computeReferences(&data_.pbc_);
+        }
+
+    private:
+        NeighborhoodSearchTestData data_;
+};
+
 class RandomTriclinicFullPBCData
 {
     public:
@@ -448,6 +504,7 @@ TEST_F(NeighborhoodSearchTest, SimpleSearch)
     testMinimumDistance(&search, data);
     testNearestPoint(&search, data);
     testPairSearch(&search, data);
+    testBatchedSearch(&search, data, 20*GMX_REAL_EPS);
 }
 
 TEST_F(NeighborhoodSearchTest, GridSearchBox)
@@ -464,6 +521,20 @@ TEST_F(NeighborhoodSearchTest, GridSearchBox)
     testMinimumDistance(&search, data);
     testNearestPoint(&search, data);
     testPairSearch(&search, data);
+    testBatchedSearch(&search, data, 20*GMX_REAL_EPS);
+}
+
+TEST_F(NeighborhoodSearchTest, GridSearchBoxBatched)
+{
+    const NeighborhoodSearchTestData &data = RandomBoxManyTestPositionsData::get();
+
+    nb_.setCutoff(data.cutoff_);
+    nb_.setMode(gmx::AnalysisNeighborhood::eSearchMode_Grid);
+    gmx::AnalysisNeighborhoodSearch search =
+        nb_.initSearch(&data.pbc_, data.refPositions());
+    ASSERT_EQ(gmx::AnalysisNeighborhood::eSearchMode_Grid, search.mode());
+
+    testBatchedSearch(&search, data, 20*GMX_REAL_EPS);
 }
 
 TEST_F(NeighborhoodSearchTest, GridSearchTriclinic)
@@ -477,6 +548,8 @@ TEST_F(NeighborhoodSearchTest, GridSearchTriclinic)
     ASSERT_EQ(gmx::AnalysisNeighborhood::eSearchMode_Grid, search.mode());
 
     testPairSearch(&search, data);
+    // Putting the positions into the triclinic unit cell loses some precision.
+    testBatchedSearch(&search, data, 100*GMX_REAL_EPS);
 }
 
 TEST_F(NeighborhoodSearchTest, GridSearch2DPBC)
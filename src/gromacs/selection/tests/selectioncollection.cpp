@@ -39,6 +39,11 @@
  * \author Teemu Murtola <teemu.murtola@gmail.com>
  * \ingroup module_selection
  */
+#include <cmath>
+#include <cstdlib>
+
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include "gromacs/options/basicoptions.h"
@@ -564,6 +569,99 @@ TEST_F(SelectionCollectionTest, RecoversFromInvalidPermutation3)
     EXPECT_THROW_GMX(sc_.evaluate(frame_, NULL), gmx::InconsistentInputError);
 }
 
+TEST_F(SelectionCollectionTest, WithinSkinMatchesNoSkinOverFrames)
+{
+    const char *const        selectionText = "within 1 of resnr 2";
+    gmx::SelectionCollection skinsc;
+    gmx::SelectionList       skinsel;
+
+    skinsc.setReferencePosType("atom");
+    skinsc.setOutputPosType("atom");
+    ASSERT_NO_FATAL_FAILURE(loadTopology("simple.gro"));
+    ASSERT_NO_THROW_GMX(skinsc.setTopology(top_, -1));
+    ASSERT_NO_THROW_GMX(sel_ = sc_.parseFromString(selectionText));
+    ASSERT_NO_THROW_GMX(skinsel = skinsc.parseFromString(selectionText));
+    ASSERT_NO_THROW_GMX(sc_.compile());
+    // The skin is read when the selection is compiled.
+    setenv("GMX_SELECTION_SKIN", "0.5", 1);
+    EXPECT_NO_THROW_GMX(skinsc.compile());
+    unsetenv("GMX_SELECTION_SKIN");
+
+    const int         natoms = frame_->natoms;
+    std::vector<real> x0(frame_->x[0], frame_->x[0] + DIM*natoms);
+    for (int f = 0; f < 25; ++f)
+    {
+        SCOPED_TRACE(gmx::formatString("Frame %d", f));
+        // All atoms jiggle, which moves those at exactly the cutoff across
+        // it, but the cache is only rebuilt when the moves add up to the skin.
+        for (int i = 0; i < natoms; ++i)
+        {
+            for (int d = 0; d < DIM; ++d)
+            {
+                frame_->x[i][d] = x0[i*DIM + d] + 0.02*std::sin(f + 3*i + d);
+            }
+        }
+        // Atom 1 starts beyond cutoff+skin from atom 5 in resnr 2 at (2,1,0),
+        // moves through it and out the other side, crossing the skin
+        // boundary and the cutoff in both directions.
+        frame_->x[0][XX] = x0[XX] - 0.6 + 0.15*f;
+        ASSERT_NO_THROW_GMX(sc_.evaluate(frame_, NULL));
+        ASSERT_NO_THROW_GMX(skinsc.evaluate(frame_, NULL));
+        gmx::ConstArrayRef<int> atoms     = sel_[0].atomIndices();
+        gmx::ConstArrayRef<int> skinAtoms = skinsel[0].atomIndices();
+        EXPECT_EQ(std::vector<int>(atoms.begin(), atoms.end()),
+                  std::vector<int>(skinAtoms.begin(), skinAtoms.end()));
+    }
+}
+
+//! Returns the atoms and position coordinates of a selection.
+std::vector<real> getSelectionValues(const gmx::Selection &sel)
+{
+    std::vector<real>       values;
+    gmx::ConstArrayRef<int> atoms = sel.atomIndices();
+    values.insert(values.end(), atoms.begin(), atoms.end());
+    for (int i = 0; i < sel.posCount(); ++i)
+    {
+        const rvec &x = sel.position(i).x();
+        values.insert(values.end(), x, x + DIM);
+    }
+    return values;
+}
+
+TEST_F(SelectionCollectionTest, FrameCopyIsNotChangedByEvaluation)
+{
+    ASSERT_NO_FATAL_FAILURE(loadTopology("simple.gro"));
+    ASSERT_NO_THROW_GMX(sel_ = sc_.parseFromString(
+                                    "within 1 of resnr 2; res_cog of x < 2"));
+    ASSERT_NO_THROW_GMX(sc_.compile());
+    ASSERT_NO_THROW_GMX(sc_.evaluate(frame_, NULL));
+
+    gmx::SelectionFrameCopy copy(sc_);
+    ASSERT_NO_THROW_GMX(copy.copyFrame());
+    std::vector<std::vector<real> > values;
+    for (size_t g = 0; g < sel_.size(); ++g)
+    {
+        values.push_back(getSelectionValues(sel_[g]));
+        EXPECT_EQ(values[g], getSelectionValues(copy.selection(sel_[g])));
+    }
+
+    // Moving the first atom changes both selections.
+    frame_->x[0][XX] += 5.0;
+    ASSERT_NO_THROW_GMX(sc_.evaluate(frame_, NULL));
+    for (size_t g = 0; g < sel_.size(); ++g)
+    {
+        EXPECT_NE(values[g], getSelectionValues(sel_[g]));
+        EXPECT_EQ(values[g], getSelectionValues(copy.selection(sel_[g])));
+    }
+
+    ASSERT_NO_THROW_GMX(copy.copyFrame());
+    for (size_t g = 0; g < sel_.size(); ++g)
+    {
+        EXPECT_EQ(getSelectionValues(sel_[g]),
+                  getSelectionValues(copy.selection(sel_[g])));
+    }
+}
+
 // TODO: Tests for evaluation errors
 
 
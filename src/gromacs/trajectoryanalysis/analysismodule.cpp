@@ -45,6 +45,7 @@
 
 #include "gromacs/analysisdata/analysisdata.h"
 #include "gromacs/selection/selection.h"
+#include "gromacs/selection/selectioncollection.h"
 #include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/gmxassert.h"
 
@@ -115,6 +116,12 @@ class TrajectoryAnalysisModuleData::Impl
         HandleContainer            handles_;
         //! Stores thread-local selections.
         const SelectionCollection &selections_;
+        /*! \brief
+         * Copies of the selections for the frame being analyzed.
+         *
+         * NULL until copySelections() is called.
+         */
+        gmx_unique_ptr<SelectionFrameCopy>::type selectionCopy_;
 };
 
 TrajectoryAnalysisModuleData::Impl::Impl(
@@ -174,8 +181,11 @@ TrajectoryAnalysisModuleData::dataHandle(const AnalysisData &data)
 
 Selection TrajectoryAnalysisModuleData::parallelSelection(const Selection &selection)
 {
-    // TODO: Implement properly.
-    return selection;
+    if (!impl_->selectionCopy_)
+    {
+        return selection;
+    }
+    return impl_->selectionCopy_->selection(selection);
 }
 
 
@@ -194,6 +204,16 @@ TrajectoryAnalysisModuleData::parallelSelections(const SelectionList &selections
 }
 
 
+void TrajectoryAnalysisModuleData::copySelections()
+{
+    if (!impl_->selectionCopy_)
+    {
+        impl_->selectionCopy_.reset(new SelectionFrameCopy(impl_->selections_));
+    }
+    impl_->selectionCopy_->copyFrame();
+}
+
+
 /********************************************************************
  * TrajectoryAnalysisModuleDataBasic
  */
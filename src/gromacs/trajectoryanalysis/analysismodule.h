@@ -136,6 +136,18 @@ class TrajectoryAnalysisModuleData
          * \see parallelSelection()
          */
         SelectionList parallelSelections(const SelectionList &selections);
+        /*! \brief
+         * Makes copies of the selections for the frame to be analyzed.
+         *
+         * \throws std::bad_alloc if out of memory.
+         *
+         * Called by the runner after the selections have been evaluated for
+         * a frame that is analyzed in a separate thread.  After the first
+         * call, parallelSelection() returns selections that only change in
+         * later calls to this method, not when the selection collection is
+         * evaluated for other frames.
+         */
+        void copySelections();
 
     protected:
         /*! \brief
@@ -339,6 +351,9 @@ class TrajectoryAnalysisModule
          * data structure.
          * Any access to data structures not stored in \p pdata should be
          * designed to be thread-safe.
+         * Frames are only analyzed in parallel if the module has set
+         * TrajectoryAnalysisSettings::efAllowParallelFrames, and the first
+         * frame is always analyzed before any other frame is started.
          */
         virtual void analyzeFrame(int frnr, const t_trxframe &fr, t_pbc *pbc,
                                   TrajectoryAnalysisModuleData *pdata) = 0;
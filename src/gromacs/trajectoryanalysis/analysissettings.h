@@ -114,6 +114,17 @@ class TrajectoryAnalysisSettings
              * \see setRmPBC()
              */
             efNoUserRmPBC    = 1<<5,
+            /*! \brief
+             * Allows analyzing frames in parallel.
+             *
+             * If this flag is specified, the user can set the number of
+             * threads that call TrajectoryAnalysisModule::analyzeFrame()
+             * concurrently for different frames.
+             * The flag can be cleared in
+             * TrajectoryAnalysisModule::optionsFinished() if the analysis
+             * is not thread-safe with the options the user has selected.
+             */
+            efAllowParallelFrames = 1<<6,
         };
 
         //! Initializes default settings.
@@ -45,9 +45,15 @@
 #include "config.h"
 #endif
 
+#include <cstring>
+
+#include <vector>
+
 #include "gromacs/legacyheaders/pbc.h"
 #include "gromacs/legacyheaders/rmpbc.h"
+#include "gromacs/legacyheaders/smalloc.h"
 #include "gromacs/legacyheaders/statutil.h"
+#include "gromacs/legacyheaders/thread_mpi/threads.h"
 
 #include "gromacs/analysisdata/paralleloptions.h"
 #include "gromacs/commandline/cmdlinehelpcontext.h"
@@ -65,10 +71,335 @@
 #include "gromacs/utility/file.h"
 #include "gromacs/utility/gmxassert.h"
 #include "gromacs/utility/programinfo.h"
+#include "gromacs/utility/uniqueptr.h"
 
 namespace gmx
 {
 
+namespace
+{
+
+/********************************************************************
+ * ParallelFrameAnalyzer
+ */
+
+/*! \internal \brief
+ * Analyzes frames in multiple threads.
+ *
+ * Each thread calls TrajectoryAnalysisModule::analyzeFrame() with its own
+ * TrajectoryAnalysisModuleData, and with its own copies of the frame, the
+ * PBC information and the selections.  The caller reads and evaluates the
+ * frames in order and passes them to analyzeFrame(), which hands them to an
+ * idle thread.  The analysis data objects finish the frames in order.
+ *
+ * \ingroup module_trajectoryanalysis
+ */
+class ParallelFrameAnalyzer
+{
+    public:
+        /*! \brief
+         * Starts the analysis threads.
+         *
+         * \param     module     Analysis module to call.
+         * \param[in] selections Evaluated selection collection.
+         * \param[in] nthreads   Number of threads.
+         */
+        ParallelFrameAnalyzer(TrajectoryAnalysisModule  *module,
+                              const SelectionCollection &selections,
+                              int                        nthreads);
+        //! Stops the threads without finishing the analysis data.
+        ~ParallelFrameAnalyzer();
+
+        /*! \brief
+         * Starts analyzing a frame in an idle thread.
+         *
+         * \param[in] frnr  Zero-based frame index.
+         * \param[in] fr    Frame, copied before returning.
+         * \param[in] pbc   PBC information, or NULL.
+         *
+         * Waits for an idle thread, and for a frame that is not too far
+         * behind \p frnr to finish, as the analysis data objects can only
+         * store \c 2*nthreads-1 frames pending.  The first frame is
+         * analyzed completely before returning.
+         */
+        void analyzeFrame(int frnr, const t_trxframe &fr, const t_pbc *pbc);
+        /*! \brief
+         * Waits for all frames, stops the threads and finishes the data.
+         *
+         * Calls TrajectoryAnalysisModule::finishFrames() and
+         * TrajectoryAnalysisModuleData::finish() for each thread.
+         */
+        void finish();
+
+    private:
+        //! Thread-local data for one analysis thread.
+        struct Worker
+        {
+            Worker();
+            ~Worker();
+
+            //! Copies \p src into the frame buffers of this thread.
+            void setFrame(const t_trxframe &src, const t_pbc *pbcSrc);
+
+            //! The analyzer this thread belongs to.
+            ParallelFrameAnalyzer              *parent;
+            //! Thread-local data for the analysis module.
+            TrajectoryAnalysisModuleDataPointer pdata;
+            //! Copy of the frame to analyze.
+            t_trxframe                          fr;
+            //! Copy of the PBC information.
+            t_pbc                               pbc;
+            //! Whether PBC are used for the frame.
+            bool                                bPBC;
+            //! Allocated buffers for the coordinates, velocities and forces.
+            rvec                               *x, *v, *f;
+            //! Number of atoms allocated for each of \a x, \a v and \a f.
+            int                                 nalloc_x, nalloc_v, nalloc_f;
+            //! Index of the frame being analyzed, -1 if idle.
+            int                                 frnr;
+            //! Whether the thread has been started.
+            bool                                bStarted;
+            tMPI_Thread_t                       thread;
+
+            GMX_DISALLOW_COPY_AND_ASSIGN(Worker);
+        };
+        //! Smart pointer to manage a Worker object.
+        typedef gmx_unique_ptr<Worker>::type WorkerPointer;
+
+        //! Returns the number of threads that are analyzing a frame.
+        int busyCount() const;
+        //! Stops and joins all threads.
+        void stopThreads();
+        //! Thread function for the analysis threads.
+        static void *workerThread(void *arg);
+
+        TrajectoryAnalysisModule   *module_;
+        std::vector<WorkerPointer>  workers_;
+        //! Whether the threads should exit, protected by \p mutex_.
+        bool                        bStop_;
+        tMPI_Thread_mutex_t         mutex_;
+        //! Signals both new frames and finished frames.
+        tMPI_Thread_cond_t          cond_;
+
+        GMX_DISALLOW_COPY_AND_ASSIGN(ParallelFrameAnalyzer);
+};
+
+ParallelFrameAnalyzer::Worker::Worker()
+    : parent(NULL), bPBC(false), x(NULL), v(NULL), f(NULL),
+      nalloc_x(0), nalloc_v(0), nalloc_f(0), frnr(-1), bStarted(false)
+{
+}
+
+ParallelFrameAnalyzer::Worker::~Worker()
+{
+    sfree(x);
+    sfree(v);
+    sfree(f);
+}
+
+//! Copies \p n vectors from \p src into \p *buf, or sets it NULL if \p src is NULL.
+rvec *
+copyFrameVectors(rvec **buf, int *nalloc, const rvec *src, int n)
+{
+    if (src == NULL)
+    {
+        return NULL;
+    }
+    if (n > *nalloc)
+    {
+        *nalloc = n;
+        srenew(*buf, *nalloc);
+    }
+    std::memcpy(*buf, src, n*sizeof(**buf));
+    return *buf;
+}
+
+void
+ParallelFrameAnalyzer::Worker::setFrame(const t_trxframe &src, const t_pbc *pbcSrc)
+{
+    fr   = src;
+    fr.x = copyFrameVectors(&x, &nalloc_x, src.x, src.natoms);
+    fr.v = copyFrameVectors(&v, &nalloc_v, src.v, src.natoms);
+    fr.f = copyFrameVectors(&f, &nalloc_f, src.f, src.natoms);
+    bPBC = (pbcSrc != NULL);
+    if (bPBC)
+    {
+        pbc = *pbcSrc;
+    }
+}
+
+ParallelFrameAnalyzer::ParallelFrameAnalyzer(
+        TrajectoryAnalysisModule  *module,
+        const SelectionCollection &selections,
+        int                        nthreads)
+    : module_(module), bStop_(false)
+{
+    AnalysisDataParallelOptions dataOptions(nthreads);
+    workers_.reserve(nthreads);
+    for (int i = 0; i < nthreads; ++i)
+    {
+        WorkerPointer worker(new Worker());
+        worker->parent = this;
+        worker->pdata  = module->startFrames(dataOptions, selections);
+        workers_.push_back(move(worker));
+    }
+    tMPI_Thread_mutex_init(&mutex_);
+    tMPI_Thread_cond_init(&cond_);
+    for (int i = 0; i < nthreads; ++i)
+    {
+        if (tMPI_Thread_create(&workers_[i]->thread, &workerThread, workers_[i].get()) != 0)
+        {
+            stopThreads();
+            GMX_THROW(InternalError("Could not start threads for analyzing frames"));
+        }
+        workers_[i]->bStarted = true;
+    }
+}
+
+ParallelFrameAnalyzer::~ParallelFrameAnalyzer()
+{
+    stopThreads();
+}
+
+int
+ParallelFrameAnalyzer::busyCount() const
+{
+    int count = 0;
+    for (size_t i = 0; i < workers_.size(); ++i)
+    {
+        if (workers_[i]->frnr >= 0)
+        {
+            ++count;
+        }
+    }
+    return count;
+}
+
+void
+ParallelFrameAnalyzer::stopThreads()
+{
+    if (bStop_)
+    {
+        return;
+    }
+    tMPI_Thread_mutex_lock(&mutex_);
+    bStop_ = true;
+    tMPI_Thread_cond_broadcast(&cond_);
+    tMPI_Thread_mutex_unlock(&mutex_);
+    for (size_t i = 0; i < workers_.size(); ++i)
+    {
+        if (workers_[i]->bStarted)
+        {
+            tMPI_Thread_join(workers_[i]->thread, NULL);
+            workers_[i]->bStarted = false;
+        }
+    }
+    tMPI_Thread_cond_destroy(&cond_);
+    tMPI_Thread_mutex_destroy(&mutex_);
+}
+
+void
+ParallelFrameAnalyzer::analyzeFrame(int frnr, const t_trxframe &fr, const t_pbc *pbc)
+{
+    const int maxPending = 2*static_cast<int>(workers_.size()) - 1;
+    Worker   *worker     = NULL;
+
+    tMPI_Thread_mutex_lock(&mutex_);
+    while (worker == NULL)
+    {
+        int oldest = frnr;
+        for (size_t i = 0; i < workers_.size(); ++i)
+        {
+            if (workers_[i]->frnr < 0)
+            {
+                worker = workers_[i].get();
+            }
+            else if (workers_[i]->frnr < oldest)
+            {
+                oldest = workers_[i]->frnr;
+            }
+        }
+        if (worker == NULL || frnr - oldest >= maxPending)
+        {
+            worker = NULL;
+            tMPI_Thread_cond_wait(&cond_, &mutex_);
+        }
+    }
+    tMPI_Thread_mutex_unlock(&mutex_);
+
+    // The thread does not access its data while it is idle.
+    worker->setFrame(fr, pbc);
+    worker->pdata->copySelections();
+
+    tMPI_Thread_mutex_lock(&mutex_);
+    worker->frnr = frnr;
+    tMPI_Thread_cond_broadcast(&cond_);
+    if (frnr == 0)
+    {
+        while (worker->frnr >= 0)
+        {
+            tMPI_Thread_cond_wait(&cond_, &mutex_);
+        }
+    }
+    tMPI_Thread_mutex_unlock(&mutex_);
+}
+
+void
+ParallelFrameAnalyzer::finish()
+{
+    tMPI_Thread_mutex_lock(&mutex_);
+    while (busyCount() > 0)
+    {
+        tMPI_Thread_cond_wait(&cond_, &mutex_);
+    }
+    tMPI_Thread_mutex_unlock(&mutex_);
+    stopThreads();
+    for (size_t i = 0; i < workers_.size(); ++i)
+    {
+        module_->finishFrames(workers_[i]->pdata.get());
+        if (workers_[i]->pdata.get() != NULL)
+        {
+            workers_[i]->pdata->finish();
+        }
+        workers_[i]->pdata.reset();
+    }
+}
+
+void *
+ParallelFrameAnalyzer::workerThread(void *arg)
+{
+    Worker                &worker = *static_cast<Worker *>(arg);
+    ParallelFrameAnalyzer &parent = *worker.parent;
+
+    tMPI_Thread_mutex_lock(&parent.mutex_);
+    while (true)
+    {
+        while (worker.frnr < 0 && !parent.bStop_)
+        {
+            tMPI_Thread_cond_wait(&parent.cond_, &parent.mutex_);
+        }
+        if (worker.frnr < 0)
+        {
+            break;
+        }
+        tMPI_Thread_mutex_unlock(&parent.mutex_);
+        try
+        {
+            parent.module_->analyzeFrame(worker.frnr, worker.fr,
+                                         worker.bPBC ? &worker.pbc : NULL,
+                                         worker.pdata.get());
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+        tMPI_Thread_mutex_lock(&parent.mutex_);
+        worker.frnr = -1;
+        tMPI_Thread_cond_broadcast(&parent.cond_);
+    }
+    tMPI_Thread_mutex_unlock(&parent.mutex_);
+    return NULL;
+}
+
+}   // namespace
+
 /********************************************************************
  * TrajectoryAnalysisCommandLineRunner::Impl
  */
@@ -200,10 +531,20 @@ TrajectoryAnalysisCommandLineRunner::run(int argc, char *argv[])
     t_pbc  pbc;
     t_pbc *ppbc = settings.hasPBC() ? &pbc : NULL;
 
-    int    nframes = 0;
-    AnalysisDataParallelOptions         dataOptions;
-    TrajectoryAnalysisModuleDataPointer pdata(
-            module->startFrames(dataOptions, selections));
+    int                                 nframes  = 0;
+    const int                           nthreads = common.threadCount();
+    TrajectoryAnalysisModuleDataPointer pdata;
+    gmx_unique_ptr<ParallelFrameAnalyzer>::type parallel;
+    if (nthreads > 1)
+    {
+        fprintf(stderr, "\nAnalyzing frames using %d threads\n", nthreads);
+        parallel.reset(new ParallelFrameAnalyzer(module, selections, nthreads));
+    }
+    else
+    {
+        AnalysisDataParallelOptions dataOptions;
+        pdata = module->startFrames(dataOptions, selections);
+    }
     do
     {
         common.initFrame();
@@ -214,17 +555,32 @@ TrajectoryAnalysisCommandLineRunner::run(int argc, char *argv[])
         }
 
         selections.evaluate(&frame, ppbc);
-        module->analyzeFrame(nframes, frame, ppbc, pdata.get());
+        if (parallel)
+        {
+            parallel->analyzeFrame(nframes, frame, ppbc);
+        }
+        else
+        {
+            module->analyzeFrame(nframes, frame, ppbc, pdata.get());
+        }
 
         nframes++;
     }
     while (common.readNextFrame());
-    module->finishFrames(pdata.get());
-    if (pdata.get() != NULL)
+    if (parallel)
+    {
+        parallel->finish();
+        parallel.reset();
+    }
+    else
     {
-        pdata->finish();
+        module->finishFrames(pdata.get());
+        if (pdata.get() != NULL)
+        {
+            pdata->finish();
+        }
+        pdata.reset();
     }
-    pdata.reset();
 
     if (common.hasTrajectory())
     {
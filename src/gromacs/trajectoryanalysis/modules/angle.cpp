@@ -312,7 +312,7 @@ Angle::~Angle()
 
 
 void
-Angle::initOptions(Options *options, TrajectoryAnalysisSettings * /*settings*/)
+Angle::initOptions(Options *options, TrajectoryAnalysisSettings *settings)
 {
     static const char *const desc[] = {
         "[THISMODULE] computes different types of angles between vectors.",
@@ -396,6 +396,8 @@ Angle::initOptions(Options *options, TrajectoryAnalysisSettings * /*settings*/)
                                        .dynamicMask().storeVector(&sel2_)
                                        .multiValue()
                                        .description("Second analysis/vector selection"));
+
+    settings->setFlag(TrajectoryAnalysisSettings::efAllowParallelFrames);
 }
 
 
@@ -702,7 +704,7 @@ Angle::analyzeFrame(int frnr, const t_trxframe &fr, t_pbc *pbc,
                 clear_rvec(c2);
                 break;
             case 's':
-                copy_rvec(sel2_[g].position(0).x(), c2);
+                copy_rvec(sel2[g].position(0).x(), c2);
                 break;
         }
         dh.selectDataSet(g);
@@ -766,7 +768,8 @@ Angle::analyzeFrame(int frnr, const t_trxframe &fr, t_pbc *pbc,
                             calc_vec(natoms2_, x, pbc, v2, c2);
                             break;
                         case 't':
-                            // FIXME: This is not parallelizable.
+                            // The first frame is analyzed before any other
+                            // frame is started, also in parallel runs.
                             if (frnr == 0)
                             {
                                 copy_rvec(v1, vt0_[g][n]);
@@ -47,14 +47,18 @@
 
 #include <string.h>
 
+#include <algorithm>
+
 #include "gromacs/legacyheaders/oenv.h"
 #include "gromacs/legacyheaders/rmpbc.h"
 #include "gromacs/legacyheaders/smalloc.h"
 #include "gromacs/legacyheaders/statutil.h"
+#include "gromacs/fileio/filenm.h"
 #include "gromacs/fileio/tpxio.h"
 #include "gromacs/fileio/trxio.h"
 #include "gromacs/legacyheaders/statutil.h"
 #include "gromacs/legacyheaders/vec.h"
+#include "gromacs/legacyheaders/thread_mpi/threads.h"
 
 #include "gromacs/options/basicoptions.h"
 #include "gromacs/options/filenameoption.h"
@@ -75,11 +79,37 @@ namespace gmx
 class TrajectoryAnalysisRunnerCommon::Impl
 {
     public:
+        //! States of the frame prefetching thread.
+        enum PrefetchState
+        {
+            ePrefetchIdle,      //!< Waiting for a request.
+            ePrefetchRequested, //!< Reading the next frame.
+            ePrefetchDone,      //!< The next frame is ready.
+            ePrefetchStop       //!< The thread should exit.
+        };
+
         Impl(TrajectoryAnalysisSettings *settings);
         ~Impl();
 
         void finishTrajectory();
 
+        /*! \brief
+         * Starts a thread that reads frames ahead of the analysis.
+         *
+         * Only done for formats where reading into a separate frame buffer
+         * does not share any data with the current frame.
+         * Does nothing if threads are not supported.
+         */
+        void startPrefetching();
+        //! Requests reading the frame after \p fr into \p frNext_.
+        void requestPrefetch();
+        //! Waits for a requested frame and returns read_next_frame() result.
+        bool waitPrefetch();
+        //! Stops and joins the prefetching thread if it is running.
+        void stopPrefetching();
+        //! Thread function for the prefetching thread.
+        static void *prefetchThread(void *arg);
+
         TrajectoryAnalysisSettings &settings_;
         TopologyInformation         topInfo_;
 
@@ -92,6 +122,8 @@ class TrajectoryAnalysisRunnerCommon::Impl
         double                      startTime_;
         double                      endTime_;
         double                      deltaTime_;
+        //! Number of threads for analyzing frames.
+        int                         nthreads_;
 
         gmx_ana_indexgrps_t        *grps_;
         bool                        bTrajOpen_;
@@ -101,14 +133,28 @@ class TrajectoryAnalysisRunnerCommon::Impl
         //! Used to store the status variable from read_first_frame().
         t_trxstatus                *status_;
         output_env_t                oenv_;
+
+        //! Whether the prefetching thread is running.
+        bool                        bPrefetch_;
+        //! Buffer for the frame read by the prefetching thread.
+        t_trxframe                 *frNext_;
+        //! Return value of read_next_frame() for \p frNext_.
+        bool                        bNextFrameOk_;
+        //! State of the prefetching thread, protected by \p prefetchMutex_.
+        PrefetchState               prefetchState_;
+        tMPI_Thread_t               prefetchThread_;
+        tMPI_Thread_mutex_t         prefetchMutex_;
+        tMPI_Thread_cond_t          prefetchCond_;
 };
 
 
 TrajectoryAnalysisRunnerCommon::Impl::Impl(TrajectoryAnalysisSettings *settings)
     : settings_(*settings),
-      startTime_(0.0), endTime_(0.0), deltaTime_(0.0),
+      startTime_(0.0), endTime_(0.0), deltaTime_(0.0), nthreads_(1),
       grps_(NULL),
-      bTrajOpen_(false), fr(NULL), gpbc_(NULL), status_(NULL), oenv_(NULL)
+      bTrajOpen_(false), fr(NULL), gpbc_(NULL), status_(NULL), oenv_(NULL),
+      bPrefetch_(false), frNext_(NULL), bNextFrameOk_(false),
+      prefetchState_(ePrefetchIdle)
 {
 }
 
@@ -128,6 +174,13 @@ TrajectoryAnalysisRunnerCommon::Impl::~Impl()
         sfree(fr->f);
         sfree(fr);
     }
+    if (frNext_)
+    {
+        sfree(frNext_->x);
+        sfree(frNext_->v);
+        sfree(frNext_->f);
+        sfree(frNext_);
+    }
     if (oenv_ != NULL)
     {
         output_env_done(oenv_);
@@ -138,6 +191,7 @@ TrajectoryAnalysisRunnerCommon::Impl::~Impl()
 void
 TrajectoryAnalysisRunnerCommon::Impl::finishTrajectory()
 {
+    stopPrefetching();
     if (bTrajOpen_)
     {
         close_trx(status_);
@@ -150,6 +204,137 @@ TrajectoryAnalysisRunnerCommon::Impl::finishTrajectory()
     }
 }
 
+
+void
+TrajectoryAnalysisRunnerCommon::Impl::startPrefetching()
+{
+    const int ftp = fn2ftp(trjfile_.c_str());
+    if (ftp != efXTC && ftp != efTRR && ftp != efTRJ)
+    {
+        return;
+    }
+    if (tMPI_Thread_support() == TMPI_THREAD_SUPPORT_NO)
+    {
+        return;
+    }
+
+    // The x, v and f arrays are allocated to the same size as those of the
+    // first frame; trr reading allocates them itself if they are NULL.
+    snew(frNext_, 1);
+    *frNext_    = *fr;
+    frNext_->x  = NULL;
+    frNext_->v  = NULL;
+    frNext_->f  = NULL;
+    if (fr->x != NULL)
+    {
+        snew(frNext_->x, fr->natoms);
+    }
+    if (fr->v != NULL)
+    {
+        snew(frNext_->v, fr->natoms);
+    }
+    if (fr->f != NULL)
+    {
+        snew(frNext_->f, fr->natoms);
+    }
+
+    prefetchState_ = ePrefetchIdle;
+    tMPI_Thread_mutex_init(&prefetchMutex_);
+    tMPI_Thread_cond_init(&prefetchCond_);
+    if (tMPI_Thread_create(&prefetchThread_, &prefetchThread, this) != 0)
+    {
+        tMPI_Thread_cond_destroy(&prefetchCond_);
+        tMPI_Thread_mutex_destroy(&prefetchMutex_);
+        return;
+    }
+    bPrefetch_ = true;
+    requestPrefetch();
+}
+
+
+void
+TrajectoryAnalysisRunnerCommon::Impl::requestPrefetch()
+{
+    // read_next_frame() uses the time and other properties of the previous
+    // frame, so make the prefetch buffer look like the current frame.
+    rvec *x     = frNext_->x;
+    rvec *v     = frNext_->v;
+    rvec *f     = frNext_->f;
+    *frNext_    = *fr;
+    frNext_->x  = x;
+    frNext_->v  = v;
+    frNext_->f  = f;
+
+    tMPI_Thread_mutex_lock(&prefetchMutex_);
+    prefetchState_ = ePrefetchRequested;
+    tMPI_Thread_cond_broadcast(&prefetchCond_);
+    tMPI_Thread_mutex_unlock(&prefetchMutex_);
+}
+
+
+bool
+TrajectoryAnalysisRunnerCommon::Impl::waitPrefetch()
+{
+    tMPI_Thread_mutex_lock(&prefetchMutex_);
+    while (prefetchState_ == ePrefetchRequested)
+    {
+        tMPI_Thread_cond_wait(&prefetchCond_, &prefetchMutex_);
+    }
+    prefetchState_ = ePrefetchIdle;
+    tMPI_Thread_mutex_unlock(&prefetchMutex_);
+    return bNextFrameOk_;
+}
+
+
+void
+TrajectoryAnalysisRunnerCommon::Impl::stopPrefetching()
+{
+    if (!bPrefetch_)
+    {
+        return;
+    }
+    waitPrefetch();
+    tMPI_Thread_mutex_lock(&prefetchMutex_);
+    prefetchState_ = ePrefetchStop;
+    tMPI_Thread_cond_broadcast(&prefetchCond_);
+    tMPI_Thread_mutex_unlock(&prefetchMutex_);
+    tMPI_Thread_join(prefetchThread_, NULL);
+    tMPI_Thread_cond_destroy(&prefetchCond_);
+    tMPI_Thread_mutex_destroy(&prefetchMutex_);
+    bPrefetch_ = false;
+}
+
+
+void *
+TrajectoryAnalysisRunnerCommon::Impl::prefetchThread(void *arg)
+{
+    Impl *impl = static_cast<Impl *>(arg);
+
+    tMPI_Thread_mutex_lock(&impl->prefetchMutex_);
+    while (true)
+    {
+        while (impl->prefetchState_ != ePrefetchRequested
+               && impl->prefetchState_ != ePrefetchStop)
+        {
+            tMPI_Thread_cond_wait(&impl->prefetchCond_, &impl->prefetchMutex_);
+        }
+        if (impl->prefetchState_ == ePrefetchStop)
+        {
+            break;
+        }
+        // The main thread does not access frNext_ or the trajectory
+        // while a request is being processed.
+        tMPI_Thread_mutex_unlock(&impl->prefetchMutex_);
+        bool bOk = read_next_frame(impl->oenv_, impl->status_, impl->frNext_);
+        tMPI_Thread_mutex_lock(&impl->prefetchMutex_);
+        impl->bNextFrameOk_  = bOk;
+        impl->prefetchState_ = ePrefetchDone;
+        tMPI_Thread_cond_broadcast(&impl->prefetchCond_);
+    }
+    tMPI_Thread_mutex_unlock(&impl->prefetchMutex_);
+    return NULL;
+}
+
 /*********************************************************************
  * TrajectoryAnalysisRunnerCommon
  */
@@ -214,6 +399,11 @@ TrajectoryAnalysisRunnerCommon::initOptions(Options *options)
         options->addOption(BooleanOption("pbc").store(&settings.impl_->bPBC)
                                .description("Use periodic boundary conditions for distance calculation"));
     }
+    if (settings.hasFlag(TrajectoryAnalysisSettings::efAllowParallelFrames))
+    {
+        options->addOption(IntegerOption("nt").store(&impl_->nthreads_)
+                               .description("Number of threads for analyzing frames"));
+    }
 }
 
 
@@ -247,6 +437,10 @@ TrajectoryAnalysisRunnerCommon::optionsFinished(Options *options)
     {
         setTimeValue(TDELTA, impl_->deltaTime_);
     }
+    if (impl_->nthreads_ < 1)
+    {
+        GMX_THROW(InvalidInputError("Number of threads should be at least one"));
+    }
 }
 
 
@@ -400,6 +594,11 @@ TrajectoryAnalysisRunnerCommon::initFirstFrame()
         impl_->gpbc_ = gmx_rmpbc_init(&top.topology()->idef, top.ePBC(),
                                       impl_->fr->natoms);
     }
+    if (impl_->bTrajOpen_)
+    {
+        // Read the next frame while the current one is analyzed.
+        impl_->startPrefetching();
+    }
 }
 
 
@@ -407,7 +606,17 @@ bool
 TrajectoryAnalysisRunnerCommon::readNextFrame()
 {
     bool bContinue = false;
-    if (hasTrajectory())
+    if (impl_->bPrefetch_)
+    {
+        bContinue = impl_->waitPrefetch();
+        // On failure, keep the last frame as the current one.
+        if (bContinue)
+        {
+            std::swap(impl_->fr, impl_->frNext_);
+            impl_->requestPrefetch();
+        }
+    }
+    else if (hasTrajectory())
     {
         bContinue = read_next_frame(impl_->oenv_, impl_->status_, impl_->fr);
     }
@@ -429,6 +638,18 @@ TrajectoryAnalysisRunnerCommon::initFrame()
 }
 
 
+int
+TrajectoryAnalysisRunnerCommon::threadCount() const
+{
+    if (!impl_->settings_.hasFlag(TrajectoryAnalysisSettings::efAllowParallelFrames)
+        || tMPI_Thread_support() == TMPI_THREAD_SUPPORT_NO)
+    {
+        return 1;
+    }
+    return impl_->nthreads_;
+}
+
+
 bool
 TrajectoryAnalysisRunnerCommon::hasTrajectory() const
 {
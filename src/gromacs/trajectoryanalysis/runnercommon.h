@@ -116,6 +116,13 @@ class TrajectoryAnalysisRunnerCommon
          */
         void initFrame();
 
+        /*! \brief
+         * Returns the number of threads to use for analyzing frames.
+         *
+         * Returns one if the analysis module does not allow parallel
+         * frames or threads are not supported.
+         */
+        int threadCount() const;
         //! Returns true if input data comes from a trajectory.
         bool hasTrajectory() const;
         //! Returns the topology information object.
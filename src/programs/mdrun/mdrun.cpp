@@ -427,6 +427,7 @@ int gmx_mdrun(int argc, char *argv[])
     gmx_bool        bRerunVSite   = FALSE;
     gmx_bool        bConfout      = TRUE;
     gmx_bool        bReproducible = FALSE;
+    gmx_bool        bAsyncIO      = FALSE;
 
     int             npme          = -1;
     int             nstlist       = 0;
@@ -530,6 +531,8 @@ int gmx_mdrun(int argc, char *argv[])
           "Print all forces larger than this (kJ/mol nm)" },
         { "-reprod",  FALSE, etBOOL, {&bReproducible},
           "Try to avoid optimizations that affect binary reproducibility" },
+        { "-asyncio", FALSE, etBOOL, {&bAsyncIO},
+          "Write trajectory frames from a separate I/O thread on the master node" },
         { "-cpt",     FALSE, etREAL, {&cpt_period},
           "Checkpoint interval (minutes)" },
         { "-cpnum",   FALSE, etBOOL, {&bKeepAndNumCPT},
@@ -710,6 +713,7 @@ int gmx_mdrun(int argc, char *argv[])
     Flags = Flags | (bConfout      ? MD_CONFOUT      : 0);
     Flags = Flags | (bRerunVSite   ? MD_RERUN_VSITE  : 0);
     Flags = Flags | (bReproducible ? MD_REPRODUCIBLE : 0);
+    Flags = Flags | (bAsyncIO      ? MD_ASYNCIO      : 0);
     Flags = Flags | (bAppendFiles  ? MD_APPENDFILES  : 0);
     Flags = Flags | (opt2parg_bSet("-append", asize(pa), pa) ? MD_APPENDFILESSET : 0);
     Flags = Flags | (bKeepAndNumCPT ? MD_KEEPANDNUMCPT : 0);
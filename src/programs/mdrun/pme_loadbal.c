@@ -663,6 +663,17 @@ gmx_bool pme_load_balance(pme_load_balancing_t pme_lb,
     ir->nstcalclr    = set->nstcalclr;
     ic->ewaldcoeff_q = set->ewaldcoeff_q;
 
+    if (pme_lb->cutoff_scheme == ecutsVERLET && nbv->nstprune > 0)
+    {
+        /* The pruned list should contain all pairs within the new
+         * cut-off plus the same buffer for the pruning interval.
+         * The list itself is generated with the new rlist at the next
+         * search step, after which it contains all pairs we need.
+         */
+        nbv->rlist_prune = min(max(ic->rcoulomb, ic->rvdw) + nbv->rbuf_prune,
+                               ic->rlist);
+    }
+
     bUsesSimpleTables = uses_simple_tables(ir->cutoff_scheme, nbv, 0);
     if (pme_lb->cutoff_scheme == ecutsVERLET &&
         nbv->grp[0].kernel_type == nbnxnk8x8x8_CUDA)
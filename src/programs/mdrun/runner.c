@@ -83,6 +83,7 @@
 
 #include "gromacs/fileio/tpxio.h"
 #include "gromacs/mdlib/nbnxn_search.h"
+#include "gromacs/mdlib/nbnxn_async_search.h"
 #include "gromacs/mdlib/nbnxn_consts.h"
 #include "gromacs/timing/wallcycle.h"
 #include "gromacs/utility/gmxmpi.h"
@@ -724,6 +725,209 @@ static void prepare_verlet_scheme(FILE                           *fplog,
     }
 }
 
+/* Sets up dynamic pruning of the pair list every nstprune steps when
+ * requested with the env.var. GMX_NBNXN_DYNAMIC_PRUNE=nstprune.
+ * The pruned list should stay valid for nstprune steps, so its radius
+ * is the Verlet buffer estimate for nstlist=nstprune.
+ */
+static void prepare_dynamic_pruning(FILE             *fplog,
+                                    const t_commrec  *cr,
+                                    t_inputrec       *ir,
+                                    const gmx_mtop_t *mtop,
+                                    matrix            box,
+                                    t_forcerec       *fr,
+                                    gmx_bool          bRerun)
+{
+    const char            *env;
+    char                  *end;
+    const char            *reason;
+    int                    nstprune, nstlist_orig;
+    verletbuf_list_setup_t ls;
+    real                   rlist_prune;
+
+    env = getenv("GMX_NBNXN_DYNAMIC_PRUNE");
+    if (env == NULL || ir->cutoff_scheme != ecutsVERLET)
+    {
+        return;
+    }
+
+    nstprune = strtol(env, &end, 10);
+
+    reason = NULL;
+    if (end == env || *end != '\0' || nstprune <= 0 || nstprune >= ir->nstlist)
+    {
+        reason = "with a pruning interval that is not between 0 and nstlist";
+    }
+    else if (fr->nbv->bUseGPU ||
+             !nbnxn_kernel_pairlist_simple(fr->nbv->grp[0].kernel_type))
+    {
+        reason = "with GPUs";
+    }
+    else if (!EI_DYNAMICS(ir->eI) || bRerun)
+    {
+        reason = "without dynamics";
+    }
+    else if (ir->verletbuf_tol <= 0)
+    {
+        reason = "without verlet-buffer-tolerance";
+    }
+
+    rlist_prune = 0;
+    if (reason == NULL)
+    {
+        verletbuf_get_list_setup(FALSE, &ls);
+
+        nstlist_orig = ir->nstlist;
+        ir->nstlist  = nstprune;
+        calc_verlet_buffer_size(mtop, det(box), ir, &ls, NULL, &rlist_prune);
+        ir->nstlist  = nstlist_orig;
+
+        if (rlist_prune >= ir->rlist)
+        {
+            reason = "as the pruning radius is not smaller than rlist";
+        }
+    }
+
+    if (reason != NULL)
+    {
+        md_print_warn(cr, fplog,
+                      "NOTE: Dynamic pruning is not supported %s, ignoring GMX_NBNXN_DYNAMIC_PRUNE\n",
+                      reason);
+        return;
+    }
+
+    fr->nbv->nstprune    = nstprune;
+    fr->nbv->rlist_prune = rlist_prune;
+    /* Store the buffer, PME load balancing can change the cut-off */
+    fr->nbv->rbuf_prune  = rlist_prune - max(ir->rcoulomb, ir->rvdw);
+
+    md_print_info(cr, fplog,
+                  "Pruning the pair list every %d steps with radius %g, rlist is %g\n\n",
+                  nstprune, rlist_prune, ir->rlist);
+}
+
+/* Sets up generating the pair list in the background when requested
+ * with the env.var. GMX_NBNXN_ASYNC_SEARCH and supported.
+ * The list is generated lag steps ahead and thus used for nstlist+lag
+ * steps, so the buffer is increased using the Verlet buffer estimate.
+ * The OpenMP threads of the helper thread are taken from the thread
+ * count of all modules, so the cores are not oversubscribed.
+ * The helper thread is started first, so the thread counts are only
+ * reduced when it runs. This should be called before the OpenMP thread
+ * counts are used.
+ * Returns the helper thread data, NULL when the search is not done
+ * in the background.
+ */
+static nbnxn_async_search_t prepare_async_pairsearch(FILE             *fplog,
+                                    const t_commrec  *cr,
+                                    t_inputrec       *ir,
+                                    const gmx_mtop_t *mtop,
+                                    matrix            box,
+                                    gmx_bool          bUseGPU,
+                                    gmx_bool          bRerun,
+                                    int               repl_ex_nst,
+                                    int              *lag,
+                                    real             *rlist_inc)
+{
+    const char            *env;
+    char                  *end;
+    const char            *reason;
+    int                    nstlist_orig, nthread, mod;
+    nbnxn_async_search_t   as;
+    verletbuf_list_setup_t ls;
+    real                   rlist_lag;
+
+    env = getenv("GMX_NBNXN_ASYNC_SEARCH");
+    if (env == NULL || ir->cutoff_scheme != ecutsVERLET ||
+        !(cr->duty & DUTY_PP))
+    {
+        return NULL;
+    }
+
+    *lag = strtol(env, &end, 10);
+    if (end == env || *end != '\0' || *lag <= 0)
+    {
+        *lag = 1;
+    }
+
+    reason = NULL;
+    if (PAR(cr))
+    {
+        reason = "with multiple ranks";
+    }
+    else if (bUseGPU)
+    {
+        reason = "with GPUs";
+    }
+    else if (gmx_omp_nthreads_get(emntDefault) < 2)
+    {
+        reason = "with a single OpenMP thread";
+    }
+    else if (!EI_DYNAMICS(ir->eI) || bRerun)
+    {
+        reason = "without dynamics";
+    }
+    else if (repl_ex_nst > 0 || ir->efep != efepNO)
+    {
+        reason = "with replica exchange or free-energy calculations";
+    }
+    else if (ir->verletbuf_tol <= 0)
+    {
+        reason = "without verlet-buffer-tolerance";
+    }
+    else if (*lag >= ir->nstlist)
+    {
+        reason = "with a lag larger than nstlist-1";
+    }
+
+    *rlist_inc = 0;
+    if (reason == NULL)
+    {
+        verletbuf_get_list_setup(FALSE, &ls);
+
+        nstlist_orig = ir->nstlist;
+        ir->nstlist  = nstlist_orig + *lag;
+        calc_verlet_buffer_size(mtop, det(box), ir, &ls, NULL, &rlist_lag);
+        ir->nstlist  = nstlist_orig;
+
+        *rlist_inc = max(0, rlist_lag - ir->rlist);
+        if (sqr(ir->rlist + *rlist_inc) >= max_cutoff2(ir->ePBC, box))
+        {
+            reason = "as the increased pair-list cut-off does not fit in the box";
+        }
+    }
+
+    if (reason != NULL)
+    {
+        md_print_warn(cr, fplog,
+                      "NOTE: Background pair search is not supported %s, ignoring GMX_NBNXN_ASYNC_SEARCH\n",
+                      reason);
+        return NULL;
+    }
+
+    /* Give half of the threads to the helper thread */
+    nthread = max(1, gmx_omp_nthreads_get(emntPairsearch)/2);
+    as      = nbnxn_async_search_create(nthread);
+    if (as == NULL)
+    {
+        md_print_warn(cr, fplog,
+                      "NOTE: Could not start a helper thread, the pair search is not done in the background\n");
+        return NULL;
+    }
+    for (mod = 0; mod < emntNR; mod++)
+    {
+        gmx_omp_nthreads_set(mod, max(1, gmx_omp_nthreads_get(mod) - nthread));
+    }
+
+    md_print_info(cr, fplog,
+                  "Generating the pair list %d step(s) ahead on a helper thread using %d OpenMP threads,\n"
+                  "with rlist %g instead of %g, using %d OpenMP threads for the rest\n\n",
+                  *lag, nthread, ir->rlist + *rlist_inc, ir->rlist,
+                  gmx_omp_nthreads_get(emntDefault));
+
+    return as;
+}
+
 static void convert_to_verlet_scheme(FILE *fplog,
                                      t_inputrec *ir,
                                      gmx_mtop_t *mtop, real box_vol)
@@ -1073,6 +1277,9 @@ int mdrunner(gmx_hw_opt_t *hw_opt,
     t_commrec                *cr_old       = cr;
     int                       nthreads_pme = 1;
     int                       nthreads_pp  = 1;
+    nbnxn_async_search_t      async_search;
+    int                       async_lag = 0;
+    real                      async_rlist_inc = 0;
     gmx_membed_t              membed       = NULL;
     gmx_hw_info_t            *hwinfo       = NULL;
     /* The master rank decides early on bUseGPU and broadcasts this later */
@@ -1534,6 +1741,11 @@ int mdrunner(gmx_hw_opt_t *hw_opt,
     /* TODO nthreads_pp is only used for pinning threads.
      * This is a temporary solution until we have a hw topology library.
      */
+    async_search = prepare_async_pairsearch(fplog, cr, inputrec, mtop, box,
+                                            bUseGPU, (Flags & MD_RERUN),
+                                            repl_ex_nst,
+                                            &async_lag, &async_rlist_inc);
+
     nthreads_pp  = gmx_omp_nthreads_get(emntNonbonded);
     nthreads_pme = gmx_omp_nthreads_get(emntPME);
 
@@ -1585,6 +1797,14 @@ int mdrunner(gmx_hw_opt_t *hw_opt,
          */
         fr->bSepDVDL = ((Flags & MD_SEPPOT) == MD_SEPPOT);
 
+        prepare_dynamic_pruning(fplog, cr, inputrec, mtop, box, fr,
+                                (Flags & MD_RERUN));
+        if (async_search != NULL)
+        {
+            nbnxn_async_search_init(fplog, async_search, fr->nbv, inputrec, fr,
+                                    async_lag, async_rlist_inc);
+        }
+
         /* Initialize QM-MM */
         if (fr->bQMMM)
         {
@@ -1752,6 +1972,11 @@ int mdrunner(gmx_hw_opt_t *hw_opt,
                                       Flags,
                                       walltime_accounting);
 
+        if (fr->nbv != NULL)
+        {
+            nbnxn_async_search_done(fr->nbv);
+        }
+
         if (inputrec->ePull != epullNO)
         {
             finish_pull(inputrec->pull);